@@ -20,6 +20,9 @@
 #define DOSBOX_BIOS_DISK_H
 
 #include <stdio.h>
+#include <map>
+#include <string>
+#include <vector>
 #ifndef DOSBOX_MEM_H
 #include "mem.h"
 #endif
@@ -43,19 +46,30 @@ struct diskGeo {
 };
 extern diskGeo DiskGeometryList[];
 
+class fatDrive;
+
 class imageDisk  {
 public:
 	Bit8u Read_Sector(Bit32u head,Bit32u cylinder,Bit32u sector,void * data);
 	Bit8u Write_Sector(Bit32u head,Bit32u cylinder,Bit32u sector,void * data);
 	Bit8u Read_AbsoluteSector(Bit32u sectnum, void * data);
 	Bit8u Write_AbsoluteSector(Bit32u sectnum, void * data);
+	/* Transfer count consecutive sectors with a single host file access */
+	Bit8u Read_AbsoluteSectors(Bit32u sectnum, Bit32u count, void * data);
+	Bit8u Write_AbsoluteSectors(Bit32u sectnum, Bit32u count, void * data);
 
 	void Set_Geometry(Bit32u setHeads, Bit32u setCyl, Bit32u setSect, Bit32u setSectSize);
 	void Get_Geometry(Bit32u * getHeads, Bit32u *getCyl, Bit32u *getSect, Bit32u *getSectSize);
 	Bit8u GetBiosType(void);
 	Bit32u getSectSize(void);
+	/* Send writes to a delta file in the delta directory from now on,
+	 * the image file is only read. Returns false if the delta can't be used. */
+	bool AttachDelta(void);
+	/* Keep writes in memory from now on, the image file is only read */
+	void AttachOverlay(void);
+
 	imageDisk(FILE *imgFile, const char *imgName, Bit32u imgSizeK, bool isHardDisk);
-	~imageDisk() { if(diskimg != NULL) { fclose(diskimg); }	};
+	~imageDisk();
 
 	bool hardDrive;
 	bool active;
@@ -65,9 +79,33 @@ public:
 
 	Bit32u sector_size;
 	Bit32u heads,cylinders,sectors;
+	/* The drive that caches the FAT of this image, told about every write
+	 * so that changes made through INT 13h or 26h reach its caches */
+	fatDrive *cacheOwner;
 private:
+	Bit8u ReadImage(Bit32u bytenum, size_t len, Bit8u *data);
+	Bit8u WriteImage(Bit32u bytenum, size_t len, const Bit8u *data);
+	bool CreateDelta(void);
+	Bit8u ReadBlocks(Bit32u block, Bit32u blocks, Bit8u *dst);
+	Bit8u WriteBlocks(Bit32u block, Bit32u blocks, const Bit8u *data);
+	bool InDelta(Bit32u block) const {
+		return block < delta_blocks && (delta_map[block >> 3] >> (block & 7)) & 1;
+	}
+
 	Bit32u current_fpos;
 	enum { NONE,READ,WRITE } last_action;
+	/* Sparse delta file: a header, a bitmap of changed blocks and then every
+	 * block of the image at its own offset, only changed ones are written.
+	 * delta_blocks is 0 when writes go to the image itself. The header keeps
+	 * the image size and delta_stamp, its modification time. Without a delta
+	 * file the changed blocks are kept in overlay. */
+	std::string delta_path;
+	FILE *delta;
+	std::vector<Bit8u> delta_map;
+	std::map<Bit32u, std::vector<Bit8u> > overlay;
+	Bit32u delta_blocks;
+	Bit32u delta_data;
+	Bit64u delta_stamp;
 };
 
 void updateDPT(void);
@@ -84,6 +122,10 @@ extern Bit16u imgDTASeg; /* Real memory location of temporary DTA pointer for fa
 extern RealPt imgDTAPtr; /* Real memory location of temporary DTA pointer for fat image disk access */
 extern DOS_DTA *imgDTA;
 
+/* Directory for the delta files of disk images, empty to write images in place */
+void DISK_SetDeltaDirectory(const char *dir);
+bool DISK_DeltaEnabled(void);
+
 void swapInDisks(void);
 void swapInNextDisk(bool pressed); // libretro fix
 bool getSwapRequest(void);
@@ -73,6 +73,8 @@ Bits CPU_Core_Normal_Trap_Run(void);
 Bits CPU_Core_Simple_Run(void);
 Bits CPU_Core_Simple_Trap_Run(void);
 Bits CPU_Core_Full_Run(void);
+Bits CPU_Core_Cached_Run(void);
+Bits CPU_Core_Cached_Trap_Run(void);
 Bits CPU_Core_Dyn_X86_Run(void);
 Bits CPU_Core_Dyn_X86_Trap_Run(void);
 Bits CPU_Core_Dynrec_Run(void);
@@ -84,6 +86,10 @@ void CPU_Enable_SkipAutoAdjust(void);
 void CPU_Disable_SkipAutoAdjust(void);
 void CPU_Reset_AutoAdjust(void);
 
+/* File the dynamic core keeps its list of translated blocks in between
+ * sessions, empty for none. */
+void CPU_SetHotBlockFile(const char * path);
+
 
 //CPU Stuff
 
@@ -28,6 +28,8 @@ enum DMAEvent {
 };
 
 class DmaChannel;
+class SnapshotWriter;
+class SnapshotReader;
 typedef void (* DMA_CallBack)(DmaChannel * chan,DMAEvent event);
 
 class DmaChannel {
@@ -106,6 +108,8 @@ public:
 	}
 	void WriteControllerReg(Bitu reg,Bitu val,Bitu len);
 	Bitu ReadControllerReg(Bitu reg,Bitu len);
+	void SaveState(SnapshotWriter& writer);
+	bool LoadState(SnapshotReader& reader);
 };
 
 DmaChannel * GetDMAChannel(Bit8u chan);
@@ -21,6 +21,9 @@
 #define DOSBOX_DOS_SYSTEM_H
 
 #include <vector>
+#include <list>
+#include <string>
+#include <unordered_map>
 #ifndef DOSBOX_DOSBOX_H
 #include "dosbox.h"
 #endif
@@ -140,6 +143,11 @@ private:
 #define MAX_OPENDIRS 2048
 //Can be high as it's only storage (16 bit variable)
 
+/* Number of resolved paths that are remembered by the directory cache. */
+#define MAX_CACHEDPATHS 256
+/* Directory entries are allocated in blocks of (1<<FILEINFO_BLOCKSHIFT). */
+#define FILEINFO_BLOCKSHIFT 10
+
 class DOS_Drive_Cache {
 public:
 	DOS_Drive_Cache					(void);
@@ -170,38 +178,49 @@ public:
 	void		SetLabel			(const char* name,bool cdrom,bool allowupdate);
 	char*		GetLabel			(void) { return label; };
 
+	// Entries are referred to by their number in the blocks of entries,
+	// number 0 means no entry.
+	struct CDirInfo;
 	class CFileInfo {
 	public:
-		CFileInfo(void) {
-			orgname[0] = shortname[0] = 0;
-			isOverlayDir = isDir = false;
-			id = MAX_OPENDIRS;
-			nextEntry = shortNr = 0;
-		}
-		~CFileInfo(void) {
-			for (Bit32u i=0; i<fileList.size(); i++) delete fileList[i];
-			fileList.clear();
-			longNameList.clear();
-		};
-		char		orgname		[CROSS_LEN];
+		const char*	orgname;		// stored in the name pool
 		char		shortname	[DOS_NAMELENGTH_ASCII];
 		bool		isOverlayDir;
 		bool		isDir;
 		Bit16u		id;
-		Bitu		nextEntry;
-		Bitu		shortNr;
-		// contents
-		std::vector<CFileInfo*>	fileList;
-		std::vector<CFileInfo*>	longNameList;
+		Bit32u		shortNr;
+		CDirInfo*	contents;		// only for directories
+	};
+	struct CDirInfo {
+		CDirInfo(void) : nextEntry(0), generation(0) {}
+		Bitu			nextEntry;
+		Bitu			generation;	// changes whenever the contents do
+		std::vector<Bit32u>	fileList;
+		std::vector<Bit32u>	longNameList;
+		// hash tables of the contents by short and by long name
+		std::vector<Bit32u>	shortIndex;
+		std::vector<Bit32u>	longIndex;
 	};
 
 private:
-	void ClearFileInfo(CFileInfo *dir);
-	void DeleteFileInfo(CFileInfo *dir);
+	struct CSortByInfo;
+
+	CFileInfo*	Info			(Bit32u nr) { return &infoBlocks[nr >> FILEINFO_BLOCKSHIFT][nr & ((1 << FILEINFO_BLOCKSHIFT) - 1)]; };
+	Bit32u		NewFileInfo		(const char* orgname);
+	CDirInfo*	GetContents		(CFileInfo* dir);
+	void DeleteFileInfo(Bit32u nr);
+	const char*	InternName		(const char* name);
+	void		ReleaseName		(const char* name);
+	void		CompactNames		(void);
+	void		TrimNames		(void);
 
 	bool		RemoveTrailingDot	(char* shortname);
 	Bits		GetLongName		(CFileInfo* info, char* shortname);
-	void		CreateShortName		(CFileInfo* dir, CFileInfo* info);
+	CFileInfo*	GetLongNameInfo		(CFileInfo* info, char* shortname);
+	void		IndexAdd		(std::vector<Bit32u>& index, const std::vector<Bit32u>& list, Bit32u nr, bool longName);
+	void		IndexInsert		(std::vector<Bit32u>& index, Bit32u nr, bool longName);
+	CFileInfo*	IndexFind		(const std::vector<Bit32u>& index, const char* name, bool longName);
+	void		CreateShortName		(CFileInfo* dir, Bit32u nr);
 	Bitu		CreateShortNameID	(CFileInfo* dir, const char* name);
 	int		CompareShortname	(const char* compareName, const char* shortName);
 	bool		SetResult		(CFileInfo* dir, char * &result, Bitu entryNr);
@@ -214,21 +233,50 @@ private:
 	Bit16u		GetFreeID		(CFileInfo* dir);
 	void		Clear			(void);
 
-	CFileInfo*	dirBase;
+	Bit32u		dirBase;
 	char		dirPath				[CROSS_LEN];
 	char		basePath			[CROSS_LEN];
 	bool		dirFirstTime;
 	TDirSort	sortDirType;
-	CFileInfo*	save_dir;
-	char		save_path			[CROSS_LEN];
-	char		save_expanded		[CROSS_LEN];
+
+	// resolved paths, the most recently used first. Every entry keeps the
+	// directories it was resolved through with their generation, it is
+	// stale once one of them has changed.
+	struct CPathDir {
+		CFileInfo*	dir;
+		Bitu		generation;
+	};
+	struct CPathEntry {
+		std::string	path;
+		std::string	expanded;
+		CFileInfo*	dir;
+		std::vector<CPathDir>	dirs;
+	};
+	bool		IsPathCurrent		(const CPathEntry& entry);
+	typedef std::list<CPathEntry> CPathList;
+	CPathList	pathList;
+	std::unordered_map<std::string,CPathList::iterator> pathIndex;
+	std::string	pathKey;
+	std::vector<CPathDir>	pathDirs;
 
 	Bit16u		srchNr;
 	CFileInfo*	dirSearch			[MAX_OPENDIRS];
 	char		dirSearchName		[MAX_OPENDIRS];
-	CFileInfo*	dirFindFirst		[MAX_OPENDIRS];
+	Bit32u		dirFindFirst		[MAX_OPENDIRS];
 	Bit16u		nextFreeFindFirst;
 
+	std::vector<CFileInfo*>	infoBlocks;
+	std::vector<Bit32u>	freeInfos;
+	Bit32u		infoCount;			// numbers handed out so far
+
+	// long names, each different name is stored only once
+	std::vector<char*>	nameBlocks;
+	Bitu		nameBlockUsed;
+	std::vector<const char*> nameIndex;
+	Bitu		nameCount;
+	Bitu		nameLiveSize;		// bytes of the names in use
+	Bitu		nameDeadSize;		// bytes of the names no entry uses anymore
+
 	char		label				[CROSS_LEN];
 	bool		updatelabel;
 };
@@ -32,6 +32,8 @@ class Section;
 typedef Bitu (LoopHandler)(void);
 
 void DOSBOX_RunMachine();
+/* How many DOSBOX_RunMachine calls are active on the host stack */
+Bitu DOSBOX_RunDepth(void);
 void DOSBOX_SetLoop(LoopHandler * handler);
 void DOSBOX_SetNormalLoop();
 
@@ -32,6 +32,8 @@ typedef Bit32s MemHandle;
 #define MEM_PAGESIZE 4096
 
 extern HostPt MemBase;
+/* One byte per ram page, set when the page is written behind the page handlers */
+extern Bit8u * MemPageDirty;
 HostPt GetMemBase(void);
 
 bool MEM_A20_Enabled(void);
@@ -151,12 +153,15 @@ void mem_writed(PhysPt pt,Bit32u val);
 
 static INLINE void phys_writeb(PhysPt addr,Bit8u val) {
 	host_writeb(MemBase+addr,val);
+	MemPageDirty[addr>>12]=1;
 }
 static INLINE void phys_writew(PhysPt addr,Bit16u val){
 	host_writew(MemBase+addr,val);
+	MemPageDirty[addr>>12]=MemPageDirty[(addr+1)>>12]=1;
 }
 static INLINE void phys_writed(PhysPt addr,Bit32u val){
 	host_writed(MemBase+addr,val);
+	MemPageDirty[addr>>12]=MemPageDirty[(addr+3)>>12]=1;
 }
 
 static INLINE Bit8u phys_readb(PhysPt addr) {
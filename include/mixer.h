@@ -37,6 +37,13 @@ enum MixerModes {
 	M_16M,M_16S
 };
 
+enum MixerResamplers {
+	MIXER_RESAMPLE_LINEAR,	//Linear interpolation between two samples
+	MIXER_RESAMPLE_SINC		//Windowed sinc over MIXER_SINC_TAPS samples
+};
+
+struct MixerSinc;
+
 #define MIXER_BUFSIZE (16*1024)
 #define MIXER_BUFMASK (MIXER_BUFSIZE-1)
 extern Bit8u MixTemp[MIXER_BUFSIZE];
@@ -50,6 +57,7 @@ public:
 	void SetScale( float f );
 	void UpdateVolume(void);
 	void SetFreq(Bitu _freq);
+	void SetResampler(MixerResamplers _resampler);
 	void Mix(Bitu _needed);
 	void AddSilence(void);			//Fill up until needed
 
@@ -96,6 +104,9 @@ public:
 	//Still work in progress and thus disabled for now.
 	Bits offset[2];
 	const char * name;
+	MixerResamplers resampler;
+	//State of the sinc resampler, only there while it is used
+	MixerSinc * sinc;
 	bool interpolate;
 	bool enabled;
 	bool last_samples_were_stereo;
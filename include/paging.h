@@ -38,6 +38,9 @@ class PageDirectory;
 
 #if defined(USE_FULL_TLB)
 #define TLB_SIZE		(1024*1024)
+#define TLB_TABLE_SHIFT	10		// pages covered by a table of page handlers
+#define TLB_TABLE_SIZE	(1<<TLB_TABLE_SHIFT)
+#define TLB_TABLES		(TLB_SIZE>>TLB_TABLE_SHIFT)
 #else
 #define TLB_SIZE		65536	// This must a power of 2 and greater then LINK_START
 #define BANK_SHIFT		28
@@ -52,6 +55,7 @@ class PageDirectory;
 #define PFLAG_NOCODE		0x10			//No dynamic code can be generated here
 #define PFLAG_INIT			0x20			//No dynamic code can be generated here
 #define PFLAG_HASCODE16		0x40			//Page contains 16-bit dynamic code
+#define PFLAG_HASCACHE		0x80			//Page contains code decoded by the cached core
 #define PFLAG_HASCODE		(PFLAG_HASCODE32|PFLAG_HASCODE16)
 
 #define LINK_START	((1024+64)/4)			//Start right after the HMA
@@ -141,7 +145,14 @@ union X86PageEntry {
 	X86_PageEntryBlock block;
 };
 
-#if !defined(USE_FULL_TLB)
+#if defined(USE_FULL_TLB)
+/* The page handlers of a 4 MB range, only allocated once a page in it is linked */
+typedef struct {
+	PageHandler * readhandler[TLB_TABLE_SIZE];
+	PageHandler * writehandler[TLB_TABLE_SIZE];
+	Bit32u phys_page[TLB_TABLE_SIZE];
+} tlb_table;
+#else
 typedef struct {
 	HostPt read;
 	HostPt write;
@@ -162,9 +173,7 @@ struct PagingBlock {
 	struct {
 		HostPt read[TLB_SIZE];
 		HostPt write[TLB_SIZE];
-		PageHandler * readhandler[TLB_SIZE];
-		PageHandler * writehandler[TLB_SIZE];
-		Bit32u	phys_page[TLB_SIZE];
+		tlb_table * tables[TLB_TABLES];
 	} tlb;
 #else
 	tlb_entry tlbh[TLB_SIZE];
@@ -204,20 +213,23 @@ static INLINE HostPt get_tlb_read(PhysPt address) {
 static INLINE HostPt get_tlb_write(PhysPt address) {
 	return paging.tlb.write[address>>12];
 }
+static INLINE tlb_table *get_tlb_table(PhysPt address) {
+	return paging.tlb.tables[address>>(12+TLB_TABLE_SHIFT)];
+}
 static INLINE PageHandler* get_tlb_readhandler(PhysPt address) {
-	return paging.tlb.readhandler[address>>12];
+	return get_tlb_table(address)->readhandler[(address>>12)&(TLB_TABLE_SIZE-1)];
 }
 static INLINE PageHandler* get_tlb_writehandler(PhysPt address) {
-	return paging.tlb.writehandler[address>>12];
+	return get_tlb_table(address)->writehandler[(address>>12)&(TLB_TABLE_SIZE-1)];
 }
 
 /* Use these helper functions to access linear addresses in readX/writeX functions */
 static INLINE PhysPt PAGING_GetPhysicalPage(PhysPt linePage) {
-	return (paging.tlb.phys_page[linePage>>12]<<12);
+	return (get_tlb_table(linePage)->phys_page[(linePage>>12)&(TLB_TABLE_SIZE-1)]<<12);
 }
 
 static INLINE PhysPt PAGING_GetPhysicalAddress(PhysPt linAddr) {
-	return (paging.tlb.phys_page[linAddr>>12]<<12)|(linAddr&0xfff);
+	return (get_tlb_table(linAddr)->phys_page[(linAddr>>12)&(TLB_TABLE_SIZE-1)]<<12)|(linAddr&0xfff);
 }
 
 #else
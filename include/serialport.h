@@ -49,6 +49,9 @@
 
 // Serial port interface 
 
+class SnapshotWriter;
+class SnapshotReader;
+
 class MyFifo {
 public:
 	MyFifo(Bitu maxsize_) {
@@ -117,6 +120,8 @@ public:
 	Bit8u probeByte() {
 		return data[pos];
 	}
+	void SaveState(SnapshotWriter& writer);
+	bool LoadState(SnapshotReader& reader);
 private:
 	Bit8u * data;
 	Bitu maxsize,size,pos,used;
@@ -144,6 +149,10 @@ public:
 	CSerial(Bitu id, CommandLine* cmd);
 	
 	virtual ~CSerial();
+
+	// UART registers and FIFOs; the host side of the connection is not saved
+	void SaveState(SnapshotWriter& writer);
+	bool LoadState(SnapshotReader& reader);
 		
 	IO_ReadHandleObject ReadHandler[8];
 	IO_WriteHandleObject WriteHandler[8];
@@ -0,0 +1,138 @@
+/*
+ *  Copyright (C) 2002-2021  The DOSBox Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef DOSBOX_SNAPSHOT_H
+#define DOSBOX_SNAPSHOT_H
+
+#ifndef DOSBOX_DOSBOX_H
+#include "dosbox.h"
+#endif
+
+#include <vector>
+
+/* Machine state snapshots.
+ *
+ * A snapshot is a small fixed header followed by a list of sections. Every
+ * section carries an 8 character tag, its own version and its length, so a
+ * module can change its layout without touching the others. Modules register
+ * a section when they are initialized and remove it again on shutdown.
+ *
+ * Data is stored in host byte order and pointers are never written directly;
+ * function pointers are written as offsets into the running binary, so a
+ * snapshot can only be loaded by the same build that created it.
+ *
+ * Host code that runs guest code through callbacks is suspended on the host
+ * stack, which is not part of a snapshot. A snapshot therefore only loads at
+ * the same callback nesting depth it was taken at.
+ *
+ * Besides full snapshots there are deltas for frequent capture, such as the
+ * per-frame states of rewind and run-ahead. The first delta sets up a base:
+ * guest memory keeps a copy of itself and starts tracking which pages get
+ * written. A delta then only stores the memory that changed since the base,
+ * and loading one puts back everything else from the base. Deltas stay valid
+ * until a full snapshot is loaded or the machine is set up again, and can
+ * only be loaded by the instance that took them. */
+
+typedef void (*SnapshotFunc)(void);
+
+enum SnapshotType {
+	SNAPSHOT_FULL,
+	SNAPSHOT_DELTA
+};
+
+class SnapshotWriter {
+public:
+	SnapshotWriter(std::vector<Bit8u>& _buf,SnapshotType _type=SNAPSHOT_FULL,Bit32u _base=0) :
+		buf(&_buf),size(0),type(_type),base(_base) {}
+	/* Only counts the bytes a full snapshot takes */
+	SnapshotWriter(void) : buf(0),size(0),type(SNAPSHOT_FULL),base(0) {}
+	void WriteBlock(const void* data,Bitu size);
+	template <class T> void Write(const T& val) {
+		WriteBlock(&val,sizeof(T));
+	}
+	/* Write a size tagged block, a load fails if the size differs */
+	void WriteStruct(const void* data,Bitu size) {
+		Write((Bit32u)size);
+		WriteBlock(data,size);
+	}
+	template <class F> void WriteFunc(F func) {
+		WriteFuncPtr(reinterpret_cast<SnapshotFunc>(func));
+	}
+	/* A null pointer is written as an empty string */
+	void WriteString(const char* str);
+	Bitu Size(void) const { return size; }
+	SnapshotType Type(void) const { return type; }
+	/* Identifies the base a delta is taken against */
+	Bit32u Base(void) const { return base; }
+private:
+	void WriteFuncPtr(SnapshotFunc func);
+	std::vector<Bit8u>* buf;
+	Bitu size;
+	SnapshotType type;
+	Bit32u base;
+};
+
+class SnapshotReader {
+public:
+	SnapshotReader(const Bit8u* _data,Bitu _size,SnapshotType _type=SNAPSHOT_FULL,Bit32u _base=0) :
+		data(_data),size(_size),pos(0),failed(false),type(_type),base(_base) {}
+	bool ReadBlock(void* dest,Bitu len);
+	template <class T> bool Read(T& val) {
+		return ReadBlock(&val,sizeof(T));
+	}
+	bool ReadStruct(void* dest,Bitu len);
+	template <class F> bool ReadFunc(F& func) {
+		SnapshotFunc tmp;
+		if (!ReadFuncPtr(tmp)) return false;
+		func = reinterpret_cast<F>(tmp);
+		return true;
+	}
+	/* Fails if the string doesn't fit len bytes including the terminator */
+	bool ReadString(char* dest,Bitu len);
+	bool Skip(Bitu len);
+	Bitu Remaining(void) const { return size - pos; }
+	bool Failed(void) const { return failed; }
+	SnapshotType Type(void) const { return type; }
+	Bit32u Base(void) const { return base; }
+private:
+	bool ReadFuncPtr(SnapshotFunc& func);
+	const Bit8u* data;
+	Bitu size;
+	Bitu pos;
+	bool failed;
+	SnapshotType type;
+	Bit32u base;
+};
+
+typedef void (*SNAPSHOT_SaveHandler)(SnapshotWriter& writer);
+/* Returns false if the section data does not fit the running machine */
+typedef bool (*SNAPSHOT_LoadHandler)(SnapshotReader& reader,Bit16u version);
+
+/* Tags are at most 8 characters. Registering an existing tag replaces it. */
+void SNAPSHOT_Register(const char* tag,Bit16u version,SNAPSHOT_SaveHandler save,SNAPSHOT_LoadHandler load);
+void SNAPSHOT_Unregister(const char* tag);
+
+/* Only call these while the emulation is paused between two frames.
+ * A failed load leaves the machine as it was. */
+bool SNAPSHOT_Save(std::vector<Bit8u>& out,SnapshotType type=SNAPSHOT_FULL);
+bool SNAPSHOT_Load(const Bit8u* data,Bitu size);
+/* Size SNAPSHOT_Save would produce right now, without copying the state */
+Bitu SNAPSHOT_Size(void);
+
+#endif
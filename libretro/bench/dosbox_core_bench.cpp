@@ -0,0 +1,829 @@
+// This is copyrighted software. More information is at the end of this file.
+
+/* Headless benchmark runner.
+ *
+ * Loads the core, boots a generated .conf that starts one of the canned workloads (or a user
+ * supplied autoexec) and runs it for a fixed amount of frames without any video or audio output.
+ * External core timing is used, so each retro_run() emulates exactly one frame at a fixed cycle
+ * rate and runs are reproducible. The time spent in the individual emulation subsystems comes from
+ * the core's frame profiler.
+ *
+ * Each workload runs in its own process, since the core can only be started once per process.
+ */
+#include "libretro.h"
+#include "workloads.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dlfcn.h>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+struct Workload final
+{
+    const char* name;
+    const char* description;
+    const char* conf;
+    const uint8_t* program;
+    size_t program_size;
+    // Writes the files the workload needs to the work directory and returns the DOS commands that
+    // set them up.
+    std::vector<std::string> (*prepare)(const std::filesystem::path& dir);
+};
+
+template <size_t N>
+constexpr auto makeWorkload(
+    const char* name, const char* description, const char* conf, const uint8_t (&program)[N],
+    std::vector<std::string> (*prepare)(const std::filesystem::path&) = nullptr) -> Workload
+{
+    return {name, description, conf, program, N, prepare};
+}
+
+auto makeCdImage(const std::filesystem::path& dir) -> std::vector<std::string>;
+
+const Workload workloads[]{
+    makeWorkload(
+        "normal", "integer/memory loop on the normal core",
+        "[cpu]\ncore=normal\ncycles=fixed 30000\n", workload_cpu_com),
+    makeWorkload(
+        "dynrec", "integer/memory loop on the dynamic core",
+        "[cpu]\ncore=dynamic\ncycles=fixed 200000\n", workload_cpu_com),
+    makeWorkload(
+        "vga13h", "full screen fills and palette writes in VGA mode 13h",
+        "[cpu]\ncore=normal\ncycles=fixed 30000\n", workload_vga13h_com),
+    makeWorkload(
+        "svga_lfb", "full screen fills through the VESA linear framebuffer",
+        "[cpu]\ncore=normal\ncycles=fixed 30000\n", workload_svga_lfb_com),
+    makeWorkload(
+        "opl", "nine OPL voices retuned continuously",
+        "[cpu]\ncore=normal\ncycles=fixed 10000\n[sblaster]\nsbtype=sb16\noplmode=opl3\n",
+        workload_opl_com),
+    makeWorkload(
+        "pit", "16 kHz timer interrupts driving the PC speaker on the dynamic core",
+        "[cpu]\ncore=dynamic\ncycles=fixed 100000\n", workload_pit_com),
+    makeWorkload(
+        "voodoo", "gouraud shaded triangles on the Voodoo software rasterizer",
+        "[cpu]\ncore=normal\ncycles=fixed 30000\n[pci]\nvoodoo=software\n", workload_voodoo_com),
+    makeWorkload(
+        "pic", "timer and RTC interrupts while both get reprogrammed",
+        "[cpu]\ncore=normal\ncycles=fixed 20000\n", workload_pic_com),
+    makeWorkload(
+        "files", "creating, renaming and deleting files through the drive cache",
+        "[cpu]\ncore=normal\ncycles=fixed 30000\n", workload_files_com),
+    makeWorkload(
+        "cdaudio", "playing, pausing and resuming the audio track of a CD image",
+        "[cpu]\ncore=normal\ncycles=fixed 10000\n", workload_cdaudio_com, makeCdImage),
+};
+
+/* Output of a known good build with the default frames and warmup, compared by --check. Changes
+ * that aren't meant to alter what the guest sees or hears must leave all of it the same. The
+ * self-checking workloads also write a line to RESULT.TXT, which has to match too.
+ *
+ * max_path_cache_misses bounds how often the drive cache had to walk a path again over the whole
+ * run, so that invalidating more resolved paths than a change needs fails the check even though
+ * the guest can't tell. Zero means it isn't checked.
+ */
+struct Expected final
+{
+    const char* workload;
+    uint32_t frame_checksum;
+    uint32_t audio_checksum;
+    const char* result;
+    uint32_t max_path_cache_misses;
+};
+
+const Expected expected[]{
+    {"normal", 0xb3879367, 0xf05e4b85, nullptr, 0},
+    {"dynrec", 0x25126fc5, 0xf05e4b85, nullptr, 0},
+    {"vga13h", 0x4acc40c5, 0xf05e4b85, nullptr, 0},
+    {"svga_lfb", 0xfd11ed85, 0x4e41bbd5, nullptr, 0},
+    {"opl", 0xc9882c45, 0x54104685, nullptr, 0},
+    {"pit", 0x8e9ce685, 0x0cae44ed, nullptr, 0},
+    {"voodoo", 0xedeaa207, 0xf05e4b85, nullptr, 0},
+    {"pic", 0x1b5bd2e7, 0xf05e4b85, "PIC trace EC929E6D", 0},
+    {"files", 0x5621cac5, 0xf05e4b85, "Drive cache PASS", 8074},
+    {"cdaudio", 0x7cc60e87, 0x2a071d85, "CD trace 0C0801F5", 0},
+};
+
+struct Settings final
+{
+    std::filesystem::path core = "./dosbox_core_libretro.so";
+    int frames = 600;
+    int warmup = 120;
+    std::string cycles;
+    std::string mount;
+    std::vector<std::string> autoexec;
+    std::map<std::string, std::string> core_options;
+    std::vector<const Workload*> selected;
+    bool verbose = false;
+    bool check = false;
+};
+
+struct Result final
+{
+    int frames = 0;
+    double wall_seconds = 0;
+    double emulated_seconds = 0;
+    long fixed_cycles = 0;
+    uint32_t checksum = 0;
+    uint32_t audio_checksum = 0;
+    std::string result;
+    uint32_t path_cache_misses = 0;
+};
+
+// State the libretro callbacks work on. There is only ever one core per process.
+std::filesystem::path work_dir;
+std::string work_dir_string;
+std::map<std::string, std::string> options;
+bool options_updated = false;
+bool verbose = false;
+double fps = 0;
+uint32_t frame_checksum = 0;
+uint32_t audio_checksum = 2166136261U;
+
+void logPrintf(const retro_log_level level, const char* const fmt, ...)
+{
+    if (level < RETRO_LOG_WARN && !verbose) {
+        return;
+    }
+    va_list args;
+    va_start(args, fmt);
+    std::vfprintf(stderr, fmt, args);
+    va_end(args);
+}
+
+auto environment(const unsigned cmd, void* const data) -> bool
+{
+    switch (cmd) {
+    case RETRO_ENVIRONMENT_GET_SYSTEM_DIRECTORY:
+    case RETRO_ENVIRONMENT_GET_SAVE_DIRECTORY:
+    case RETRO_ENVIRONMENT_GET_CORE_ASSETS_DIRECTORY:
+        *static_cast<const char**>(data) = work_dir_string.c_str();
+        return true;
+
+    case RETRO_ENVIRONMENT_GET_LOG_INTERFACE:
+        static_cast<retro_log_callback*>(data)->log = logPrintf;
+        return true;
+
+    case RETRO_ENVIRONMENT_GET_CORE_OPTIONS_VERSION:
+        *static_cast<unsigned*>(data) = 2;
+        return true;
+
+    case RETRO_ENVIRONMENT_SET_CORE_OPTIONS_V2:
+        // Use the defaults of everything we weren't told to override. The core submits its options
+        // again when a conf file locks some of them to a single value, so also reset values that
+        // are no longer valid.
+        for (const auto* def = static_cast<const retro_core_options_v2*>(data)->definitions;
+             def->key; ++def)
+        {
+            if (!def->default_value) {
+                continue;
+            }
+            const auto [it, inserted] = options.emplace(def->key, def->default_value);
+            if (inserted) {
+                continue;
+            }
+            bool valid = false;
+            for (const auto* val = def->values; val->value && !valid; ++val) {
+                valid = it->second == val->value;
+            }
+            if (!valid) {
+                it->second = def->default_value;
+            }
+        }
+        return true;
+
+    case RETRO_ENVIRONMENT_GET_VARIABLE: {
+        auto* const var = static_cast<retro_variable*>(data);
+        const auto it = options.find(var->key);
+        var->value = it == options.end() ? nullptr : it->second.c_str();
+        return it != options.end();
+    }
+
+    case RETRO_ENVIRONMENT_GET_VARIABLE_UPDATE:
+        *static_cast<bool*>(data) = options_updated;
+        options_updated = false;
+        return true;
+
+    case RETRO_ENVIRONMENT_SET_SYSTEM_AV_INFO:
+        fps = static_cast<const retro_system_av_info*>(data)->timing.fps;
+        return true;
+
+    case RETRO_ENVIRONMENT_SET_PIXEL_FORMAT:
+    case RETRO_ENVIRONMENT_SET_GEOMETRY:
+    case RETRO_ENVIRONMENT_SET_CORE_OPTIONS_DISPLAY:
+        return true;
+
+    case RETRO_ENVIRONMENT_GET_CAN_DUPE:
+        *static_cast<bool*>(data) = true;
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+// FNV-1a over the visible part of the last frame. Only the final one matters, so earlier frames
+// are just overwritten.
+void videoRefresh(const void* const data, const unsigned width, const unsigned height, size_t pitch)
+{
+    if (!data) {
+        return;
+    }
+    uint32_t hash = 2166136261U;
+    const auto* row = static_cast<const uint8_t*>(data);
+    for (unsigned y = 0; y < height; ++y, row += pitch) {
+        for (size_t x = 0; x < width * sizeof(uint32_t); ++x) {
+            hash = (hash ^ row[x]) * 16777619U;
+        }
+    }
+    frame_checksum = hash;
+}
+
+// FNV-1a over all the audio the core produced, so that changes to the mixer can be checked for
+// giving the same output.
+void hashAudio(const int16_t* const data, const size_t samples)
+{
+    const auto* bytes = reinterpret_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < samples * sizeof(int16_t); ++i) {
+        audio_checksum = (audio_checksum ^ bytes[i]) * 16777619U;
+    }
+}
+
+void audioSample(const int16_t left, const int16_t right)
+{
+    const int16_t frame[]{left, right};
+    hashAudio(frame, 2);
+}
+
+auto audioSampleBatch(const int16_t* const data, const size_t frames) -> size_t
+{
+    hashAudio(data, frames * 2);
+    return frames;
+}
+
+void inputPoll()
+{ }
+
+auto inputState(unsigned /*port*/, unsigned /*device*/, unsigned /*index*/, unsigned /*id*/)
+    -> int16_t
+{
+    return 0;
+}
+
+template <typename T>
+auto symbol(void* const lib, const char* const name) -> T
+{
+    auto* sym = dlsym(lib, name);
+    if (!sym) {
+        std::fprintf(stderr, "Core does not export %s.\n", name);
+        std::exit(EXIT_FAILURE);
+    }
+    return reinterpret_cast<T>(sym);
+}
+
+auto fixedCycles(const std::string& conf) -> long
+{
+    const auto pos = conf.rfind("cycles=fixed ");
+    return pos == std::string::npos ? 0 : std::atol(conf.c_str() + pos + 13);
+}
+
+/* A CD with a minimal ISO 9660 data track and a few seconds of generated tones as the audio track.
+ */
+auto makeCdImage(const std::filesystem::path& dir) -> std::vector<std::string>
+{
+    constexpr size_t data_sectors = 32;
+    constexpr size_t audio_frames = 300 * 588;
+
+    std::vector<uint8_t> iso(data_sectors * 2048);
+    // ISO 9660 stores most numbers in both byte orders, little endian first.
+    const auto both16 = [&iso](const size_t pos, const uint16_t val) {
+        iso[pos] = iso[pos + 3] = val & 0xff;
+        iso[pos + 1] = iso[pos + 2] = val >> 8;
+    };
+    const auto both32 = [&iso](const size_t pos, const uint32_t val) {
+        for (size_t i = 0; i < 4; ++i) {
+            iso[pos + i] = iso[pos + 7 - i] = (val >> (i * 8)) & 0xff;
+        }
+    };
+    const auto rootRecord = [&](const size_t pos, const uint8_t name) {
+        iso[pos] = 34;
+        both32(pos + 2, 18);
+        both32(pos + 10, 2048);
+        iso[pos + 25] = 2;
+        both16(pos + 28, 1);
+        iso[pos + 32] = 1;
+        iso[pos + 33] = name;
+    };
+    const auto descriptor = [&iso](const size_t sector, const uint8_t type) {
+        iso[sector * 2048] = type;
+        std::memcpy(&iso[sector * 2048 + 1], "CD001", 5);
+        iso[sector * 2048 + 6] = 1;
+    };
+
+    constexpr size_t pvd = 16 * 2048;
+    descriptor(16, 1);
+    std::memset(&iso[pvd + 8], ' ', 64);
+    std::memcpy(&iso[pvd + 40], "BENCH", 5);
+    both32(pvd + 80, data_sectors);
+    both16(pvd + 120, 1);
+    both16(pvd + 124, 1);
+    both16(pvd + 128, 2048);
+    both32(pvd + 132, 10);
+    iso[pvd + 140] = 19;
+    iso[pvd + 151] = 20;
+    rootRecord(pvd + 156, 0);
+    iso[pvd + 881] = 1;
+    descriptor(17, 255);
+    rootRecord(18 * 2048, 0);
+    rootRecord(18 * 2048 + 34, 1);
+    // Path tables with just the root, little endian one first.
+    for (const size_t table : {19 * 2048, 20 * 2048}) {
+        iso[table] = 1;
+        iso[table + (table == 19 * 2048 ? 2 : 5)] = 18;
+        iso[table + (table == 19 * 2048 ? 6 : 7)] = 1;
+    }
+    std::ofstream(dir / "cd.iso", std::ios::binary)
+        .write(reinterpret_cast<const char*>(iso.data()), iso.size());
+
+    // A saw tone on the left and a square wave on the right.
+    std::vector<uint8_t> audio;
+    audio.reserve(audio_frames * 4);
+    for (size_t i = 0; i < audio_frames; ++i) {
+        const auto left = static_cast<uint16_t>(static_cast<int>(i % 100) * 160 - 8000);
+        const auto right = static_cast<uint16_t>((i / 63) % 2 ? 6000 : -6000);
+        for (const uint16_t sample : {left, right}) {
+            audio.push_back(sample & 0xff);
+            audio.push_back(sample >> 8);
+        }
+    }
+    std::ofstream(dir / "cd.bin", std::ios::binary)
+        .write(reinterpret_cast<const char*>(audio.data()), audio.size());
+
+    std::ofstream(dir / "cd.cue") << "FILE \"cd.iso\" BINARY\n"
+                                     "  TRACK 01 MODE1/2048\n"
+                                     "    INDEX 01 00:00:00\n"
+                                     "FILE \"cd.bin\" BINARY\n"
+                                     "  TRACK 02 AUDIO\n"
+                                     "    INDEX 01 00:00:00\n";
+    return {"imgmount d \"" + (dir / "cd.cue").u8string() + "\" -t iso"};
+}
+
+auto makeConf(
+    const Settings& settings, const Workload* const workload, const std::vector<std::string>& setup)
+    -> std::string
+{
+    std::string conf = "[dosbox]\nmachine=svga_s3\n[dos]\nems=false\n";
+    if (workload) {
+        conf += workload->conf;
+    } else {
+        conf += "[cpu]\ncore=normal\ncycles=fixed 30000\n";
+    }
+    if (!settings.cycles.empty()) {
+        conf += "[cpu]\ncycles=fixed " + settings.cycles + '\n';
+    }
+
+    conf += "[autoexec]\n";
+    if (!settings.mount.empty()) {
+        const auto ext = std::filesystem::path(settings.mount).extension().string();
+        if (std::filesystem::is_directory(settings.mount)) {
+            conf += "mount d \"" + settings.mount + "\"\n";
+        } else if (ext == ".iso" || ext == ".cue" || ext == ".ISO" || ext == ".CUE") {
+            conf += "imgmount d \"" + settings.mount + "\" -t iso\n";
+        } else {
+            conf += "imgmount d \"" + settings.mount + "\" -t hdd\n";
+        }
+    }
+    // The work directory has the pid in its name, clear the screen so that it doesn't end up in the
+    // frame checksum.
+    conf += "mount c \"" + work_dir.u8string() + "\"\n";
+    for (const auto& line : setup) {
+        conf += line + '\n';
+    }
+    conf += "c:\ncls\n";
+    if (!settings.autoexec.empty()) {
+        for (const auto& line : settings.autoexec) {
+            conf += line + '\n';
+        }
+    } else if (workload) {
+        conf += std::string(workload->name) + ".com\n";
+    }
+    return conf;
+}
+
+struct ProfileValue final
+{
+    std::string name;
+    double mean = 0;
+    double total = 0;
+    bool is_time = false;
+};
+
+/* Mean per-frame microseconds of every profiled section and mean per-frame value of every counter,
+ * skipping the warmup frames, and their totals over all frames. The core writes the profile in
+ * chunks, "profile.0.csv", "profile.1.csv" and so on.
+ */
+auto readProfile(const std::filesystem::path& dir, const int warmup) -> std::vector<ProfileValue>
+{
+    std::vector<std::string> columns;
+    std::vector<double> sums;
+    std::vector<double> totals;
+    int rows = 0;
+    for (int n = 0;; ++n) {
+        std::ifstream in(dir / ("profile." + std::to_string(n) + ".csv"));
+        std::string line;
+        if (!std::getline(in, line)) {
+            break;
+        }
+        if (columns.empty()) {
+            std::istringstream header(line);
+            std::string col;
+            while (std::getline(header, col, ',')) {
+                columns.push_back(col);
+            }
+            sums.resize(columns.size());
+            totals.resize(columns.size());
+        }
+        while (std::getline(in, line)) {
+            std::istringstream row(line);
+            std::string cell;
+            std::vector<double> values;
+            while (std::getline(row, cell, ',')) {
+                values.push_back(std::atof(cell.c_str()));
+            }
+            if (values.empty() || values.size() != columns.size()) {
+                continue;
+            }
+            for (size_t i = 0; i < values.size(); ++i) {
+                totals[i] += values[i];
+            }
+            if (values[0] < warmup) {
+                continue;
+            }
+            for (size_t i = 0; i < values.size(); ++i) {
+                sums[i] += values[i];
+            }
+            ++rows;
+        }
+    }
+
+    const auto ends_with = [](const std::string& name, const std::string& suffix) {
+        return name.size() > suffix.size()
+            && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+    };
+    std::vector<ProfileValue> ret;
+    for (size_t i = 0; i < columns.size() && rows > 0; ++i) {
+        const auto& name = columns[i];
+        if (name == "frame" || name == "wall_us" || ends_with(name, "_calls")) {
+            continue;
+        }
+        if (ends_with(name, "_us")) {
+            ret.push_back({name.substr(0, name.size() - 3), sums[i] / rows, totals[i], true});
+        } else {
+            ret.push_back({name, sums[i] / rows, totals[i], false});
+        }
+    }
+    return ret;
+}
+
+/* Compares the output of a workload with the one of a known good build.
+ */
+auto check(const Workload* const workload, const Result& result) -> bool
+{
+    const auto* const want = std::find_if(std::begin(expected), std::end(expected),
+        [workload](const Expected& e) { return std::strcmp(e.workload, workload->name) == 0; });
+    if (want == std::end(expected)) {
+        std::printf("  check: no expected output for %s\n", workload->name);
+        return false;
+    }
+    bool ok = true;
+    if (result.checksum != want->frame_checksum) {
+        std::printf("  check: frame checksum %08x, expected %08x\n", result.checksum,
+            want->frame_checksum);
+        ok = false;
+    }
+    if (result.audio_checksum != want->audio_checksum) {
+        std::printf("  check: audio checksum %08x, expected %08x\n", result.audio_checksum,
+            want->audio_checksum);
+        ok = false;
+    }
+    if (want->result && result.result != want->result) {
+        std::printf("  check: result \"%s\", expected \"%s\"\n", result.result.c_str(),
+            want->result);
+        ok = false;
+    }
+    if (want->max_path_cache_misses != 0
+        && result.path_cache_misses > want->max_path_cache_misses)
+    {
+        std::printf("  check: %u path cache misses, expected at most %u\n",
+            result.path_cache_misses, want->max_path_cache_misses);
+        ok = false;
+    }
+    if (ok) {
+        std::printf("  check: ok\n");
+    }
+    return ok;
+}
+
+/* Runs a single workload in the current process and prints its results.
+ */
+auto run(const Settings& settings, const Workload* const workload) -> bool
+{
+    const char* const name = workload ? workload->name : "custom";
+    verbose = settings.verbose;
+
+    std::error_code err;
+    work_dir = std::filesystem::temp_directory_path(err)
+        / ("dosbox_core_bench_" + std::to_string(getpid()));
+    std::filesystem::remove_all(work_dir, err);
+    if (!std::filesystem::create_directories(work_dir, err)) {
+        std::fprintf(stderr, "Failed to create %s: %s\n", work_dir.c_str(), err.message().c_str());
+        return false;
+    }
+    work_dir_string = work_dir.u8string();
+
+    if (workload) {
+        std::ofstream(work_dir / (std::string(name) + ".com"), std::ios::binary)
+            .write(reinterpret_cast<const char*>(workload->program), workload->program_size);
+    }
+    std::vector<std::string> setup;
+    if (workload && workload->prepare) {
+        setup = workload->prepare(work_dir);
+    }
+    const auto conf = makeConf(settings, workload, setup);
+    const auto conf_path = work_dir / "bench.conf";
+    std::ofstream(conf_path) << conf;
+
+    options = settings.core_options;
+    options.emplace("dosbox_core_core_timing", "external");
+    options.emplace("dosbox_core_thread_sync", "wait");
+    options["dosbox_core_profiling"] = "csv";
+
+    void* const lib = dlopen(settings.core.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!lib) {
+        std::fprintf(stderr, "Failed to load core: %s\n", dlerror());
+        return false;
+    }
+    symbol<void (*)(retro_environment_t)>(lib, "retro_set_environment")(environment);
+    symbol<void (*)(retro_video_refresh_t)>(lib, "retro_set_video_refresh")(videoRefresh);
+    symbol<void (*)(retro_audio_sample_t)>(lib, "retro_set_audio_sample")(audioSample);
+    symbol<void (*)(retro_audio_sample_batch_t)>(lib, "retro_set_audio_sample_batch")(
+        audioSampleBatch);
+    symbol<void (*)(retro_input_poll_t)>(lib, "retro_set_input_poll")(inputPoll);
+    symbol<void (*)(retro_input_state_t)>(lib, "retro_set_input_state")(inputState);
+    const auto retro_init = symbol<void (*)()>(lib, "retro_init");
+    const auto retro_deinit = symbol<void (*)()>(lib, "retro_deinit");
+    const auto retro_load_game = symbol<bool (*)(const retro_game_info*)>(lib, "retro_load_game");
+    const auto retro_unload_game = symbol<void (*)()>(lib, "retro_unload_game");
+    const auto retro_get_system_av_info =
+        symbol<void (*)(retro_system_av_info*)>(lib, "retro_get_system_av_info");
+    const auto retro_run = symbol<void (*)()>(lib, "retro_run");
+
+    retro_init();
+    const auto conf_path_string = conf_path.u8string();
+    const retro_game_info game{conf_path_string.c_str(), nullptr, 0, nullptr};
+    if (!retro_load_game(&game)) {
+        std::fprintf(stderr, "%s: core failed to load %s\n", name, conf_path_string.c_str());
+        return false;
+    }
+    retro_system_av_info av_info{};
+    retro_get_system_av_info(&av_info);
+    fps = av_info.timing.fps;
+
+    for (int i = 0; i < settings.warmup; ++i) {
+        retro_run();
+    }
+
+    Result result;
+    result.frames = settings.frames;
+    result.fixed_cycles = fixedCycles(conf);
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < settings.frames; ++i) {
+        retro_run();
+        result.emulated_seconds += fps > 0 ? 1.0 / fps : 0;
+    }
+    result.wall_seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.checksum = frame_checksum;
+    result.audio_checksum = audio_checksum;
+
+    // The profile gets written out when the core shuts down.
+    retro_unload_game();
+    retro_deinit();
+    const auto profile = readProfile(work_dir / "DOSBox-core", settings.warmup);
+    std::ifstream result_file(work_dir / "RESULT.TXT");
+    if (std::getline(result_file, result.result) && !result.result.empty()
+        && result.result.back() == '\r')
+    {
+        result.result.pop_back();
+    }
+
+    std::printf("%s", name);
+    if (workload) {
+        std::printf(" (%s)", workload->description);
+    }
+    std::printf(
+        "\n  %d frames in %.3f s: %.1f fps, %.2fx realtime\n", result.frames, result.wall_seconds,
+        result.frames / result.wall_seconds, result.emulated_seconds / result.wall_seconds);
+    if (result.fixed_cycles > 0) {
+        std::printf(
+            "  %.1f M emulated cycles/s\n",
+            result.fixed_cycles * 1000.0 * result.emulated_seconds / result.wall_seconds / 1e6);
+    }
+    double slices = 0.0;
+    double emulated_ms = 0.0;
+    for (const auto& value : profile) {
+        if (value.is_time) {
+            std::printf("  %-17s %9.1f us/frame\n", value.name.c_str(), value.mean);
+        } else {
+            std::printf("  %-17s %9.1f /frame\n", value.name.c_str(), value.mean);
+        }
+        if (value.name == "cpu_slices") {
+            slices = value.mean;
+        } else if (value.name == "emulated_ms") {
+            emulated_ms = value.mean;
+        } else if (value.name == "path_cache_misses") {
+            result.path_cache_misses = static_cast<uint32_t>(value.total);
+        }
+    }
+    if (emulated_ms > 0.0) {
+        std::printf("  %-17s %9.1f /emulated ms\n", "cpu_slices", slices / emulated_ms);
+    }
+    std::printf("  final frame checksum %08x\n", result.checksum);
+    std::printf("  audio checksum %08x\n", result.audio_checksum);
+    if (!result.result.empty()) {
+        std::printf("  result: %s\n", result.result.c_str());
+    }
+    const bool ok = !settings.check || check(workload, result);
+    std::fflush(stdout);
+
+    std::filesystem::remove_all(work_dir, err);
+    return ok;
+}
+
+void usage(const char* const argv0)
+{
+    std::printf(
+        "Usage: %s [options] [workload...]\n"
+        "\n"
+        "Options:\n"
+        "  --core PATH            core to load (default ./dosbox_core_libretro.so)\n"
+        "  --frames N             frames to measure (default 600)\n"
+        "  --warmup N             frames to run before measuring (default 120)\n"
+        "  --cycles N             override the fixed cycles of the workload\n"
+        "  --mount PATH           mount a directory or disk image as D:\n"
+        "  --autoexec CMD         run CMD instead of a canned workload, can be repeated\n"
+        "  --core-option KEY=VAL  set a core option, can be repeated\n"
+        "  --list                 list the canned workloads\n"
+        "  --verbose              show the core's log output\n"
+        "  --check                compare the output with the one of a known good build and fail\n"
+        "                         on any difference, needs the default frames, warmup and cycles\n"
+        "\n"
+        "Without a workload and --autoexec, all canned workloads are run.\n",
+        argv0);
+}
+
+} // namespace
+
+auto main(int argc, char** argv) -> int
+{
+    Settings settings;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const auto value = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                std::fprintf(stderr, "%s needs a value.\n", arg.c_str());
+                std::exit(EXIT_FAILURE);
+            }
+            return argv[++i];
+        };
+
+        if (arg == "--core") {
+            settings.core = value();
+        } else if (arg == "--frames") {
+            settings.frames = std::max(1, std::atoi(value().c_str()));
+        } else if (arg == "--warmup") {
+            settings.warmup = std::max(0, std::atoi(value().c_str()));
+        } else if (arg == "--cycles") {
+            settings.cycles = value();
+        } else if (arg == "--mount") {
+            settings.mount = value();
+        } else if (arg == "--autoexec") {
+            settings.autoexec.push_back(value());
+        } else if (arg == "--core-option") {
+            const auto opt = value();
+            const auto eq = opt.find('=');
+            if (eq == std::string::npos) {
+                std::fprintf(stderr, "Core options are given as KEY=VALUE.\n");
+                return EXIT_FAILURE;
+            }
+            auto key = opt.substr(0, eq);
+            if (key.rfind("dosbox_core_", 0) != 0) {
+                key.insert(0, "dosbox_core_");
+            }
+            settings.core_options[key] = opt.substr(eq + 1);
+        } else if (arg == "--list") {
+            for (const auto& workload : workloads) {
+                std::printf("%-10s %s\n", workload.name, workload.description);
+            }
+            return EXIT_SUCCESS;
+        } else if (arg == "--verbose") {
+            settings.verbose = true;
+        } else if (arg == "--check") {
+            settings.check = true;
+        } else if (arg == "--help" || arg == "-h") {
+            usage(argv[0]);
+            return EXIT_SUCCESS;
+        } else {
+            const Workload* found = nullptr;
+            for (const auto& workload : workloads) {
+                if (arg == workload.name) {
+                    found = &workload;
+                }
+            }
+            if (!found) {
+                std::fprintf(stderr, "Unknown workload or option \"%s\".\n", arg.c_str());
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            settings.selected.push_back(found);
+        }
+    }
+
+    if (settings.check) {
+        const Settings defaults;
+        if (settings.frames != defaults.frames || settings.warmup != defaults.warmup
+            || !settings.cycles.empty() || !settings.mount.empty() || !settings.autoexec.empty())
+        {
+            std::fprintf(
+                stderr, "--check only works with the canned workloads and their defaults.\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (!settings.autoexec.empty()) {
+        settings.selected = {nullptr};
+    } else if (settings.selected.empty()) {
+        for (const auto& workload : workloads) {
+            settings.selected.push_back(&workload);
+        }
+    }
+
+    std::printf("core: %s, %d warmup + %d measured frames\n\n", settings.core.c_str(),
+        settings.warmup, settings.frames);
+    std::fflush(stdout);
+
+    bool ok = true;
+    for (const auto* workload : settings.selected) {
+        std::fflush(stdout);
+        const pid_t pid = fork();
+        if (pid < 0) {
+            std::perror("fork");
+            return EXIT_FAILURE;
+        }
+        if (pid == 0) {
+            // Skip static destructors of the core, it has already been shut down.
+            std::_Exit(run(settings, workload) ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
+        int status = 0;
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+            std::fprintf(stderr, "%s failed.\n", workload ? workload->name : "custom");
+            ok = false;
+        }
+        std::printf("\n");
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+
+Copyright (C) 2022 Nikos Chantziaras <realnc@gmail.com>
+
+This file is part of DOSBox-core.
+
+DOSBox-core is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation, either version 2 of the License, or (at your option) any later
+version.
+
+DOSBox-core is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+DOSBox-core. If not, see <https://www.gnu.org/licenses/>.
+
+*/
@@ -0,0 +1,210 @@
+// Generated by workloads/assemble.sh from workloads/*.S, do not edit.
+#pragma once
+#include <cstdint>
+
+inline constexpr uint8_t workload_cdaudio_com[] = {
+    0xb8, 0x40, 0x00, 0x8e, 0xe0, 0x8c, 0x0e, 0x28, 0x02, 0xc6, 0x06, 0x62, 0x02, 0x0b, 0xc6, 0x06,
+    0x63, 0x02, 0x02, 0xbb, 0x18, 0x02, 0xe8, 0x6f, 0x00, 0xf6, 0xc4, 0x80, 0x75, 0x5c, 0x66, 0xa1,
+    0x64, 0x02, 0x66, 0xa3, 0x40, 0x02, 0xbb, 0x32, 0x02, 0xe8, 0x5c, 0x00, 0xbf, 0xa6, 0x02, 0x31,
+    0xed, 0xe8, 0x66, 0x00, 0x83, 0xfd, 0x10, 0x75, 0x15, 0xbb, 0x48, 0x02, 0xe8, 0x49, 0x00, 0xba,
+    0x04, 0x00, 0xe8, 0x55, 0x00, 0x4a, 0x75, 0xfa, 0xbb, 0x55, 0x02, 0xe8, 0x3a, 0x00, 0xc6, 0x06,
+    0x62, 0x02, 0x0c, 0xbb, 0x18, 0x02, 0xe8, 0x2f, 0x00, 0xfc, 0xab, 0xbe, 0x63, 0x02, 0xb9, 0x0a,
+    0x00, 0xf3, 0xa4, 0x45, 0x83, 0xfd, 0x20, 0x72, 0xc8, 0xbe, 0xa6, 0x02, 0xb9, 0x80, 0x01, 0xe8,
+    0x51, 0x00, 0xbf, 0x76, 0x02, 0xe8, 0x2e, 0x00, 0xeb, 0x5c, 0xbe, 0x91, 0x02, 0xbf, 0x6d, 0x02,
+    0xb9, 0x15, 0x00, 0xfc, 0xf3, 0xa4, 0xeb, 0x4e, 0x56, 0x57, 0x55, 0xb8, 0x10, 0x15, 0xb9, 0x03,
+    0x00, 0xcd, 0x2f, 0x8b, 0x47, 0x03, 0x5d, 0x5f, 0x5e, 0xc3, 0x64, 0xa1, 0x6c, 0x00, 0x64, 0x3b,
+    0x06, 0x6c, 0x00, 0x74, 0xf9, 0xc3, 0xb9, 0x08, 0x00, 0x66, 0xc1, 0xc0, 0x04, 0x88, 0xc3, 0x80,
+    0xe3, 0x0f, 0x80, 0xc3, 0x30, 0x80, 0xfb, 0x39, 0x76, 0x03, 0x80, 0xc3, 0x07, 0x88, 0x1d, 0x47,
+    0xe2, 0xe7, 0xc3, 0x66, 0xb8, 0xc5, 0x9d, 0x1c, 0x81, 0x32, 0x04, 0x66, 0x69, 0xc0, 0x93, 0x01,
+    0x00, 0x01, 0x46, 0xe2, 0xf4, 0xc3, 0xba, 0x6d, 0x02, 0xb4, 0x09, 0xcd, 0x21, 0xbf, 0x6d, 0x02,
+    0xb0, 0x24, 0xb9, 0xff, 0xff, 0xfc, 0xf2, 0xae, 0x89, 0xfe, 0x81, 0xee, 0x6e, 0x02, 0xb4, 0x3c,
+    0x31, 0xc9, 0xba, 0x0d, 0x02, 0xcd, 0x21, 0x72, 0x0f, 0x89, 0xc3, 0x89, 0xf1, 0xba, 0x6d, 0x02,
+    0xb4, 0x40, 0xcd, 0x21, 0xb4, 0x3e, 0xcd, 0x21, 0xb8, 0x00, 0x4c, 0xcd, 0x21, 0x52, 0x45, 0x53,
+    0x55, 0x4c, 0x54, 0x2e, 0x54, 0x58, 0x54, 0x00, 0x1a, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x62, 0x02, 0x00, 0x00, 0x0b, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x16, 0x00, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01,
+    0x00, 0x00, 0x00, 0x00, 0x2c, 0x01, 0x00, 0x00, 0x0d, 0x00, 0x85, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x0d, 0x00, 0x88, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x43, 0x44, 0x20,
+    0x74, 0x72, 0x61, 0x63, 0x65, 0x20, 0x2e, 0x2e, 0x2e, 0x2e, 0x2e, 0x2e, 0x2e, 0x2e, 0x0d, 0x0a,
+    0x24, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x4e, 0x6f, 0x20, 0x43, 0x44, 0x20, 0x61, 0x75, 0x64, 0x69, 0x6f, 0x20, 0x74, 0x72, 0x61,
+    0x63, 0x6b, 0x2e, 0x0d, 0x0a, 0x24,
+};
+
+inline constexpr uint8_t workload_cpu_com[] = {
+    0x31, 0xed, 0xb9, 0x00, 0x10, 0x31, 0xdb, 0x8b, 0x87, 0x50, 0x01, 0x01, 0xc8, 0x31, 0xe8, 0xc1,
+    0xc0, 0x03, 0x6b, 0xc0, 0x07, 0x89, 0x87, 0x50, 0x01, 0xba, 0x00, 0x00, 0x89, 0xce, 0x83, 0xce,
+    0x01, 0xf7, 0xf6, 0xe8, 0x0c, 0x00, 0x83, 0xc3, 0x02, 0x81, 0xe3, 0xfe, 0x1f, 0xe2, 0xd8, 0x45,
+    0xeb, 0xd0, 0x50, 0x51, 0x88, 0xc1, 0x80, 0xe1, 0x07, 0x66, 0xd3, 0xe8, 0x66, 0x01, 0x06, 0x50,
+    0x21, 0x66, 0x83, 0x16, 0x54, 0x21, 0x00, 0x59, 0x58, 0xc3, 0x8d, 0xb4, 0x00, 0x00, 0x66, 0x90,
+};
+
+inline constexpr uint8_t workload_files_com[] = {
+    0xc6, 0x06, 0x56, 0x04, 0x31, 0xba, 0x20, 0x04, 0xb4, 0x39, 0xcd, 0x21, 0x0f, 0x82, 0x0b, 0x02,
+    0xc6, 0x06, 0x56, 0x04, 0x32, 0x31, 0xf6, 0xe8, 0x16, 0x02, 0x89, 0xf0, 0xe8, 0x32, 0x02, 0x0f,
+    0x82, 0xf8, 0x01, 0x46, 0x81, 0xfe, 0x2c, 0x01, 0x72, 0xed, 0xc6, 0x06, 0x56, 0x04, 0x33, 0x31,
+    0xf6, 0xe8, 0xfc, 0x01, 0xe8, 0x3b, 0x02, 0x0f, 0x82, 0xe0, 0x01, 0x39, 0xf0, 0x0f, 0x85, 0xda,
+    0x01, 0x46, 0x81, 0xfe, 0x2c, 0x01, 0x72, 0xe9, 0xc6, 0x06, 0x56, 0x04, 0x34, 0xbe, 0x01, 0x00,
+    0xe8, 0xdd, 0x01, 0xba, 0x42, 0x04, 0xb4, 0x41, 0xcd, 0x21, 0x0f, 0x82, 0xbd, 0x01, 0x83, 0xc6,
+    0x02, 0x81, 0xfe, 0x2c, 0x01, 0x72, 0xe9, 0xc6, 0x06, 0x56, 0x04, 0x35, 0x31, 0xf6, 0xe8, 0xbf,
+    0x01, 0xe8, 0xfe, 0x01, 0x73, 0x0a, 0xf7, 0xc6, 0x01, 0x00, 0x0f, 0x84, 0x9d, 0x01, 0xeb, 0x0e,
+    0xf7, 0xc6, 0x01, 0x00, 0x0f, 0x85, 0x93, 0x01, 0x39, 0xf0, 0x0f, 0x85, 0x8d, 0x01, 0x46, 0x81,
+    0xfe, 0x2c, 0x01, 0x72, 0xd9, 0xc6, 0x06, 0x56, 0x04, 0x36, 0xe8, 0xfa, 0x01, 0x3d, 0x96, 0x00,
+    0x0f, 0x85, 0x77, 0x01, 0xc6, 0x06, 0x56, 0x04, 0x37, 0x31, 0xf6, 0xe8, 0x82, 0x01, 0xba, 0x42,
+    0x04, 0xbf, 0x4c, 0x04, 0xb4, 0x56, 0xcd, 0x21, 0x0f, 0x82, 0x5f, 0x01, 0xe8, 0xb3, 0x01, 0x0f,
+    0x83, 0x58, 0x01, 0xc6, 0x06, 0x56, 0x04, 0x38, 0xc6, 0x06, 0x47, 0x04, 0x47, 0xe8, 0xa2, 0x01,
+    0x0f, 0x82, 0x47, 0x01, 0x85, 0xc0, 0x0f, 0x85, 0x41, 0x01, 0xc6, 0x06, 0x47, 0x04, 0x46, 0xc6,
+    0x06, 0x56, 0x04, 0x39, 0xba, 0x20, 0x04, 0xbf, 0x25, 0x04, 0xb4, 0x56, 0xcd, 0x21, 0x0f, 0x82,
+    0x29, 0x01, 0xbe, 0x02, 0x00, 0xe8, 0x38, 0x01, 0xe8, 0x77, 0x01, 0x0f, 0x83, 0x1c, 0x01, 0xc6,
+    0x06, 0x56, 0x04, 0x41, 0xc6, 0x06, 0x45, 0x04, 0x42, 0xc6, 0x06, 0x3c, 0x04, 0x42, 0xe8, 0x61,
+    0x01, 0x0f, 0x82, 0x06, 0x01, 0x83, 0xf8, 0x02, 0x0f, 0x85, 0xff, 0x00, 0xc6, 0x06, 0x56, 0x04,
+    0x42, 0xbe, 0x01, 0x00, 0xe8, 0x09, 0x01, 0xb8, 0xe9, 0x03, 0xe8, 0x24, 0x01, 0x0f, 0x82, 0xea,
+    0x00, 0xe8, 0x3e, 0x01, 0x0f, 0x82, 0xe3, 0x00, 0x3d, 0xe9, 0x03, 0x0f, 0x85, 0xdc, 0x00, 0xc6,
+    0x06, 0x56, 0x04, 0x43, 0xe8, 0x50, 0x01, 0x3d, 0x97, 0x00, 0x0f, 0x85, 0xcd, 0x00, 0xc6, 0x06,
+    0x56, 0x04, 0x44, 0xba, 0x20, 0x04, 0xb4, 0x39, 0xcd, 0x21, 0x0f, 0x82, 0xbd, 0x00, 0xc6, 0x06,
+    0x45, 0x04, 0x41, 0xbe, 0x02, 0x00, 0xe8, 0xc7, 0x00, 0xb8, 0xef, 0xbe, 0xe8, 0xe2, 0x00, 0x0f,
+    0x82, 0xa8, 0x00, 0xe8, 0xfc, 0x00, 0x0f, 0x82, 0xa1, 0x00, 0x3d, 0xef, 0xbe, 0x0f, 0x85, 0x9a,
+    0x00, 0xc6, 0x06, 0x56, 0x04, 0x45, 0xba, 0x2a, 0x04, 0xb4, 0x39, 0xcd, 0x21, 0x0f, 0x82, 0x8a,
+    0x00, 0xba, 0x2f, 0x04, 0xb8, 0x34, 0x12, 0xe8, 0xba, 0x00, 0x72, 0x7f, 0xc6, 0x06, 0x45, 0x04,
+    0x42, 0xc6, 0x06, 0x4f, 0x04, 0x42, 0x31, 0xf6, 0xe8, 0x85, 0x00, 0xc6, 0x06, 0x47, 0x04, 0x54,
+    0x89, 0xf0, 0xe8, 0x9c, 0x00, 0x72, 0x64, 0xc6, 0x06, 0x51, 0x04, 0x55, 0xa1, 0x48, 0x04, 0xa3,
+    0x52, 0x04, 0xa0, 0x4a, 0x04, 0xa2, 0x54, 0x04, 0xba, 0x42, 0x04, 0xbf, 0x4c, 0x04, 0xb4, 0x56,
+    0xcd, 0x21, 0x72, 0x47, 0xba, 0x4c, 0x04, 0xb4, 0x41, 0xcd, 0x21, 0x72, 0x3e, 0xba, 0x2f, 0x04,
+    0xe8, 0x92, 0x00, 0x72, 0x36, 0x3d, 0x34, 0x12, 0x75, 0x31, 0x46, 0x81, 0xfe, 0xe8, 0x03, 0x72,
+    0xb7, 0xc6, 0x06, 0x47, 0x04, 0x46, 0xc6, 0x06, 0x56, 0x04, 0x46, 0xe8, 0x99, 0x00, 0x3d, 0x97,
+    0x00, 0x75, 0x18, 0xc6, 0x06, 0x56, 0x04, 0x47, 0xbe, 0x2a, 0x01, 0xe8, 0x22, 0x00, 0xe8, 0x61,
+    0x00, 0x72, 0x08, 0x3d, 0x2a, 0x01, 0x75, 0x03, 0xe9, 0xc3, 0x00, 0xa0, 0x56, 0x04, 0xa2, 0x86,
+    0x04, 0xbe, 0x7c, 0x04, 0xbf, 0x65, 0x04, 0xb9, 0x0e, 0x00, 0xfc, 0xf3, 0xa4, 0xe9, 0xae, 0x00,
+    0x89, 0xf0, 0xbb, 0x0a, 0x00, 0x31, 0xd2, 0xf7, 0xf3, 0x80, 0xc2, 0x30, 0x88, 0x16, 0x4a, 0x04,
+    0x31, 0xd2, 0xf7, 0xf3, 0x80, 0xc2, 0x30, 0x88, 0x16, 0x49, 0x04, 0x04, 0x30, 0xa2, 0x48, 0x04,
+    0xc3, 0xba, 0x42, 0x04, 0xa3, 0x57, 0x04, 0xb4, 0x3c, 0x31, 0xc9, 0xcd, 0x21, 0x72, 0x12, 0x89,
+    0xc3, 0xb4, 0x40, 0xb9, 0x02, 0x00, 0xba, 0x57, 0x04, 0xcd, 0x21, 0x72, 0x04, 0xb4, 0x3e, 0xcd,
+    0x21, 0xc3, 0xba, 0x42, 0x04, 0xc7, 0x06, 0x57, 0x04, 0xff, 0xff, 0xb8, 0x00, 0x3d, 0xcd, 0x21,
+    0x72, 0x14, 0x89, 0xc3, 0xb4, 0x3f, 0xb9, 0x02, 0x00, 0xba, 0x57, 0x04, 0xcd, 0x21, 0xb4, 0x3e,
+    0xcd, 0x21, 0xa1, 0x57, 0x04, 0xf8, 0xc3, 0x31, 0xed, 0xb4, 0x4e, 0x31, 0xc9, 0xba, 0x39, 0x04,
+    0xcd, 0x21, 0x72, 0x07, 0x45, 0xb4, 0x4f, 0xcd, 0x21, 0xeb, 0xf7, 0x89, 0xe8, 0xc3, 0xb9, 0x08,
+    0x00, 0x66, 0xc1, 0xc0, 0x04, 0x88, 0xc3, 0x80, 0xe3, 0x0f, 0x80, 0xc3, 0x30, 0x80, 0xfb, 0x39,
+    0x76, 0x03, 0x80, 0xc3, 0x07, 0x88, 0x1d, 0x47, 0xe2, 0xe7, 0xc3, 0x66, 0xb8, 0xc5, 0x9d, 0x1c,
+    0x81, 0x32, 0x04, 0x66, 0x69, 0xc0, 0x93, 0x01, 0x00, 0x01, 0x46, 0xe2, 0xf4, 0xc3, 0xba, 0x59,
+    0x04, 0xb4, 0x09, 0xcd, 0x21, 0xbf, 0x59, 0x04, 0xb0, 0x24, 0xb9, 0xff, 0xff, 0xfc, 0xf2, 0xae,
+    0x89, 0xfe, 0x81, 0xee, 0x5a, 0x04, 0xb4, 0x3c, 0x31, 0xc9, 0xba, 0x15, 0x04, 0xcd, 0x21, 0x72,
+    0x0f, 0x89, 0xc3, 0x89, 0xf1, 0xba, 0x59, 0x04, 0xb4, 0x40, 0xcd, 0x21, 0xb4, 0x3e, 0xcd, 0x21,
+    0xb8, 0x00, 0x4c, 0xcd, 0x21, 0x52, 0x45, 0x53, 0x55, 0x4c, 0x54, 0x2e, 0x54, 0x58, 0x54, 0x00,
+    0x44, 0x49, 0x52, 0x41, 0x00, 0x44, 0x49, 0x52, 0x42, 0x00, 0x44, 0x49, 0x52, 0x43, 0x00, 0x44,
+    0x49, 0x52, 0x43, 0x5c, 0x4b, 0x45, 0x45, 0x50, 0x00, 0x44, 0x49, 0x52, 0x41, 0x5c, 0x2a, 0x2e,
+    0x2a, 0x00, 0x44, 0x49, 0x52, 0x41, 0x5c, 0x46, 0x30, 0x30, 0x30, 0x00, 0x44, 0x49, 0x52, 0x41,
+    0x5c, 0x47, 0x30, 0x30, 0x30, 0x00, 0x00, 0x00, 0x00, 0x44, 0x72, 0x69, 0x76, 0x65, 0x20, 0x63,
+    0x61, 0x63, 0x68, 0x65, 0x20, 0x50, 0x41, 0x53, 0x53, 0x0d, 0x0a, 0x24, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x46, 0x41, 0x49, 0x4c,
+    0x20, 0x73, 0x74, 0x65, 0x70, 0x20, 0x3f, 0x0d, 0x0a, 0x24,
+};
+
+inline constexpr uint8_t workload_opl_com[] = {
+    0xb8, 0x01, 0x20, 0xe8, 0x88, 0x00, 0x31, 0xdb, 0x89, 0xde, 0x8a, 0x84, 0xa8, 0x01, 0xb9, 0x02,
+    0x00, 0x89, 0xc7, 0x04, 0x20, 0xb4, 0x21, 0xe8, 0x74, 0x00, 0x89, 0xf8, 0x04, 0x40, 0xb4, 0x10,
+    0xe8, 0x6b, 0x00, 0x89, 0xf8, 0x04, 0x60, 0xb4, 0xf4, 0xe8, 0x62, 0x00, 0x89, 0xf8, 0x04, 0x80,
+    0xb4, 0x55, 0xe8, 0x59, 0x00, 0x89, 0xf8, 0x04, 0xe0, 0x88, 0xdc, 0x80, 0xe4, 0x03, 0xe8, 0x4d,
+    0x00, 0x89, 0xf8, 0x04, 0x03, 0xe2, 0xca, 0x88, 0xd8, 0x04, 0xc0, 0xb4, 0x3e, 0xe8, 0x3e, 0x00,
+    0x43, 0x83, 0xfb, 0x09, 0x72, 0xb2, 0x31, 0xed, 0x31, 0xdb, 0x89, 0xe8, 0x01, 0xd8, 0xc1, 0xe0,
+    0x05, 0x25, 0xff, 0x03, 0x0d, 0x00, 0x01, 0x89, 0xc2, 0x88, 0xd8, 0x04, 0xa0, 0x88, 0xd4, 0xe8,
+    0x1c, 0x00, 0x88, 0xd8, 0x04, 0xb0, 0x88, 0xf4, 0x80, 0xcc, 0x30, 0xe8, 0x10, 0x00, 0x43, 0x83,
+    0xfb, 0x09, 0x72, 0xd6, 0xb9, 0xd0, 0x07, 0xe4, 0x61, 0xe2, 0xfc, 0x45, 0xeb, 0xca, 0x51, 0x52,
+    0xba, 0x88, 0x03, 0xee, 0xb9, 0x06, 0x00, 0xec, 0xe2, 0xfd, 0x42, 0x88, 0xe0, 0xee, 0x4a, 0xb9,
+    0x23, 0x00, 0xec, 0xe2, 0xfd, 0x5a, 0x59, 0xc3, 0x00, 0x01, 0x02, 0x08, 0x09, 0x0a, 0x10, 0x11,
+    0x12,
+};
+
+inline constexpr uint8_t workload_pic_com[] = {
+    0xfa, 0x31, 0xc0, 0x8e, 0xc0, 0x26, 0x66, 0xa1, 0x20, 0x00, 0x66, 0xa3, 0xcc, 0x02, 0x26, 0x66,
+    0xa1, 0xc0, 0x01, 0x66, 0xa3, 0xd0, 0x02, 0x26, 0xc7, 0x06, 0x20, 0x00, 0xdd, 0x01, 0x26, 0x8c,
+    0x0e, 0x22, 0x00, 0x26, 0xc7, 0x06, 0xc0, 0x01, 0x06, 0x02, 0x26, 0x8c, 0x0e, 0xc2, 0x01, 0x0e,
+    0x07, 0x31, 0xdb, 0xe8, 0x7a, 0x00, 0xb0, 0x0a, 0xe6, 0x70, 0xb0, 0x26, 0xe6, 0x71, 0xb0, 0x0b,
+    0xe6, 0x70, 0xe4, 0x71, 0x0c, 0x40, 0x88, 0xc4, 0xb0, 0x0b, 0xe6, 0x70, 0x88, 0xe0, 0xe6, 0x71,
+    0xe4, 0xa1, 0x24, 0xfe, 0xe6, 0xa1, 0xe4, 0x21, 0x24, 0xfb, 0xe6, 0x21, 0x31, 0xf6, 0xfb, 0x46,
+    0x81, 0x3e, 0xc7, 0x02, 0x00, 0x08, 0x72, 0xf7, 0xfa, 0xb0, 0x0b, 0xe6, 0x70, 0xe4, 0x71, 0x24,
+    0xbf, 0x88, 0xc4, 0xb0, 0x0b, 0xe6, 0x70, 0x88, 0xe0, 0xe6, 0x71, 0xb0, 0x34, 0xe6, 0x43, 0x30,
+    0xc0, 0xe6, 0x40, 0xe6, 0x40, 0x31, 0xc0, 0x8e, 0xc0, 0x66, 0xa1, 0xcc, 0x02, 0x26, 0x66, 0xa3,
+    0x20, 0x00, 0x66, 0xa1, 0xd0, 0x02, 0x26, 0x66, 0xa3, 0xc0, 0x01, 0x0e, 0x07, 0xfb, 0xbe, 0xd4,
+    0x02, 0xb9, 0x00, 0x08, 0xe8, 0xae, 0x00, 0xbf, 0xb4, 0x02, 0xe8, 0x8b, 0x00, 0xe9, 0xb8, 0x00,
+    0xd1, 0xe3, 0x8b, 0x9f, 0xbf, 0x02, 0xb0, 0x34, 0xe6, 0x43, 0x88, 0xd8, 0xe6, 0x40, 0x88, 0xf8,
+    0xe6, 0x40, 0xc3, 0x53, 0x8b, 0x1e, 0xc7, 0x02, 0x81, 0xfb, 0x00, 0x08, 0x73, 0x0b, 0x89, 0x87,
+    0xd4, 0x02, 0x83, 0xc3, 0x02, 0x89, 0x1e, 0xc7, 0x02, 0x31, 0xf6, 0x5b, 0xc3, 0x50, 0x53, 0x89,
+    0xf0, 0x80, 0xe4, 0x7f, 0xe8, 0xdc, 0xff, 0xfe, 0x06, 0xc9, 0x02, 0xf6, 0x06, 0xc9, 0x02, 0x0f,
+    0x75, 0x0d, 0x8a, 0x1e, 0xc9, 0x02, 0xc0, 0xeb, 0x04, 0x83, 0xe3, 0x03, 0xe8, 0xb1, 0xff, 0xb0,
+    0x20, 0xe6, 0x20, 0x5b, 0x58, 0xcf, 0x50, 0xb0, 0x0c, 0xe6, 0x70, 0xe4, 0x71, 0x89, 0xf0, 0x80,
+    0xcc, 0x80, 0xe8, 0xae, 0xff, 0xfe, 0x06, 0xca, 0x02, 0xf6, 0x06, 0xca, 0x02, 0x1f, 0x75, 0x10,
+    0xb0, 0x0a, 0xe6, 0x70, 0xa0, 0xca, 0x02, 0xc0, 0xe8, 0x05, 0x24, 0x01, 0x0c, 0x26, 0xe6, 0x71,
+    0xb0, 0x20, 0xe6, 0xa0, 0xe6, 0x20, 0x58, 0xcf, 0xb9, 0x08, 0x00, 0x66, 0xc1, 0xc0, 0x04, 0x88,
+    0xc3, 0x80, 0xe3, 0x0f, 0x80, 0xc3, 0x30, 0x80, 0xfb, 0x39, 0x76, 0x03, 0x80, 0xc3, 0x07, 0x88,
+    0x1d, 0x47, 0xe2, 0xe7, 0xc3, 0x66, 0xb8, 0xc5, 0x9d, 0x1c, 0x81, 0x32, 0x04, 0x66, 0x69, 0xc0,
+    0x93, 0x01, 0x00, 0x01, 0x46, 0xe2, 0xf4, 0xc3, 0xba, 0xaa, 0x02, 0xb4, 0x09, 0xcd, 0x21, 0xbf,
+    0xaa, 0x02, 0xb0, 0x24, 0xb9, 0xff, 0xff, 0xfc, 0xf2, 0xae, 0x89, 0xfe, 0x81, 0xee, 0xab, 0x02,
+    0xb4, 0x3c, 0x31, 0xc9, 0xba, 0x9f, 0x02, 0xcd, 0x21, 0x72, 0x0f, 0x89, 0xc3, 0x89, 0xf1, 0xba,
+    0xaa, 0x02, 0xb4, 0x40, 0xcd, 0x21, 0xb4, 0x3e, 0xcd, 0x21, 0xb8, 0x00, 0x4c, 0xcd, 0x21, 0x52,
+    0x45, 0x53, 0x55, 0x4c, 0x54, 0x2e, 0x54, 0x58, 0x54, 0x00, 0x50, 0x49, 0x43, 0x20, 0x74, 0x72,
+    0x61, 0x63, 0x65, 0x20, 0x2e, 0x2e, 0x2e, 0x2e, 0x2e, 0x2e, 0x2e, 0x2e, 0x0d, 0x0a, 0x24, 0xe8,
+    0x03, 0xdc, 0x05, 0x09, 0x03, 0xa9, 0x04, 0x00, 0x00, 0x00, 0x00, 0x90, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00,
+};
+
+inline constexpr uint8_t workload_pit_com[] = {
+    0xfa, 0x31, 0xc0, 0x8e, 0xc0, 0x26, 0xc7, 0x06, 0x20, 0x00, 0x43, 0x01, 0x26, 0x8c, 0x0e, 0x22,
+    0x00, 0xb0, 0x34, 0xe6, 0x43, 0xb0, 0x4b, 0xe6, 0x40, 0x30, 0xc0, 0xe6, 0x40, 0xfb, 0x31, 0xed,
+    0xb9, 0x00, 0x10, 0x31, 0xdb, 0x8b, 0x87, 0x50, 0x01, 0x01, 0xc8, 0x31, 0xe8, 0xc1, 0xc0, 0x03,
+    0x6b, 0xc0, 0x07, 0x89, 0x87, 0x50, 0x01, 0x83, 0xc3, 0x02, 0x81, 0xe3, 0xfe, 0x1f, 0xe2, 0xe5,
+    0x45, 0xeb, 0xdd, 0x50, 0xe4, 0x61, 0x34, 0x02, 0xe6, 0x61, 0xb0, 0x20, 0xe6, 0x20, 0x58, 0xcf,
+};
+
+inline constexpr uint8_t workload_svga_lfb_com[] = {
+    0xb8, 0x01, 0x4f, 0xb9, 0x01, 0x01, 0xbf, 0xa0, 0x01, 0xcd, 0x10, 0x83, 0xf8, 0x4f, 0x75, 0x4a,
+    0x66, 0x8b, 0x36, 0xc8, 0x01, 0x66, 0x85, 0xf6, 0x74, 0x40, 0xb8, 0x02, 0x4f, 0xbb, 0x01, 0x41,
+    0xcd, 0x10, 0x83, 0xf8, 0x4f, 0x75, 0x33, 0x31, 0xc0, 0x8e, 0xc0, 0x66, 0x31, 0xed, 0x66, 0x89,
+    0xf7, 0x66, 0xba, 0xe0, 0x01, 0x00, 0x00, 0x66, 0x89, 0xeb, 0x88, 0xd8, 0x88, 0xc4, 0x89, 0xc1,
+    0x66, 0xc1, 0xe0, 0x10, 0x89, 0xc8, 0x66, 0xb9, 0xa0, 0x00, 0x00, 0x00, 0x67, 0x66, 0xf3, 0xab,
+    0x66, 0x43, 0x66, 0x4a, 0x75, 0xe4, 0x66, 0x45, 0xeb, 0xd4, 0xba, 0x66, 0x01, 0xb4, 0x09, 0xcd,
+    0x21, 0xb8, 0x01, 0x4c, 0xcd, 0x21, 0x56, 0x45, 0x53, 0x41, 0x20, 0x6d, 0x6f, 0x64, 0x65, 0x20,
+    0x31, 0x30, 0x31, 0x68, 0x20, 0x77, 0x69, 0x74, 0x68, 0x20, 0x6c, 0x69, 0x6e, 0x65, 0x61, 0x72,
+    0x20, 0x66, 0x72, 0x61, 0x6d, 0x65, 0x20, 0x62, 0x75, 0x66, 0x66, 0x65, 0x72, 0x20, 0x6e, 0x6f,
+    0x74, 0x20, 0x61, 0x76, 0x61, 0x69, 0x6c, 0x61, 0x62, 0x6c, 0x65, 0x2e, 0x0d, 0x0a, 0x24, 0x90,
+};
+
+inline constexpr uint8_t workload_vga13h_com[] = {
+    0xb8, 0x13, 0x00, 0xcd, 0x10, 0xb8, 0x00, 0xa0, 0x8e, 0xc0, 0x31, 0xed, 0x31, 0xff, 0xba, 0xc8,
+    0x00, 0x89, 0xeb, 0x88, 0xd8, 0x88, 0xc4, 0xb9, 0xa0, 0x00, 0xf3, 0xab, 0x43, 0x4a, 0x75, 0xf3,
+    0xba, 0xc8, 0x03, 0x30, 0xc0, 0xee, 0x42, 0x31, 0xc9, 0x88, 0xc8, 0x01, 0xe8, 0x24, 0x3f, 0xee,
+    0xd0, 0xe8, 0xee, 0xf6, 0xd0, 0x24, 0x3f, 0xee, 0xfe, 0xc1, 0x75, 0xed, 0x45, 0xeb, 0xcd,
+};
+
+inline constexpr uint8_t workload_voodoo_com[] = {
+    0x66, 0x31, 0xdb, 0x66, 0x89, 0xd8, 0x66, 0xc1, 0xe0, 0x0b, 0x66, 0x0d, 0x00, 0x00, 0x00, 0x80,
+    0xba, 0xf8, 0x0c, 0x66, 0xef, 0xba, 0xfc, 0x0c, 0x66, 0xed, 0x3d, 0x1a, 0x12, 0x74, 0x12, 0x43,
+    0x83, 0xfb, 0x20, 0x72, 0xde, 0xba, 0x66, 0x02, 0xb4, 0x09, 0xcd, 0x21, 0xb8, 0x01, 0x4c, 0xcd,
+    0x21, 0x66, 0x89, 0xd8, 0x66, 0xc1, 0xe0, 0x0b, 0x66, 0x0d, 0x10, 0x00, 0x00, 0x80, 0xba, 0xf8,
+    0x0c, 0x66, 0xef, 0xba, 0xfc, 0x0c, 0x66, 0xed, 0x66, 0x83, 0xe0, 0xf0, 0x66, 0x89, 0xc6, 0x31,
+    0xc0, 0x8e, 0xe0, 0x64, 0x67, 0x66, 0xc7, 0x86, 0x04, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x64, 0x67, 0x66, 0xc7, 0x86, 0x10, 0x01, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x66, 0x31, 0xed,
+    0x31, 0xdb, 0x89, 0xdf, 0xc1, 0xe7, 0x04, 0x66, 0x0f, 0xb7, 0x85, 0x90, 0x02, 0x66, 0xc1, 0xe0,
+    0x04, 0x64, 0x67, 0x66, 0x89, 0x46, 0x08, 0x66, 0x0f, 0xb7, 0x85, 0x92, 0x02, 0x66, 0xc1, 0xe0,
+    0x04, 0x64, 0x67, 0x66, 0x89, 0x46, 0x0c, 0x66, 0x0f, 0xb7, 0x85, 0x94, 0x02, 0x66, 0xc1, 0xe0,
+    0x04, 0x64, 0x67, 0x66, 0x89, 0x46, 0x10, 0x66, 0x0f, 0xb7, 0x85, 0x96, 0x02, 0x66, 0xc1, 0xe0,
+    0x04, 0x64, 0x67, 0x66, 0x89, 0x46, 0x14, 0x66, 0x0f, 0xb7, 0x85, 0x98, 0x02, 0x66, 0xc1, 0xe0,
+    0x04, 0x64, 0x67, 0x66, 0x89, 0x46, 0x18, 0x66, 0x0f, 0xb7, 0x85, 0x9a, 0x02, 0x66, 0xc1, 0xe0,
+    0x04, 0x64, 0x67, 0x66, 0x89, 0x46, 0x1c, 0x66, 0x89, 0xe8, 0x66, 0x01, 0xd8, 0x66, 0x25, 0xff,
+    0x00, 0x00, 0x00, 0x66, 0xc1, 0xe0, 0x0c, 0x64, 0x67, 0x66, 0x89, 0x46, 0x20, 0x66, 0x35, 0x00,
+    0xf0, 0x0f, 0x00, 0x64, 0x67, 0x66, 0x89, 0x46, 0x24, 0x64, 0x67, 0x66, 0xc7, 0x46, 0x28, 0x00,
+    0x00, 0x08, 0x00, 0x64, 0x67, 0x66, 0xc7, 0x46, 0x40, 0x00, 0x01, 0x00, 0x00, 0x64, 0x67, 0x66,
+    0xc7, 0x46, 0x44, 0x80, 0x00, 0x00, 0x00, 0x64, 0x67, 0x66, 0xc7, 0x46, 0x48, 0x40, 0x00, 0x00,
+    0x00, 0x64, 0x67, 0x66, 0xc7, 0x46, 0x60, 0x80, 0x00, 0x00, 0x00, 0x64, 0x67, 0x66, 0xc7, 0x46,
+    0x64, 0x00, 0x01, 0x00, 0x00, 0x64, 0x67, 0x66, 0xc7, 0x46, 0x68, 0x00, 0x02, 0x00, 0x00, 0x64,
+    0x67, 0x66, 0xc7, 0x86, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x43, 0x83, 0xfb, 0x04,
+    0x0f, 0x82, 0x1e, 0xff, 0x66, 0x45, 0xba, 0xda, 0x03, 0xec, 0xa8, 0x08, 0x75, 0xfb, 0xec, 0xa8,
+    0x08, 0x74, 0xfb, 0xe9, 0x0a, 0xff, 0x4e, 0x6f, 0x20, 0x33, 0x64, 0x66, 0x78, 0x20, 0x56, 0x6f,
+    0x6f, 0x64, 0x6f, 0x6f, 0x20, 0x66, 0x6f, 0x75, 0x6e, 0x64, 0x20, 0x6f, 0x6e, 0x20, 0x74, 0x68,
+    0x65, 0x20, 0x50, 0x43, 0x49, 0x20, 0x62, 0x75, 0x73, 0x2e, 0x0d, 0x0a, 0x24, 0x8d, 0x74, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x7f, 0x02, 0x00, 0x00, 0x00, 0x00, 0xdf, 0x01, 0x00, 0x00, 0x00, 0x00,
+    0x7f, 0x02, 0x00, 0x00, 0x7f, 0x02, 0xdf, 0x01, 0x00, 0x00, 0xdf, 0x01, 0x00, 0x00, 0x00, 0x00,
+    0x40, 0x01, 0x14, 0x00, 0x6c, 0x02, 0xcc, 0x01, 0x14, 0x00, 0xcc, 0x01, 0x00, 0x00, 0x00, 0x00,
+    0x64, 0x00, 0x90, 0x01, 0x40, 0x01, 0x28, 0x00, 0x1c, 0x02, 0x90, 0x01, 0x00, 0x00, 0x00, 0x00,
+};
+
@@ -0,0 +1,27 @@
+#!/bin/sh
+# Assembles the benchmark workload programs into DOS .COM images and writes
+# them out as C arrays to ../workloads.h. Needs GNU binutils that can target
+# i386. Only has to be run after changing one of the .S files.
+set -e
+cd "$(dirname "$0")"
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+
+out=../workloads.h
+{
+    echo "// Generated by workloads/assemble.sh from workloads/*.S, do not edit."
+    echo "#pragma once"
+    echo "#include <cstdint>"
+    echo
+    for src in *.S; do
+        name=$(basename "$src" .S)
+        ${AS:-as} --32 -o "$tmp/$name.o" "$src"
+        ${LD:-ld} -m elf_i386 -Ttext=0x100 --oformat binary -o "$tmp/$name.com" "$tmp/$name.o"
+        echo "inline constexpr uint8_t workload_${name}_com[] = {"
+        od -An -v -tx1 "$tmp/$name.com" | sed -e 's/ \([0-9a-f][0-9a-f]\)/0x\1, /g' -e 's/, $/,/' \
+            -e 's/^/    /'
+        echo "};"
+        echo
+    done
+} > "$out.tmp"
+mv "$out.tmp" "$out"
@@ -2,13 +2,30 @@
 #include "emu_thread.h"
 
 #include "libretro_dosbox.h"
+#include "libretro_profiler.h"
+#include "log.h"
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <cstdint>
 #include <mutex>
+#include <new>
 #include <thread>
+#if !defined(_WIN32) && !defined(__APPLE__) && !defined(__ANDROID__) && __has_include(<ucontext.h>)
+    #define HAVE_EMU_FIBER 1
+    #include <sys/mman.h>
+    #include <ucontext.h>
+    #include <unistd.h>
+#endif
 
 static const auto main_thread_id = std::this_thread::get_id();
 static bool use_spinlock = false;
+static bool use_adaptive_spin = false;
+static bool use_fiber = false;
+
+static std::thread emu_thread;
 
 // For CV-based waiting.
 static bool emu_keep_waiting = true;
@@ -22,6 +39,115 @@ static std::mutex main_mutex;
 static std::atomic_flag emu_flag = ATOMIC_FLAG_INIT;
 static std::atomic_flag main_flag = ATOMIC_FLAG_INIT;
 
+// For adaptive spinning. A thread that didn't get its turn within its spin budget parks on this CV
+// until the other thread clears its flag.
+static std::mutex park_mutex;
+static std::condition_variable park_cv;
+static std::atomic<int> parked_threads{0};
+static constexpr std::chrono::nanoseconds min_spin_budget = std::chrono::microseconds(1);
+static constexpr std::chrono::nanoseconds max_spin_budget = std::chrono::microseconds(500);
+
+// Handoff latency is the time from one thread giving up its turn to the other thread running. The
+// histogram uses power of two buckets in microseconds; the first one is everything below 1us and
+// the last one everything above.
+static constexpr size_t latency_buckets = 18;
+static constexpr auto latency_report_interval = std::chrono::seconds(60);
+
+struct HandoffStats final
+{
+    const char* const target;
+    std::chrono::nanoseconds spin_budget = std::chrono::microseconds(50);
+    std::array<uint32_t, latency_buckets> histogram{};
+    uint32_t switches = 0;
+    uint32_t parked = 0;
+    std::chrono::steady_clock::time_point last_report = std::chrono::steady_clock::now();
+};
+
+// Each of these is only touched by the thread that is being switched to.
+static HandoffStats to_emu_stats{"emulation thread"};
+static HandoffStats to_main_stats{"frontend thread"};
+static std::atomic<std::chrono::steady_clock::rep> handoff_start{0};
+
+#ifdef HAVE_EMU_FIBER
+// For running the emulation as a fiber on the frontend thread. Dosbox can nest deeply (shells,
+// callbacks running the CPU recursively), so give it the same stack a thread would get. Like a
+// thread stack, it's mapped with an inaccessible guard page below it so that an overflow crashes
+// right away instead of overwriting whatever is next to it.
+static constexpr size_t fiber_stack_size = 8 * 1024 * 1024;
+static char* fiber_mapping = nullptr;
+static size_t fiber_guard_size = 0;
+static std::function<void()> fiber_func;
+static ucontext_t main_context;
+static ucontext_t emu_context;
+static bool fiber_started = false;
+static bool fiber_finished = false;
+static bool in_emu_fiber = false;
+
+static void fiberEntry()
+{
+    fiber_func();
+    fiber_finished = true;
+    in_emu_fiber = false;
+    // Returning resumes main_context through uc_link.
+}
+
+static void freeFiberStack()
+{
+    if (fiber_mapping) {
+        munmap(fiber_mapping, fiber_guard_size + fiber_stack_size);
+        fiber_mapping = nullptr;
+    }
+}
+
+static void allocFiberStack()
+{
+    freeFiberStack();
+    fiber_guard_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    void* const mapping = mmap(
+        nullptr, fiber_guard_size + fiber_stack_size, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+    fiber_mapping = static_cast<char*>(mapping);
+    // The stack grows down, so the guard goes at the low end.
+    if (mprotect(fiber_mapping, fiber_guard_size, PROT_NONE) != 0) {
+        retro::logWarn("Failed to set up the guard page of the emulation fiber stack.");
+    }
+}
+
+static void startFiber(std::function<void()> func)
+{
+    fiber_func = std::move(func);
+    allocFiberStack();
+    getcontext(&emu_context);
+    emu_context.uc_stack.ss_sp = fiber_mapping + fiber_guard_size;
+    emu_context.uc_stack.ss_size = fiber_stack_size;
+    emu_context.uc_link = &main_context;
+    makecontext(&emu_context, fiberEntry, 0);
+    fiber_started = true;
+    fiber_finished = false;
+}
+
+static void switchToEmuFiber()
+{
+    if (fiber_finished) {
+        return;
+    }
+    in_emu_fiber = true;
+    swapcontext(&main_context, &emu_context);
+}
+
+static void switchToMainFiber()
+{
+    if (frontend_exit) {
+        throw EmuThreadCanceled();
+    }
+    in_emu_fiber = false;
+    swapcontext(&emu_context, &main_context);
+}
+#endif
+
 static void switchToEmuWait()
 {
     std::unique_lock emu_lock(emu_mutex);
@@ -55,32 +181,174 @@ static void switchToMainWait()
     emu_cv.wait(emu_lock, [] { return !emu_keep_waiting; });
 }
 
-static void switchToEmuSpin()
+static void cpuRelax()
 {
-    main_flag.test_and_set(std::memory_order_acquire);
-    emu_flag.clear(std::memory_order_release);
-    while (main_flag.test_and_set(std::memory_order_acquire)) {
-        if (dosbox_exit || frontend_exit) {
-            return;
+#if defined(__i386__) || defined(__x86_64__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || (defined(__arm__) && defined(__ARM_ARCH) && __ARM_ARCH >= 7)
+    asm volatile("yield");
+#endif
+}
+
+/* Give the turn to the thread waiting on `flag`, waking it up if it's parked.
+ */
+static void releaseFlag(std::atomic_flag& flag)
+{
+    flag.clear(std::memory_order_seq_cst);
+    // Pairs with the increment in acquireFlag(). Either we see the other thread parking, or it sees
+    // the cleared flag before going to sleep.
+    if (parked_threads.load(std::memory_order_seq_cst) > 0) {
+        {
+            std::lock_guard park_lock(park_mutex);
         }
+        park_cv.notify_all();
     }
 }
 
+/* Wait until `flag` is cleared by the other thread, or until `canceled` returns true, in which case
+ * false is returned. With adaptive spinning, the thread parks after spinning for its spin budget.
+ * The budget follows the waits we've seen: it grows towards twice the recent wait times when
+ * spinning a bit longer would have avoided parking, and shrinks when the other thread takes much
+ * longer than we'd ever want to spin (like when the frontend waits for vsync.)
+ */
+template <typename Pred>
+static auto acquireFlag(std::atomic_flag& flag, HandoffStats& stats, Pred canceled) -> bool
+{
+    using namespace std::chrono;
+
+    if (!flag.test_and_set(std::memory_order_acquire)) {
+        return true;
+    }
+    if (!use_adaptive_spin) {
+        while (flag.test_and_set(std::memory_order_acquire)) {
+            if (canceled()) {
+                return false;
+            }
+            cpuRelax();
+        }
+        return true;
+    }
+
+    const auto wait_start = steady_clock::now();
+    const auto spin_end = wait_start + stats.spin_budget;
+    bool acquired = false;
+    for (unsigned i = 1; !acquired; ++i) {
+        if (canceled()) {
+            return false;
+        }
+        if (i % 64 == 0 && steady_clock::now() >= spin_end) {
+            break;
+        }
+        cpuRelax();
+        acquired = !flag.test_and_set(std::memory_order_acquire);
+    }
+    if (!acquired) {
+        ++stats.parked;
+        std::unique_lock park_lock(park_mutex);
+        parked_threads.fetch_add(1, std::memory_order_seq_cst);
+        park_cv.wait(park_lock, [&flag, &acquired, &canceled] {
+            acquired = !flag.test_and_set(std::memory_order_seq_cst);
+            return acquired || canceled();
+        });
+        parked_threads.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    const auto waited = duration_cast<nanoseconds>(steady_clock::now() - wait_start);
+    const auto target =
+        waited < max_spin_budget ? std::clamp(waited * 2, min_spin_budget, max_spin_budget)
+                                 : min_spin_budget;
+    stats.spin_budget += (target - stats.spin_budget) / 8;
+    return acquired;
+}
+
+static void switchToEmuSpin()
+{
+    main_flag.test_and_set(std::memory_order_acquire);
+    releaseFlag(emu_flag);
+    acquireFlag(main_flag, to_main_stats, [] { return dosbox_exit || frontend_exit; });
+}
+
 static void switchToMainSpin()
 {
     emu_flag.test_and_set(std::memory_order_acquire);
-    main_flag.clear(std::memory_order_release);
-    while (emu_flag.test_and_set(std::memory_order_acquire)) {
-        if (frontend_exit) {
-            throw EmuThreadCanceled();
+    releaseFlag(main_flag);
+    if (!acquireFlag(emu_flag, to_emu_stats, [] { return frontend_exit; })) {
+        throw EmuThreadCanceled();
+    }
+}
+
+static auto latencyBucketName(const size_t bucket) -> std::string
+{
+    if (bucket == 0) {
+        return "<1us";
+    }
+    if (bucket == latency_buckets - 1) {
+        return fmt::format(">={}ms", (1U << (bucket - 1)) / 1000);
+    }
+    const auto low = 1U << (bucket - 1);
+    if (low < 1000) {
+        return fmt::format("{}us", low);
+    }
+    return fmt::format("{}ms", low / 1000);
+}
+
+static void logHandoffLatency(HandoffStats& stats)
+{
+    if (stats.switches == 0) {
+        return;
+    }
+    std::string buckets;
+    for (size_t i = 0; i < latency_buckets; ++i) {
+        if (stats.histogram[i] != 0) {
+            buckets += fmt::format(" {}: {}", latencyBucketName(i), stats.histogram[i]);
         }
     }
+    if (use_spinlock && use_adaptive_spin) {
+        retro::logDebug(
+            "Handoff latency to {} over {} switches ({} parked, spin budget {}us):{}", stats.target,
+            stats.switches, stats.parked,
+            std::chrono::duration_cast<std::chrono::microseconds>(stats.spin_budget).count(),
+            buckets);
+    } else {
+        retro::logDebug(
+            "Handoff latency to {} over {} switches:{}", stats.target, stats.switches, buckets);
+    }
+    stats.histogram.fill(0);
+    stats.switches = 0;
+    stats.parked = 0;
+}
+
+static void markHandoff()
+{
+    handoff_start.store(
+        std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+}
+
+static void recordHandoff(HandoffStats& stats)
+{
+    using namespace std::chrono;
+
+    const auto now = steady_clock::now();
+    const auto latency = duration_cast<microseconds>(
+        now.time_since_epoch()
+        - steady_clock::duration(handoff_start.load(std::memory_order_relaxed)));
+    size_t bucket = 0;
+    for (auto us = latency.count(); us > 0 && bucket < latency_buckets - 1; us >>= 1) {
+        ++bucket;
+    }
+    ++stats.histogram[bucket];
+    ++stats.switches;
+    if (now - stats.last_report >= latency_report_interval) {
+        logHandoffLatency(stats);
+        stats.last_report = now;
+    }
 }
 
 static void switchToEmuThread()
 {
     const bool was_using_spinlock = use_spinlock;
 
+    markHandoff();
     if (use_spinlock) {
         switchToEmuSpin();
     } else {
@@ -93,12 +361,14 @@ static void switchToEmuThread()
             switchToEmuWait();
         }
     }
+    recordHandoff(to_main_stats);
 }
 
 static void switchToMainThread()
 {
     const bool was_using_spinlock = use_spinlock;
 
+    markHandoff();
     if (use_spinlock) {
         switchToMainSpin();
     } else {
@@ -111,6 +381,7 @@ static void switchToMainThread()
             switchToMainWait();
         }
     }
+    recordHandoff(to_emu_stats);
 }
 
 auto switchThread(const ThreadSwitchReason reason) -> ThreadSwitchReason
@@ -118,22 +389,40 @@ auto switchThread(const ThreadSwitchReason reason) -> ThreadSwitchReason
     static ThreadSwitchReason switch_reason = ThreadSwitchReason::None;
 
     switch_reason = reason;
+#ifdef HAVE_EMU_FIBER
+    if (use_fiber) {
+        if (in_emu_fiber) {
+            profiler::suspendEmulation();
+            switchToMainFiber();
+            profiler::resumeEmulation();
+        } else {
+            switchToEmuFiber();
+        }
+        return switch_reason;
+    }
+#endif
     if (std::this_thread::get_id() == main_thread_id) {
         switchToEmuThread();
     } else {
+        profiler::suspendEmulation();
         switchToMainThread();
+        profiler::resumeEmulation();
     }
     return switch_reason;
 }
 
-void useSpinlockThreadSync(const bool use_spinlock_)
+void useSpinlockThreadSync(const bool use_spinlock_, const bool adaptive)
 {
+    ::use_adaptive_spin = adaptive;
     if (use_spinlock_ == ::use_spinlock) {
         return;
     }
 
     ::use_spinlock = use_spinlock_;
 
+    if (use_fiber) {
+        return;
+    }
     if (std::this_thread::get_id() == main_thread_id) {
         if (use_spinlock_) {
             std::unique_lock emu_lock(emu_mutex);
@@ -141,7 +430,7 @@ void useSpinlockThreadSync(const bool use_spinlock_)
             emu_lock.unlock();
             emu_cv.notify_one();
         } else {
-            emu_flag.clear(std::memory_order_release);
+            releaseFlag(emu_flag);
         }
     } else {
         if (use_spinlock_) {
@@ -150,11 +439,70 @@ void useSpinlockThreadSync(const bool use_spinlock_)
             main_lock.unlock();
             main_cv.notify_one();
         } else {
-            main_flag.clear(std::memory_order_release);
+            releaseFlag(main_flag);
         }
     }
 }
 
+auto useFiberThreadSync(const bool use_fiber_) -> bool
+{
+#ifdef HAVE_EMU_FIBER
+    if (!emuThreadRunning()) {
+        ::use_fiber = use_fiber_;
+    }
+    return true;
+#else
+    return !use_fiber_;
+#endif
+}
+
+void startEmuThread(std::function<void()> func)
+{
+#ifdef HAVE_EMU_FIBER
+    if (use_fiber) {
+        retro::logDebug("Running emulation as a fiber on the frontend thread.");
+        startFiber(std::move(func));
+        return;
+    }
+#endif
+    emu_thread = std::thread(std::move(func));
+}
+
+auto emuThreadRunning() -> bool
+{
+#ifdef HAVE_EMU_FIBER
+    if (use_fiber) {
+        return fiber_started;
+    }
+#endif
+    return emu_thread.joinable();
+}
+
+void joinEmuThread()
+{
+#ifdef HAVE_EMU_FIBER
+    if (use_fiber) {
+        if (!fiber_finished) {
+            retro::logWarn("Emulation fiber has not finished, discarding it.");
+        }
+        fiber_started = false;
+        freeFiberStack();
+        fiber_func = nullptr;
+        return;
+    }
+#endif
+    if (!emu_thread.joinable()) {
+        return;
+    }
+    try {
+        emu_thread.join();
+    }
+    catch (...) {
+    }
+    logHandoffLatency(to_emu_stats);
+    logHandoffLatency(to_main_stats);
+}
+
 /*
 
 Copyright (C) 2019 Nikos Chantziaras.
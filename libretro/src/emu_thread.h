@@ -1,6 +1,7 @@
 // This is copyrighted software. More information is at the end of this file.
 #pragma once
 #include <fmt/format.h>
+#include <functional>
 #include <string_view>
 
 /* Thrown as an exception for canceling the emulation thread.
@@ -22,8 +23,32 @@ auto switchThread(ThreadSwitchReason reason = ThreadSwitchReason::None) -> Threa
 
 /* Change current thread synchronization mode. If true, use a spinlock. If false, use condition
  * variables. Can be called from either the main thread or the emulation thread.
+ *
+ * An adaptive spinlock only spins for a short time before it puts the thread to sleep. The spin time
+ * is tuned from the handoff latencies seen so far, which are also logged as a histogram every minute
+ * and when the emulation ends.
  */
-void useSpinlockThreadSync(bool use_spinlock);
+void useSpinlockThreadSync(bool use_spinlock, bool adaptive = false);
+
+/* Run the emulation as a fiber (a stackful coroutine) on the frontend's thread instead of in its
+ * own thread. Switching then is a plain context switch that never involves the OS scheduler. Only
+ * has an effect before the emulation is started. Returns false if fibers are not supported on this
+ * platform, in which case the emulation thread is used.
+ */
+auto useFiberThreadSync(bool use_fiber) -> bool;
+
+/* Start running the emulation. Depending on the synchronization mode, this creates the emulation
+ * thread or a fiber. A fiber does not run until the first call to switchThread().
+ */
+void startEmuThread(std::function<void()> func);
+
+/* Returns true if the emulation has been started and not yet joined.
+ */
+auto emuThreadRunning() -> bool;
+
+/* Wait for the emulation to finish and release its thread or fiber.
+ */
+void joinEmuThread();
 
 /* Make ThreadSwitchReason formattable.
  */
@@ -84,6 +84,12 @@ inline auto SDL_CondSignal(SDL_cond* const cond) noexcept -> int
     return 0;
 }
 
+inline auto SDL_CondBroadcast(SDL_cond* const cond) noexcept -> int
+{
+    cond->notify_all();
+    return 0;
+}
+
 /*
 
 Copyright (C) 2020 Nikos Chantziaras <realnc@gmail.com>
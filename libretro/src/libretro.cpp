@@ -1,7 +1,9 @@
 // This is copyrighted software. More information is at the end of this file.
 #include "libretro.h"
 #include "CoreOptions.h"
+#include "bios_disk.h"
 #include "control.h"
+#include "cpu.h"
 #include "deps/char8_t-remediation/char8_t-remediation.h"
 #include "disk_control.h"
 #include "dos/drives.h"
@@ -16,12 +18,14 @@
 #include "libretro_gfx.h"
 #include "libretro_input.h"
 #include "libretro_message.h"
+#include "libretro_profiler.h"
 #include "log.h"
 #include "mixer.h"
 #include "pic.h"
 #include "programs.h"
 #include "render.h"
 #include "setup.h"
+#include "snapshot.h"
 #include "util.h"
 #ifdef ANDROID
     #include "nonlibc.h"
@@ -41,7 +45,7 @@
 #include <memory>
 #include <set>
 #include <string>
-#include <thread>
+#include <vector>
 #ifdef _WIN32
     #include <direct.h>
 #else
@@ -131,9 +135,6 @@ void retro_set_input_state(retro_input_state_t cb)
 // Pending overlay mount.
 static bool mount_overlay = true;
 
-// Thread we run dosbox in.
-static std::thread emu_thread;
-
 /* helper functions */
 
 auto retro_ticks() -> long
@@ -431,8 +432,8 @@ static RETRO_CALLCONV auto update_core_option_visibility() -> bool
 
     updated |= core_options.setVisible(
         {CORE_OPT_DEFAULT_MOUNT_FREESIZE, CORE_OPT_THREAD_SYNC, CORE_OPT_CPU_TYPE, CORE_OPT_SCALER,
-         CORE_OPT_MPU_TYPE, CORE_OPT_TANDY, CORE_OPT_DISNEY, CORE_OPT_LOG_METHOD,
-         CORE_OPT_LOG_LEVEL},
+         CORE_OPT_MPU_TYPE, CORE_OPT_TANDY, CORE_OPT_DISNEY, CORE_OPT_RESAMPLER,
+         CORE_OPT_SMOOTHDRIFT, CORE_OPT_LOG_METHOD, CORE_OPT_LOG_LEVEL},
         show_all);
 
 #ifdef WITH_PINHACK
@@ -695,6 +696,24 @@ static void update_log_verbosity()
     }
 }
 
+static void update_profiling()
+{
+    const auto& mode = retro::core_options[CORE_OPT_PROFILING].toString();
+    if (mode == "disabled") {
+        profiler::stop();
+        return;
+    }
+    if (mode == "json") {
+        profiler::start(
+            retro_save_directory / retro_library_name / "profile.json", profiler::Format::Json,
+            perf_cb);
+    } else {
+        profiler::start(
+            retro_save_directory / retro_library_name / "profile.csv", profiler::Format::Csv,
+            perf_cb);
+    }
+}
+
 static void check_variables()
 {
     using namespace retro;
@@ -715,8 +734,11 @@ static void check_variables()
     }
 
     use_frame_duping = core_options[CORE_OPT_FRAME_DUPING].toBool();
-    use_spinlock = core_options[CORE_OPT_THREAD_SYNC].toString() == "spin";
-    useSpinlockThreadSync(use_spinlock);
+    {
+        const auto& thread_sync = core_options[CORE_OPT_THREAD_SYNC].toString();
+        use_spinlock = thread_sync == "spin" || thread_sync == "adaptive";
+        useSpinlockThreadSync(use_spinlock, thread_sync == "adaptive");
+    }
 
     if (!dosbox_initialiazed) {
         update_dosbox_variable(
@@ -769,7 +791,34 @@ static void check_variables()
             false, "pci", "voodoomem", core_options[CORE_OPT_VOODOO_MEMORY_SIZE].toString());
 #endif
 
+        // The mixer reads these only when it starts.
+        update_dosbox_variable(
+            false, "mixer", "resampler", core_options[CORE_OPT_RESAMPLER].toString());
+        update_dosbox_variable(
+            false, "mixer", "smoothdrift", core_options[CORE_OPT_SMOOTHDRIFT].toString());
+
         mount_overlay = core_options[CORE_OPT_SAVE_OVERLAY].toBool();
+
+        // Image deltas go next to the overlay directory, not inside it where DOS would see them.
+        if (core_options[CORE_OPT_SAVE_IMAGE_DELTA].toBool()) {
+            const auto delta_directory = retro_save_directory / retro_library_name
+                / (game_path.parent_path().filename().string() + ".deltas");
+            DISK_SetDeltaDirectory(from_u8string(delta_directory.u8string()).c_str());
+        } else {
+            DISK_SetDeltaDirectory("");
+        }
+
+#if defined(C_DYNREC) || defined(C_DYNAMIC_X86)
+        if (core_options[CORE_OPT_CPU_HOT_BLOCKS].toBool()) {
+            const auto hot_block_file = retro_save_directory / retro_library_name
+                / (game_path.parent_path().filename().string() + ".hotblocks");
+            std::error_code err;
+            std::filesystem::create_directories(hot_block_file.parent_path(), err);
+            CPU_SetHotBlockFile(from_u8string(hot_block_file.u8string()).c_str());
+        } else {
+            CPU_SetHotBlockFile("");
+        }
+#endif
     } else {
         update_dosbox_variable(false, "dos", "xms", core_options[CORE_OPT_XMS].toString());
         update_dosbox_variable(false, "dos", "ems", core_options[CORE_OPT_EMS].toString());
@@ -808,6 +857,10 @@ static void check_variables()
         }
 
         update_dosbox_variable(false, "cpu", "cputype", core_options[CORE_OPT_CPU_TYPE].toString());
+#if defined(C_DYNREC) || defined(C_DYNAMIC_X86)
+        update_dosbox_variable(
+            false, "cpu", "dynamic_cache", core_options[CORE_OPT_CPU_CACHE_SIZE].toString());
+#endif
         update_dosbox_variable(false, "cpu", "core", core_options[CORE_OPT_CPU_CORE].toString());
         update_dosbox_variable(
             false, "render", "aspect", core_options[CORE_OPT_ASPECT_CORRECTION].toString());
@@ -1141,16 +1194,13 @@ void retro_init()
 
 void retro_deinit()
 {
+    profiler::stop();
     frontend_exit = true;
-    if (emu_thread.joinable()) {
+    if (emuThreadRunning()) {
         if (!dosbox_exit) {
             switchThread();
         }
-        try {
-            emu_thread.join();
-        }
-        catch (...) {
-        }
+        joinEmuThread();
     }
 
     libretro_graph_free();
@@ -1195,7 +1245,13 @@ auto retro_load_game(const retro_game_info* const game) -> bool
         load_game_directory = game_path.parent_path();
     }
 
-    emu_thread = std::thread(start_dosbox, from_u8string(load_path.u8string()));
+    const bool use_fiber = retro::core_options[CORE_OPT_THREAD_SYNC].toString() == "fiber";
+    if (!useFiberThreadSync(use_fiber)) {
+        retro::logWarn("Fibers are not supported on this platform, using a thread instead.");
+    }
+    // Started before the emulation so that what runs until the first frame is counted into it.
+    update_profiling();
+    startEmuThread([cmd_line = from_u8string(load_path.u8string())] { start_dosbox(cmd_line); });
     // Run dosbox until it sets its initial video mode.
     while (switchThread() != ThreadSwitchReason::VideoModeChange && !dosbox_exit)
         ;
@@ -1206,6 +1262,11 @@ auto retro_load_game(const retro_game_info* const game) -> bool
     }
 
     update_core_option_visibility();
+
+    // Save states contain raw host data and are tied to the build that created them.
+    uint64_t quirks =
+        RETRO_SERIALIZATION_QUIRK_ENDIAN_DEPENDENT | RETRO_SERIALIZATION_QUIRK_PLATFORM_DEPENDENT;
+    environ_cb(RETRO_ENVIRONMENT_SET_SERIALIZATION_QUIRKS, &quirks);
     return true;
 }
 
@@ -1216,16 +1277,12 @@ auto retro_load_game_special(
     return false;
 }
 
-void retro_run()
+static void run_frame()
 {
     if (dosbox_exit) {
-        if (emu_thread.joinable()) {
+        if (emuThreadRunning()) {
             switchThread();
-            try {
-                emu_thread.join();
-            }
-            catch (...) {
-            }
+            joinEmuThread();
         }
         environ_cb(RETRO_ENVIRONMENT_SHUTDOWN, nullptr);
         return;
@@ -1248,6 +1305,7 @@ void retro_run()
         }
         update_core_option_visibility();
         libretro_input_init();
+        update_profiling();
     }
 
     /* Once C is mounted, mount the overlay */
@@ -1263,9 +1321,12 @@ void retro_run()
     /* Run emulator */
     auto current_gfx_fps = render.src.fps;
     fakeTimingReset();
-    while (switchThread() == ThreadSwitchReason::VideoModeChange) {
-        update_gfx_mode(run_synced && render.src.fps != current_gfx_fps);
-        current_gfx_fps = render.src.fps;
+    {
+        profiler::Scope profile_scope(profiler::Section::Emulation);
+        while (switchThread() == ThreadSwitchReason::VideoModeChange) {
+            update_gfx_mode(run_synced && render.src.fps != current_gfx_fps);
+            current_gfx_fps = render.src.fps;
+        }
     }
 
     /* Virtual keyboard */
@@ -1289,6 +1350,15 @@ void retro_run()
     }
 }
 
+void retro_run()
+{
+    {
+        profiler::Scope profile_scope(profiler::Section::Frame);
+        run_frame();
+    }
+    profiler::frameDone();
+}
+
 void retro_reset()
 {
     restart_program(control->startup_params);
@@ -1310,22 +1380,75 @@ auto retro_get_memory_size(const unsigned type) -> size_t
     return 0;
 }
 
-/* Stubs */
+/* Save states. The emulation thread is always parked at a frame boundary between calls to
+ * retro_run(), so the machine state can be accessed directly from here. */
+static auto can_serialize() -> bool
+{
+    return emuThreadRunning() && !dosbox_exit;
+}
+
 auto retro_serialize_size() -> size_t
 {
-    return 0;
+    // Frontends allocate once and expect the size to stay stable. The snapshot size only varies
+    // with the amount of queued audio and pending events, so report the largest size seen so
+    // far plus some room to grow. The size is counted without copying any of the state.
+    static size_t max_size = 0;
+    static constexpr size_t slack = 256 * 1024;
+
+    if (!can_serialize()) {
+        return max_size;
+    }
+    max_size = std::max(max_size, SNAPSHOT_Size() + slack);
+    return max_size;
 }
 
-auto retro_serialize(void* const /*data*/, const size_t /*size*/) -> bool
+/* The frontend asks for fast save states when it keeps them in memory and loads them back into
+ * this same instance, as it does for rewind and run-ahead. */
+static auto fast_savestates_requested() -> bool
 {
-    return false;
+    int flags = 0;
+    return environ_cb(RETRO_ENVIRONMENT_GET_AUDIO_VIDEO_ENABLE, &flags) && (flags & 4);
 }
 
-auto retro_unserialize(const void* const /*data*/, const size_t /*size*/) -> bool
+auto retro_serialize(void* const data, const size_t size) -> bool
 {
-    return false;
+    if (!can_serialize()) {
+        return false;
+    }
+    // Fast states only store the guest memory that changed since the snapshot base, which is a
+    // small part of it for most games. Copying all of it every frame would cost several ms.
+    const bool fast = fast_savestates_requested();
+    std::vector<Bit8u> buffer;
+    if (!SNAPSHOT_Save(buffer, fast ? SNAPSHOT_DELTA : SNAPSHOT_FULL)) {
+        return false;
+    }
+    if (buffer.size() > size) {
+        retro::logError("Save state needs {} bytes, but only {} are available.", buffer.size(), size);
+        return false;
+    }
+    std::copy(buffer.begin(), buffer.end(), static_cast<Bit8u*>(data));
+    // Fast states are never written out, clearing the rest of the buffer would cost as much as
+    // the full state they avoid.
+    if (!fast) {
+        std::fill(static_cast<Bit8u*>(data) + buffer.size(), static_cast<Bit8u*>(data) + size, 0);
+    }
+    return true;
+}
+
+auto retro_unserialize(const void* const data, const size_t size) -> bool
+{
+    if (!can_serialize()) {
+        return false;
+    }
+    if (!SNAPSHOT_Load(static_cast<const Bit8u*>(data), size)) {
+        retro::logError("Failed to load save state.");
+        return false;
+    }
+    return true;
 }
 
+/* Stubs */
+
 void retro_cheat_reset()
 { }
 
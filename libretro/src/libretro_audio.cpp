@@ -2,6 +2,7 @@
 #include "libretro_audio.h"
 #include "SDL_stdinc.h"
 #include "libretro.h"
+#include "libretro_profiler.h"
 #include "log.h"
 #include "mixer.h"
 #include <vector>
@@ -20,6 +21,7 @@ void init_audio()
 
 auto queue_audio() -> Bitu
 {
+    profiler::Scope profile_scope(profiler::Section::Audio);
     const auto available_audio_frames = MIXER_RETRO_GetAvailableFrames();
 
     if (available_audio_frames > 0) {
@@ -545,10 +545,17 @@ CoreOptions core_options {
                 "(or it might make it worse.) However, \"spin\" will also result in 100% usage on "
                 "one of your CPU cores. This is \"idle load\" and doesn't increase CPU "
                 "temperatures by much, but it will prevent the CPU from clocking down which on "
-                "laptops will affect battery life. ",
+                "laptops will affect battery life. \"Adaptive\" spins only briefly before "
+                "sleeping, tuning the spin time to how quickly the other side usually answers. "
+                "\"Fiber\" runs the emulation on the frontend's own thread, switching to it and "
+                "back without involving the OS scheduler at all. This gives the most consistent "
+                "frame times, but is not available on every platform. Switching to or from "
+                "\"fiber\" requires a restart.",
             {
                 "wait",
                 "spin",
+                "adaptive",
+                "fiber",
             },
             "wait"
         },
@@ -601,6 +608,17 @@ CoreOptions core_options {
             },
             false
         },
+        CoreOptionDefinition {
+            CORE_OPT_SAVE_IMAGE_DELTA,
+            "Keep disk image changes in save directory (restart)",
+            "Write changes to mounted disk images into delta files in the save directory instead "
+                "of the images themselves. Delete the delta files to get the original images back.",
+            {
+                true,
+                false,
+            },
+            false
+        },
     },
     CoreOptionCategory {
         CORE_OPTCAT_VIDEO_EMULATION,
@@ -762,7 +780,8 @@ CoreOptions core_options {
         #if defined(C_DYNREC) || defined(C_DYNAMIC_X86)
                 "When set to \"auto\", the \"normal\" interpreter core will be used for real mode "
                 "games, while the faster \"dynamic\" recompiler core will be used for protected "
-                "mode games. The \"simple\" interpreter core is optimized for old real mode games.",
+                "mode games. The \"simple\" interpreter core is optimized for old real mode games. "
+                "The \"cached\" interpreter core keeps the decoded instructions of the code it runs.",
             {
                 "auto",
                 {
@@ -780,18 +799,54 @@ CoreOptions core_options {
                 },
                 "normal",
                 "simple",
+                "cached",
             },
             "auto"
         #else
-            "\"Simple\" is optimized for old real-mode games. (There are no dynamic recompiler "
-                "cores available on this platform.)",
+            "When set to \"auto\", the \"normal\" interpreter core will be used for real mode "
+                "games, while the \"cached\" interpreter core, which keeps the decoded "
+                "instructions of the code it runs, will be used for protected mode games. "
+                "\"Simple\" is optimized for old real-mode games. (There are no dynamic "
+                "recompiler cores available on this platform.)",
             {
+                "auto",
                 "normal",
                 "simple",
+                "cached",
             },
-            "normal"
+            "auto"
         #endif
         },
+    #if defined(C_DYNREC) || defined(C_DYNAMIC_X86)
+        CoreOptionDefinition {
+            CORE_OPT_CPU_HOT_BLOCKS,
+            "Remember translated code (restart)",
+            "Keep a list of the code the dynamic core translated in the save directory and "
+                "translate it ahead of time the next time the game runs. Shortens the stutter "
+                "while the dynamic core warms up.",
+            {
+                true,
+                false,
+            },
+            false
+        },
+        CoreOptionDefinition {
+            CORE_OPT_CPU_CACHE_SIZE,
+            "Dynamic core code cache (restart)",
+            "How big the cache of translated code may grow. Games with a lot of code, like "
+                "Windows 3.x applications and big DOS/4GW titles, run smoother with a bigger "
+                "cache. Memory is only used as the cache grows.",
+            {
+                { 8, "8MB" },
+                { 16, "16MB" },
+                { 32, "32MB" },
+                { 64, "64MB" },
+                { 128, "128MB" },
+                { 256, "256MB" },
+            },
+            8
+        },
+    #endif
         CoreOptionDefinition {
             CORE_OPT_CPU_TYPE,
             "CPU type",
@@ -1613,6 +1668,29 @@ CoreOptions core_options {
             },
             false
         },
+        CoreOptionDefinition {
+            CORE_OPT_RESAMPLER,
+            "Resampler (restart)",
+            "How devices that don't run at the mixer rate are resampled. The windowed sinc filter "
+                "sounds cleaner but needs slightly more CPU time. Single channels can be set with "
+                "the \"channelresampler\" setting in a DOSBox config file.",
+            {
+                { "linear", "linear interpolation" },
+                { "sinc", "windowed sinc" },
+            },
+            "linear"
+        },
+        CoreOptionDefinition {
+            CORE_OPT_SMOOTHDRIFT,
+            "Smooth drift compensation (restart)",
+            "Interpolate between frames when the audio output gets stretched to follow the audio "
+                "device, instead of dropping or repeating frames.",
+            {
+                true,
+                false,
+            },
+            false
+        },
     },
     CoreOptionCategory {
         CORE_OPTCAT_MIDI,
@@ -2610,6 +2688,24 @@ CoreOptions core_options {
             },
             "warnings",
         },
+        CoreOptionDefinition {
+            CORE_OPT_PROFILING,
+            "Frame profiling",
+            "Measures where the time of each frame goes (emulation, PIC events, video drawing, "
+                "audio mixing and MIDI synthesis) and writes every 3600 frames to a new file, "
+                "\"DOSBox-core/profile.0.csv\", \"profile.1.csv\" and so on (or \"profile.0.json\", "
+                "...) in the frontend's save directory. The frames since the last file are written "
+                "when the core exits. Files of an earlier run are removed. The JSON output "
+                "also contains a histogram of the per-frame times. If the frontend provides "
+                "performance counters, they are updated as well. Profiling adds a small overhead, "
+                "so leave this disabled unless you need it.",
+            {
+                "disabled",
+                { "csv", "CSV" },
+                { "json", "JSON" },
+            },
+            "disabled",
+        },
     },
 };
 
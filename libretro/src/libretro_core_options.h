@@ -28,6 +28,7 @@ inline constexpr const char* CORE_OPTCAT_FILE_AND_DISK = "file_and_disk";
 inline constexpr const char* CORE_OPT_MOUNT_C_AS = "mount_c_as";
 inline constexpr const char* CORE_OPT_DEFAULT_MOUNT_FREESIZE = "default_mount_freesize";
 inline constexpr const char* CORE_OPT_SAVE_OVERLAY = "save_overlay";
+inline constexpr const char* CORE_OPT_SAVE_IMAGE_DELTA = "save_image_delta";
 
 inline constexpr const char* CORE_OPTCAT_VIDEO_EMULATION = "video_emulation";
 inline constexpr const char* CORE_OPT_MACHINE_TYPE = "machine";
@@ -44,6 +45,8 @@ inline constexpr const char* CORE_OPT_EMS = "ems";
 inline constexpr const char* CORE_OPT_UMB = "umb";
 inline constexpr const char* CORE_OPT_CPU_CORE = "core";
 inline constexpr const char* CORE_OPT_CPU_TYPE = "cputype";
+inline constexpr const char* CORE_OPT_CPU_HOT_BLOCKS = "cpu_hot_blocks";
+inline constexpr const char* CORE_OPT_CPU_CACHE_SIZE = "cpu_cache_size";
 inline constexpr const char* CORE_OPT_CPU_CYCLES_MODE = "cpu_cycles_mode";
 inline constexpr const char* CORE_OPT_CPU_CYCLES_MULTIPLIER_REALMODE =
     "cpu_cycles_multiplier_realmode";
@@ -146,6 +149,8 @@ inline constexpr const char* CORE_OPT_GUSDMA = "gusdma";
 inline constexpr const char* CORE_OPT_PCSPEAKER = "pcspeaker";
 inline constexpr const char* CORE_OPT_TANDY = "tandy";
 inline constexpr const char* CORE_OPT_DISNEY = "disney";
+inline constexpr const char* CORE_OPT_RESAMPLER = "resampler";
+inline constexpr const char* CORE_OPT_SMOOTHDRIFT = "smoothdrift";
 
 inline constexpr const char* CORE_OPTCAT_MIDI = "midi";
 inline constexpr const char* CORE_OPT_MPU_TYPE = "mpu401";
@@ -197,6 +202,7 @@ inline constexpr const char* CORE_OPT_PINHACKEXPANDHEIGHT_FINE = "pinhackexpandh
 inline constexpr const char* CORE_OPTCAT_LOGGING = "logging";
 inline constexpr const char* CORE_OPT_LOG_METHOD = "log_method";
 inline constexpr const char* CORE_OPT_LOG_LEVEL = "log_level";
+inline constexpr const char* CORE_OPT_PROFILING = "profiling";
 
 /*
 
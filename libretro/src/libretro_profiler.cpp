@@ -0,0 +1,410 @@
+// This is copyrighted software. More information is at the end of this file.
+#include "libretro_profiler.h"
+
+#include "log.h"
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace profiler {
+
+using std::chrono::steady_clock;
+
+static constexpr auto section_count = static_cast<size_t>(Section::Count);
+
+static constexpr std::array<const char*, section_count> section_names{
+    "frame", "emulation", "events", "video", "render_line", "mixer", "audio", "midi",
+};
+
+static constexpr std::array<const char*, section_count> perf_idents{
+    "dosbox_core_frame",  "dosbox_core_emulation",   "dosbox_core_events",
+    "dosbox_core_video",  "dosbox_core_render_line", "dosbox_core_mixer",
+    "dosbox_core_audio",  "dosbox_core_midi",
+};
+
+static constexpr auto counter_count = static_cast<size_t>(Counter::Count);
+
+static constexpr std::array<const char*, counter_count> counter_names{
+    "events_dispatched",
+    "event_queue_max",
+    "cpu_slices",
+    "emulated_ms",
+    "path_cache_misses",
+};
+
+// About a minute worth of frames.
+static constexpr size_t ring_size = 3600;
+
+// Power of two buckets of per-frame microseconds, the last one takes everything above.
+static constexpr size_t histogram_buckets = 21;
+
+struct FrameRecord final
+{
+    uint64_t number = 0;
+    float wall_us = 0;
+    std::array<float, section_count> us{};
+    std::array<uint32_t, section_count> calls{};
+    std::array<uint32_t, counter_count> counters{};
+};
+
+// Scopes that are currently open. The emulation keeps its own stack, since it gets suspended with
+// scopes still open when it hands control back to the frontend.
+struct ScopeStack final
+{
+    struct Entry
+    {
+        Section section;
+        steady_clock::time_point start;
+    };
+    std::array<Entry, 16> entries;
+    size_t depth = 0;
+};
+
+bool internal::enabled = false;
+std::array<uint32_t, counter_count> internal::counters{};
+
+static ScopeStack frontend_scopes;
+static ScopeStack emulation_scopes;
+static ScopeStack* current_scopes = &frontend_scopes;
+
+static std::array<steady_clock::duration, section_count> frame_time{};
+static std::array<uint32_t, section_count> frame_calls{};
+static std::vector<FrameRecord> ring;
+static unsigned dump_count = 0;
+static uint64_t frame_number = 0;
+static steady_clock::time_point last_frame_end{};
+
+static std::filesystem::path out_file;
+static Format out_format = Format::Csv;
+static retro_perf_callback perf_cb{};
+
+// Formatting and writing a full ring takes long enough to show up as a frame spike, so it's done on
+// a writer thread. Every full ring goes to a file of its own, so nothing gets overwritten.
+struct DumpJob final
+{
+    std::vector<FrameRecord> frames;
+    std::filesystem::path file;
+    Format format = Format::Csv;
+};
+static std::thread writer_thread;
+static std::mutex writer_mutex;
+static std::condition_variable writer_cv;
+static std::deque<DumpJob> pending_jobs;
+static bool writer_quit = false;
+static std::array<retro_perf_counter, section_count> perf_counters{};
+
+static auto index(const Section section) noexcept -> size_t
+{
+    return static_cast<size_t>(section);
+}
+
+static auto toMicroseconds(const steady_clock::duration d) noexcept -> float
+{
+    return std::chrono::duration<float, std::micro>(d).count();
+}
+
+auto internal::begin(const Section section) noexcept -> bool
+{
+    auto& stack = *current_scopes;
+    if (stack.depth == stack.entries.size()) {
+        return false;
+    }
+    stack.entries[stack.depth++] = {section, steady_clock::now()};
+    if (perf_counters[index(section)].registered) {
+        perf_cb.perf_start(&perf_counters[index(section)]);
+    }
+    return true;
+}
+
+void internal::end(const Section section) noexcept
+{
+    auto& stack = *current_scopes;
+    if (stack.depth == 0 || stack.entries[stack.depth - 1].section != section) {
+        return;
+    }
+    const auto& entry = stack.entries[--stack.depth];
+    if (!enabled) {
+        return;
+    }
+    frame_time[index(section)] += steady_clock::now() - entry.start;
+    ++frame_calls[index(section)];
+    if (perf_counters[index(section)].registered) {
+        perf_cb.perf_stop(&perf_counters[index(section)]);
+    }
+}
+
+void suspendEmulation() noexcept
+{
+    const auto now = steady_clock::now();
+    for (size_t i = 0; i < emulation_scopes.depth; ++i) {
+        frame_time[index(emulation_scopes.entries[i].section)] +=
+            now - emulation_scopes.entries[i].start;
+    }
+    current_scopes = &frontend_scopes;
+}
+
+void resumeEmulation() noexcept
+{
+    const auto now = steady_clock::now();
+    for (size_t i = 0; i < emulation_scopes.depth; ++i) {
+        emulation_scopes.entries[i].start = now;
+    }
+    current_scopes = &emulation_scopes;
+}
+
+static void writeCsv(std::ofstream& out, const std::vector<FrameRecord>& frames)
+{
+    out << "frame,wall_us";
+    for (const auto* name : section_names) {
+        out << ',' << name << "_us," << name << "_calls";
+    }
+    for (const auto* name : counter_names) {
+        out << ',' << name;
+    }
+    out << '\n';
+    for (const auto& frame : frames) {
+        out << fmt::format("{},{:.1f}", frame.number, frame.wall_us);
+        for (size_t i = 0; i < section_count; ++i) {
+            out << fmt::format(",{:.1f},{}", frame.us[i], frame.calls[i]);
+        }
+        for (const auto value : frame.counters) {
+            out << ',' << value;
+        }
+        out << '\n';
+    }
+}
+
+static void writeJson(std::ofstream& out, const std::vector<FrameRecord>& frames)
+{
+    out << "{\n  \"sections\": [";
+    for (size_t i = 0; i < section_count; ++i) {
+        out << (i ? ", " : "") << '"' << section_names[i] << '"';
+    }
+    out << "],\n  \"counters\": [";
+    for (size_t i = 0; i < counter_count; ++i) {
+        out << (i ? ", " : "") << '"' << counter_names[i] << '"';
+    }
+    out << "],\n  \"histogram_bucket_us\": [0";
+    for (size_t i = 1; i < histogram_buckets; ++i) {
+        out << ", " << (1U << (i - 1));
+    }
+    out << "],\n  \"histograms\": {";
+    for (size_t s = 0; s < section_count; ++s) {
+        std::array<uint32_t, histogram_buckets> histogram{};
+        for (const auto& frame : frames) {
+            size_t bucket = 0;
+            for (auto us = static_cast<uint32_t>(frame.us[s]);
+                 us > 0 && bucket < histogram_buckets - 1; us >>= 1) {
+                ++bucket;
+            }
+            ++histogram[bucket];
+        }
+        out << (s ? "," : "") << "\n    \"" << section_names[s] << "\": [";
+        for (size_t i = 0; i < histogram_buckets; ++i) {
+            out << (i ? ", " : "") << histogram[i];
+        }
+        out << ']';
+    }
+    out << "\n  },\n  \"frames\": [";
+    bool first = true;
+    for (const auto& frame : frames) {
+        out << (first ? "" : ",")
+            << fmt::format(
+                   "\n    {{\"frame\": {}, \"wall_us\": {:.1f}, \"us\": [", frame.number,
+                   frame.wall_us);
+        for (size_t i = 0; i < section_count; ++i) {
+            out << fmt::format("{}{:.1f}", i ? ", " : "", frame.us[i]);
+        }
+        out << "], \"calls\": [";
+        for (size_t i = 0; i < section_count; ++i) {
+            out << (i ? ", " : "") << frame.calls[i];
+        }
+        out << "], \"counters\": [";
+        for (size_t i = 0; i < counter_count; ++i) {
+            out << (i ? ", " : "") << frame.counters[i];
+        }
+        out << "]}";
+        first = false;
+    }
+    out << "\n  ]\n}\n";
+}
+
+static void writeJob(const DumpJob& job)
+{
+    std::error_code err;
+    std::filesystem::create_directories(job.file.parent_path(), err);
+    std::ofstream out(job.file, std::ios::trunc);
+    if (!out) {
+        retro::logError("Failed to write frame profile to {}.", job.file);
+        return;
+    }
+    if (job.format == Format::Json) {
+        writeJson(out, job.frames);
+    } else {
+        writeCsv(out, job.frames);
+    }
+    retro::logDebug("Wrote profile of {} frames to {}.", job.frames.size(), job.file);
+}
+
+static void writerLoop()
+{
+    DumpJob job;
+    while (true) {
+        {
+            std::unique_lock lock(writer_mutex);
+            writer_cv.wait(lock, [] { return !pending_jobs.empty() || writer_quit; });
+            if (pending_jobs.empty()) {
+                return;
+            }
+            job = std::move(pending_jobs.front());
+            pending_jobs.pop_front();
+        }
+        writeJob(job);
+    }
+}
+
+/* Name of the n-th file of a profiling run: "profile.csv" becomes "profile.0.csv", "profile.1.csv"
+ * and so on.
+ */
+static auto numberedFile(const std::filesystem::path& file, const unsigned n)
+    -> std::filesystem::path
+{
+    auto name = file;
+    name.replace_filename(
+        fmt::format("{}.{}{}", file.stem().string(), n, file.extension().string()));
+    return name;
+}
+
+/* Hand the frames collected since the last dump to the writer thread, then start a new ring.
+ */
+static void dump()
+{
+    if (ring.empty() || out_file.empty()) {
+        return;
+    }
+
+    {
+        std::lock_guard lock(writer_mutex);
+        pending_jobs.push_back({std::move(ring), numberedFile(out_file, dump_count++), out_format});
+    }
+    writer_cv.notify_one();
+    ring = {};
+    ring.reserve(ring_size);
+}
+
+void start(std::filesystem::path file, const Format format, const retro_perf_callback& perf)
+{
+    out_file = std::move(file);
+    out_format = format;
+    if (internal::enabled) {
+        return;
+    }
+
+    perf_cb = perf;
+    for (size_t i = 0; i < section_count; ++i) {
+        perf_counters[i] = {};
+        perf_counters[i].ident = perf_idents[i];
+        if (perf_cb.perf_register && perf_cb.perf_start && perf_cb.perf_stop) {
+            perf_cb.perf_register(&perf_counters[i]);
+        }
+    }
+    frame_time.fill({});
+    frame_calls.fill(0);
+    internal::counters.fill(0);
+    ring.clear();
+    ring.reserve(ring_size);
+    // Files left over from an earlier run would look like they belong to this one.
+    dump_count = 0;
+    for (std::error_code err; std::filesystem::remove(numberedFile(out_file, dump_count), err);
+         ++dump_count)
+    { }
+    dump_count = 0;
+    last_frame_end = steady_clock::now();
+    writer_quit = false;
+    writer_thread = std::thread(writerLoop);
+    internal::enabled = true;
+    retro::logDebug("Frame profiling enabled, writing to {}.", out_file);
+}
+
+void stop()
+{
+    if (!internal::enabled) {
+        return;
+    }
+    internal::enabled = false;
+    dump();
+    // Let the writer finish the last dump.
+    {
+        std::lock_guard lock(writer_mutex);
+        writer_quit = true;
+    }
+    writer_cv.notify_one();
+    writer_thread.join();
+    if (perf_cb.perf_log) {
+        perf_cb.perf_log();
+    }
+    for (auto& counter : perf_counters) {
+        counter.registered = false;
+    }
+    ring.clear();
+    ring.shrink_to_fit();
+}
+
+auto isEnabled() noexcept -> bool
+{
+    return internal::enabled;
+}
+
+void frameDone()
+{
+    if (!internal::enabled) {
+        return;
+    }
+
+    const auto now = steady_clock::now();
+    FrameRecord record;
+    record.number = frame_number++;
+    record.wall_us = toMicroseconds(now - last_frame_end);
+    for (size_t i = 0; i < section_count; ++i) {
+        record.us[i] = toMicroseconds(frame_time[i]);
+        record.calls[i] = frame_calls[i];
+    }
+    record.counters = internal::counters;
+    last_frame_end = now;
+    frame_time.fill({});
+    frame_calls.fill(0);
+    internal::counters.fill(0);
+
+    ring.push_back(record);
+    if (ring.size() == ring_size) {
+        dump();
+    }
+}
+
+} // namespace profiler
+
+/*
+
+Copyright (C) 2022 Nikos Chantziaras <realnc@gmail.com>
+
+This file is part of DOSBox-core.
+
+DOSBox-core is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation, either version 2 of the License, or (at your option) any later
+version.
+
+DOSBox-core is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+DOSBox-core. If not, see <https://www.gnu.org/licenses/>.
+
+*/
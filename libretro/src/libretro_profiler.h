@@ -0,0 +1,156 @@
+// This is copyrighted software. More information is at the end of this file.
+#pragma once
+#include "libretro.h"
+#include <array>
+#include <cstdint>
+#include <filesystem>
+
+/*
+ * Per-frame profiling.
+ *
+ * Code that is worth watching is wrapped in a profiler::Scope. While profiling is enabled, the time
+ * spent in each section is summed up per frame and the frames are collected in a buffer. The
+ * buffer is written out as CSV or JSON (including a histogram of the per-frame times of each
+ * section) every time it fills up and when profiling is stopped, each time to a new numbered file.
+ * The files are written on a background thread.
+ *
+ * Sections can nest and the time of a section includes everything that ran inside it. For example
+ * VGA drawing happens from within PIC event dispatch, and RENDER line handlers from within VGA
+ * drawing.
+ *
+ * Scopes may run on either the frontend or the emulation thread, but never at the same time. The
+ * thread handoff in switchThread() is what keeps the counters consistent.
+ *
+ * Counters record how often something happened, or the largest value something reached, in each
+ * frame. They are written out next to the section times.
+ */
+
+namespace profiler {
+
+enum class Section
+{
+    Frame,
+    Emulation,
+    Events,
+    Video,
+    RenderLine,
+    Mixer,
+    Audio,
+    Midi,
+    Count,
+};
+
+enum class Counter
+{
+    EventsDispatched,
+    EventQueueMax,
+    CpuSlices,
+    EmulatedMs,
+    PathCacheMisses,
+    Count,
+};
+
+enum class Format
+{
+    Csv,
+    Json,
+};
+
+namespace internal {
+
+extern bool enabled;
+
+auto begin(Section section) noexcept -> bool;
+void end(Section section) noexcept;
+
+extern std::array<uint32_t, static_cast<size_t>(Counter::Count)> counters;
+
+} // namespace internal
+
+/* Add to a counter of the current frame.
+ */
+inline void count(const Counter counter, const uint32_t amount = 1) noexcept
+{
+    if (internal::enabled) {
+        internal::counters[static_cast<size_t>(counter)] += amount;
+    }
+}
+
+/* Raise a counter of the current frame to `value` if it is lower.
+ */
+inline void countMax(const Counter counter, const uint32_t value) noexcept
+{
+    if (internal::enabled && internal::counters[static_cast<size_t>(counter)] < value) {
+        internal::counters[static_cast<size_t>(counter)] = value;
+    }
+}
+
+/* Adds the time until the end of the current scope to a section.
+ */
+class Scope final
+{
+public:
+    explicit Scope(const Section section) noexcept
+        : section_(section)
+        , active_(internal::enabled && internal::begin(section))
+    { }
+
+    ~Scope()
+    {
+        if (active_) {
+            internal::end(section_);
+        }
+    }
+
+    Scope(const Scope&) = delete;
+    auto operator=(const Scope&) -> Scope& = delete;
+
+private:
+    const Section section_;
+    const bool active_;
+};
+
+/* Start profiling, writing to `file` in the given format. The frontend's performance counters are
+ * updated too if `perf` provides them. Calling this while already profiling only changes the output
+ * file and format.
+ */
+void start(std::filesystem::path file, Format format, const retro_perf_callback& perf);
+
+/* Write out the frames collected so far and stop profiling.
+ */
+void stop();
+
+[[nodiscard]]
+auto isEnabled() noexcept -> bool;
+
+/* Close the current frame. Called once at the end of every retro_run().
+ */
+void frameDone();
+
+/* Called by the emulation right before it hands control to the frontend and right after it gets it
+ * back. Scopes that are open in the emulation stop counting in between.
+ */
+void suspendEmulation() noexcept;
+void resumeEmulation() noexcept;
+
+} // namespace profiler
+
+/*
+
+Copyright (C) 2022 Nikos Chantziaras <realnc@gmail.com>
+
+This file is part of DOSBox-core.
+
+DOSBox-core is free software: you can redistribute it and/or modify it under
+the terms of the GNU General Public License as published by the Free Software
+Foundation, either version 2 of the License, or (at your option) any later
+version.
+
+DOSBox-core is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+DOSBox-core. If not, see <https://www.gnu.org/licenses/>.
+
+*/
@@ -3,6 +3,7 @@
 #include "deps/char8_t-remediation/char8_t-remediation.h"
 #include "control.h"
 #include "libretro_dosbox.h"
+#include "libretro_profiler.h"
 #include "log.h"
 #include <dlfcn.h>
 #include <tuple>
@@ -213,6 +214,7 @@ auto MidiHandlerBassmidi::GetName() -> const char*
 
 void MidiHandlerBassmidi::mixerCallback(const Bitu len)
 {
+    profiler::Scope profile_scope(profiler::Section::Midi);
     if (BASS_ChannelGetData(instance_.stream_, MixTemp, len * 4) == -1u) {
         retro::logError("BASSMIDI failed to render audio: code {}.", BASS_ErrorGetCode());
     }
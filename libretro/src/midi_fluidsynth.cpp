@@ -3,6 +3,7 @@
 
 #include "control.h"
 #include "libretro_dosbox.h"
+#include "libretro_profiler.h"
 #include "log.h"
 #include "setup.h"
 #include <string_view>
@@ -196,6 +197,7 @@ auto MidiHandlerFluidsynth::GetName() -> const char*
 
 void MidiHandlerFluidsynth::mixerCallback(const Bitu len)
 {
+    profiler::Scope profile_scope(profiler::Section::Midi);
     fluid_synth_write_s16(instance_.synth_.get(), len, MixTemp, 0, 2, MixTemp, 1, 2);
     instance_.channel_->AddSamples_s16(len, reinterpret_cast<Bit16s*>(MixTemp));
 }
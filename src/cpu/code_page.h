@@ -0,0 +1,186 @@
+/*
+ *  Copyright (C) 2002-2021  The DOSBox Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef DOSBOX_CODE_PAGE_H
+#define DOSBOX_CODE_PAGE_H
+
+// the pages that a core keeps translated code of
+template <class Page> struct CodePageList {
+	Page * free_pages;		// pointer to the free list
+	Page * used_pages;		// pointer to the list of used pages
+	Page * last_page;		// the last used page
+};
+
+// the part of a code page handler that the dynamic and the cached cores
+// share: it intercepts the writes to a page with translated code and keeps
+// the page in the list of used pages. Page is the handler of the core, it
+// provides InvalidateRange(start,end) and its list of pages as Page::Pages()
+template <class Page> class CodePageHandlerBase : public PageHandler {
+public:
+	CodePageHandlerBase() {
+		invalidation_map=NULL;
+	}
+
+	// the following functions will clean all blocks that are invalid now due to the write
+	void writeb(PhysPt addr,Bitu val){
+		if (GCC_UNLIKELY(old_pagehandler->flags&PFLAG_HASROM)) return;
+		if (GCC_UNLIKELY((old_pagehandler->flags&PFLAG_READABLE)!=PFLAG_READABLE)) {
+			E_Exit("wb:non-readable code page found that is no ROM page");
+		}
+		addr&=4095;
+		if (host_readb(hostmem+addr)==(Bit8u)val) return;
+		host_writeb(hostmem+addr,val);
+		// see if there's code where we are writing to
+		if (!host_readb(&write_map[addr])) {
+			WriteWithoutCode();
+			return;
+		}
+		CountInvalidation(addr,addr);
+		static_cast<Page*>(this)->InvalidateRange(addr,addr);
+	}
+	void writew(PhysPt addr,Bitu val){
+		if (GCC_UNLIKELY(old_pagehandler->flags&PFLAG_HASROM)) return;
+		if (GCC_UNLIKELY((old_pagehandler->flags&PFLAG_READABLE)!=PFLAG_READABLE)) {
+			E_Exit("ww:non-readable code page found that is no ROM page");
+		}
+		addr&=4095;
+		if (host_readw(hostmem+addr)==(Bit16u)val) return;
+		host_writew(hostmem+addr,val);
+		// see if there's code where we are writing to
+		if (!host_readw(&write_map[addr])) {
+			WriteWithoutCode();
+			return;
+		}
+		CountInvalidation(addr,addr+1);
+		static_cast<Page*>(this)->InvalidateRange(addr,addr+1);
+	}
+	void writed(PhysPt addr,Bitu val){
+		if (GCC_UNLIKELY(old_pagehandler->flags&PFLAG_HASROM)) return;
+		if (GCC_UNLIKELY((old_pagehandler->flags&PFLAG_READABLE)!=PFLAG_READABLE)) {
+			E_Exit("wd:non-readable code page found that is no ROM page");
+		}
+		addr&=4095;
+		if (host_readd(hostmem+addr)==(Bit32u)val) return;
+		host_writed(hostmem+addr,val);
+		// see if there's code where we are writing to
+		if (!host_readd(&write_map[addr])) {
+			WriteWithoutCode();
+			return;
+		}
+		CountInvalidation(addr,addr+3);
+		static_cast<Page*>(this)->InvalidateRange(addr,addr+3);
+	}
+
+	void Release(void) {
+		MEM_SetPageHandler(phys_page,1,old_pagehandler);	// revert to old handler
+		PAGING_ClearTLB();
+
+		// remove page from the lists
+		CodePageList<Page> & list=Page::Pages();
+		if (prev) prev->next=next;
+		else list.used_pages=next;
+		if (next) next->prev=prev;
+		else list.last_page=prev;
+		next=list.free_pages;
+		list.free_pages=static_cast<Page*>(this);
+		prev=0;
+	}
+	// add this page to the end of the list of used pages
+	void Use(void) {
+		CodePageList<Page> & list=Page::Pages();
+		prev=list.last_page;
+		next=0;
+		if (list.last_page) list.last_page->next=static_cast<Page*>(this);
+		list.last_page=static_cast<Page*>(this);
+		if (!list.used_pages) list.used_pages=static_cast<Page*>(this);
+	}
+	// move this page to the end of the list of used pages, the pages at
+	// the start of the list are the ones that were run the longest time ago
+	void Touch(void) {
+		if (!next) return;
+		CodePageList<Page> & list=Page::Pages();
+		if (prev) prev->next=next;
+		else list.used_pages=next;
+		next->prev=prev;
+		prev=list.last_page;
+		list.last_page->next=static_cast<Page*>(this);
+		next=0;
+		list.last_page=static_cast<Page*>(this);
+	}
+
+	HostPt GetHostReadPt(Bitu phys_page) {
+		hostmem=old_pagehandler->GetHostReadPt(phys_page);
+		return hostmem;
+	}
+	HostPt GetHostWritePt(Bitu phys_page) {
+		return GetHostReadPt( phys_page );
+	}
+public:
+	// the write map, there are write_map[i] blocks that cover the byte at address i
+	Bit8u write_map[4096+4];
+	Bit8u * invalidation_map;
+	Page * next, * prev;	// page linking
+protected:
+	void SetupPage(Bitu _phys_page,PageHandler * _old_pagehandler,Bitu code_flags) {
+		// initialize this codepage handler
+		phys_page=_phys_page;
+		// save the old pagehandler to provide direct read access to the memory,
+		// and to be able to restore it later on
+		old_pagehandler=_old_pagehandler;
+
+		// adjust flags
+		flags=old_pagehandler->flags|code_flags;
+		flags&=~PFLAG_WRITEABLE;
+
+		active_blocks=0;
+		active_count=16;
+
+		// no code present
+		memset(&write_map,0,sizeof(write_map));
+		if (invalidation_map!=NULL) {
+			free(invalidation_map);
+			invalidation_map=NULL;
+		}
+	}
+	// a write that didn't hit any code, a page without blocks is released
+	// after a few of these
+	void WriteWithoutCode(void) {
+		if (active_blocks) return;		// still some blocks in this page
+		active_count--;
+		if (!active_count) Release();	// delay page releasing until active_count is zero
+	}
+	// note how often the code was changed, the decoders leave code
+	// alone that keeps being modified
+	void CountInvalidation(Bitu start,Bitu end) {
+		if (!invalidation_map) {
+			invalidation_map=(Bit8u*)malloc(4096);
+			memset(invalidation_map,0,4096);
+		}
+		for (Bitu i=start;i<=end && i<4096;i++) {
+			if (invalidation_map[i]<0xff) invalidation_map[i]++;
+		}
+	}
+
+	PageHandler * old_pagehandler;
+	Bitu active_blocks;		// the number of blocks in this page
+	Bitu active_count;		// delaying parameter to not immediately release a page
+	HostPt hostmem;
+	Bitu phys_page;
+};
+
+#endif
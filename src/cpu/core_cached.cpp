@@ -0,0 +1,212 @@
+/*
+ *  Copyright (C) 2002-2021  The DOSBox Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/*
+	The cached core is an interpreter that decodes every instruction only
+	once. The instructions are decoded into blocks of operations which
+	are kept per page and run by calling the handler of each operation in
+	turn, so the prefix, modrm and address decoding of the normal core is
+	skipped when the code runs again. Writes to pages with decoded code
+	are caught like in the dynamic cores, the blocks covering the written
+	bytes are thrown away. Instructions that are not decoded are run by
+	the normal core.
+*/
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "dosbox.h"
+#include "mem.h"
+#include "cpu.h"
+#include "lazyflags.h"
+#include "inout.h"
+#include "callback.h"
+#include "pic.h"
+#include "fpu.h"
+#include "paging.h"
+#include "modrm.h"
+
+#if C_DEBUG
+#include "debug.h"
+#endif
+
+#if (!C_CORE_INLINE)
+#define LoadMb(off) mem_readb(off)
+#define LoadMw(off) mem_readw(off)
+#define LoadMd(off) mem_readd(off)
+#define SaveMb(off,val)	mem_writeb(off,val)
+#define SaveMw(off,val)	mem_writew(off,val)
+#define SaveMd(off,val)	mem_writed(off,val)
+#else
+#define LoadMb(off) mem_readb_inline(off)
+#define LoadMw(off) mem_readw_inline(off)
+#define LoadMd(off) mem_readd_inline(off)
+#define SaveMb(off,val)	mem_writeb_inline(off,val)
+#define SaveMw(off,val)	mem_writew_inline(off,val)
+#define SaveMd(off,val)	mem_writed_inline(off,val)
+#endif
+
+#define CACHED_MAXINSTRUCTIONS	32		// maximum number of instructions in a block
+#define CACHED_MAXSPAN			512		// maximum number of bytes a block covers
+#define CACHED_HASH_SHIFT		4
+#define CACHED_PAGE_HASH		(4096>>CACHED_HASH_SHIFT)
+#define CACHED_MAXOPS			(256*1024)	// operations kept before pages are thrown away
+
+struct CachedOp;
+typedef const CachedOp * (* CachedHandler)(const CachedOp * op);
+
+// a decoded instruction
+struct CachedOp {
+	CachedHandler handler;
+	union {
+		Bit8u * b;
+		Bit16u * w;
+		Bit32u * d;
+	} reg,rm;				// the register operands
+	Bit32u * base;			// parts of the effective address
+	Bit32u * index;
+	Bit32u disp;
+	Bit32u imm;				// immediate or displacement of jumps
+	Bit32u mask;			// address size, operand size for jumps
+	Bit16u ip;				// offset of the instruction from the start of the block
+	Bit8u len;				// length of the instruction
+	Bit8u seg;				// segment of the effective address
+	Bit8u scale;
+};
+
+enum CachedExit {
+	CACHED_EXIT_NORMAL,		// the block ended, continue with the next one
+	CACHED_EXIT_OPCODE		// the normal core has to run the next instruction
+};
+
+static struct {
+	Bit32u eip;							// eip at the start of the running block
+	struct CacheBlockCached * running;	// the block that is being run
+	struct CacheBlockCached * zombie;	// the running block was invalidated
+	bool smc;							// the running block has been modified
+	CachedExit exit;
+} core_cached;
+
+#include "instructions.h"
+#include "code_page.h"
+#include "core_cached/cache.h"
+#include "core_cached/ops.h"
+#include "core_cached/decoder.h"
+
+Bits CPU_Core_Cached_Run(void) {
+	while (CPU_Cycles>0) {
+		// Determine the linear address of CS:EIP
+		PhysPt ip_point=SegPhys(cs)+reg_eip;
+#if C_DEBUG
+#if C_HEAVY_DEBUG
+		if (DEBUG_HeavyIsBreakpoint()) {
+			FillFlags();
+			return debugCallback;
+		}
+#endif
+#endif
+		CodePageHandlerCached * chandler=0;
+		// see if the current page is present and can hold decoded code
+		if (GCC_UNLIKELY(MakeCachedPage(ip_point,chandler))) {
+			// page not present, throw the exception
+			CPU_Exception(cpu.exception.which,cpu.exception.error);
+			continue;
+		}
+
+		// page is special, the normal core runs it
+		if (GCC_UNLIKELY(!chandler)) return CPU_Core_Normal_Run();
+
+		// keep the pages in the order they were last run in
+		if (chandler!=cache_cached.pages.last_page) chandler->Touch();
+
+		Bitu page_ip=ip_point&4095;
+		CacheBlockCached * block=chandler->FindCacheBlock(page_ip,cpu.code.big ? 1:0);
+		if (!block) {
+			// the normal core runs code that keeps being modified
+			if (chandler->invalidation_map && chandler->invalidation_map[page_ip]>=4) goto normal_core;
+			block=CreateCachedBlock(chandler,ip_point);
+		}
+
+		CPU_Cycles-=block->count;
+		core_cached.eip=reg_eip;
+		core_cached.exit=CACHED_EXIT_NORMAL;
+		core_cached.running=block;
+		{
+			const CachedOp * op=block->ops;
+			do op=op->handler(op); while (op);
+		}
+		core_cached.running=0;
+		if (GCC_UNLIKELY(core_cached.smc)) {
+			core_cached.smc=false;
+			if (core_cached.zombie) {
+				free(core_cached.zombie);
+				core_cached.zombie=0;
+			}
+		}
+		if (core_cached.exit==CACHED_EXIT_OPCODE) goto normal_core;
+		continue;
+normal_core:
+		// the instruction at cs:eip is not decoded, let the normal core
+		// run it and return from the core like the dynamic cores do
+		CPU_CycleLeft+=CPU_Cycles;
+		CPU_Cycles=1;
+		Bits ret=CPU_Core_Normal_Run();
+		// the instruction may have set the trap flag
+		if (cpudecoder==CPU_Core_Normal_Trap_Run) cpudecoder=CPU_Core_Cached_Trap_Run;
+		return ret;
+	}
+	FillFlags();
+	return CBRET_NONE;
+}
+
+Bits CPU_Core_Cached_Trap_Run(void) {
+	Bits oldCycles = CPU_Cycles;
+	CPU_Cycles = 1;
+	cpu.trap_skip = false;
+
+	// let the normal core execute the next (only one!) instruction
+	Bits ret=CPU_Core_Normal_Run();
+
+	// trap to int1 unless the last instruction deferred this
+	// (allows hardware interrupts to be served without interaction)
+	if (!cpu.trap_skip) CPU_DebugException(DBINT_STEP,reg_eip);
+
+	CPU_Cycles = oldCycles-1;
+	// continue (either the trapflag was clear anyways, or the int1 cleared it)
+	cpudecoder = &CPU_Core_Cached_Run;
+
+	return ret;
+}
+
+void CPU_Core_Cached_Init(void) {
+	cache_cached.initialized=true;
+}
+
+void CPU_Core_Cached_Cache_Init(bool enable_cache) {
+	// the decoded code is only kept while the cached core is in use
+	if (!enable_cache) cached_reset();
+}
+
+void CPU_Core_Cached_Cache_Close(void) {
+	cached_close();
+}
+
+void CPU_Core_Cached_Cache_Reset(void) {
+	cached_reset();
+}
@@ -0,0 +1,227 @@
+/*
+ *  Copyright (C) 2002-2021  The DOSBox Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+class CodePageHandlerCached;	// forward
+
+// a decoded block, the instructions of a straight piece of guest code
+// that all lie in the same page, ending with a control transfer
+struct CacheBlockCached {
+	Bit16u start,end;		// where in the page is the original code
+	Bit8u big;				// decoded as 32-bit code
+	Bitu count;				// number of guest instructions
+	Bitu size;				// number of operations
+	CacheBlockCached * hash_next;
+	CachedOp ops[1];		// the operations, allocated along with the block
+};
+
+static struct {
+	CodePageList<CodePageHandlerCached> pages;	// free and used code pages
+	Bitu ops;					// number of operations in all blocks
+	bool initialized;
+} cache_cached;
+
+static void cached_freeblock(CacheBlockCached * block);
+
+
+// the CodePageHandlerCached class provides access to the decoded blocks
+// and intercepts writes to the code for special treatment
+class CodePageHandlerCached : public CodePageHandlerBase<CodePageHandlerCached> {
+public:
+	static CodePageList<CodePageHandlerCached> & Pages(void) {
+		return cache_cached.pages;
+	}
+
+	void SetupAt(Bitu _phys_page,PageHandler * _old_pagehandler) {
+		SetupPage(_phys_page,_old_pagehandler,PFLAG_HASCACHE);
+		// initialize the hash map with zero (no blocks present)
+		memset(&hash_map,0,sizeof(hash_map));
+	}
+
+	// clear out blocks that contain code which has been modified, blocks
+	// can start up to CACHED_MAXSPAN bytes before the code they cover
+	void InvalidateRange(Bitu start,Bitu end) {
+		Bitu index=(start>CACHED_MAXSPAN ? start-CACHED_MAXSPAN:0)>>CACHED_HASH_SHIFT;
+		for (;index<=(end>>CACHED_HASH_SHIFT);index++) {
+			Bitu map=0;
+			// see if there is still some code in the range
+			for (Bitu count=start;count<=end;count++) map+=write_map[count];
+			if (!map) return;	// no more code, finished
+
+			CacheBlockCached * block=hash_map[index];
+			while (block) {
+				CacheBlockCached * nextblock=block->hash_next;
+				// test if this block is in the range
+				if (start<=block->end && end>=block->start) {
+					DelCacheBlock(block);
+					cached_freeblock(block);
+				}
+				block=nextblock;
+			}
+		}
+	}
+
+	// add a block to this page and note it in the hash map
+	void AddCacheBlock(CacheBlockCached * block) {
+		Bitu index=block->start>>CACHED_HASH_SHIFT;
+		block->hash_next=hash_map[index];
+		hash_map[index]=block;
+		for (Bitu i=block->start;i<=block->end;i++) write_map[i]++;
+		active_blocks++;
+	}
+	// remove a block
+	void DelCacheBlock(CacheBlockCached * block) {
+		active_blocks--;
+		active_count=16;
+		CacheBlockCached * * bwhere=&hash_map[block->start>>CACHED_HASH_SHIFT];
+		while (*bwhere!=block) bwhere=&((*bwhere)->hash_next);
+		*bwhere=block->hash_next;
+		for (Bitu i=block->start;i<=block->end;i++) {
+			if (write_map[i]) write_map[i]--;
+		}
+	}
+
+	void ClearRelease(void) {
+		// clear out all blocks in this page
+		for (Bitu index=0;index<CACHED_PAGE_HASH;index++) {
+			CacheBlockCached * block=hash_map[index];
+			while (block) {
+				CacheBlockCached * nextblock=block->hash_next;
+				cached_freeblock(block);
+				block=nextblock;
+			}
+			hash_map[index]=0;
+		}
+		active_blocks=0;
+		Release();	// now can release this page
+	}
+
+	CacheBlockCached * FindCacheBlock(Bitu start,Bit8u big) {
+		CacheBlockCached * block=hash_map[start>>CACHED_HASH_SHIFT];
+		// see if there's a block present at the start address
+		while (block) {
+			if (block->start==start && block->big==big) return block;	// found
+			block=block->hash_next;
+		}
+		return 0;	// none found
+	}
+private:
+	// hash map to quickly find the blocks in this page
+	CacheBlockCached * hash_map[CACHED_PAGE_HASH];
+};
+
+
+static CacheBlockCached * cached_newblock(Bitu size) {
+	CacheBlockCached * block=(CacheBlockCached*)malloc(sizeof(CacheBlockCached)+(size-1)*sizeof(CachedOp));
+	if (!block) E_Exit("Allocating a decoded block has failed");
+	block->size=size;
+	cache_cached.ops+=size;
+	return block;
+}
+
+static void cached_freeblock(CacheBlockCached * block) {
+	cache_cached.ops-=block->size;
+	if (GCC_UNLIKELY(block==core_cached.running)) {
+		// the block is still being run, let it finish the current
+		// instruction and throw it away afterwards
+		core_cached.smc=true;
+		core_cached.zombie=block;
+		return;
+	}
+	free(block);
+}
+
+// throw away the pages that were run the longest time ago until there
+// is room for another block, but keep the page that it is decoded for
+static void cached_makeroom(CodePageHandlerCached * keep) {
+	while (cache_cached.ops>CACHED_MAXOPS) {
+		CodePageHandlerCached * page=cache_cached.pages.used_pages;
+		if (page==keep) page=page->next;
+		if (!page) break;
+		page->ClearRelease();
+	}
+}
+
+static bool MakeCachedPage(Bitu lin_addr,CodePageHandlerCached * &cph) {
+	Bit8u rdval;
+	//Ensure page contains memory:
+	if (GCC_UNLIKELY(mem_readb_checked(lin_addr,&rdval))) return true;
+
+	PageHandler * handler=get_tlb_readhandler(lin_addr);
+	if (handler->flags & PFLAG_HASCACHE) {
+		cph=(CodePageHandlerCached *)handler;
+		return false;
+	}
+	if (handler->flags & PFLAG_NOCODE) {
+		if (PAGING_ForcePageInit(lin_addr)) {
+			handler=get_tlb_readhandler(lin_addr);
+			if (handler->flags & PFLAG_HASCACHE) {
+				cph=(CodePageHandlerCached *)handler;
+				return false;
+			}
+		}
+	}
+	// only ordinary memory can be tracked, everything else (including the
+	// pages still held by the dynamic cores) is left to the normal core
+	if ((handler->flags & (PFLAG_NOCODE|PFLAG_HASCODE|PFLAG_READABLE))!=PFLAG_READABLE) {
+		cph=0;
+		return false;
+	}
+	Bitu lin_page=lin_addr>>12;
+	Bitu phys_page=lin_page;
+	// find the physical page that the linear page is mapped to
+	if (!PAGING_MakePhysPage(phys_page)) {
+		cph=0;
+		return false;
+	}
+	// find a free CodePage
+	if (!cache_cached.pages.free_pages) cache_cached.pages.free_pages=new CodePageHandlerCached();
+	CodePageHandlerCached * cpagehandler=cache_cached.pages.free_pages;
+	cache_cached.pages.free_pages=cache_cached.pages.free_pages->next;
+
+	// add the page to the end of the list of used pages
+	cpagehandler->Use();
+
+	// initialize the code page handler and add the handler to the memory page
+	cpagehandler->SetupAt(phys_page,handler);
+	MEM_SetPageHandler(phys_page,1,cpagehandler);
+	PAGING_UnlinkPages(lin_page,1);
+	cph=cpagehandler;
+	return false;
+}
+
+// throw away all decoded code
+static void cached_reset(void) {
+	if (!cache_cached.initialized) return;
+	while (cache_cached.pages.used_pages) cache_cached.pages.used_pages->ClearRelease();
+	if (core_cached.zombie) {
+		free(core_cached.zombie);
+		core_cached.zombie=0;
+	}
+}
+
+static void cached_close(void) {
+	cached_reset();
+	while (cache_cached.pages.free_pages) {
+		CodePageHandlerCached * next=cache_cached.pages.free_pages->next;
+		if (cache_cached.pages.free_pages->invalidation_map) free(cache_cached.pages.free_pages->invalidation_map);
+		delete cache_cached.pages.free_pages;
+		cache_cached.pages.free_pages=next;
+	}
+	cache_cached.initialized=false;
+}
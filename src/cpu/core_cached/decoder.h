@@ -0,0 +1,473 @@
+/*
+ *  Copyright (C) 2002-2021  The DOSBox Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/*
+	The decoder turns the instructions starting at some address into a
+	block of operations. Register operands are resolved to pointers and
+	the parts of effective addresses are stored with the operation, so
+	running it does not need to look at the instruction bytes again.
+	Decoding stops at the first control transfer, at instructions that
+	are left to the normal core and at the end of the page.
+*/
+
+#define CACHED_SEG_NONE	0xff
+#define CACHED_MAXLEN	15		// longest instruction the cpu accepts
+
+static struct {
+	PhysPt page;		// linear address of the page
+	Bitu start;			// where in the page the block starts
+	Bitu pos;			// where in the page the next byte is fetched from
+	bool big;			// 32-bit code segment
+	bool opsize;		// 32-bit operand size
+	bool addrsize;		// 32-bit address size
+	Bit8u seg;			// segment override
+	bool cross;			// the instruction runs into the next page
+} decode_cached;
+
+static Bit32u cached_zero=0;		// the missing base or index of an address
+
+static Bit8u cached_fetchb(void) {
+	if (GCC_UNLIKELY(decode_cached.pos>=4096)) {
+		decode_cached.cross=true;
+		return 0;
+	}
+	return mem_readb(decode_cached.page+decode_cached.pos++);
+}
+static Bit16u cached_fetchw(void) {
+	Bit16u val=cached_fetchb();
+	return val|(cached_fetchb()<<8);
+}
+static Bit32u cached_fetchd(void) {
+	Bit32u val=cached_fetchw();
+	return val|(cached_fetchw()<<16);
+}
+
+// the immediate of the operand size, sign extended for byte immediates
+static Bit32u cached_fetchimm(Bitu size,bool sbyte) {
+	if (sbyte) return (Bit32u)(Bit32s)(Bit8s)cached_fetchb();
+	switch (size) {
+	case 0:return cached_fetchb();
+	case 1:return cached_fetchw();
+	default:return cached_fetchd();
+	}
+}
+
+static Bit32u * const cached_regs[8]={
+	&reg_eax,&reg_ecx,&reg_edx,&reg_ebx,&reg_esp,&reg_ebp,&reg_esi,&reg_edi
+};
+
+// store the effective address of a memory operand in op
+static void cached_ea(CachedOp * op,Bitu rm) {
+	Bitu mod=rm>>6;
+	Bit8u seg=ds;
+	op->base=op->index=&cached_zero;
+	op->scale=0;
+	op->disp=0;
+	if (!decode_cached.addrsize) {
+		op->mask=0xffff;
+		switch (rm&7) {
+		case 0:op->base=&reg_ebx;op->index=&reg_esi;break;
+		case 1:op->base=&reg_ebx;op->index=&reg_edi;break;
+		case 2:op->base=&reg_ebp;op->index=&reg_esi;seg=ss;break;
+		case 3:op->base=&reg_ebp;op->index=&reg_edi;seg=ss;break;
+		case 4:op->base=&reg_esi;break;
+		case 5:op->base=&reg_edi;break;
+		case 6:
+			if (!mod) op->disp=cached_fetchw();
+			else {op->base=&reg_ebp;seg=ss;}
+			break;
+		case 7:op->base=&reg_ebx;break;
+		}
+		if (mod==1) op->disp=(Bit32u)(Bit32s)(Bit8s)cached_fetchb();
+		else if (mod==2) op->disp=cached_fetchw();
+	} else {
+		op->mask=0xffffffff;
+		Bitu base=rm&7;
+		if (base==4) {
+			Bit8u sib=cached_fetchb();
+			base=sib&7;
+			Bitu index=(sib>>3)&7;
+			if (index!=4) op->index=cached_regs[index];
+			op->scale=sib>>6;
+		}
+		if (base==5 && !mod) op->disp=cached_fetchd();
+		else {
+			op->base=cached_regs[base];
+			if (base==4 || base==5) seg=ss;
+		}
+		if (mod==1) op->disp+=(Bit32u)(Bit32s)(Bit8s)cached_fetchb();
+		else if (mod==2) op->disp+=cached_fetchd();
+	}
+	op->seg=(decode_cached.seg!=CACHED_SEG_NONE) ? decode_cached.seg:seg;
+}
+
+// fetch the modrm byte and resolve the operands, the register operand
+// has size regsize and the r/m operand rmsize (0 byte, 1 word, 2 dword)
+static Bitu cached_modrm(CachedOp * op,Bitu regsize,Bitu rmsize) {
+	Bitu rm=cached_fetchb();
+	switch (regsize) {
+	case 0:op->reg.b=lookupRMregb[rm];break;
+	case 1:op->reg.w=lookupRMregw[rm];break;
+	default:op->reg.d=lookupRMregd[rm];break;
+	}
+	if (rm>=0xc0) {
+		switch (rmsize) {
+		case 0:op->rm.b=lookupRMEAregb[rm];break;
+		case 1:op->rm.w=lookupRMEAregw[rm];break;
+		default:op->rm.d=lookupRMEAregd[rm];break;
+		}
+	} else cached_ea(op,rm);
+	return rm;
+}
+
+// the register operand encoded in the low bits of the opcode
+static void cached_opreg(CachedOp * op,Bitu size,Bitu reg) {
+	switch (size) {
+	case 0:op->rm.b=lookupRMEAregb[0xc0+reg];break;
+	case 1:op->rm.w=lookupRMEAregw[0xc0+reg];break;
+	default:op->rm.d=lookupRMEAregd[0xc0+reg];break;
+	}
+}
+
+// the accumulator as the register operand
+static void cached_accreg(CachedOp * op,Bitu size) {
+	switch (size) {
+	case 0:op->reg.b=lookupRMregb[0];break;
+	case 1:op->reg.w=lookupRMregw[0];break;
+	default:op->reg.d=lookupRMregd[0];break;
+	}
+}
+
+// decode the instruction at the current position into op, returns false
+// if it is left to the normal core, end is set for control transfers
+// and emit is cleared for instructions that do nothing
+static bool cached_decode(CachedOp * op,bool & end,bool & emit) {
+	decode_cached.opsize=decode_cached.big;
+	decode_cached.addrsize=decode_cached.big;
+	decode_cached.seg=CACHED_SEG_NONE;
+	end=false;
+	emit=true;
+	const Bitu first=decode_cached.pos;
+	Bitu opcode;
+	for (;;) {
+		// more prefixes than fit in an instruction
+		if (decode_cached.pos-first>=CACHED_MAXLEN) return false;
+		opcode=cached_fetchb();
+		switch (opcode) {
+		case 0x26:decode_cached.seg=es;continue;
+		case 0x2e:decode_cached.seg=cs;continue;
+		case 0x36:decode_cached.seg=ss;continue;
+		case 0x3e:decode_cached.seg=ds;continue;
+		case 0x64:decode_cached.seg=fs;continue;
+		case 0x65:decode_cached.seg=gs;continue;
+		case 0x66:decode_cached.opsize=!decode_cached.big;continue;
+		case 0x67:decode_cached.addrsize=!decode_cached.big;continue;
+		}
+		break;
+	}
+	if (decode_cached.cross) return false;
+	// operand size of the instructions with a byte form at the even opcode
+	const Bitu wsize=decode_cached.opsize ? 2:1;
+	const Bitu size=(opcode&1) ? wsize:0;
+	// near jumps are cut down to the operand size
+	const Bit32u jmask=decode_cached.opsize ? 0xffffffff:0xffff;
+	Bitu rm;
+
+	if (opcode<0x40 && (opcode&7)<6) {
+		/* ADD, OR, ADC, SBB, AND, SUB, XOR, CMP */
+		const CachedHandler (*ops)[3][2]=cached_alu_ops[opcode>>3];
+		switch (opcode&7) {
+		case 0:case 1:
+			rm=cached_modrm(op,size,size);
+			op->handler=ops[size][CACHED_EG][rm<0xc0];
+			break;
+		case 2:case 3:
+			rm=cached_modrm(op,size,size);
+			op->handler=ops[size][CACHED_GE][rm<0xc0];
+			break;
+		default:
+			cached_opreg(op,size,0);
+			op->imm=cached_fetchimm(size,false);
+			op->handler=ops[size][CACHED_EI][0];
+			break;
+		}
+		return true;
+	}
+	switch (opcode) {
+	case 0x40:case 0x41:case 0x42:case 0x43:case 0x44:case 0x45:case 0x46:case 0x47:	/* INC Gv */
+	case 0x48:case 0x49:case 0x4a:case 0x4b:case 0x4c:case 0x4d:case 0x4e:case 0x4f:	/* DEC Gv */
+		cached_opreg(op,wsize,opcode&7);
+		op->handler=cached_incdec_ops[(opcode>>3)&1][wsize][0];
+		return true;
+	case 0x50:case 0x51:case 0x52:case 0x53:case 0x54:case 0x55:case 0x56:case 0x57:	/* PUSH Gv */
+		cached_opreg(op,wsize,opcode&7);
+		op->handler=cached_push_ops[wsize-1][0];
+		return true;
+	case 0x58:case 0x59:case 0x5a:case 0x5b:case 0x5c:case 0x5d:case 0x5e:case 0x5f:	/* POP Gv */
+		cached_opreg(op,wsize,opcode&7);
+		op->handler=(wsize==2) ? cached_pop_d_r:cached_pop_w_r;
+		return true;
+	case 0x68:																			/* PUSH Iv */
+	case 0x6a:																			/* PUSH Ib */
+		op->imm=cached_fetchimm(wsize,opcode==0x6a);
+		op->handler=(wsize==2) ? cached_push_d_i:cached_push_w_i;
+		return true;
+	case 0x69:																			/* IMUL Gv,Ev,Iv */
+	case 0x6b:																			/* IMUL Gv,Ev,Ib */
+		rm=cached_modrm(op,wsize,wsize);
+		op->imm=cached_fetchimm(wsize,opcode==0x6b);
+		op->handler=cached_imul3_ops[wsize-1][rm<0xc0];
+		return true;
+	case 0x70:case 0x71:case 0x72:case 0x73:case 0x74:case 0x75:case 0x76:case 0x77:	/* Jcc Jb */
+	case 0x78:case 0x79:case 0x7a:case 0x7b:case 0x7c:case 0x7d:case 0x7e:case 0x7f:
+		op->imm=cached_fetchimm(0,true);
+		op->mask=jmask;
+		op->handler=cached_jcc_ops[opcode&0xf];
+		end=true;
+		return true;
+	case 0x80:case 0x81:case 0x82:case 0x83:											/* GRP1 Ev,Iv */
+		{
+			const Bitu osize=(opcode==0x81 || opcode==0x83) ? wsize:0;
+			rm=cached_modrm(op,osize,osize);
+			op->imm=cached_fetchimm(osize,opcode==0x83);
+			op->handler=cached_alu_ops[(rm>>3)&7][osize][CACHED_EI][rm<0xc0];
+			return true;
+		}
+	case 0x84:case 0x85:																/* TEST Ev,Gv */
+		rm=cached_modrm(op,size,size);
+		op->handler=cached_test_ops[size][CACHED_EG][rm<0xc0];
+		return true;
+	case 0x86:case 0x87:																/* XCHG Ev,Gv */
+		rm=cached_modrm(op,size,size);
+		op->handler=cached_xchg_ops[size][rm<0xc0];
+		return true;
+	case 0x88:case 0x89:																/* MOV Ev,Gv */
+		rm=cached_modrm(op,size,size);
+		op->handler=cached_mov_ops[size][CACHED_EG][rm<0xc0];
+		if (rm==0x05 && opcode==0x88 && !decode_cached.big) op->handler=cached_mov_eg_b_m_di;
+		return true;
+	case 0x8a:case 0x8b:																/* MOV Gv,Ev */
+		rm=cached_modrm(op,size,size);
+		op->handler=cached_mov_ops[size][CACHED_GE][rm<0xc0];
+		return true;
+	case 0x8d:																			/* LEA Gv */
+		rm=cached_modrm(op,wsize,wsize);
+		if (rm>=0xc0) return false;
+		op->handler=(wsize==2) ? cached_lea_d:cached_lea_w;
+		return true;
+	case 0x90:																			/* NOP */
+		emit=false;
+		return true;
+	case 0x91:case 0x92:case 0x93:case 0x94:case 0x95:case 0x96:case 0x97:				/* XCHG Gv,eAX */
+		cached_opreg(op,wsize,opcode&7);
+		cached_accreg(op,wsize);
+		op->handler=cached_xchg_ops[wsize][0];
+		return true;
+	case 0x98:																			/* CBW */
+		op->handler=(wsize==2) ? cached_cwde:cached_cbw;
+		return true;
+	case 0x99:																			/* CWD */
+		op->handler=(wsize==2) ? cached_cdq:cached_cwd;
+		return true;
+	case 0xa0:case 0xa1:																/* MOV eAX,Ov */
+	case 0xa2:case 0xa3:																/* MOV Ov,eAX */
+		cached_accreg(op,size);
+		op->base=op->index=&cached_zero;
+		op->scale=0;
+		op->disp=decode_cached.addrsize ? cached_fetchd():cached_fetchw();
+		op->mask=decode_cached.addrsize ? 0xffffffff:0xffff;
+		op->seg=(decode_cached.seg!=CACHED_SEG_NONE) ? decode_cached.seg:(Bit8u)ds;
+		op->handler=cached_mov_ops[size][(opcode&2) ? CACHED_EG:CACHED_GE][1];
+		return true;
+	case 0xa8:case 0xa9:																/* TEST eAX,Iv */
+		cached_opreg(op,size,0);
+		op->imm=cached_fetchimm(size,false);
+		op->handler=cached_test_ops[size][CACHED_EI][0];
+		return true;
+	case 0xb0:case 0xb1:case 0xb2:case 0xb3:case 0xb4:case 0xb5:case 0xb6:case 0xb7:	/* MOV Gb,Ib */
+		cached_opreg(op,0,opcode&7);
+		op->imm=cached_fetchb();
+		op->handler=cached_mov_ops[0][CACHED_EI][0];
+		return true;
+	case 0xb8:case 0xb9:case 0xba:case 0xbb:case 0xbc:case 0xbd:case 0xbe:case 0xbf:	/* MOV Gv,Iv */
+		cached_opreg(op,wsize,opcode&7);
+		op->imm=cached_fetchimm(wsize,false);
+		op->handler=cached_mov_ops[wsize][CACHED_EI][0];
+		return true;
+	case 0xc0:case 0xc1:																/* GRP2 Ev,Ib */
+	case 0xd0:case 0xd1:																/* GRP2 Ev,1 */
+	case 0xd2:case 0xd3:																/* GRP2 Ev,CL */
+		rm=cached_modrm(op,0,size);
+		if (opcode<0xd0) op->reg.b=&cached_counts[cached_fetchb()&0x1f];
+		else if (opcode<0xd2) op->reg.b=&cached_counts[1];
+		else op->reg.b=&reg_cl;
+		op->handler=cached_shift_ops[(rm>>3)&7][size][rm<0xc0];
+		return true;
+	case 0xc2:																			/* RETN Iw */
+	case 0xc3:																			/* RETN */
+		op->imm=(opcode==0xc2) ? cached_fetchw():0;
+		op->handler=(wsize==2) ? cached_ret_d:cached_ret_w;
+		end=true;
+		return true;
+	case 0xc6:case 0xc7:																/* MOV Ev,Iv */
+		rm=cached_modrm(op,size,size);
+		op->imm=cached_fetchimm(size,false);
+		op->handler=cached_mov_ops[size][CACHED_EI][rm<0xc0];
+		return true;
+	case 0xe0:case 0xe1:case 0xe2:case 0xe3:											/* LOOPcc/JCXZ */
+		op->imm=cached_fetchimm(0,true);
+		op->mask=jmask;
+		op->handler=cached_loop_ops[opcode&3][decode_cached.addrsize ? 1:0];
+		end=true;
+		return true;
+	case 0xe8:																			/* CALL Jv */
+		op->imm=cached_fetchimm(wsize,false);
+		op->handler=(wsize==2) ? cached_call_d:cached_call_w;
+		end=true;
+		return true;
+	case 0xe9:																			/* JMP Jv */
+	case 0xeb:																			/* JMP Jb */
+		op->imm=(opcode==0xeb) ? cached_fetchimm(0,true):cached_fetchimm(wsize,false);
+		op->mask=jmask;
+		op->handler=cached_jmp;
+		end=true;
+		return true;
+	case 0xf5:op->handler=cached_cmc;return true;										/* CMC */
+	case 0xf6:case 0xf7:																/* GRP3 Ev(,Iv) */
+		rm=cached_modrm(op,0,size);
+		if (((rm>>3)&7)<2) {
+			op->imm=cached_fetchimm(size,false);
+			op->handler=cached_test_ops[size][CACHED_EI][rm<0xc0];
+		} else {
+			op->handler=cached_grp3_ops[(rm>>3)&7][size][rm<0xc0];
+		}
+		return op->handler!=0;
+	case 0xf8:op->handler=cached_clc;return true;										/* CLC */
+	case 0xf9:op->handler=cached_stc;return true;										/* STC */
+	case 0xfc:op->handler=cached_cld;return true;										/* CLD */
+	case 0xfd:op->handler=cached_std;return true;										/* STD */
+	case 0xfe:																			/* GRP4 Eb */
+		rm=cached_modrm(op,0,0);
+		if (((rm>>3)&7)>1) return false;
+		op->handler=cached_incdec_ops[(rm>>3)&1][0][rm<0xc0];
+		return true;
+	case 0xff:																			/* GRP5 Ev */
+		rm=cached_modrm(op,0,wsize);
+		switch ((rm>>3)&7) {
+		case 0x00:case 0x01:															/* INC/DEC Ev */
+			op->handler=cached_incdec_ops[(rm>>3)&1][wsize][rm<0xc0];
+			return true;
+		case 0x02:																		/* CALL Ev */
+			op->handler=cached_callev_ops[wsize-1][rm<0xc0];
+			end=true;
+			return true;
+		case 0x04:																		/* JMP Ev */
+			op->handler=cached_jmpev_ops[wsize-1][rm<0xc0];
+			end=true;
+			return true;
+		case 0x06:																		/* PUSH Ev */
+			op->handler=cached_push_ops[wsize-1][rm<0xc0];
+			return true;
+		}
+		return false;
+	case 0x0f:
+		opcode=cached_fetchb();
+		switch (opcode) {
+		case 0x80:case 0x81:case 0x82:case 0x83:case 0x84:case 0x85:case 0x86:case 0x87:	/* Jcc Jv */
+		case 0x88:case 0x89:case 0x8a:case 0x8b:case 0x8c:case 0x8d:case 0x8e:case 0x8f:
+			op->imm=cached_fetchimm(wsize,false);
+			op->mask=jmask;
+			op->handler=cached_jcc_ops[opcode&0xf];
+			end=true;
+			return true;
+		case 0x90:case 0x91:case 0x92:case 0x93:case 0x94:case 0x95:case 0x96:case 0x97:	/* SETcc Eb */
+		case 0x98:case 0x99:case 0x9a:case 0x9b:case 0x9c:case 0x9d:case 0x9e:case 0x9f:
+			rm=cached_modrm(op,0,0);
+			op->handler=cached_setcc_ops[opcode&0xf][rm<0xc0];
+			return true;
+		case 0xaf:																			/* IMUL Gv,Ev */
+			rm=cached_modrm(op,wsize,wsize);
+			op->handler=cached_imul2_ops[wsize-1][rm<0xc0];
+			return true;
+		case 0xb6:case 0xb7:																/* MOVZX Gv,Ev */
+		case 0xbe:case 0xbf:																/* MOVSX Gv,Ev */
+			rm=cached_modrm(op,wsize,opcode&1);
+			op->handler=cached_movx_ops[(opcode>>3)&1][opcode&1][wsize-1][rm<0xc0];
+			return true;
+		}
+		return false;
+	}
+	return false;
+}
+
+// decode the instructions starting at ip_point into a new block
+static CacheBlockCached * CreateCachedBlock(CodePageHandlerCached * chandler,PhysPt ip_point) {
+	CachedOp ops[CACHED_MAXINSTRUCTIONS+1];
+	cached_makeroom(chandler);
+
+	decode_cached.page=ip_point&~4095;
+	decode_cached.start=decode_cached.pos=ip_point&4095;
+	decode_cached.big=cpu.code.big;
+	decode_cached.cross=false;
+	const Bit8u * invmap=chandler->invalidation_map;
+
+	Bitu count=0,size=0;
+	bool end=false,emit;
+	CachedHandler exit=cached_continue;
+	while (count<CACHED_MAXINSTRUCTIONS) {
+		Bitu start=decode_cached.pos;
+		CachedOp * op=&ops[size];
+		bool decoded=cached_decode(op,end,emit) && !decode_cached.cross;
+		// keeps the block within CACHED_MAXSPAN bytes
+		if (decode_cached.pos-start>CACHED_MAXLEN) decoded=false;
+		// leave code alone that keeps being modified
+		if (decoded && invmap) {
+			for (Bitu i=start;i<decode_cached.pos;i++) {
+				if (invmap[i]>=4) decoded=false;
+			}
+		}
+		if (!decoded) {
+			decode_cached.pos=start;
+			end=false;
+			exit=cached_opcode;
+			break;
+		}
+		op->ip=(Bit16u)(start-decode_cached.start);
+		op->len=(Bit8u)(decode_cached.pos-start);
+		count++;
+		if (emit) size++;
+		if (end) break;
+	}
+	if (!end) {
+		// the block runs into an instruction that is not part of it
+		CachedOp * op=&ops[size++];
+		op->handler=exit;
+		op->ip=(Bit16u)(decode_cached.pos-decode_cached.start);
+		op->len=0;
+	}
+
+	CacheBlockCached * block=cached_newblock(size);
+	block->start=(Bit16u)decode_cached.start;
+	block->end=(Bit16u)(decode_cached.pos>decode_cached.start ? decode_cached.pos-1:decode_cached.start);
+	block->big=decode_cached.big ? 1:0;
+	block->count=count;
+	memcpy(block->ops,ops,size*sizeof(CachedOp));
+	chandler->AddCacheBlock(block);
+	return block;
+}
@@ -0,0 +1,460 @@
+/*
+ *  Copyright (C) 2002-2021  The DOSBox Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+/*
+	The operation handlers. Every handler executes one instruction and
+	returns the operation to run next, or NULL when the block is left,
+	in which case reg_eip has been set to where execution continues.
+	While an instruction runs reg_eip points to its start, like it does
+	in the normal core, so page faults and exceptions see the right eip.
+*/
+
+#define CACHED_OP(name) static const CachedOp * name(const CachedOp * op)
+
+#define LoadRb(reg) reg
+#define LoadRw(reg) reg
+#define LoadRd(reg) reg
+
+#define SaveRb(reg,val)	reg=val
+#define SaveRw(reg,val)	reg=val
+#define SaveRd(reg,val)	reg=val
+
+#define Push_16 CPU_Push16
+#define Push_32 CPU_Push32
+#define Pop_16 CPU_Pop16
+#define Pop_32 CPU_Pop32
+
+static INLINE void CachedSetIP(const CachedOp * op) {
+	reg_eip=core_cached.eip+op->ip;
+}
+
+static INLINE PhysPt CachedEA(const CachedOp * op) {
+	CachedSetIP(op);
+	return SegPhys((SegNames)op->seg)+((*op->base+(*op->index<<op->scale)+op->disp)&op->mask);
+}
+
+// leave the block after the current instruction
+static const CachedOp * CachedLeave(const CachedOp * op) {
+	reg_eip=core_cached.eip+op->ip+op->len;
+	return 0;
+}
+
+// operations that write to memory may have modified the running block
+static INLINE const CachedOp * CachedNextW(const CachedOp * op) {
+	if (GCC_UNLIKELY(core_cached.smc)) return CachedLeave(op);
+	return op+1;
+}
+
+// a near jump, op->mask cuts the target down to the operand size
+static INLINE const CachedOp * CachedBranch(const CachedOp * op,bool cond) {
+	Bit32u target=core_cached.eip+op->ip+op->len;
+	if (cond) target+=op->imm;
+	reg_eip=target&op->mask;
+	return 0;
+}
+
+// the block ends here, continue with the next one
+CACHED_OP(cached_continue) {
+	CachedSetIP(op);
+	return 0;
+}
+
+// the instruction at op is not handled, the normal core runs it
+CACHED_OP(cached_opcode) {
+	CachedSetIP(op);
+	core_cached.exit=CACHED_EXIT_OPCODE;
+	return 0;
+}
+
+
+/* Two operand instructions, in the forms E,G and G,E and E,I */
+
+#define CACHED_MOVB(op1,op2,load,save) save(op1,op2);
+#define CACHED_MOVW(op1,op2,load,save) save(op1,op2);
+#define CACHED_MOVD(op1,op2,load,save) save(op1,op2);
+
+#define CACHED_ALU_SIZE(NAME,SZ,OP,T,M,LOADM,SAVEM)											\
+CACHED_OP(cached_##NAME##_eg_##SZ##_r) { OP(*op->rm.M,*op->reg.M,LoadR##SZ,SaveR##SZ); return op+1; }	\
+CACHED_OP(cached_##NAME##_eg_##SZ##_m) {														\
+	PhysPt eaa=CachedEA(op);OP(eaa,*op->reg.M,LOADM,SAVEM);return CachedNextW(op);			\
+}																							\
+CACHED_OP(cached_##NAME##_ge_##SZ##_r) { OP(*op->reg.M,*op->rm.M,LoadR##SZ,SaveR##SZ); return op+1; }	\
+CACHED_OP(cached_##NAME##_ge_##SZ##_m) {														\
+	PhysPt eaa=CachedEA(op);OP(*op->reg.M,LOADM(eaa),LoadR##SZ,SaveR##SZ);return op+1;		\
+}																							\
+CACHED_OP(cached_##NAME##_ei_##SZ##_r) { OP(*op->rm.M,(T)op->imm,LoadR##SZ,SaveR##SZ); return op+1; }	\
+CACHED_OP(cached_##NAME##_ei_##SZ##_m) {														\
+	PhysPt eaa=CachedEA(op);OP(eaa,(T)op->imm,LOADM,SAVEM);return CachedNextW(op);			\
+}
+
+#define CACHED_ALU(NAME,OPB,OPW,OPD)										\
+	CACHED_ALU_SIZE(NAME,b,OPB,Bit8u,b,LoadMb,SaveMb)						\
+	CACHED_ALU_SIZE(NAME,w,OPW,Bit16u,w,LoadMw,SaveMw)						\
+	CACHED_ALU_SIZE(NAME,d,OPD,Bit32u,d,LoadMd,SaveMd)
+
+#define CACHED_ALU_ENTRY(NAME,SZ)											\
+	{ {cached_##NAME##_eg_##SZ##_r,cached_##NAME##_eg_##SZ##_m},				\
+	  {cached_##NAME##_ge_##SZ##_r,cached_##NAME##_ge_##SZ##_m},				\
+	  {cached_##NAME##_ei_##SZ##_r,cached_##NAME##_ei_##SZ##_m} }
+
+#define CACHED_ALU_TABLE(NAME)												\
+	{ CACHED_ALU_ENTRY(NAME,b),CACHED_ALU_ENTRY(NAME,w),CACHED_ALU_ENTRY(NAME,d) }
+
+CACHED_ALU(add,ADDB,ADDW,ADDD)
+CACHED_ALU(or_op,ORB,ORW,ORD)
+CACHED_ALU(adc,ADCB,ADCW,ADCD)
+CACHED_ALU(sbb,SBBB,SBBW,SBBD)
+CACHED_ALU(and_op,ANDB,ANDW,ANDD)
+CACHED_ALU(sub,SUBB,SUBW,SUBD)
+CACHED_ALU(xor_op,XORB,XORW,XORD)
+CACHED_ALU(cmp,CMPB,CMPW,CMPD)
+CACHED_ALU(test,TESTB,TESTW,TESTD)
+CACHED_ALU(mov,CACHED_MOVB,CACHED_MOVW,CACHED_MOVD)
+
+enum { CACHED_EG=0,CACHED_GE=1,CACHED_EI=2 };
+
+// indexed by the operation, the operand size, the form and register/memory
+static const CachedHandler cached_alu_ops[8][3][3][2]={
+	CACHED_ALU_TABLE(add),CACHED_ALU_TABLE(or_op),CACHED_ALU_TABLE(adc),CACHED_ALU_TABLE(sbb),
+	CACHED_ALU_TABLE(and_op),CACHED_ALU_TABLE(sub),CACHED_ALU_TABLE(xor_op),CACHED_ALU_TABLE(cmp)
+};
+static const CachedHandler cached_test_ops[3][3][2]=CACHED_ALU_TABLE(test);
+static const CachedHandler cached_mov_ops[3][3][2]=CACHED_ALU_TABLE(mov);
+
+// MOV [DI],AL of 16-bit code raises an exception in protected mode when
+// DS is a code segment, the normal core does the checking
+CACHED_OP(cached_mov_eg_b_m_di) {
+	if (GCC_UNLIKELY(cpu.pmode)) return cached_opcode(op);
+	return cached_mov_eg_b_m(op);
+}
+
+#define CACHED_XCHG(SZ,T,M,LOADM,SAVEM)										\
+CACHED_OP(cached_xchg_##SZ##_r) { T old=*op->reg.M;*op->reg.M=*op->rm.M;*op->rm.M=old;return op+1; }	\
+CACHED_OP(cached_xchg_##SZ##_m) {											\
+	PhysPt eaa=CachedEA(op);T old=*op->reg.M;								\
+	*op->reg.M=LOADM(eaa);SAVEM(eaa,old);return CachedNextW(op);			\
+}
+
+CACHED_XCHG(b,Bit8u,b,LoadMb,SaveMb)
+CACHED_XCHG(w,Bit16u,w,LoadMw,SaveMw)
+CACHED_XCHG(d,Bit32u,d,LoadMd,SaveMd)
+
+static const CachedHandler cached_xchg_ops[3][2]={
+	{cached_xchg_b_r,cached_xchg_b_m},{cached_xchg_w_r,cached_xchg_w_m},{cached_xchg_d_r,cached_xchg_d_m}
+};
+
+
+/* One operand instructions */
+
+#define CACHED_NOTB(op1,load,save) save(op1,~load(op1));
+#define CACHED_NOTW(op1,load,save) save(op1,~load(op1));
+#define CACHED_NOTD(op1,load,save) save(op1,~load(op1));
+
+#define CACHED_NEGB(op1,load,save)											\
+	lflags.type=t_NEGb;lf_var1b=load(op1);lf_resb=0-lf_var1b;save(op1,lf_resb);
+#define CACHED_NEGW(op1,load,save)											\
+	lflags.type=t_NEGw;lf_var1w=load(op1);lf_resw=0-lf_var1w;save(op1,lf_resw);
+#define CACHED_NEGD(op1,load,save)											\
+	lflags.type=t_NEGd;lf_var1d=load(op1);lf_resd=0-lf_var1d;save(op1,lf_resd);
+
+#define CACHED_UNARY_SIZE(NAME,SZ,OP,M,LOADM,SAVEM)							\
+CACHED_OP(cached_##NAME##_##SZ##_r) { OP(*op->rm.M,LoadR##SZ,SaveR##SZ); return op+1; }	\
+CACHED_OP(cached_##NAME##_##SZ##_m) {										\
+	PhysPt eaa=CachedEA(op);OP(eaa,LOADM,SAVEM);return CachedNextW(op);		\
+}
+
+#define CACHED_UNARY(NAME,OPB,OPW,OPD)										\
+	CACHED_UNARY_SIZE(NAME,b,OPB,b,LoadMb,SaveMb)							\
+	CACHED_UNARY_SIZE(NAME,w,OPW,w,LoadMw,SaveMw)							\
+	CACHED_UNARY_SIZE(NAME,d,OPD,d,LoadMd,SaveMd)
+
+#define CACHED_UNARY_TABLE(NAME)											\
+	{ {cached_##NAME##_b_r,cached_##NAME##_b_m},							\
+	  {cached_##NAME##_w_r,cached_##NAME##_w_m},							\
+	  {cached_##NAME##_d_r,cached_##NAME##_d_m} }
+
+CACHED_UNARY(inc,INCB,INCW,INCD)
+CACHED_UNARY(dec,DECB,DECW,DECD)
+CACHED_UNARY(not_op,CACHED_NOTB,CACHED_NOTW,CACHED_NOTD)
+CACHED_UNARY(neg,CACHED_NEGB,CACHED_NEGW,CACHED_NEGD)
+CACHED_UNARY(mul,MULB,MULW,MULD)
+CACHED_UNARY(imul,IMULB,IMULW,IMULD)
+
+// GRP3 and GRP4/5, leaving out the ones that are not handled
+static const CachedHandler cached_grp3_ops[8][3][2]={
+	{},{},CACHED_UNARY_TABLE(not_op),CACHED_UNARY_TABLE(neg),
+	CACHED_UNARY_TABLE(mul),CACHED_UNARY_TABLE(imul),{},{}
+};
+static const CachedHandler cached_incdec_ops[2][3][2]={
+	CACHED_UNARY_TABLE(inc),CACHED_UNARY_TABLE(dec)
+};
+
+
+/* Shifts and rotates, the count is read through op->reg */
+
+// counts of the immediate forms to point op->reg to
+static Bit8u cached_counts[32]={
+	0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19,20,21,22,23,24,25,26,27,28,29,30,31
+};
+
+#define CACHED_SHIFT_SIZE(NAME,SZ,OP,M,LOADM,SAVEM)							\
+CACHED_OP(cached_##NAME##_##SZ##_r) {										\
+	Bit8u val=*op->reg.b & 0x1f;											\
+	if (val) do { OP(*op->rm.M,val,LoadR##SZ,SaveR##SZ); } while (0);		\
+	return op+1;															\
+}																			\
+CACHED_OP(cached_##NAME##_##SZ##_m) {										\
+	PhysPt eaa=CachedEA(op);												\
+	Bit8u val=*op->reg.b & 0x1f;											\
+	if (val) do { OP(eaa,val,LOADM,SAVEM); } while (0);						\
+	return CachedNextW(op);													\
+}
+
+#define CACHED_SHIFT(NAME,OPB,OPW,OPD)										\
+	CACHED_SHIFT_SIZE(NAME,b,OPB,b,LoadMb,SaveMb)							\
+	CACHED_SHIFT_SIZE(NAME,w,OPW,w,LoadMw,SaveMw)							\
+	CACHED_SHIFT_SIZE(NAME,d,OPD,d,LoadMd,SaveMd)
+
+CACHED_SHIFT(rol,ROLB,ROLW,ROLD)
+CACHED_SHIFT(ror,RORB,RORW,RORD)
+CACHED_SHIFT(rcl,RCLB,RCLW,RCLD)
+CACHED_SHIFT(rcr,RCRB,RCRW,RCRD)
+CACHED_SHIFT(shl,SHLB,SHLW,SHLD)
+CACHED_SHIFT(shr,SHRB,SHRW,SHRD)
+CACHED_SHIFT(sar,SARB,SARW,SARD)
+
+static const CachedHandler cached_shift_ops[8][3][2]={
+	CACHED_UNARY_TABLE(rol),CACHED_UNARY_TABLE(ror),CACHED_UNARY_TABLE(rcl),CACHED_UNARY_TABLE(rcr),
+	CACHED_UNARY_TABLE(shl),CACHED_UNARY_TABLE(shr),CACHED_UNARY_TABLE(shl),CACHED_UNARY_TABLE(sar)
+};
+
+
+/* Multiplications with a destination register */
+
+#define CACHED_IMUL_SIZE(SZ,OP,M,LOADM)										\
+CACHED_OP(cached_imul3_##SZ##_r) { OP(*op->reg.M,*op->rm.M,op->imm,LoadR##SZ,SaveR##SZ); return op+1; }	\
+CACHED_OP(cached_imul3_##SZ##_m) {											\
+	PhysPt eaa=CachedEA(op);OP(*op->reg.M,LOADM(eaa),op->imm,LoadR##SZ,SaveR##SZ);return op+1;	\
+}																			\
+CACHED_OP(cached_imul2_##SZ##_r) { OP(*op->reg.M,*op->rm.M,*op->reg.M,LoadR##SZ,SaveR##SZ); return op+1; }	\
+CACHED_OP(cached_imul2_##SZ##_m) {											\
+	PhysPt eaa=CachedEA(op);OP(*op->reg.M,LOADM(eaa),*op->reg.M,LoadR##SZ,SaveR##SZ);return op+1;	\
+}
+
+CACHED_IMUL_SIZE(w,DIMULW,w,LoadMw)
+CACHED_IMUL_SIZE(d,DIMULD,d,LoadMd)
+
+static const CachedHandler cached_imul3_ops[2][2]={
+	{cached_imul3_w_r,cached_imul3_w_m},{cached_imul3_d_r,cached_imul3_d_m}
+};
+static const CachedHandler cached_imul2_ops[2][2]={
+	{cached_imul2_w_r,cached_imul2_w_m},{cached_imul2_d_r,cached_imul2_d_m}
+};
+
+
+/* Moves with zero and sign extension */
+
+#define CACHED_MOVX(NAME,DM,DT,SM,ST,LOADM)									\
+CACHED_OP(cached_##NAME##_r) { *op->reg.DM=(DT)(ST)*op->rm.SM; return op+1; }	\
+CACHED_OP(cached_##NAME##_m) {												\
+	PhysPt eaa=CachedEA(op);*op->reg.DM=(DT)(ST)LOADM(eaa);return op+1;		\
+}
+
+CACHED_MOVX(movzx_bw,w,Bit16u,b,Bit8u,LoadMb)
+CACHED_MOVX(movzx_bd,d,Bit32u,b,Bit8u,LoadMb)
+CACHED_MOVX(movzx_wd,d,Bit32u,w,Bit16u,LoadMw)
+CACHED_MOVX(movsx_bw,w,Bit16u,b,Bit8s,LoadMb)
+CACHED_MOVX(movsx_bd,d,Bit32u,b,Bit8s,LoadMb)
+CACHED_MOVX(movsx_wd,d,Bit32u,w,Bit16s,LoadMw)
+
+// indexed by sign extension, the source and the destination size
+static const CachedHandler cached_movx_ops[2][2][2][2]={
+	{ { {cached_movzx_bw_r,cached_movzx_bw_m},{cached_movzx_bd_r,cached_movzx_bd_m} },
+	  { {cached_mov_ge_w_r,cached_mov_ge_w_m},{cached_movzx_wd_r,cached_movzx_wd_m} } },
+	{ { {cached_movsx_bw_r,cached_movsx_bw_m},{cached_movsx_bd_r,cached_movsx_bd_m} },
+	  { {cached_mov_ge_w_r,cached_mov_ge_w_m},{cached_movsx_wd_r,cached_movsx_wd_m} } }
+};
+
+CACHED_OP(cached_lea_w) {
+	*op->reg.w=(Bit16u)(*op->base+(*op->index<<op->scale)+op->disp);
+	return op+1;
+}
+CACHED_OP(cached_lea_d) {
+	*op->reg.d=(*op->base+(*op->index<<op->scale)+op->disp)&op->mask;
+	return op+1;
+}
+
+
+/* Stack operations */
+
+CACHED_OP(cached_push_w_r) { CachedSetIP(op);Push_16(*op->rm.w);return CachedNextW(op); }
+CACHED_OP(cached_push_d_r) { CachedSetIP(op);Push_32(*op->rm.d);return CachedNextW(op); }
+CACHED_OP(cached_push_w_m) { PhysPt eaa=CachedEA(op);Push_16(LoadMw(eaa));return CachedNextW(op); }
+CACHED_OP(cached_push_d_m) { PhysPt eaa=CachedEA(op);Push_32(LoadMd(eaa));return CachedNextW(op); }
+CACHED_OP(cached_push_w_i) { CachedSetIP(op);Push_16((Bit16u)op->imm);return CachedNextW(op); }
+CACHED_OP(cached_push_d_i) { CachedSetIP(op);Push_32(op->imm);return CachedNextW(op); }
+CACHED_OP(cached_pop_w_r) { CachedSetIP(op);*op->rm.w=Pop_16();return op+1; }
+CACHED_OP(cached_pop_d_r) { CachedSetIP(op);*op->rm.d=Pop_32();return op+1; }
+
+static const CachedHandler cached_push_ops[2][2]={
+	{cached_push_w_r,cached_push_w_m},{cached_push_d_r,cached_push_d_m}
+};
+
+
+/* Conditional jumps and SETcc */
+
+#define CACHED_COND(NAME,COND)												\
+CACHED_OP(cached_j##NAME) { return CachedBranch(op,COND); }					\
+CACHED_OP(cached_set##NAME##_r) { *op->rm.b=(COND) ? 1:0; return op+1; }	\
+CACHED_OP(cached_set##NAME##_m) {											\
+	PhysPt eaa=CachedEA(op);SaveMb(eaa,(COND) ? 1:0);return CachedNextW(op);	\
+}
+
+CACHED_COND(o,TFLG_O)
+CACHED_COND(no,TFLG_NO)
+CACHED_COND(b,TFLG_B)
+CACHED_COND(nb,TFLG_NB)
+CACHED_COND(z,TFLG_Z)
+CACHED_COND(nz,TFLG_NZ)
+CACHED_COND(be,TFLG_BE)
+CACHED_COND(nbe,TFLG_NBE)
+CACHED_COND(s,TFLG_S)
+CACHED_COND(ns,TFLG_NS)
+CACHED_COND(p,TFLG_P)
+CACHED_COND(np,TFLG_NP)
+CACHED_COND(l,TFLG_L)
+CACHED_COND(nl,TFLG_NL)
+CACHED_COND(le,TFLG_LE)
+CACHED_COND(nle,TFLG_NLE)
+
+static const CachedHandler cached_jcc_ops[16]={
+	cached_jo,cached_jno,cached_jb,cached_jnb,cached_jz,cached_jnz,cached_jbe,cached_jnbe,
+	cached_js,cached_jns,cached_jp,cached_jnp,cached_jl,cached_jnl,cached_jle,cached_jnle
+};
+
+#define CACHED_SETCC_ENTRY(NAME) {cached_set##NAME##_r,cached_set##NAME##_m}
+
+static const CachedHandler cached_setcc_ops[16][2]={
+	CACHED_SETCC_ENTRY(o),CACHED_SETCC_ENTRY(no),CACHED_SETCC_ENTRY(b),CACHED_SETCC_ENTRY(nb),
+	CACHED_SETCC_ENTRY(z),CACHED_SETCC_ENTRY(nz),CACHED_SETCC_ENTRY(be),CACHED_SETCC_ENTRY(nbe),
+	CACHED_SETCC_ENTRY(s),CACHED_SETCC_ENTRY(ns),CACHED_SETCC_ENTRY(p),CACHED_SETCC_ENTRY(np),
+	CACHED_SETCC_ENTRY(l),CACHED_SETCC_ENTRY(nl),CACHED_SETCC_ENTRY(le),CACHED_SETCC_ENTRY(nle)
+};
+
+CACHED_OP(cached_loopnz_w) { return CachedBranch(op,--reg_cx && !get_ZF()); }
+CACHED_OP(cached_loopnz_d) { return CachedBranch(op,--reg_ecx && !get_ZF()); }
+CACHED_OP(cached_loopz_w) { return CachedBranch(op,--reg_cx && get_ZF()); }
+CACHED_OP(cached_loopz_d) { return CachedBranch(op,--reg_ecx && get_ZF()); }
+CACHED_OP(cached_loop_w) { return CachedBranch(op,--reg_cx!=0); }
+CACHED_OP(cached_loop_d) { return CachedBranch(op,--reg_ecx!=0); }
+CACHED_OP(cached_jcxz_w) { return CachedBranch(op,!reg_cx); }
+CACHED_OP(cached_jcxz_d) { return CachedBranch(op,!reg_ecx); }
+
+// indexed by the opcode (0xe0-0xe3) and the address size
+static const CachedHandler cached_loop_ops[4][2]={
+	{cached_loopnz_w,cached_loopnz_d},{cached_loopz_w,cached_loopz_d},
+	{cached_loop_w,cached_loop_d},{cached_jcxz_w,cached_jcxz_d}
+};
+
+
+/* Near jumps, calls and returns */
+
+CACHED_OP(cached_jmp) { return CachedBranch(op,true); }
+
+CACHED_OP(cached_call_w) {
+	CachedSetIP(op);
+	Bit32u next=reg_eip+op->len;
+	Push_16((Bit16u)next);
+	reg_eip=(Bit16u)(next+op->imm);
+	return 0;
+}
+CACHED_OP(cached_call_d) {
+	CachedSetIP(op);
+	Bit32u next=reg_eip+op->len;
+	Push_32(next);
+	reg_eip=next+op->imm;
+	return 0;
+}
+
+CACHED_OP(cached_ret_w) {
+	CachedSetIP(op);
+	reg_eip=Pop_16();
+	reg_esp+=op->imm;
+	return 0;
+}
+CACHED_OP(cached_ret_d) {
+	CachedSetIP(op);
+	reg_eip=Pop_32();
+	reg_esp+=op->imm;
+	return 0;
+}
+
+CACHED_OP(cached_callev_w_r) {
+	Bit16u target=*op->rm.w;
+	CachedSetIP(op);
+	Push_16((Bit16u)(reg_eip+op->len));
+	reg_eip=target;
+	return 0;
+}
+CACHED_OP(cached_callev_w_m) {
+	PhysPt eaa=CachedEA(op);
+	Bit16u target=LoadMw(eaa);
+	Push_16((Bit16u)(reg_eip+op->len));
+	reg_eip=target;
+	return 0;
+}
+CACHED_OP(cached_callev_d_r) {
+	Bit32u target=*op->rm.d;
+	CachedSetIP(op);
+	Push_32(reg_eip+op->len);
+	reg_eip=target;
+	return 0;
+}
+CACHED_OP(cached_callev_d_m) {
+	PhysPt eaa=CachedEA(op);
+	Bit32u target=LoadMd(eaa);
+	Push_32(reg_eip+op->len);
+	reg_eip=target;
+	return 0;
+}
+CACHED_OP(cached_jmpev_w_r) { reg_eip=*op->rm.w; return 0; }
+CACHED_OP(cached_jmpev_w_m) { PhysPt eaa=CachedEA(op);reg_eip=LoadMw(eaa);return 0; }
+CACHED_OP(cached_jmpev_d_r) { reg_eip=*op->rm.d; return 0; }
+CACHED_OP(cached_jmpev_d_m) { PhysPt eaa=CachedEA(op);reg_eip=LoadMd(eaa);return 0; }
+
+static const CachedHandler cached_callev_ops[2][2]={
+	{cached_callev_w_r,cached_callev_w_m},{cached_callev_d_r,cached_callev_d_m}
+};
+static const CachedHandler cached_jmpev_ops[2][2]={
+	{cached_jmpev_w_r,cached_jmpev_w_m},{cached_jmpev_d_r,cached_jmpev_d_m}
+};
+
+
+/* Everything else */
+
+CACHED_OP(cached_cbw) { reg_ax=(Bit8s)reg_al; return op+1; }
+CACHED_OP(cached_cwde) { reg_eax=(Bit16s)reg_ax; return op+1; }
+CACHED_OP(cached_cwd) { reg_dx=(reg_ax & 0x8000) ? 0xffff:0; return op+1; }
+CACHED_OP(cached_cdq) { reg_edx=(reg_eax & 0x80000000) ? 0xffffffff:0; return op+1; }
+
+CACHED_OP(cached_cmc) { FillFlags();SETFLAGBIT(CF,!(reg_flags & FLAG_CF));return op+1; }
+CACHED_OP(cached_clc) { FillFlags();SETFLAGBIT(CF,false);return op+1; }
+CACHED_OP(cached_stc) { FillFlags();SETFLAGBIT(CF,true);return op+1; }
+CACHED_OP(cached_cld) { SETFLAGBIT(DF,false);cpu.direction=1;return op+1; }
+CACHED_OP(cached_std) { SETFLAGBIT(DF,true);cpu.direction=-1;return op+1; }
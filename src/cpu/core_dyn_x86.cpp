@@ -27,6 +27,9 @@
 #include <string.h>
 #include <stddef.h>
 #include <stdlib.h>
+#include <algorithm>
+#include <string>
+#include <vector>
 
 #if defined (WIN32)
 #include <windows.h>
@@ -50,6 +53,8 @@
 #include "paging.h"
 #include "inout.h"
 #include "fpu.h"
+#include "snapshot.h"
+#include "cross.h"
 
 #define CACHE_MAXSIZE	(4096*3)
 #define CACHE_TOTAL		(1024*1024*8)
@@ -157,6 +162,7 @@ static struct {
 #define IllegalOption(msg) E_Exit("DYNX86: illegal option in " msg)
 
 #define dyn_return(a,b) gen_return(a)
+#include "code_page.h"
 #include "dyn_cache.h"
 typedef CacheBlockDynRec CacheBlock;
 typedef CodePageHandlerDynRec CodePageHandler;
@@ -251,6 +257,20 @@ static void dyn_restoreregister(DynReg * src_reg, DynReg * dst_reg) {
 
 #include "core_dyn_x86/decoder.h"
 
+#if defined(X86_DYNFPU_DH_ENABLED)
+/* The host fpu state is always saved back when leaving the core */
+static void dyn_dh_fpu_savestate(SnapshotWriter& writer) {
+	writer.WriteStruct(&dyn_dh_fpu.state,sizeof(dyn_dh_fpu.state));
+	writer.Write(dyn_dh_fpu.dh_fpu_enabled);
+}
+
+static bool dyn_dh_fpu_loadstate(SnapshotReader& reader,Bit16u /*version*/) {
+	dyn_dh_fpu.state_used=false;
+	return reader.ReadStruct(&dyn_dh_fpu.state,sizeof(dyn_dh_fpu.state)) &&
+		reader.Read(dyn_dh_fpu.dh_fpu_enabled);
+}
+#endif
+
 Bits CPU_Core_Dyn_X86_Run(void) {
 	// helper class to auto-save DH_FPU state on function exit
 	class auto_dh_fpu {
@@ -280,6 +300,10 @@ restart_core:
 	if (!chandler) {
 		return CPU_Core_Normal_Run();
 	}
+	/* Keep the pages in the order they were last run in */
+	if (chandler!=cache.pages.last_page) chandler->Touch();
+	/* First time in this page, translate what ran here in earlier sessions */
+	if (GCC_UNLIKELY(chandler->prewarm)) cache_prewarm(chandler,ip_point&~4095);
 	/* Find correct Dynamic Block to run */
 	CacheBlock * block=chandler->FindCacheBlock(ip_point&4095);
 	if (!block) {
@@ -355,7 +379,16 @@ run_block:
 			if (temp_handler->flags & (cpu.code.big ? PFLAG_HASCODE32:PFLAG_HASCODE16)) {
 				block=temp_handler->FindCacheBlock(temp_ip & 4095);
 				if (!block) goto restart_core;
-				cache.block.running->LinkTo(ret==BR_Link2,block);
+				switch (cache_profile_exit(cache.block.running,ret==BR_Link2)) {
+				case PROFILE_LINK:
+					cache.block.running->LinkTo(ret==BR_Link2,block);
+					break;
+				case PROFILE_COUNT:
+					break;
+				case PROFILE_RETRANSLATE:
+					/* The target may have been the block that was thrown away */
+					goto restart_core;
+				}
 				goto run_block;
 			}
 		}
@@ -447,6 +480,7 @@ void CPU_Core_Dyn_X86_Init(void) {
 	memset(&dyn_dh_fpu.state, 0, sizeof(dyn_dh_fpu.state));
 	dyn_dh_fpu.state.cw = 0x37F;
 	dyn_dh_fpu.state.tag = 0xFFFF;
+	SNAPSHOT_Register("DYNFPU",1,dyn_dh_fpu_savestate,dyn_dh_fpu_loadstate);
 #endif
 
 	return;
@@ -461,6 +495,18 @@ void CPU_Core_Dyn_X86_Cache_Close(void) {
 	cache_close();
 }
 
+void CPU_Core_Dyn_X86_Cache_Reset(void) {
+	cache_reset();
+}
+
+void CPU_Core_Dyn_X86_SetCacheSize(Bitu size) {
+	cache_setmaxsize(size);
+}
+
+void CPU_Core_Dyn_X86_SetHotBlockFile(const char * path) {
+	hot_blocks_file=path;
+}
+
 void CPU_Core_Dyn_X86_SetFPUMode(bool dh_fpu) {
 #if defined(X86_DYNFPU_DH_ENABLED)
 	dyn_dh_fpu.dh_fpu_enabled=dh_fpu;
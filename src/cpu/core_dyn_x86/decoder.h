@@ -86,24 +86,20 @@ static bool MakeCodePage(Bitu lin_addr,CodePageHandler * &cph) {
 		cph=0;		return false;
 	}
 	/* Find a free CodePage */
-	if (!cache.free_pages) {
-		if (cache.used_pages!=decode.page.code) cache.used_pages->ClearRelease();
+	if (!cache.pages.free_pages && !cache_addpages()) {
+		if (cache.pages.used_pages!=decode.page.code) cache.pages.used_pages->ClearRelease();
 		else {
-			if ((cache.used_pages->next) && (cache.used_pages->next!=decode.page.code))
-				cache.used_pages->next->ClearRelease();
+			if ((cache.pages.used_pages->next) && (cache.pages.used_pages->next!=decode.page.code))
+				cache.pages.used_pages->next->ClearRelease();
 			else {
 				LOG_MSG("DYNX86:Invalid cache links");
-				cache.used_pages->ClearRelease();
+				cache.pages.used_pages->ClearRelease();
 			}
 		}
 	}
-	CodePageHandler * cpagehandler=cache.free_pages;
-	cache.free_pages=cache.free_pages->next;
-	cpagehandler->prev=cache.last_page;
-	cpagehandler->next=0;
-	if (cache.last_page) cache.last_page->next=cpagehandler;
-	cache.last_page=cpagehandler;
-	if (!cache.used_pages) cache.used_pages=cpagehandler;
+	CodePageHandler * cpagehandler=cache.pages.free_pages;
+	cache.pages.free_pages=cache.pages.free_pages->next;
+	cpagehandler->Use();
 	cpagehandler->SetupAt(phys_page,handler);
 	MEM_SetPageHandler(phys_page,1,cpagehandler);
 	PAGING_UnlinkPages(lin_page,1);
@@ -257,6 +253,24 @@ static bool decode_fetchd_imm(Bitu & val) {
 	return false;
 }
 
+/* See if the block can go on at the target of a jump, see cache_can_follow */
+static bool decode_can_follow(Bits eip_change) {
+	return cache_can_follow(decode.page.index,decode.code-SegPhys(cs),decode.big_op,eip_change);
+}
+
+/* Continue the block at the target of a short forward jump in the same page
+ * instead of ending the block. The skipped bytes are masked in the write map
+ * so they don't count as code of this block */
+static bool decode_follow_jump(Bits eip_change) {
+	if (!decode_can_follow(eip_change)) return false;
+	for (;eip_change>0;eip_change--) {
+		decode_increase_wmapmask(1);
+		decode.code++;
+		decode.page.index++;
+	}
+	return true;
+}
+
 
 static void dyn_reduce_cycles(void) {
 	gen_protectflags();
@@ -306,7 +320,7 @@ static INLINE void dyn_set_eip_last(void) {
 }
 
 
-enum save_info_type {db_exception, cycle_check, normal, fpu_restore};
+enum save_info_type {db_exception, cycle_check, normal, fpu_restore, side_exit};
 
 
 static struct {
@@ -402,6 +416,20 @@ static void dyn_fill_blocks(void) {
 				dyn_save_critical_regs();
 				gen_return(BR_Cycles);
 				break;
+			case side_exit:
+				/* The rarely taken way of a conditional jump inside a superblock,
+				 * it gets linked to the next block through a block of its own */
+				{
+					CacheBlock * exit=cache_addsideexit(decode.block);
+					dyn_loadstate(&save_info[sct].state);
+					decode.cycles=save_info[sct].cycles;
+					dyn_reduce_cycles();
+					gen_dop_word_imm(DOP_ADD,cpu.code.big,DREG(EIP),save_info[sct].eip_change);
+					dyn_save_critical_regs();
+					gen_save_host_direct(&cache.block.running,(Bitu)exit);
+					gen_jmp_ptr(&exit->link[0].to,offsetof(CacheBlock,cache.start));
+				}
+				break;
 #ifdef X86_DYNFPU_DH_ENABLED
 			case fpu_restore:
 				dyn_loadstate(&save_info[sct].state);
@@ -1926,6 +1954,52 @@ static void dyn_branched_exit(BranchTypes btype,Bit32s eip_add) {
  	dyn_closeblock();
 }
 
+/* Jump relative to the end of the instruction, jumps that can be followed
+ * inside the block don't end it; returns true if the block has been closed */
+static bool dyn_jmp_near(Bits eip_change) {
+	if (decode_follow_jump(eip_change)) return false;
+	dyn_exit_link(eip_change);
+	return true;
+}
+
+/* Leave the block to eip_change when the condition is true, else go on */
+static void dyn_side_exit(BranchTypes btype,Bitu eip_change) {
+	gen_needflags();
+	gen_protectflags();
+	save_info[used_save_info].branch_pos=gen_create_branch_long(btype);
+	dyn_savestate(&save_info[used_save_info].state);
+	if (!decode.cycles) decode.cycles++;
+	save_info[used_save_info].cycles=decode.cycles;
+	save_info[used_save_info].eip_change=(Bit32u)eip_change;
+	if (!cpu.code.big) save_info[used_save_info].eip_change&=0xffff;
+	save_info[used_save_info].type=side_exit;
+	used_save_info++;
+}
+
+/* Conditional jump relative to the end of the instruction. It ends the block
+ * and gets profiled, unless one way has been seen to be taken nearly always.
+ * Then the block goes on that way and only the other one leaves the block;
+ * returns true if the block has been closed */
+static bool dyn_branch(BranchTypes btype,Bit32s eip_add) {
+	Bitu eip_base=decode.code-decode.code_start;
+	Bitu length=decode.code-decode.op_start;
+	/* Only jumps in the page of the block are profiled */
+	bool in_page=decode.active_block==decode.block && decode.page.index>=length && decode.big_op==cpu.code.big;
+	switch (cache_plan_branch(decode.block,in_page ? decode.page.code : NULL,decode.page.index-length,decode_can_follow(eip_add))) {
+	case PLAN_FALL_THROUGH:
+		dyn_side_exit(btype,eip_base+eip_add);
+		return false;
+	case PLAN_FOLLOW:
+		/* The inverse condition leaves the block */
+		dyn_side_exit((BranchTypes)(btype^1),eip_base);
+		decode_follow_jump(eip_add);
+		return false;
+	default:
+		dyn_branched_exit(btype,eip_add);
+		return true;
+	}
+}
+
 enum LoopTypes {
 	LOOP_NONE,LOOP_NE,LOOP_E,LOOP_JCXZ
 };
@@ -2178,7 +2252,7 @@ static CacheBlock * CreateCacheBlock(CodePageHandler * codepage,PhysPt start,Bit
 	decode.page.wmap=codepage->write_map;
 	decode.page.invmap=codepage->invalidation_map;
 	decode.page.first=start >> 12;
-	decode.active_block=decode.block=cache_openblock();
+	decode.active_block=decode.block=cache_openblock(codepage);
 	decode.block->page.start=decode.page.index;
 	codepage->AddCacheBlock(decode.block);
 
@@ -2249,9 +2323,9 @@ restart_prefix:
 			/* Short conditional jumps */
 			case 0x80:case 0x81:case 0x82:case 0x83:case 0x84:case 0x85:case 0x86:case 0x87:	
 			case 0x88:case 0x89:case 0x8a:case 0x8b:case 0x8c:case 0x8d:case 0x8e:case 0x8f:	
-				dyn_branched_exit((BranchTypes)(dual_code&0xf),
-					decode.big_op ? (Bit32s)decode_fetchd() : (Bit16s)decode_fetchw());	
-				goto finish_block;
+				if (dyn_branch((BranchTypes)(dual_code&0xf),
+					decode.big_op ? (Bit32s)decode_fetchd() : (Bit16s)decode_fetchw())) goto finish_block;
+				break;
 			/* PUSH/POP FS */
 			case 0xa0:dyn_push_seg(fs);break;
 			case 0xa1:dyn_pop_seg(fs);break;
@@ -2402,8 +2476,8 @@ restart_prefix:
 		/* Short conditional jumps */
 		case 0x70:case 0x71:case 0x72:case 0x73:case 0x74:case 0x75:case 0x76:case 0x77:	
 		case 0x78:case 0x79:case 0x7a:case 0x7b:case 0x7c:case 0x7d:case 0x7e:case 0x7f:	
-			dyn_branched_exit((BranchTypes)(opcode&0xf),(Bit8s)decode_fetchb());	
-			goto finish_block;
+			if (dyn_branch((BranchTypes)(opcode&0xf),(Bit8s)decode_fetchb())) goto finish_block;
+			break;
 		/* Group 1 */
 		case 0x80:dyn_grp1_eb_ib();break;
 		case 0x81:dyn_grp1_ev_ivx(false);break;
@@ -2707,13 +2781,13 @@ restart_prefix:
 			dyn_call_near_imm();
 			goto finish_block;
 		case 0xe9:		/* Jmp Ivx */
-			dyn_exit_link(decode.big_op ? (Bit32s)decode_fetchd() : (Bit16s)decode_fetchw());
-			goto finish_block;
+			if (dyn_jmp_near(decode.big_op ? (Bit32s)decode_fetchd() : (Bit16s)decode_fetchw())) goto finish_block;
+			break;
 		case 0xea:		/* JMP FAR Ip */
 			dyn_jmp_far_imm();
 			goto finish_block;
 			/* Jmp Ibx */
-		case 0xeb:dyn_exit_link((Bit8s)decode_fetchb());goto finish_block;
+		case 0xeb:if (dyn_jmp_near((Bit8s)decode_fetchb())) goto finish_block;break;
 		/* IN AL/AX,DX*/
 		case 0xec:
 			gen_call_function((void*)&dyn_io_readB,"%Dw",DREG(EDX));
@@ -27,6 +27,9 @@
 #include <string.h>
 #include <stddef.h>
 #include <stdlib.h>
+#include <algorithm>
+#include <string>
+#include <vector>
 
 #if defined (WIN32)
 #include <windows.h>
@@ -51,6 +54,7 @@
 #include "inout.h"
 #include "lazyflags.h"
 #include "pic.h"
+#include "cross.h"
 
 #define CACHE_MAXSIZE	(4096*2)
 #define CACHE_TOTAL		(1024*1024*8)
@@ -131,6 +135,7 @@ static struct {
 } core_dynrec;
 
 
+#include "code_page.h"
 #include "dyn_cache.h"
 
 #define X86			0x01
@@ -163,7 +168,16 @@ CacheBlockDynRec * LinkBlocks(BlockReturn ret) {
 		// see if the target is an already translated block
 		block=temp_handler->FindCacheBlock(temp_ip & 4095);
 		if (block) { // found it, link the current block to
-			cache.block.running->LinkTo(ret==BR_Link2,block);
+			switch (cache_profile_exit(cache.block.running,ret==BR_Link2)) {
+			case PROFILE_LINK:
+				cache.block.running->LinkTo(ret==BR_Link2,block);
+				break;
+			case PROFILE_COUNT:
+				break;
+			case PROFILE_RETRANSLATE:
+				// the target may have been the block that was thrown away
+				return NULL;
+			}
 		}
 	}
 	return block;
@@ -200,6 +214,12 @@ Bits CPU_Core_Dynrec_Run(void) {
 		// page doesn't contain code or is special
 		if (GCC_UNLIKELY(!chandler)) return CPU_Core_Normal_Run();
 
+		// keep the pages in the order they were last run in
+		if (chandler!=cache.pages.last_page) chandler->Touch();
+
+		// first time in this page, translate what ran here in earlier sessions
+		if (GCC_UNLIKELY(chandler->prewarm)) cache_prewarm(chandler,ip_point&~4095);
+
 		// find correct Dynamic Block to run
 		CacheBlockDynRec * block=chandler->FindCacheBlock(ip_point&4095);
 		if (!block) {
@@ -333,4 +353,16 @@ void CPU_Core_Dynrec_Cache_Close(void) {
 	cache_close();
 }
 
+void CPU_Core_Dynrec_Cache_Reset(void) {
+	cache_reset();
+}
+
+void CPU_Core_Dynrec_SetCacheSize(Bitu size) {
+	cache_setmaxsize(size);
+}
+
+void CPU_Core_Dynrec_SetHotBlockFile(const char * path) {
+	hot_blocks_file=path;
+}
+
 #endif
@@ -40,7 +40,7 @@ static CacheBlockDynRec * CreateCacheBlock(CodePageHandlerDynRec * codepage,Phys
 	decode.page.wmap=codepage->write_map;
 	decode.page.invmap=codepage->invalidation_map;
 	decode.page.first=start >> 12;
-	decode.active_block=decode.block=cache_openblock();
+	decode.active_block=decode.block=cache_openblock(codepage);
 	decode.block->page.start=(Bit16u)decode.page.index;
 	codepage->AddCacheBlock(decode.block);
 
@@ -194,9 +194,9 @@ restart_prefix:
 				// short conditional jumps
 				case 0x80:case 0x81:case 0x82:case 0x83:case 0x84:case 0x85:case 0x86:case 0x87:	
 				case 0x88:case 0x89:case 0x8a:case 0x8b:case 0x8c:case 0x8d:case 0x8e:case 0x8f:	
-					dyn_branched_exit((BranchTypes)(dual_code&0xf),
-						decode.big_op ? (Bit32s)decode_fetchd() : (Bit16s)decode_fetchw());
-					goto finish_block;
+					if (dyn_branch((BranchTypes)(dual_code&0xf),
+						decode.big_op ? (Bit32s)decode_fetchd() : (Bit16s)decode_fetchw())) goto finish_block;
+					break;
 
 				// conditional byte set instructions
 /*				case 0x90:case 0x91:case 0x92:case 0x93:case 0x94:case 0x95:case 0x96:case 0x97:	
@@ -297,8 +297,8 @@ restart_prefix:
 		// short conditional jumps
 		case 0x70:case 0x71:case 0x72:case 0x73:case 0x74:case 0x75:case 0x76:case 0x77:	
 		case 0x78:case 0x79:case 0x7a:case 0x7b:case 0x7c:case 0x7d:case 0x7e:case 0x7f:	
-			dyn_branched_exit((BranchTypes)(opcode&0xf),(Bit8s)decode_fetchb());	
-			goto finish_block;
+			if (dyn_branch((BranchTypes)(opcode&0xf),(Bit8s)decode_fetchb())) goto finish_block;
+			break;
 
 		// 'op []/reg8,imm8'
 		case 0x80:
@@ -519,16 +519,16 @@ restart_prefix:
 			goto finish_block;
 		// 'jmp near imm16/32'
 		case 0xe9:
-			dyn_exit_link(decode.big_op ? (Bit32s)decode_fetchd() : (Bit16s)decode_fetchw());
-			goto finish_block;
+			if (dyn_jmp_near(decode.big_op ? (Bit32s)decode_fetchd() : (Bit16s)decode_fetchw())) goto finish_block;
+			break;
 		// 'jmp far'
 		case 0xea:
 			dyn_jmp_far_imm();
 			goto finish_block;
 		// 'jmp short imm8'
 		case 0xeb:
-			dyn_exit_link((Bit8s)decode_fetchb());
-			goto finish_block;
+			if (dyn_jmp_near((Bit8s)decode_fetchb())) goto finish_block;
+			break;
 
 
 		// repeat prefixes
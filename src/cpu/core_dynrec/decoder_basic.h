@@ -171,27 +171,23 @@ static bool MakeCodePage(Bitu lin_addr,CodePageHandlerDynRec * &cph) {
 		return false;
 	}
 	// find a free CodePage
-	if (!cache.free_pages) {
-		if (cache.used_pages!=decode.page.code) cache.used_pages->ClearRelease();
+	if (!cache.pages.free_pages && !cache_addpages()) {
+		if (cache.pages.used_pages!=decode.page.code) cache.pages.used_pages->ClearRelease();
 		else {
 			// try another page to avoid clearing our source-crosspage
-			if ((cache.used_pages->next) && (cache.used_pages->next!=decode.page.code))
-				cache.used_pages->next->ClearRelease();
+			if ((cache.pages.used_pages->next) && (cache.pages.used_pages->next!=decode.page.code))
+				cache.pages.used_pages->next->ClearRelease();
 			else {
 				LOG_MSG("DYNREC:Invalid cache links");
-				cache.used_pages->ClearRelease();
+				cache.pages.used_pages->ClearRelease();
 			}
 		}
 	}
-	CodePageHandlerDynRec * cpagehandler=cache.free_pages;
-	cache.free_pages=cache.free_pages->next;
+	CodePageHandlerDynRec * cpagehandler=cache.pages.free_pages;
+	cache.pages.free_pages=cache.pages.free_pages->next;
 
-	// adjust previous and next page pointer
-	cpagehandler->prev=cache.last_page;
-	cpagehandler->next=0;
-	if (cache.last_page) cache.last_page->next=cpagehandler;
-	cache.last_page=cpagehandler;
-	if (!cache.used_pages) cache.used_pages=cpagehandler;
+	// add the page to the end of the list of used pages
+	cpagehandler->Use();
 
 	// initialize the code page handler and add the handler to the memory page
 	cpagehandler->SetupAt(phys_page,handler);
@@ -378,6 +374,25 @@ static bool decode_fetchd_imm(Bitu & val) {
 	return false;
 }
 
+// see if the block can go on at the target of a jump, see cache_can_follow
+static bool decode_can_follow(Bits eip_change) {
+	return cache_can_follow(decode.page.index,decode.code-SegPhys(cs),decode.big_op,eip_change);
+}
+
+// continue the block at the target of a short forward jump in the same page
+// instead of ending the block, makes superblocks out of code that jumps over
+// an else part. The skipped bytes are masked in the write map so they don't
+// count as code of this block
+static bool decode_follow_jump(Bits eip_change) {
+	if (!decode_can_follow(eip_change)) return false;
+	for (;eip_change>0;eip_change--) {
+		decode_increase_wmapmask(1);
+		decode.code++;
+		decode.page.index++;
+	}
+	return true;
+}
+
 
 // modrm decoding helper
 static void INLINE dyn_get_modrm(void) {
@@ -606,7 +621,7 @@ static INLINE const Bit8u* gen_call_function_mm(void * func,Bitu op1,Bitu op2) {
 
 
 
-enum save_info_type {db_exception, cycle_check, string_break};
+enum save_info_type {db_exception, cycle_check, string_break, side_exit};
 
 
 // function that is called on exceptions
@@ -666,6 +681,18 @@ static void dyn_fill_blocks(void) {
 				gen_add_direct_word(&reg_eip,save_info_dynrec[sct].eip_change,decode.big_op);
 				dyn_return(BR_Cycles);
 				break;
+			case side_exit:
+				// the rarely taken way of a conditional jump inside a superblock,
+				// it gets linked to the next block through a block of its own
+				{
+					CacheBlockDynRec * exit=cache_addsideexit(decode.block);
+					decode.cycles=save_info_dynrec[sct].cycles;
+					dyn_reduce_cycles();
+					gen_add_direct_word(&reg_eip,save_info_dynrec[sct].eip_change,cpu.code.big);
+					gen_mov_direct_ptr(&cache.block.running,(Bitu)exit);
+					gen_jmp_ptr(&exit->link[0].to,offsetof(CacheBlockDynRec,cache.start));
+				}
+				break;
 		}
 	}
 	used_save_info_dynrec=0;
@@ -1246,6 +1273,13 @@ static void InvalidateFlagsPartially(void* current_simple_function,const Bit8u*
 #endif
 }
 
+// shifts by a count that is known to be nonzero set all condition flags,
+// a variable count can turn out to be zero and leave the flags unchanged
+static void InvalidateFlagsShift(void* current_simple_function,Bitu flags_type,bool known_count) {
+	if (known_count) InvalidateFlags(current_simple_function,flags_type);
+	else InvalidateFlagsPartially(current_simple_function,flags_type);
+}
+
 // the current function needs the condition flags thus reset the queue
 static void AcquireFlags(Bitu flags_mask) {
 #ifdef DRC_FLAGS_INVALIDATION
@@ -633,20 +633,20 @@ static void dyn_grp2_eb(grp2_types type) {
 	switch (type) {
 	case grp2_1:
 		gen_mov_byte_to_reg_low_imm_canuseword(FC_OP2,1);
-		dyn_shift_byte_gencall((ShiftOps)decode.modrm.reg);
+		dyn_shift_byte_gencall((ShiftOps)decode.modrm.reg,true);
 		break;
 	case grp2_imm: {
 		Bit8u imm=decode_fetchb();
 		if (imm) {
 			gen_mov_byte_to_reg_low_imm_canuseword(FC_OP2,imm&0x1f);
-			dyn_shift_byte_gencall((ShiftOps)decode.modrm.reg);
+			dyn_shift_byte_gencall((ShiftOps)decode.modrm.reg,(imm&0x1f)!=0);
 		} else return;
 		}
 		break;
 	case grp2_cl:
 		MOV_REG_BYTE_TO_HOST_REG_LOW_CANUSEWORD(FC_OP2,DRC_REG_ECX,0);
 		gen_and_imm(FC_OP2,0x1f);
-		dyn_shift_byte_gencall((ShiftOps)decode.modrm.reg);
+		dyn_shift_byte_gencall((ShiftOps)decode.modrm.reg,false);
 		break;
 	}
 	if (decode.modrm.mod<3) {
@@ -669,27 +669,27 @@ static void dyn_grp2_ev(grp2_types type) {
 	switch (type) {
 	case grp2_1:
 		gen_mov_byte_to_reg_low_imm_canuseword(FC_OP2,1);
-		dyn_shift_word_gencall((ShiftOps)decode.modrm.reg,decode.big_op);
+		dyn_shift_word_gencall((ShiftOps)decode.modrm.reg,decode.big_op,true);
 		break;
 	case grp2_imm: {
 		Bitu val;
 		if (decode_fetchb_imm(val)) {
 			gen_mov_byte_to_reg_low_canuseword(FC_OP2,(void*)val);
 			gen_and_imm(FC_OP2,0x1f);
-			dyn_shift_word_gencall((ShiftOps)decode.modrm.reg,decode.big_op);
+			dyn_shift_word_gencall((ShiftOps)decode.modrm.reg,decode.big_op,false);
 			break;
 		}
 		Bit8u imm=(Bit8u)val;
 		if (imm) {
 			gen_mov_byte_to_reg_low_imm_canuseword(FC_OP2,imm&0x1f);
-			dyn_shift_word_gencall((ShiftOps)decode.modrm.reg,decode.big_op);
+			dyn_shift_word_gencall((ShiftOps)decode.modrm.reg,decode.big_op,(imm&0x1f)!=0);
 		} else return;
 		}
 		break;
 	case grp2_cl:
 		MOV_REG_BYTE_TO_HOST_REG_LOW_CANUSEWORD(FC_OP2,DRC_REG_ECX,0);
 		gen_and_imm(FC_OP2,0x1f);
-		dyn_shift_word_gencall((ShiftOps)decode.modrm.reg,decode.big_op);
+		dyn_shift_word_gencall((ShiftOps)decode.modrm.reg,decode.big_op,false);
 		break;
 	}
 	if (decode.modrm.mod<3) {
@@ -1089,9 +1089,10 @@ static void dyn_cwd(void) {
 }
 
 static void dyn_sahf(void) {
+	// the overflow flag is kept, so the flags of earlier instructions are needed
+	AcquireFlags(FLAG_OF);
 	MOV_REG_WORD16_TO_HOST_REG(FC_OP1,DRC_REG_EAX);
 	gen_call_function_raw((void *)&dynrec_sahf);
-	InvalidateFlags();
 }
 
 
@@ -1102,6 +1103,14 @@ static void dyn_exit_link(Bits eip_change) {
 	dyn_closeblock();
 }
 
+// jump relative to the end of the instruction, jumps that can be followed
+// inside the block don't end it; returns true if the block has been closed
+static bool dyn_jmp_near(Bits eip_change) {
+	if (decode_follow_jump(eip_change)) return false;
+	dyn_exit_link(eip_change);
+	return true;
+}
+
 
 static void dyn_branched_exit(BranchTypes btype,Bit32s eip_add) {
 	Bitu eip_base=decode.code-decode.code_start;
@@ -1121,6 +1130,43 @@ static void dyn_branched_exit(BranchTypes btype,Bit32s eip_add) {
  	dyn_closeblock();
 }
 
+// leave the block to eip_change when the condition is true, else go on
+static void dyn_side_exit(BranchTypes btype,Bitu eip_change) {
+	dyn_branchflag_to_reg(btype);
+	// the flags are read here, the instructions before have to produce them
+	AcquireFlags(FMASK_TEST);
+	save_info_dynrec[used_save_info_dynrec].branch_pos=gen_create_branch_long_nonzero(FC_RETOP,true);
+	if (!decode.cycles) decode.cycles++;
+	save_info_dynrec[used_save_info_dynrec].cycles=decode.cycles;
+	save_info_dynrec[used_save_info_dynrec].eip_change=(Bit32u)eip_change;
+	save_info_dynrec[used_save_info_dynrec].type=side_exit;
+	used_save_info_dynrec++;
+}
+
+// conditional jump relative to the end of the instruction. It ends the block
+// and gets profiled, unless one way has been seen to be taken nearly always.
+// Then the block goes on that way and only the other one leaves the block;
+// returns true if the block has been closed
+static bool dyn_branch(BranchTypes btype,Bit32s eip_add) {
+	Bitu eip_base=decode.code-decode.code_start;
+	Bitu length=decode.code-decode.op_start;
+	// only jumps in the page of the block are profiled
+	bool in_page=decode.active_block==decode.block && decode.page.index>=length && decode.big_op==cpu.code.big;
+	switch (cache_plan_branch(decode.block,in_page ? decode.page.code : NULL,decode.page.index-length,decode_can_follow(eip_add))) {
+	case PLAN_FALL_THROUGH:
+		dyn_side_exit(btype,eip_base+eip_add);
+		return false;
+	case PLAN_FOLLOW:
+		// the inverse condition leaves the block
+		dyn_side_exit((BranchTypes)(btype^1),eip_base);
+		decode_follow_jump(eip_add);
+		return false;
+	default:
+		dyn_branched_exit(btype,eip_add);
+		return true;
+	}
+}
+
 /*
 static void dyn_set_byte_on_condition(BranchTypes btype) {
 	dyn_get_modrm();
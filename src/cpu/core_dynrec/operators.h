@@ -1111,7 +1111,7 @@ static Bit32u DRC_CALL_CONV dynrec_sar_dword_simple(Bit32u op1,Bit8u op2) {
 	else return op1 >> op2;
 }
 
-static void dyn_shift_byte_gencall(ShiftOps op) {
+static void dyn_shift_byte_gencall(ShiftOps op,bool known_count) {
 	switch (op) {
 		case SHIFT_ROL:
 			InvalidateFlagsPartially((void*)&dynrec_rol_byte_simple,t_ROLb);
@@ -1131,22 +1131,22 @@ static void dyn_shift_byte_gencall(ShiftOps op) {
 			break;
 		case SHIFT_SHL:
 		case SHIFT_SAL:
-			InvalidateFlagsPartially((void*)&dynrec_shl_byte_simple,t_SHLb);
+			InvalidateFlagsShift((void*)&dynrec_shl_byte_simple,t_SHLb,known_count);
 			gen_call_function_raw((void*)&dynrec_shl_byte);
 			break;
 		case SHIFT_SHR:
-			InvalidateFlagsPartially((void*)&dynrec_shr_byte_simple,t_SHRb);
+			InvalidateFlagsShift((void*)&dynrec_shr_byte_simple,t_SHRb,known_count);
 			gen_call_function_raw((void*)&dynrec_shr_byte);
 			break;
 		case SHIFT_SAR:
-			InvalidateFlagsPartially((void*)&dynrec_sar_byte_simple,t_SARb);
+			InvalidateFlagsShift((void*)&dynrec_sar_byte_simple,t_SARb,known_count);
 			gen_call_function_raw((void*)&dynrec_sar_byte);
 			break;
 		default: IllegalOptionDynrec("dyn_shift_byte_gencall");
 	}
 }
 
-static void dyn_shift_word_gencall(ShiftOps op,bool dword) {
+static void dyn_shift_word_gencall(ShiftOps op,bool dword,bool known_count) {
 	if (dword) {
 		switch (op) {
 			case SHIFT_ROL:
@@ -1167,15 +1167,15 @@ static void dyn_shift_word_gencall(ShiftOps op,bool dword) {
 				break;
 			case SHIFT_SHL:
 			case SHIFT_SAL:
-				InvalidateFlagsPartially((void*)&dynrec_shl_dword_simple,t_SHLd);
+				InvalidateFlagsShift((void*)&dynrec_shl_dword_simple,t_SHLd,known_count);
 				gen_call_function_raw((void*)&dynrec_shl_dword);
 				break;
 			case SHIFT_SHR:
-				InvalidateFlagsPartially((void*)&dynrec_shr_dword_simple,t_SHRd);
+				InvalidateFlagsShift((void*)&dynrec_shr_dword_simple,t_SHRd,known_count);
 				gen_call_function_raw((void*)&dynrec_shr_dword);
 				break;
 			case SHIFT_SAR:
-				InvalidateFlagsPartially((void*)&dynrec_sar_dword_simple,t_SARd);
+				InvalidateFlagsShift((void*)&dynrec_sar_dword_simple,t_SARd,known_count);
 				gen_call_function_raw((void*)&dynrec_sar_dword);
 				break;
 			default: IllegalOptionDynrec("dyn_shift_dword_gencall");
@@ -1200,15 +1200,15 @@ static void dyn_shift_word_gencall(ShiftOps op,bool dword) {
 				break;
 			case SHIFT_SHL:
 			case SHIFT_SAL:
-				InvalidateFlagsPartially((void*)&dynrec_shl_word_simple,t_SHLw);
+				InvalidateFlagsShift((void*)&dynrec_shl_word_simple,t_SHLw,known_count);
 				gen_call_function_raw((void*)&dynrec_shl_word);
 				break;
 			case SHIFT_SHR:
-				InvalidateFlagsPartially((void*)&dynrec_shr_word_simple,t_SHRw);
+				InvalidateFlagsShift((void*)&dynrec_shr_word_simple,t_SHRw,known_count);
 				gen_call_function_raw((void*)&dynrec_shr_word);
 				break;
 			case SHIFT_SAR:
-				InvalidateFlagsPartially((void*)&dynrec_sar_word_simple,t_SARw);
+				InvalidateFlagsShift((void*)&dynrec_sar_word_simple,t_SARw,known_count);
 				gen_call_function_raw((void*)&dynrec_sar_word);
 				break;
 			default: IllegalOptionDynrec("dyn_shift_word_gencall");
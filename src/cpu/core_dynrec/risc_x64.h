@@ -614,6 +614,32 @@ static void gen_return_function(void) {
 }
 
 #ifdef DRC_FLAGS_INVALIDATION
+#ifdef DRC_FLAGS_INVALIDATION_DCODE
+// modrm byte of 'op eax,cl' for the shift and rotate flag types
+static Bit8u gen_shift_modrm(Bitu flags_type) {
+	switch (flags_type) {
+		case t_ROLb:
+		case t_ROLw:
+		case t_ROLd:
+			return 0xc0;
+		case t_RORb:
+		case t_RORw:
+		case t_RORd:
+			return 0xc8;
+		case t_SHLb:
+		case t_SHLw:
+		case t_SHLd:
+			return 0xe0;
+		case t_SHRb:
+		case t_SHRw:
+		case t_SHRd:
+			return 0xe8;
+		default:
+			return 0xf8;	// sar
+	}
+}
+#endif
+
 // called when a call to a function can be replaced by a
 // call to a simpler function
 // check gen_call_function_raw and gen_call_function_setup
@@ -686,6 +712,39 @@ static void gen_fill_function_ptr(const Bit8u * pos,void* fct_ptr,Bitu flags_typ
 			cache_addd(0xd8f7c089+(FC_OP1<<11),pos);
 			cache_addw(0x06eb,pos+4);       // skip
 			return;
+		// the shift count has to be in cl, which the call would have clobbered anyways;
+		// byte and word sized operations keep the upper bits out of the result
+		case t_ROLb:
+		case t_RORb:
+		case t_SHLb:
+		case t_SHRb:
+		case t_SARb:
+			// mov eax,FC_OP1; mov ecx,FC_OP2; op al,cl
+			cache_addd(0xc189c089+(FC_OP1<<11)+(FC_OP2<<27),pos);
+			cache_addw(0xd2+(gen_shift_modrm(flags_type)<<8),pos+4);
+			cache_addw(0x04eb,pos+6);       // skip
+			return;
+		case t_ROLw:
+		case t_RORw:
+		case t_SHLw:
+		case t_SHRw:
+		case t_SARw:
+			// mov eax,FC_OP1; mov ecx,FC_OP2; op ax,cl
+			cache_addd(0xc189c089+(FC_OP1<<11)+(FC_OP2<<27),pos);
+			cache_addb(0x66,pos+4);
+			cache_addw(0xd3+(gen_shift_modrm(flags_type)<<8),pos+5);
+			cache_addw(0x03eb,pos+7);       // skip
+			return;
+		case t_ROLd:
+		case t_RORd:
+		case t_SHLd:
+		case t_SHRd:
+		case t_SARd:
+			// mov eax,FC_OP1; mov ecx,FC_OP2; op eax,cl
+			cache_addd(0xc189c089+(FC_OP1<<11)+(FC_OP2<<27),pos);
+			cache_addw(0xd3+(gen_shift_modrm(flags_type)<<8),pos+4);
+			cache_addw(0x04eb,pos+6);       // skip
+			return;
 	}
 #endif
 	cache_addq((Bit64u)fct_ptr,pos+2);      // fill function pointer
@@ -29,6 +29,7 @@
 #include "programs.h"
 #include "paging.h"
 #include "lazyflags.h"
+#include "snapshot.h"
 #include "support.h"
 
 #ifdef __LIBRETRO__
@@ -77,15 +78,25 @@ Bitu CPU_PrefetchQueueSize=0;
 void CPU_Core_Full_Init(void);
 void CPU_Core_Normal_Init(void);
 void CPU_Core_Simple_Init(void);
+void CPU_Core_Cached_Init(void);
+void CPU_Core_Cached_Cache_Init(bool enable_cache);
+void CPU_Core_Cached_Cache_Close(void);
+void CPU_Core_Cached_Cache_Reset(void);
 #if (C_DYNAMIC_X86)
 void CPU_Core_Dyn_X86_Init(void);
 void CPU_Core_Dyn_X86_Cache_Init(bool enable_cache);
 void CPU_Core_Dyn_X86_Cache_Close(void);
+void CPU_Core_Dyn_X86_Cache_Reset(void);
 void CPU_Core_Dyn_X86_SetFPUMode(bool dh_fpu);
+void CPU_Core_Dyn_X86_SetHotBlockFile(const char * path);
+void CPU_Core_Dyn_X86_SetCacheSize(Bitu size);
 #elif (C_DYNREC)
 void CPU_Core_Dynrec_Init(void);
 void CPU_Core_Dynrec_Cache_Init(bool enable_cache);
 void CPU_Core_Dynrec_Cache_Close(void);
+void CPU_Core_Dynrec_Cache_Reset(void);
+void CPU_Core_Dynrec_SetHotBlockFile(const char * path);
+void CPU_Core_Dynrec_SetCacheSize(Bitu size);
 #endif
 
 /* In debug mode exceptions are tested and dosbox exits when 
@@ -1600,6 +1611,10 @@ void CPU_SET_CRX(Bitu cr,Bitu value) {
 					CPU_Core_Dynrec_Cache_Init(true);
 					cpudecoder=&CPU_Core_Dynrec_Run;
 				}
+#else
+				if (CPU_AutoDetermineMode&CPU_AUTODETERMINE_CORE) {
+					cpudecoder=&CPU_Core_Cached_Run;
+				}
 #endif
 				CPU_AutoDetermineMode<<=CPU_AUTODETERMINE_SHIFT;
 			} else {
@@ -2193,11 +2208,79 @@ void CPU_Reset_AutoAdjust(void) {
 	ticksScheduled = 0;
 }
 
+void CPU_SetHotBlockFile(const char * path) {
+#if (C_DYNAMIC_X86)
+	CPU_Core_Dyn_X86_SetHotBlockFile(path);
+#elif (C_DYNREC)
+	CPU_Core_Dynrec_SetHotBlockFile(path);
+#endif
+}
+
+static void CPU_SaveState(SnapshotWriter& writer) {
+	writer.WriteStruct(&cpu_regs,sizeof(cpu_regs));
+	writer.WriteStruct(&Segs,sizeof(Segs));
+	writer.WriteStruct(&cpu,sizeof(cpu));
+	writer.WriteFunc(cpu.hlt.old_decoder);
+	writer.WriteStruct(&cpu_tss,sizeof(cpu_tss));
+	writer.WriteStruct(&lflags,sizeof(lflags));
+	writer.WriteFunc(cpudecoder);
+	writer.Write(CPU_Cycles);
+	writer.Write(CPU_CycleLeft);
+	writer.Write(CPU_CycleMax);
+	writer.Write(CPU_OldCycleMax);
+	writer.Write(CPU_CyclePercUsed);
+	writer.Write(CPU_CycleLimit);
+	writer.Write(CPU_IODelayRemoved);
+	writer.Write(CPU_CycleAutoAdjust);
+	writer.Write(CPU_SkipCycleAutoAdjust);
+	writer.Write((Bit32u)CPU_AutoDetermineMode);
+	writer.Write(lastint);
+}
+
+static bool CPU_LoadState(SnapshotReader& reader,Bit16u /*version*/) {
+	CPU_Decoder * old_decoder;
+	Bit32u autodetermine;
+	if (!reader.ReadStruct(&cpu_regs,sizeof(cpu_regs)) ||
+	    !reader.ReadStruct(&Segs,sizeof(Segs)) ||
+	    !reader.ReadStruct(&cpu,sizeof(cpu)) ||
+	    !reader.ReadFunc(old_decoder) ||
+	    !reader.ReadStruct(&cpu_tss,sizeof(cpu_tss)) ||
+	    !reader.ReadStruct(&lflags,sizeof(lflags)) ||
+	    !reader.ReadFunc(cpudecoder)) return false;
+	cpu.hlt.old_decoder=old_decoder;
+	reader.Read(CPU_Cycles);
+	reader.Read(CPU_CycleLeft);
+	reader.Read(CPU_CycleMax);
+	reader.Read(CPU_OldCycleMax);
+	reader.Read(CPU_CyclePercUsed);
+	reader.Read(CPU_CycleLimit);
+	reader.Read(CPU_IODelayRemoved);
+	reader.Read(CPU_CycleAutoAdjust);
+	reader.Read(CPU_SkipCycleAutoAdjust);
+	reader.Read(autodetermine);
+	CPU_AutoDetermineMode=autodetermine;
+	reader.Read(lastint);
+
+	/* Guest memory has been replaced, none of the translated code is valid anymore */
+#if (C_DYNAMIC_X86)
+	if (cpudecoder==&CPU_Core_Dyn_X86_Run || cpu.hlt.old_decoder==&CPU_Core_Dyn_X86_Run)
+		CPU_Core_Dyn_X86_Cache_Init(true);
+	CPU_Core_Dyn_X86_Cache_Reset();
+#elif (C_DYNREC)
+	if (cpudecoder==&CPU_Core_Dynrec_Run || cpu.hlt.old_decoder==&CPU_Core_Dynrec_Run)
+		CPU_Core_Dynrec_Cache_Init(true);
+	CPU_Core_Dynrec_Cache_Reset();
+#endif
+	CPU_Core_Cached_Cache_Reset();
+	return !reader.Failed();
+}
+
 class CPU: public Module_base {
 private:
 	static bool inited;
 public:
 	CPU(Section* configuration):Module_base(configuration) {
+		SNAPSHOT_Register("CPU",1,CPU_SaveState,CPU_LoadState);
 		if(inited) {
 			Change_Config(configuration);
 			return;
@@ -2246,6 +2329,7 @@ public:
 		CPU_Core_Normal_Init();
 		CPU_Core_Simple_Init();
 		CPU_Core_Full_Init();
+		CPU_Core_Cached_Init();
 #if (C_DYNAMIC_X86)
 		CPU_Core_Dyn_X86_Init();
 #elif (C_DYNREC)
@@ -2349,6 +2433,8 @@ public:
 			cpudecoder=&CPU_Core_Simple_Run;
 		} else if (core == "full") {
 			cpudecoder=&CPU_Core_Full_Run;
+		} else if (core == "cached") {
+			cpudecoder=&CPU_Core_Cached_Run;
 		} else if (core == "auto") {
 			cpudecoder=&CPU_Core_Normal_Run;
 #if (C_DYNAMIC_X86)
@@ -2366,15 +2452,27 @@ public:
 		else if (core == "dynamic") {
 			cpudecoder=&CPU_Core_Dynrec_Run;
 #else
-
+			/* Without a dynamic core the cached core runs protected mode code */
+			CPU_AutoDetermineMode|=CPU_AUTODETERMINE_CORE;
 #endif
 		}
 
 #if (C_DYNAMIC_X86)
+		CPU_Core_Dyn_X86_SetCacheSize((Bitu)section->Get_int("dynamic_cache")*1024*1024);
 		CPU_Core_Dyn_X86_Cache_Init((core == "dynamic") || (core == "dynamic_nodhfpu"));
 #elif (C_DYNREC)
+		CPU_Core_Dynrec_SetCacheSize((Bitu)section->Get_int("dynamic_cache")*1024*1024);
 		CPU_Core_Dynrec_Cache_Init( core == "dynamic" );
 #endif
+		CPU_Core_Cached_Cache_Init( core == "cached" );
+		/* The cores can't share the pages with code, the one not in use lets go of them */
+		if (core == "cached") {
+#if (C_DYNAMIC_X86)
+			CPU_Core_Dyn_X86_Cache_Reset();
+#elif (C_DYNREC)
+			CPU_Core_Dynrec_Cache_Reset();
+#endif
+		}
 
 		CPU_ArchitectureType = CPU_ARCHTYPE_MIXED;
 		std::string cputype(section->Get_string("cputype"));
@@ -2426,7 +2524,9 @@ public:
 		else GFX_SetTitle(CPU_CycleMax,-1,false);
 		return true;
 	}
-	~CPU(){ /* empty */};
+	~CPU(){
+		SNAPSHOT_Unregister("CPU");
+	};
 };
 	
 static CPU * test;
@@ -2437,6 +2537,7 @@ void CPU_ShutDown(Section* sec) {
 #elif (C_DYNREC)
 	CPU_Core_Dynrec_Cache_Close();
 #endif
+	CPU_Core_Cached_Cache_Close();
 	delete test;
 }
 
@@ -19,10 +19,25 @@
 
 class CodePageHandlerDynRec;	// forward
 
+// what a conditional jump has been seen to do, kept per byte of a code page
+enum BranchWay {
+	BRANCH_UNKNOWN=0,	// not profiled yet
+	BRANCH_NOT_TAKEN,	// nearly always falls through
+	BRANCH_TAKEN,		// nearly always jumps
+	BRANCH_MIXED		// goes both ways, stays a block exit
+};
+
+// the exits of a block that ends in an unprofiled conditional jump are only
+// linked after the block has been left this many times
+#define DYN_PROFILE_EXITS	64
+#define DYN_PROFILE_NONE	0xffff
+
 // basic cache block representation
 class CacheBlockDynRec {
 public:
 	void Clear(void);
+	// remove the link of this block from the from-list of the block it points to
+	void Unlink(Bitu index);
 	// link this cache block to another block, index specifies the code
 	// path (always zero for unconditional links, 0/1 for conditional ones
 	void LinkTo(Bitu index,CacheBlockDynRec * toblock) {
@@ -54,6 +69,12 @@ public:
 		CacheBlockDynRec * next;
 		CacheBlockDynRec * from;	// the from-block can transfer control to this block
 	} link[2];	// maximum two links (conditional jumps)
+	struct {
+		Bit16u branch;			// where in the page is the conditional jump that ends the block
+		Bit16u count[2];		// how often the block was left through each link
+		bool follow;			// the jump target can become part of the block
+	} profile;
+	CacheBlockDynRec * side_exits;	// blocks that hold the links of the side exits
 	CacheBlockDynRec * crossblock;
 };
 
@@ -65,9 +86,7 @@ static struct {
 		CacheBlockDynRec * running;		// the last block that was entered for execution
 	} block;
 	const Bit8u * pos;		// position in the cache block
-	CodePageHandlerDynRec * free_pages;		// pointer to the free list
-	CodePageHandlerDynRec * used_pages;		// pointer to the list of used pages
-	CodePageHandlerDynRec * last_page;		// the last used page
+	CodePageList<CodePageHandlerDynRec> pages;	// free and used code pages
 } cache;
 
 
@@ -79,36 +98,65 @@ static Bit8u * cache_code_link_blocks=NULL;
 static CacheBlockDynRec * cache_blocks=NULL;
 static CacheBlockDynRec link_blocks[2];		// default linking (specially marked)
 
+// the code cache starts out at CACHE_TOTAL bytes and grows in steps of
+// CACHE_TOTAL bytes up to cache_code_max bytes before code is thrown away
+static Bitu cache_code_size=CACHE_TOTAL;
+static Bitu cache_code_max=CACHE_TOTAL;
+static Bitu cache_pages=0;		// number of code page handlers that exist
+static bool cache_code_reserved=false;	// only committed as far as it is used
+
+
+// a translated block that is remembered in between sessions, identified
+// by where it is in physical memory and the code it was translated from
+struct HotBlockDynRec {
+	Bit32u phys_page;
+	Bit16u start,end;
+	Bit32u hash;
+	Bit8u big;
+	bool operator<(const HotBlockDynRec & other) const {
+		return phys_page<other.phys_page;
+	}
+};
+
+#define HOTBLOCKS_MAX	(64*1024)
+
+static std::vector<HotBlockDynRec> hot_blocks;	// sorted by physical page
+static std::string hot_blocks_file;
+
+static Bit32u cache_hashcode(const Bit8u * mem,Bitu start,Bitu end) {
+	Bit32u hash=2166136261u;
+	for (Bitu i=start;i<=end;i++) hash=(hash^mem[i])*16777619u;
+	return hash;
+}
+
 
 // the CodePageHandlerDynRec class provides access to the contained
 // cache blocks and intercepts writes to the code for special treatment
-class CodePageHandlerDynRec : public PageHandler {
+class CodePageHandlerDynRec : public CodePageHandlerBase<CodePageHandlerDynRec> {
 public:
 	CodePageHandlerDynRec() {
-		invalidation_map=NULL;
+		branch_map=NULL;
+		branch_count=0;
+		branch_size=0;
+		prewarm=false;
 	}
 
-	void SetupAt(Bitu _phys_page,PageHandler * _old_pagehandler) {
-		// initialize this codepage handler
-		phys_page=_phys_page;
-		// save the old pagehandler to provide direct read access to the memory,
-		// and to be able to restore it later on
-		old_pagehandler=_old_pagehandler;
-
-		// adjust flags
-		flags=old_pagehandler->flags|(cpu.code.big ? PFLAG_HASCODE32:PFLAG_HASCODE16);
-		flags&=~PFLAG_WRITEABLE;
+	static CodePageList<CodePageHandlerDynRec> & Pages(void) {
+		return cache.pages;
+	}
 
-		active_blocks=0;
-		active_count=16;
+	void SetupAt(Bitu _phys_page,PageHandler * _old_pagehandler) {
+		SetupPage(_phys_page,_old_pagehandler,cpu.code.big ? PFLAG_HASCODE32:PFLAG_HASCODE16);
+		prewarm=!hot_blocks.empty();
 
-		// initialize the maps with zero (no cache blocks as well as code present)
+		// initialize the hash map with zero (no cache blocks present)
 		memset(&hash_map,0,sizeof(hash_map));
-		memset(&write_map,0,sizeof(write_map));
-		if (invalidation_map!=NULL) {
-			free(invalidation_map);
-			invalidation_map=NULL;
+		if (branch_map!=NULL) {
+			free(branch_map);
+			branch_map=NULL;
 		}
+		branch_count=0;
+		branch_size=0;
 	}
 
 	// clear out blocks that contain code which has been modified
@@ -139,80 +187,6 @@ public:
 		return is_current_block;
 	}
 
-	// the following functions will clean all cache blocks that are invalid now due to the write
-	void writeb(PhysPt addr,Bitu val){
-		if (GCC_UNLIKELY(old_pagehandler->flags&PFLAG_HASROM)) return;
-		if (GCC_UNLIKELY((old_pagehandler->flags&PFLAG_READABLE)!=PFLAG_READABLE)) {
-			E_Exit("wb:non-readable code page found that is no ROM page");
-		}
-		addr&=4095;
-		if (host_readb(hostmem+addr)==(Bit8u)val) return;
-		host_writeb(hostmem+addr,val);
-		// see if there's code where we are writing to
-		if (!host_readb(&write_map[addr])) {
-			if (active_blocks) return;		// still some blocks in this page
-			active_count--;
-			if (!active_count) Release();	// delay page releasing until active_count is zero
-			return;
-		} else if (!invalidation_map) {
-			invalidation_map=(Bit8u*)malloc(4096);
-			memset(invalidation_map,0,4096);
-		}
-		invalidation_map[addr]++;
-		InvalidateRange(addr,addr);
-	}
-	void writew(PhysPt addr,Bitu val){
-		if (GCC_UNLIKELY(old_pagehandler->flags&PFLAG_HASROM)) return;
-		if (GCC_UNLIKELY((old_pagehandler->flags&PFLAG_READABLE)!=PFLAG_READABLE)) {
-			E_Exit("ww:non-readable code page found that is no ROM page");
-		}
-		addr&=4095;
-		if (host_readw(hostmem+addr)==(Bit16u)val) return;
-		host_writew(hostmem+addr,val);
-		// see if there's code where we are writing to
-		if (!host_readw(&write_map[addr])) {
-			if (active_blocks) return;		// still some blocks in this page
-			active_count--;
-			if (!active_count) Release();	// delay page releasing until active_count is zero
-			return;
-		} else if (!invalidation_map) {
-			invalidation_map=(Bit8u*)malloc(4096);
-			memset(invalidation_map,0,4096);
-		}
-#if defined(WORDS_BIGENDIAN) || !defined(C_UNALIGNED_MEMORY)
-		host_writew(&invalidation_map[addr],
-			host_readw(&invalidation_map[addr])+0x101);
-#else
-		(*(Bit16u*)&invalidation_map[addr])+=0x101;
-#endif
-		InvalidateRange(addr,addr+1);
-	}
-	void writed(PhysPt addr,Bitu val){
-		if (GCC_UNLIKELY(old_pagehandler->flags&PFLAG_HASROM)) return;
-		if (GCC_UNLIKELY((old_pagehandler->flags&PFLAG_READABLE)!=PFLAG_READABLE)) {
-			E_Exit("wd:non-readable code page found that is no ROM page");
-		}
-		addr&=4095;
-		if (host_readd(hostmem+addr)==(Bit32u)val) return;
-		host_writed(hostmem+addr,val);
-		// see if there's code where we are writing to
-		if (!host_readd(&write_map[addr])) {
-			if (active_blocks) return;		// still some blocks in this page
-			active_count--;
-			if (!active_count) Release();	// delay page releasing until active_count is zero
-			return;
-		} else if (!invalidation_map) {
-			invalidation_map=(Bit8u*)malloc(4096);
-			memset(invalidation_map,0,4096);
-		}
-#if defined(WORDS_BIGENDIAN) || !defined(C_UNALIGNED_MEMORY)
-		host_writed(&invalidation_map[addr],
-			host_readd(&invalidation_map[addr])+0x1010101);
-#else
-		(*(Bit32u*)&invalidation_map[addr])+=0x1010101;
-#endif
-		InvalidateRange(addr,addr+3);
-	}
 	bool writeb_checked(PhysPt addr,Bitu val) {
 		if (GCC_UNLIKELY(old_pagehandler->flags&PFLAG_HASROM)) return false;
 		if (GCC_UNLIKELY((old_pagehandler->flags&PFLAG_READABLE)!=PFLAG_READABLE)) {
@@ -221,18 +195,9 @@ public:
 		addr&=4095;
 		if (host_readb(hostmem+addr)==(Bit8u)val) return false;
 		// see if there's code where we are writing to
-		if (!host_readb(&write_map[addr])) {
-			if (!active_blocks) {
-				// no blocks left in this page, still delay the page releasing a bit
-				active_count--;
-				if (!active_count) Release();
-			}
-		} else {
-			if (!invalidation_map) {
-				invalidation_map=(Bit8u*)malloc(4096);
-				memset(invalidation_map,0,4096);
-			}
-			invalidation_map[addr]++;
+		if (!host_readb(&write_map[addr])) WriteWithoutCode();
+		else {
+			CountInvalidation(addr,addr);
 			if (InvalidateRange(addr,addr)) {
 				cpu.exception.which=SMC_CURRENT_BLOCK;
 				return true;
@@ -249,23 +214,9 @@ public:
 		addr&=4095;
 		if (host_readw(hostmem+addr)==(Bit16u)val) return false;
 		// see if there's code where we are writing to
-		if (!host_readw(&write_map[addr])) {
-			if (!active_blocks) {
-				// no blocks left in this page, still delay the page releasing a bit
-				active_count--;
-				if (!active_count) Release();
-			}
-		} else {
-			if (!invalidation_map) {
-				invalidation_map=(Bit8u*)malloc(4096);
-				memset(invalidation_map,0,4096);
-			}
-#if defined(WORDS_BIGENDIAN) || !defined(C_UNALIGNED_MEMORY)
-			host_writew(&invalidation_map[addr],
-				host_readw(&invalidation_map[addr])+0x101);
-#else
-			(*(Bit16u*)&invalidation_map[addr])+=0x101;
-#endif
+		if (!host_readw(&write_map[addr])) WriteWithoutCode();
+		else {
+			CountInvalidation(addr,addr+1);
 			if (InvalidateRange(addr,addr+1)) {
 				cpu.exception.which=SMC_CURRENT_BLOCK;
 				return true;
@@ -282,23 +233,9 @@ public:
 		addr&=4095;
 		if (host_readd(hostmem+addr)==(Bit32u)val) return false;
 		// see if there's code where we are writing to
-		if (!host_readd(&write_map[addr])) {
-			if (!active_blocks) {
-				// no blocks left in this page, still delay the page releasing a bit
-				active_count--;
-				if (!active_count) Release();
-			}
-		} else {
-			if (!invalidation_map) {
-				invalidation_map=(Bit8u*)malloc(4096);
-				memset(invalidation_map,0,4096);
-			}
-#if defined(WORDS_BIGENDIAN) || !defined(C_UNALIGNED_MEMORY)
-			host_writed(&invalidation_map[addr],
-				host_readd(&invalidation_map[addr])+0x1010101);
-#else
-			(*(Bit32u*)&invalidation_map[addr])+=0x1010101;
-#endif
+		if (!host_readd(&write_map[addr])) WriteWithoutCode();
+		else {
+			CountInvalidation(addr,addr+3);
 			if (InvalidateRange(addr,addr+3)) {
 				cpu.exception.which=SMC_CURRENT_BLOCK;
 				return true;
@@ -359,19 +296,6 @@ public:
 		}
 	}
 
-	void Release(void) {
-		MEM_SetPageHandler(phys_page,1,old_pagehandler);	// revert to old handler
-		PAGING_ClearTLB();
-
-		// remove page from the lists
-		if (prev) prev->next=next;
-		else cache.used_pages=next;
-		if (next) next->prev=prev;
-		else cache.last_page=prev;
-		next=cache.free_pages;
-		cache.free_pages=this;
-		prev=0;
-	}
 	void ClearRelease(void) {
 		// clear out all cache blocks in this page
 		Bitu count=active_blocks;
@@ -397,28 +321,67 @@ public:
 		return 0;	// none found
 	}
 
-	HostPt GetHostReadPt(Bitu phys_page) { 
-		hostmem=old_pagehandler->GetHostReadPt(phys_page);
-		return hostmem;
+	Bitu GetPhysPage(void) const {
+		return phys_page;
+	}
+	// add the blocks that are contained in this page to a hot block list
+	void ListHotBlocks(std::vector<HotBlockDynRec> & list) {
+		if ((old_pagehandler->flags&PFLAG_READABLE)!=PFLAG_READABLE) return;
+		HostPt mem=old_pagehandler->GetHostReadPt(phys_page);
+		if (!mem) return;
+		for (Bitu index=1;index<=DYN_PAGE_HASH;index++) {
+			for (CacheBlockDynRec * block=hash_map[index];block;block=block->hash.next) {
+				if (block->crossblock) continue;	// only blocks that stay within the page
+				HotBlockDynRec hot;
+				hot.phys_page=(Bit32u)phys_page;
+				hot.start=block->page.start;
+				hot.end=block->page.end;
+				hot.hash=cache_hashcode(mem,block->page.start,block->page.end);
+				hot.big=(flags&PFLAG_HASCODE32) ? 1:0;
+				list.push_back(hot);
+			}
+		}
+	}
+	BranchWay GetBranchWay(Bitu index) const {
+		Bitu pos=FindBranch(index);
+		if (pos<branch_count && (Bitu)(branch_map[pos]>>2)==index) return (BranchWay)(branch_map[pos]&3);
+		return BRANCH_UNKNOWN;
 	}
-	HostPt GetHostWritePt(Bitu phys_page) { 
-		return GetHostReadPt( phys_page );
+	void SetBranchWay(Bitu index,BranchWay way) {
+		Bitu pos=FindBranch(index);
+		if (pos>=branch_count || (Bitu)(branch_map[pos]>>2)!=index) {
+			// a page only has a few profiled jumps, grow the list in small steps
+			if (branch_count==branch_size) {
+				Bit16u * map=(Bit16u*)realloc(branch_map,(branch_size+16)*sizeof(Bit16u));
+				if (!map) return;
+				branch_map=map;
+				branch_size+=16;
+			}
+			memmove(&branch_map[pos+1],&branch_map[pos],(branch_count-pos)*sizeof(Bit16u));
+			branch_count++;
+		}
+		branch_map[pos]=(Bit16u)((index<<2)|way);
 	}
 public:
-	// the write map, there are write_map[i] cache blocks that cover the byte at address i
-	Bit8u write_map[4096];
-	Bit8u * invalidation_map;
-	CodePageHandlerDynRec * next, * prev;	// page linking
+	// the profiled conditional jumps sorted by position, each entry holds
+	// the position in the page shifted left by two and the way it goes
+	Bit16u * branch_map;
+	Bitu branch_count,branch_size;
+	bool prewarm;		// the hot blocks of this page have not been translated yet
 private:
-	PageHandler * old_pagehandler;
-
 	// hash map to quickly find the cache blocks in this page
 	CacheBlockDynRec * hash_map[1+DYN_PAGE_HASH];
 
-	Bitu active_blocks;		// the number of cache blocks in this page
-	Bitu active_count;		// delaying parameter to not immediately release a page
-	HostPt hostmem;	
-	Bitu phys_page;
+	// position in the list where the jump at index is or would be inserted
+	Bitu FindBranch(Bitu index) const {
+		Bitu low=0,high=branch_count;
+		while (low<high) {
+			Bitu mid=(low+high)/2;
+			if ((Bitu)(branch_map[mid]>>2)<index) low=mid+1;
+			else high=mid;
+		}
+		return low;
+	}
 };
 
 
@@ -428,17 +391,54 @@ static INLINE void cache_addunusedblock(CacheBlockDynRec * block) {
 	cache.block.free=block;
 }
 
+// allocate another CACHE_BLOCKS cache blocks and add them to the freelist
+static void cache_addblocks(void) {
+	CacheBlockDynRec * blocks=(CacheBlockDynRec*)malloc(CACHE_BLOCKS*sizeof(CacheBlockDynRec));
+	if (!blocks) E_Exit("Allocating cache_blocks has failed");
+	memset(blocks,0,sizeof(CacheBlockDynRec)*CACHE_BLOCKS);
+	for (Bitu i=0;i<CACHE_BLOCKS;i++) {
+		blocks[i].link[0].to=(CacheBlockDynRec *)1;
+		blocks[i].link[1].to=(CacheBlockDynRec *)1;
+		blocks[i].cache.next=(i<CACHE_BLOCKS-1) ? &blocks[i+1] : cache.block.free;
+	}
+	cache.block.free=&blocks[0];
+	if (!cache_blocks) cache_blocks=blocks;
+}
+
 static CacheBlockDynRec * cache_getblock(void) {
 	// get a free cache block and advance the free pointer
+	if (!cache.block.free) cache_addblocks();
 	CacheBlockDynRec * ret=cache.block.free;
-	if (!ret) E_Exit("Ran out of CacheBlocks" );
 	cache.block.free=ret->cache.next;
 	ret->cache.next=0;
 	return ret;
 }
 
+void CacheBlockDynRec::Unlink(Bitu index) {
+	if (link[index].to==&link_blocks[index]) return;
+	// not linked to the standard linkcode, find the block that links to this block
+	CacheBlockDynRec * * wherelink=&link[index].to->link[index].from;
+	while (*wherelink != this && *wherelink) {
+		wherelink = &(*wherelink)->link[index].next;
+	}
+	// now remove the link
+	if(*wherelink) 
+		*wherelink = (*wherelink)->link[index].next;
+	else {
+		LOG(LOG_CPU,LOG_ERROR)("Cache anomaly. please investigate");
+	}
+	link[index].to=&link_blocks[index];
+}
+
 void CacheBlockDynRec::Clear(void) {
 	Bitu ind;
+	// release the blocks that hold the links of the side exits
+	while (side_exits) {
+		CacheBlockDynRec * exit=side_exits;
+		side_exits=exit->hash.next;
+		exit->Unlink(0);
+		cache_addunusedblock(exit);
+	}
 	// check if this is not a cross page block
 	if (hash.index) for (ind=0;ind<2;ind++) {
 		CacheBlockDynRec * fromlink=link[ind].from;
@@ -451,19 +451,7 @@ void CacheBlockDynRec::Clear(void) {
 
 			fromlink=nextlink;
 		}
-		if (link[ind].to!=&link_blocks[ind]) {
-			// not linked to the standard linkcode, find the block that links to this block
-			CacheBlockDynRec * * wherelink=&link[ind].to->link[ind].from;
-			while (*wherelink != this && *wherelink) {
-				wherelink = &(*wherelink)->link[ind].next;
-			}
-			// now remove the link
-			if(*wherelink) 
-				*wherelink = (*wherelink)->link[ind].next;
-			else {
-				LOG(LOG_CPU,LOG_ERROR)("Cache anomaly. please investigate");
-			}
-		}
+		Unlink(ind);
 	} else 
 		cache_addunusedblock(this);
 	if (crossblock) {
@@ -484,31 +472,128 @@ void CacheBlockDynRec::Clear(void) {
 }
 
 
-static CacheBlockDynRec * cache_openblock(void) {
-	CacheBlockDynRec * block=cache.block.active;
-	// check for enough space in this block
+/* Define temporary pagesize so the MPROTECT case and the regular case share as much code as possible */
+#if (C_HAVE_MPROTECT)
+#define PAGESIZE_TEMP PAGESIZE
+#else 
+#define PAGESIZE_TEMP 4096
+#endif
+
+// merge a free block with the free blocks that follow it until it is
+// at least CACHE_MAXSIZE bytes, returns if a new block fits in there
+static bool cache_mergeblock(CacheBlockDynRec * block) {
+	if (block->page.handler) return false;
+	Bitu size=block->cache.size;
+	CacheBlockDynRec * nextblock=block->cache.next;
+	while (size<CACHE_MAXSIZE && nextblock && !nextblock->page.handler) {
+		size+=nextblock->cache.size;
+		CacheBlockDynRec * tempblock=nextblock->cache.next;
+		// block is free now
+		cache_addunusedblock(nextblock);
+		nextblock=tempblock;
+	}
+	block->cache.size=size;
+	block->cache.next=nextblock;
+	if (nextblock) return size>=CACHE_MAXSIZE;
+	// the last block reaches up to the end of the cache
+	return block->cache.start+CACHE_MAXSIZE<=cache_code+cache_code_size;
+}
+
+// make the code cache memory usable up to size bytes, plus the room for
+// code that runs past the end of the last block
+static bool cache_commit(Bitu size) {
+#if defined (WIN32)
+	if (cache_code_reserved && !VirtualAlloc(cache_code_link_blocks,PAGESIZE_TEMP+size+CACHE_MAXSIZE,
+		MEM_COMMIT,PAGE_EXECUTE_READWRITE)) return false;
+#elif (C_HAVE_MPROTECT)
+	if (cache_code_reserved && mprotect(cache_code_link_blocks,PAGESIZE_TEMP+size+CACHE_MAXSIZE,
+		PROT_WRITE|PROT_READ|PROT_EXEC)) return false;
+#endif
+	return true;
+}
+
+// add the next CACHE_TOTAL bytes to the end of the code cache
+static bool cache_grow(CacheBlockDynRec * last) {
+	if (cache_code_size>=cache_code_max) return false;
+	if (!cache_commit(cache_code_size+CACHE_TOTAL)) return false;
+	if (!last->page.handler) last->cache.size+=CACHE_TOTAL;
+	else {
+		// leave room for code that ran past the end of the last block
+		CacheBlockDynRec * newblock=cache_getblock();
+		newblock->cache.start=cache_code+cache_code_size+CACHE_MAXSIZE;
+		newblock->cache.size=CACHE_TOTAL-CACHE_MAXSIZE;
+		newblock->cache.next=0;
+		last->cache.next=newblock;
+	}
+	cache_code_size+=CACHE_TOTAL;
+	return true;
+}
+
+// throw away the code of a quarter of the pages, the ones that were run the
+// longest time ago. The page that is being translated is kept
+static bool cache_evictpages(CodePageHandlerDynRec * keep) {
+	Bitu count=0;
+	for (CodePageHandlerDynRec * cpage=cache.pages.used_pages;cpage;cpage=cpage->next) count++;
+	count=(count+3)/4;
+	bool evicted=false;
+	CodePageHandlerDynRec * cpage=cache.pages.used_pages;
+	while (cpage && count) {
+		CodePageHandlerDynRec * npage=cpage->next;
+		if (cpage!=keep) {
+			cpage->ClearRelease();
+			evicted=true;
+			count--;
+		}
+		cpage=npage;
+	}
+	return evicted;
+}
+
+// find room for a new block, going on from the block at the current position
+static CacheBlockDynRec * cache_findroom(CacheBlockDynRec * block,CodePageHandlerDynRec * codepage) {
+	for (;;) {
+		if (cache_mergeblock(block)) return block;
+		if (!block->cache.next) break;
+		block=block->cache.next;
+	}
+	// the end is reached, grow the cache before any code is thrown away
+	if (cache_grow(block)) return block->page.handler ? block->cache.next : block;
+	do {
+		for (block=cache.block.first;block;block=block->cache.next) {
+			if (cache_mergeblock(block)) return block;
+		}
+	} while (cache_evictpages(codepage));
+
+	// nothing left to throw away, clear the blocks at the start of the cache
+	block=cache.block.first;
 	Bitu size=block->cache.size;
 	CacheBlockDynRec * nextblock=block->cache.next;
 	if (block->page.handler) 
 		block->Clear();
-	// block size must be at least CACHE_MAXSIZE
-	while (size<CACHE_MAXSIZE) {
-		if (!nextblock)
-			goto skipresize;
-		// merge blocks
+	while (size<CACHE_MAXSIZE && nextblock) {
 		size+=nextblock->cache.size;
 		CacheBlockDynRec * tempblock=nextblock->cache.next;
 		if (nextblock->page.handler) 
 			nextblock->Clear();
-		// block is free now
 		cache_addunusedblock(nextblock);
 		nextblock=tempblock;
 	}
-skipresize:
-	// adjust parameters and open this block
 	block->cache.size=size;
 	block->cache.next=nextblock;
+	return block;
+}
+
+static CacheBlockDynRec * cache_openblock(CodePageHandlerDynRec * codepage) {
+	CacheBlockDynRec * block=cache.block.active;
+	// use the space at the current position if there is enough of it
+	if (!cache_mergeblock(block)) block=cache_findroom(block,codepage);
+	// open this block
+	cache.block.active=block;
 	cache.pos=block->cache.start;
+	block->profile.branch=DYN_PROFILE_NONE;
+	block->profile.count[0]=0;
+	block->profile.count[1]=0;
+	block->side_exits=NULL;
 	return block;
 }
 
@@ -542,12 +627,91 @@ static void cache_closeblock(void) {
 			block->cache.size=new_size;
 		}
 	}
-	// advance the active block pointer
-	if (!block->cache.next || (block->cache.next->cache.start>(cache_code_start_ptr + CACHE_TOTAL - CACHE_MAXSIZE))) {
-//		LOG_MSG("Cache full restarting");
-		cache.block.active=cache.block.first;
-	} else {
-		cache.block.active=block->cache.next;
+	// advance the active block pointer, cache_openblock looks for room from there
+	if (block->cache.next) cache.block.active=block->cache.next;
+}
+
+enum ProfileResult {
+	PROFILE_LINK,			// link the exit as usual
+	PROFILE_COUNT,			// still counting, run the next block without linking to it
+	PROFILE_RETRANSLATE		// the block has been thrown away to be translated again
+};
+
+// count a run through an exit of a block that ends in a conditional jump.
+// Once one way is taken nearly always, the block is thrown away and then
+// translated again with that way as part of the block, the other way
+// becomes a side exit. Superblocks grow like this one jump at a time
+static ProfileResult cache_profile_exit(CacheBlockDynRec * block,Bitu index) {
+	if (block->profile.branch==DYN_PROFILE_NONE || !block->page.handler) return PROFILE_LINK;
+	block->profile.count[index]++;
+	Bitu total=block->profile.count[0]+block->profile.count[1];
+	if (total<DYN_PROFILE_EXITS) return PROFILE_COUNT;
+	BranchWay way=BRANCH_MIXED;
+	if (block->profile.count[0]*8>=total*7) way=BRANCH_NOT_TAKEN;
+	else if (block->profile.count[1]*8>=total*7 && block->profile.follow) way=BRANCH_TAKEN;
+	block->page.handler->SetBranchWay(block->profile.branch,way);
+	block->profile.branch=DYN_PROFILE_NONE;
+	if (way==BRANCH_MIXED) return PROFILE_LINK;
+	block->Clear();
+	return PROFILE_RETRANSLATE;
+}
+
+
+// a side exit leaves a superblock through a block of its own that only holds
+// the link, so the exit jumps straight to the next block after the first run
+static CacheBlockDynRec * cache_addsideexit(CacheBlockDynRec * block) {
+	CacheBlockDynRec * exit=cache_getblock();
+	exit->page.handler=NULL;
+	exit->hash.index=0;
+	exit->crossblock=NULL;
+	exit->side_exits=NULL;
+	exit->profile.branch=DYN_PROFILE_NONE;
+	exit->link[0].to=&link_blocks[0];
+	exit->link[0].next=0;
+	exit->link[0].from=0;
+	// the side exits of a block are chained through the hash list
+	exit->hash.next=block->side_exits;
+	block->side_exits=exit;
+	return exit;
+}
+
+// jumps that skip at most this many bytes are followed within the block
+#define DYN_FOLLOW_MAX	256
+
+// see if the block can go on at the target of a jump that ends at index in
+// the page and at the instruction pointer ip, only short forward jumps in
+// the same page qualify
+static bool cache_can_follow(Bitu index,Bitu ip,bool big_op,Bits eip_change) {
+	if (eip_change<=0 || eip_change>DYN_FOLLOW_MAX) return false;
+	if (index+eip_change>=4096) return false;
+	if (big_op!=cpu.code.big) return false;
+	// the instruction pointer must not wrap around
+	if (!cpu.code.big && ip+eip_change>0xffff) return false;
+	return true;
+}
+
+enum BranchPlan {
+	PLAN_EXIT,			// end the block, both ways are block exits
+	PLAN_FALL_THROUGH,	// go on after the jump, a side exit takes the jump
+	PLAN_FOLLOW			// go on at the jump target, a side exit falls through
+};
+
+// decide how a conditional jump that starts at index in the page of the block
+// is translated. It ends the block and gets profiled, unless one way has been
+// seen to be taken nearly always. page is NULL for jumps that can't be profiled
+static BranchPlan cache_plan_branch(CacheBlockDynRec * block,CodePageHandlerDynRec * page,Bitu index,bool can_follow) {
+	if (!page) return PLAN_EXIT;
+	switch (page->GetBranchWay(index)) {
+	case BRANCH_UNKNOWN:
+		block->profile.branch=(Bit16u)index;
+		block->profile.follow=can_follow;
+		return PLAN_EXIT;
+	case BRANCH_NOT_TAKEN:
+		return PLAN_FALL_THROUGH;
+	case BRANCH_TAKEN:
+		return can_follow ? PLAN_FOLLOW : PLAN_EXIT;
+	default:
+		return PLAN_EXIT;
 	}
 }
 
@@ -595,45 +759,149 @@ static INLINE void cache_addq(Bit64u val) {
 
 static void dyn_return(BlockReturn retcode,bool ret_exception);
 static void dyn_run_code(void);
+static CacheBlockDynRec * CreateCacheBlock(CodePageHandlerDynRec * codepage,PhysPt start,Bitu max_opcodes);
 
 
-/* Define temporary pagesize so the MPROTECT case and the regular case share as much code as possible */
-#if (C_HAVE_MPROTECT)
-#define PAGESIZE_TEMP PAGESIZE
-#else 
-#define PAGESIZE_TEMP 4096
-#endif
-
 static bool cache_initialized = false;
 
+static bool hotblock_before(const HotBlockDynRec & a,const HotBlockDynRec & b) {
+	if (a.phys_page!=b.phys_page) return a.phys_page<b.phys_page;
+	if (a.start!=b.start) return a.start<b.start;
+	return a.hash<b.hash;
+}
+
+static bool hotblock_same(const HotBlockDynRec & a,const HotBlockDynRec & b) {
+	return a.phys_page==b.phys_page && a.start==b.start && a.hash==b.hash;
+}
+
+/* Hot block file: "DBXHOTBL", Bit32u version, Bit32u count, then count entries
+ * of Bit32u phys_page, Bit16u start, Bit16u end, Bit32u hash, Bit8u big, 3 unused */
+static void cache_load_hotblocks(void) {
+	hot_blocks.clear();
+	if (hot_blocks_file.empty()) return;
+	FILE * file=fopen_wrap(hot_blocks_file.c_str(),"rb");
+	if (!file) return;
+	Bit8u header[16];
+	if (fread(header,1,16,file)==16 && !memcmp(header,"DBXHOTBL",8) && host_readd(&header[8])==1) {
+		Bit32u count=host_readd(&header[12]);
+		if (count>HOTBLOCKS_MAX) count=HOTBLOCKS_MAX;
+		hot_blocks.reserve(count);
+		Bit8u entry[16];
+		for (;count && fread(entry,1,16,file)==16;count--) {
+			HotBlockDynRec hot;
+			hot.phys_page=host_readd(&entry[0]);
+			hot.start=host_readw(&entry[4]);
+			hot.end=host_readw(&entry[6]);
+			hot.hash=host_readd(&entry[8]);
+			hot.big=entry[12];
+			if (hot.start<=hot.end && hot.end<4096) hot_blocks.push_back(hot);
+		}
+	}
+	fclose(file);
+	std::sort(hot_blocks.begin(),hot_blocks.end(),hotblock_before);
+	LOG_MSG("DYNREC:Loaded %d hot blocks",(int)hot_blocks.size());
+}
+
+static void cache_save_hotblocks(void) {
+	if (hot_blocks_file.empty() || !cache_initialized) return;
+	// blocks that are translated right now first, then the ones still
+	// remembered from earlier sessions
+	std::vector<HotBlockDynRec> list;
+	for (CodePageHandlerDynRec * cpage=cache.pages.used_pages;cpage;cpage=cpage->next) cpage->ListHotBlocks(list);
+	list.insert(list.end(),hot_blocks.begin(),hot_blocks.end());
+	if (list.size()>HOTBLOCKS_MAX) list.resize(HOTBLOCKS_MAX);
+	std::sort(list.begin(),list.end(),hotblock_before);
+	list.erase(std::unique(list.begin(),list.end(),hotblock_same),list.end());
+
+	FILE * file=fopen_wrap(hot_blocks_file.c_str(),"wb");
+	if (!file) {
+		LOG_MSG("DYNREC:Can't write hot blocks to %s",hot_blocks_file.c_str());
+		return;
+	}
+	Bit8u header[16];
+	memcpy(header,"DBXHOTBL",8);
+	host_writed(&header[8],1);
+	host_writed(&header[12],(Bit32u)list.size());
+	fwrite(header,1,16,file);
+	for (size_t i=0;i<list.size();i++) {
+		Bit8u entry[16];
+		memset(entry,0,16);
+		host_writed(&entry[0],list[i].phys_page);
+		host_writew(&entry[4],list[i].start);
+		host_writew(&entry[6],list[i].end);
+		host_writed(&entry[8],list[i].hash);
+		entry[12]=list[i].big;
+		fwrite(entry,1,16,file);
+	}
+	fclose(file);
+}
+
+// translate the blocks remembered from an earlier session when their
+// page becomes a code page, unless the code there is different now
+static void cache_prewarm(CodePageHandlerDynRec * chandler,PhysPt lin_page) {
+	chandler->prewarm=false;
+	HotBlockDynRec key;
+	key.phys_page=(Bit32u)chandler->GetPhysPage();
+	std::pair<std::vector<HotBlockDynRec>::iterator,std::vector<HotBlockDynRec>::iterator> range=
+		std::equal_range(hot_blocks.begin(),hot_blocks.end(),key);
+	if (range.first==range.second) return;
+	const Bit8u * mem=chandler->GetHostReadPt(key.phys_page);
+	if (!mem) return;
+	const Bit8u big=cpu.code.big ? 1:0;
+	for (std::vector<HotBlockDynRec>::iterator hot=range.first;hot!=range.second;++hot) {
+		if (hot->big!=big || chandler->FindCacheBlock(hot->start)) continue;
+		if (cache_hashcode(mem,hot->start,hot->end)!=hot->hash) continue;
+		CreateCacheBlock(chandler,lin_page+hot->start,32);
+	}
+}
+
+// set the size the code cache may grow to, before it is allocated
+static void cache_setmaxsize(Bitu size) {
+	if (cache_code_start_ptr!=NULL) return;
+	if (size<CACHE_TOTAL) size=CACHE_TOTAL;
+	cache_code_max=size-size%CACHE_TOTAL;
+}
+
+// allocate another CACHE_PAGES code page handlers, there are at
+// most CACHE_PAGES of them for every CACHE_TOTAL bytes of code cache
+static bool cache_addpages(void) {
+	if (cache_pages>=CACHE_PAGES*(cache_code_max/CACHE_TOTAL)) return false;
+	for (Bitu i=0;i<CACHE_PAGES;i++) {
+		CodePageHandlerDynRec * newpage=new CodePageHandlerDynRec();
+		newpage->next=cache.pages.free_pages;
+		cache.pages.free_pages=newpage;
+	}
+	cache_pages+=CACHE_PAGES;
+	return true;
+}
+
 static void cache_init(bool enable) {
-	Bits i;
 	if (enable) {
 		// see if cache is already initialized
 		if (cache_initialized) return;
 		cache_initialized = true;
-		if (cache_blocks == NULL) {
-			// allocate the cache blocks memory
-			cache_blocks=(CacheBlockDynRec*)malloc(CACHE_BLOCKS*sizeof(CacheBlockDynRec));
-			if(!cache_blocks) E_Exit("Allocating cache_blocks has failed");
-			memset(cache_blocks,0,sizeof(CacheBlockDynRec)*CACHE_BLOCKS);
-			cache.block.free=&cache_blocks[0];
-			// initialize the cache blocks
-			for (i=0;i<CACHE_BLOCKS-1;i++) {
-				cache_blocks[i].link[0].to=(CacheBlockDynRec *)1;
-				cache_blocks[i].link[1].to=(CacheBlockDynRec *)1;
-				cache_blocks[i].cache.next=&cache_blocks[i+1];
-			}
-		}
+		cache_load_hotblocks();
+		// allocate the cache blocks memory, more is added when they run out
+		if (cache_blocks == NULL) cache_addblocks();
 		if (cache_code_start_ptr==NULL) {
 			// allocate the code cache memory
 #if defined (WIN32)
-			cache_code_start_ptr=(Bit8u*)VirtualAlloc(0,CACHE_TOTAL+CACHE_MAXSIZE+PAGESIZE_TEMP-1+PAGESIZE_TEMP,
-				MEM_COMMIT,PAGE_EXECUTE_READWRITE);
+			// only reserve the address space, it is committed as the cache grows
+			cache_code_start_ptr=(Bit8u*)VirtualAlloc(0,cache_code_max+CACHE_MAXSIZE+PAGESIZE_TEMP-1+PAGESIZE_TEMP,
+				MEM_RESERVE,PAGE_EXECUTE_READWRITE);
+			cache_code_reserved=(cache_code_start_ptr!=NULL);
+			if (!cache_code_start_ptr)
+				cache_code_start_ptr=(Bit8u*)malloc(cache_code_max+CACHE_MAXSIZE+PAGESIZE_TEMP-1+PAGESIZE_TEMP);
+#elif (C_HAVE_MPROTECT)
+			// only reserve the address space, it is made accessible as the cache grows
+			cache_code_start_ptr=(Bit8u*)mmap(0,cache_code_max+CACHE_MAXSIZE+PAGESIZE_TEMP-1+PAGESIZE_TEMP,
+				PROT_NONE,MAP_PRIVATE|MAP_ANONYMOUS,-1,0);
+			if (cache_code_start_ptr==(Bit8u*)MAP_FAILED) cache_code_start_ptr=NULL;
+			cache_code_reserved=(cache_code_start_ptr!=NULL);
 			if (!cache_code_start_ptr)
-				cache_code_start_ptr=(Bit8u*)malloc(CACHE_TOTAL+CACHE_MAXSIZE+PAGESIZE_TEMP-1+PAGESIZE_TEMP);
+				cache_code_start_ptr=(Bit8u*)malloc(cache_code_max+CACHE_MAXSIZE+PAGESIZE_TEMP-1+PAGESIZE_TEMP);
 #else
-			cache_code_start_ptr=(Bit8u*)malloc(CACHE_TOTAL+CACHE_MAXSIZE+PAGESIZE_TEMP-1+PAGESIZE_TEMP);
+			cache_code_start_ptr=(Bit8u*)malloc(cache_code_max+CACHE_MAXSIZE+PAGESIZE_TEMP-1+PAGESIZE_TEMP);
 #endif
 			if(!cache_code_start_ptr) E_Exit("Allocating dynamic cache failed");
 
@@ -642,9 +910,10 @@ static void cache_init(bool enable) {
 
 			cache_code_link_blocks=cache_code;
 			cache_code=cache_code+PAGESIZE_TEMP;
+			if (!cache_commit(CACHE_TOTAL)) E_Exit("Allocating dynamic cache failed");
 
 #if (C_HAVE_MPROTECT)
-			if(mprotect(cache_code_link_blocks,CACHE_TOTAL+CACHE_MAXSIZE+PAGESIZE_TEMP,PROT_WRITE|PROT_READ|PROT_EXEC))
+			if(!cache_code_reserved && mprotect(cache_code_link_blocks,cache_code_max+CACHE_MAXSIZE+PAGESIZE_TEMP,PROT_WRITE|PROT_READ|PROT_EXEC))
 				LOG_MSG("Setting execute permission on the code cache has failed");
 #endif
 			CacheBlockDynRec * block=cache_getblock();
@@ -652,6 +921,7 @@ static void cache_init(bool enable) {
 			cache.block.active=block;
 			block->cache.start=&cache_code[0];
 			block->cache.size=CACHE_TOTAL;
+			cache_code_size=CACHE_TOTAL;
 			block->cache.next=0;						// last block in the list
 		}
 		// setup the default blocks for block linkage returns
@@ -671,26 +941,30 @@ static void cache_init(bool enable) {
 		dyn_run_code();
 #endif
 
-		cache.free_pages=0;
-		cache.last_page=0;
-		cache.used_pages=0;
+		cache.pages.free_pages=0;
+		cache.pages.last_page=0;
+		cache.pages.used_pages=0;
 		// setup the code pages
-		for (i=0;i<CACHE_PAGES;i++) {
-			CodePageHandlerDynRec * newpage=new CodePageHandlerDynRec();
-			newpage->next=cache.free_pages;
-			cache.free_pages=newpage;
-		}
+		cache_pages=0;
+		cache_addpages();
 	}
 }
 
+// throw away all translated code, used when guest memory is replaced as a whole
+static void cache_reset(void) {
+	if (!cache_initialized) return;
+	while (cache.pages.used_pages) cache.pages.used_pages->ClearRelease();
+}
+
 static void cache_close(void) {
+	cache_save_hotblocks();
 /*	for (;;) {
-		if (cache.used_pages) {
-			CodePageHandler * cpage=cache.used_pages;
-			CodePageHandler * npage=cache.used_pages->next;
+		if (cache.pages.used_pages) {
+			CodePageHandler * cpage=cache.pages.used_pages;
+			CodePageHandler * npage=cache.pages.used_pages->next;
 			cpage->ClearRelease();
 			delete cpage;
-			cache.used_pages=npage;
+			cache.pages.used_pages=npage;
 		} else break;
 	}
 	if (cache_blocks != NULL) {
@@ -29,6 +29,7 @@
 #include "cpu.h"
 #include "debug.h"
 #include "setup.h"
+#include "snapshot.h"
 
 #define LINK_TOTAL		(64*1024)
 
@@ -644,14 +645,38 @@ bool PAGING_ForcePageInit(Bitu lin_addr) {
 }
 
 #if defined(USE_FULL_TLB)
+/* Stands in for the tables of page handlers that are not allocated, all pages
+   in it go through the init handler */
+static tlb_table tlb_empty_table;
+
+static tlb_table * GetTLBTable(Bitu lin_page) {
+	tlb_table * &table=paging.tlb.tables[lin_page>>TLB_TABLE_SHIFT];
+	if (table==&tlb_empty_table) {
+		table=(tlb_table *)malloc(sizeof(tlb_table));
+		if (!table) E_Exit("Out of Memory");
+		memcpy(table,&tlb_empty_table,sizeof(tlb_table));
+	}
+	return table;
+}
+
+static void FreeTLBTables(void) {
+	for (Bitu i=0;i<TLB_TABLES;i++) {
+		if (paging.tlb.tables[i]==&tlb_empty_table) continue;
+		free(paging.tlb.tables[i]);
+		paging.tlb.tables[i]=&tlb_empty_table;
+	}
+}
+
 void PAGING_InitTLB(void) {
-	for (Bitu i=0;i<TLB_SIZE;i++) {
-		paging.tlb.read[i]=0;
-		paging.tlb.write[i]=0;
-		paging.tlb.readhandler[i]=&init_page_handler;
-		paging.tlb.writehandler[i]=&init_page_handler;
+	for (Bitu i=0;i<TLB_TABLE_SIZE;i++) {
+		tlb_empty_table.readhandler[i]=&init_page_handler;
+		tlb_empty_table.writehandler[i]=&init_page_handler;
+		tlb_empty_table.phys_page[i]=0;
 	}
-	paging.links.used=0;
+	/* Only the linked pages have their host pointers set, so the rest of
+	   the TLB is never touched and takes up no memory */
+	PAGING_ClearTLB();
+	FreeTLBTables();
 }
 
 void PAGING_ClearTLB(void) {
@@ -660,8 +685,10 @@ void PAGING_ClearTLB(void) {
 		Bitu page=*entries++;
 		paging.tlb.read[page]=0;
 		paging.tlb.write[page]=0;
-		paging.tlb.readhandler[page]=&init_page_handler;
-		paging.tlb.writehandler[page]=&init_page_handler;
+		/* The table of a linked page is kept for when the page gets linked again */
+		tlb_table * table=paging.tlb.tables[page>>TLB_TABLE_SHIFT];
+		table->readhandler[page&(TLB_TABLE_SIZE-1)]=&init_page_handler;
+		table->writehandler[page&(TLB_TABLE_SIZE-1)]=&init_page_handler;
 	}
 	paging.links.used=0;
 }
@@ -670,8 +697,11 @@ void PAGING_UnlinkPages(Bitu lin_page,Bitu pages) {
 	for (;pages>0;pages--) {
 		paging.tlb.read[lin_page]=0;
 		paging.tlb.write[lin_page]=0;
-		paging.tlb.readhandler[lin_page]=&init_page_handler;
-		paging.tlb.writehandler[lin_page]=&init_page_handler;
+		tlb_table * table=paging.tlb.tables[lin_page>>TLB_TABLE_SHIFT];
+		if (table!=&tlb_empty_table) {
+			table->readhandler[lin_page&(TLB_TABLE_SIZE-1)]=&init_page_handler;
+			table->writehandler[lin_page&(TLB_TABLE_SIZE-1)]=&init_page_handler;
+		}
 		lin_page++;
 	}
 }
@@ -679,10 +709,7 @@ void PAGING_UnlinkPages(Bitu lin_page,Bitu pages) {
 void PAGING_MapPage(Bitu lin_page,Bitu phys_page) {
 	if (lin_page<LINK_START) {
 		paging.firstmb[lin_page]=phys_page;
-		paging.tlb.read[lin_page]=0;
-		paging.tlb.write[lin_page]=0;
-		paging.tlb.readhandler[lin_page]=&init_page_handler;
-		paging.tlb.writehandler[lin_page]=&init_page_handler;
+		PAGING_UnlinkPages(lin_page,1);
 	} else {
 		PAGING_LinkPage(lin_page,phys_page);
 	}
@@ -699,15 +726,17 @@ void PAGING_LinkPage(Bitu lin_page,Bitu phys_page) {
 		PAGING_ClearTLB();
 	}
 
-	paging.tlb.phys_page[lin_page]=phys_page;
+	tlb_table * table=GetTLBTable(lin_page);
+	Bitu index=lin_page&(TLB_TABLE_SIZE-1);
+	table->phys_page[index]=phys_page;
 	if (handler->flags & PFLAG_READABLE) paging.tlb.read[lin_page]=handler->GetHostReadPt(phys_page)-lin_base;
 	else paging.tlb.read[lin_page]=0;
 	if (handler->flags & PFLAG_WRITEABLE) paging.tlb.write[lin_page]=handler->GetHostWritePt(phys_page)-lin_base;
 	else paging.tlb.write[lin_page]=0;
 
 	paging.links.entries[paging.links.used++]=lin_page;
-	paging.tlb.readhandler[lin_page]=handler;
-	paging.tlb.writehandler[lin_page]=handler;
+	table->readhandler[index]=handler;
+	table->writehandler[index]=handler;
 }
 
 void PAGING_LinkPage_ReadOnly(Bitu lin_page,Bitu phys_page) {
@@ -721,14 +750,16 @@ void PAGING_LinkPage_ReadOnly(Bitu lin_page,Bitu phys_page) {
 		PAGING_ClearTLB();
 	}
 
-	paging.tlb.phys_page[lin_page]=phys_page;
+	tlb_table * table=GetTLBTable(lin_page);
+	Bitu index=lin_page&(TLB_TABLE_SIZE-1);
+	table->phys_page[index]=phys_page;
 	if (handler->flags & PFLAG_READABLE) paging.tlb.read[lin_page]=handler->GetHostReadPt(phys_page)-lin_base;
 	else paging.tlb.read[lin_page]=0;
 	paging.tlb.write[lin_page]=0;
 
 	paging.links.entries[paging.links.used++]=lin_page;
-	paging.tlb.readhandler[lin_page]=handler;
-	paging.tlb.writehandler[lin_page]=&init_page_handler_userro;
+	table->readhandler[index]=handler;
+	table->writehandler[index]=&init_page_handler_userro;
 }
 
 #else
@@ -869,6 +900,33 @@ bool PAGING_Enabled(void) {
 	return paging.enabled;
 }
 
+static void PAGING_SaveState(SnapshotWriter& writer) {
+	writer.Write((Bit32u)paging.cr3);
+	writer.Write((Bit32u)paging.cr2);
+	writer.Write(paging.enabled);
+	writer.WriteStruct(paging.firstmb,sizeof(paging.firstmb));
+	/* A snapshot taken inside a nested page fault can only resume in the same nesting */
+	writer.Write((Bit32u)pf_queue.used);
+}
+
+static bool PAGING_LoadState(SnapshotReader& reader,Bit16u /*version*/) {
+	Bit32u cr3,cr2,pf_used;
+	bool enabled;
+	Bit32u firstmb[LINK_START];
+	if (!reader.Read(cr3) || !reader.Read(cr2) || !reader.Read(enabled) ||
+	    !reader.ReadStruct(firstmb,sizeof(firstmb)) || !reader.Read(pf_used)) return false;
+	if (pf_used != pf_queue.used) {
+		LOG_MSG("PAGING: Snapshot was taken at a different page fault nesting level");
+		return false;
+	}
+	PAGING_ClearTLB();
+	paging.cr2=cr2;
+	paging.enabled=enabled;
+	memcpy(paging.firstmb,firstmb,sizeof(firstmb));
+	PAGING_SetDirBase(cr3);
+	return true;
+}
+
 class PAGING:public Module_base{
 public:
 	PAGING(Section* configuration):Module_base(configuration){
@@ -880,8 +938,15 @@ public:
 			paging.firstmb[i]=i;
 		}
 		pf_queue.used=0;
+		SNAPSHOT_Register("PAGING",1,PAGING_SaveState,PAGING_LoadState);
+	}
+	~PAGING(){
+		SNAPSHOT_Unregister("PAGING");
+#if defined(USE_FULL_TLB)
+		PAGING_ClearTLB();
+		FreeTLBTables();
+#endif
 	}
-	~PAGING(){}
 };
 
 static PAGING* test;
@@ -31,6 +31,7 @@
 #include "dosbox.h"
 #include "mem.h"
 #include "mixer.h"
+#include "snapshot.h"
 #include "SDL.h"
 #include "SDL_thread.h"
 
@@ -141,6 +142,8 @@ private:
 		virtual ~TrackFile() { };
 	};
 	
+	class SectorCache;
+
 	class BinaryFile : public TrackFile {
 	public:
 		BinaryFile(const char *filename, bool &error);
@@ -148,8 +151,16 @@ private:
 		bool read(Bit8u *buffer, int seek, int count);
 		int getLength();
 	private:
+		friend class SectorCache;
 		BinaryFile();
+		bool readBlock(Bit8u *buffer, Bit32u block, Bitu &length);
 		std::ifstream *file;
+		SDL_mutex *fileMutex;
+		// state of the sector cache
+		Bit32u cacheId;
+		Bit32u lastBlock;
+		Bit32u aheadBlock;
+		int streak;
 	};
 	
 	#if defined(C_SDL_SOUND)
@@ -161,6 +172,7 @@ private:
 		int getLength();
 	private:
 		AudioFile();
+		SDL_mutex *mutex;
 		Sound_Sample *sample;
 		int lastCount;
 		int lastSeek;
@@ -196,13 +208,19 @@ public:
 	bool	ReadSectors		(PhysPt buffer, bool raw, unsigned long sector, unsigned long num);
 	bool	LoadUnloadMedia		(bool unload);
 	bool	ReadSector		(Bit8u *buffer, bool raw, unsigned long sector);
+	bool	ReadSectorsHost		(Bit8u *buffer, bool raw, unsigned long sector, unsigned long num);
 	bool	HasDataTrack		(void);
 	
 static	CDROM_Interface_Image* images[26];
+static	SectorCache* sectorCache;
+	// state of the audio player for snapshots
+static	void	SaveState(SnapshotWriter& writer);
+static	bool	LoadState(SnapshotReader& reader, Bit16u version);
 
 private:
 	// player
 static	void	CDAudioCallBack(Bitu len);
+static	int	CDAudioThread(void *data);
 	int	GetTrack(int sector);
 
 static  struct imagePlayer {
@@ -217,6 +235,13 @@ static  struct imagePlayer {
 		bool    isPaused;
 		bool    ctrlUsed;
 		TCtrl   ctrlData;
+		// the decoder thread and what it works on
+		SDL_Thread *thread;
+		SDL_cond   *workCond;
+		SDL_cond   *dataCond;
+		Bit32u  generation;
+		bool    busy;
+		bool    stop;
 	} player;
 	
 	void 	ClearTracks();
@@ -17,14 +17,17 @@
  */
 
 
+#include <atomic>
 #include <cctype>
 #include <cmath>
 #include <cstdio>
+#include <deque>
 #include <fstream>
 #include <iostream>
 #include <limits>
 #include <limits.h> //GCC 2.95
 #include <sstream>
+#include <unordered_map>
 #include <vector>
 #include <sys/stat.h>
 #include "cdrom.h"
@@ -43,30 +46,295 @@ using namespace std;
 #define MAX_LINE_LENGTH 512
 #define MAX_FILENAME_LENGTH 256
 
+// image files are read and cached in blocks of this size
+#define CACHE_BLOCK_SHIFT	15
+#define CACHE_BLOCK_SIZE	(1 << CACHE_BLOCK_SHIFT)
+// blocks kept for all images together
+#define CACHE_BLOCKS		128
+// blocks read in a row before the cache starts reading ahead
+#define READAHEAD_STREAK	2
+// how many blocks the cache keeps ahead of sequential reads
+#define READAHEAD_BLOCKS	8
+
+/*
+	The data of all binary image files goes through one cache of file blocks,
+	so isoDrive and MSCDEX raw reads share it. The blocks that are used least
+	recently are replaced first. When a file is read sequentially, a worker
+	thread reads the next blocks before they are needed, so streaming data
+	from the image doesn't wait for the disk on the emulation thread.
+*/
+class CDROM_Interface_Image::SectorCache {
+public:
+	SectorCache();
+	~SectorCache();
+	bool read(BinaryFile *file, Bit8u *buffer, int seek, int count);
+	void purge(BinaryFile *file);
+	int users;
+private:
+	struct Block {
+		BinaryFile *file;
+		Bit32u number;
+		Bitu length;
+		bool pending;			// being read from the file
+		Block *prev, *next;		// most recently used first
+		Bit8u data[CACHE_BLOCK_SIZE];
+	};
+	struct Request {
+		BinaryFile *file;
+		Bit32u number;
+	};
+	static Bit64u key(BinaryFile *file, Bit32u number) {
+		return ((Bit64u)file->cacheId << 32) | number;
+	}
+	void unlink(Block *block);
+	void touch(Block *block);
+	void drop(Block *block);
+	Block *fill(BinaryFile *file, Bit32u number);
+	Block *get(BinaryFile *file, Bit32u number);
+	static int workerThread(void *data);
+
+	Block *blocks;
+	Block *first, *last;
+	std::unordered_map<Bit64u, Block*> index;
+	std::deque<Request> queue;
+	SDL_mutex *mutex;
+	SDL_cond *work;			// signaled when there are blocks to read ahead
+	SDL_cond *done;			// broadcast when a pending block got read
+	SDL_Thread *thread;
+	bool stop;
+};
+
+CDROM_Interface_Image::SectorCache::SectorCache()
+{
+	users = 0;
+	blocks = new Block[CACHE_BLOCKS];
+	first = last = NULL;
+	for (int i = 0; i < CACHE_BLOCKS; i++) {
+		blocks[i].file = NULL;
+		blocks[i].pending = false;
+		blocks[i].prev = last;
+		blocks[i].next = NULL;
+		if (last) last->next = &blocks[i];
+		else first = &blocks[i];
+		last = &blocks[i];
+	}
+	mutex = SDL_CreateMutex();
+	work = SDL_CreateCond();
+	done = SDL_CreateCond();
+	stop = false;
+	thread = SDL_CreateThread(workerThread, this);
+}
+
+CDROM_Interface_Image::SectorCache::~SectorCache()
+{
+	if (thread) {
+		SDL_mutexP(mutex);
+		stop = true;
+		SDL_CondSignal(work);
+		SDL_mutexV(mutex);
+		SDL_WaitThread(thread, NULL);
+	}
+	SDL_DestroyCond(done);
+	SDL_DestroyCond(work);
+	SDL_DestroyMutex(mutex);
+	delete[] blocks;
+}
+
+void CDROM_Interface_Image::SectorCache::unlink(Block *block)
+{
+	if (block->prev) block->prev->next = block->next;
+	else first = block->next;
+	if (block->next) block->next->prev = block->prev;
+	else last = block->prev;
+}
+
+void CDROM_Interface_Image::SectorCache::touch(Block *block)
+{
+	if (block == first) return;
+	unlink(block);
+	block->prev = NULL;
+	block->next = first;
+	first->prev = block;
+	first = block;
+}
+
+// forget the contents of a block and make it the first one to be reused
+void CDROM_Interface_Image::SectorCache::drop(Block *block)
+{
+	index.erase(key(block->file, block->number));
+	block->file = NULL;
+	if (block == last) return;
+	unlink(block);
+	block->prev = last;
+	block->next = NULL;
+	last->next = block;
+	last = block;
+}
+
+// read a block from the file into the cache, the mutex is released while reading
+CDROM_Interface_Image::SectorCache::Block *CDROM_Interface_Image::SectorCache::fill(BinaryFile *file, Bit32u number)
+{
+	Block *block = last;
+	while (block && block->pending) block = block->prev;
+	if (!block) return NULL;
+	if (block->file) index.erase(key(block->file, block->number));
+	block->file = file;
+	block->number = number;
+	block->pending = true;
+	index[key(file, number)] = block;
+	touch(block);
+
+	SDL_mutexV(mutex);
+	bool success = file->readBlock(block->data, number, block->length);
+	SDL_mutexP(mutex);
+
+	block->pending = false;
+	if (!success) drop(block);
+	SDL_CondBroadcast(done);
+	return success ? block : NULL;
+}
+
+// find a block or read it, waits for it if the worker is reading it already
+CDROM_Interface_Image::SectorCache::Block *CDROM_Interface_Image::SectorCache::get(BinaryFile *file, Bit32u number)
+{
+	while (true) {
+		std::unordered_map<Bit64u, Block*>::iterator it = index.find(key(file, number));
+		if (it == index.end()) return fill(file, number);
+		Block *block = it->second;
+		if (!block->pending) {
+			touch(block);
+			return block;
+		}
+		SDL_CondWait(done, mutex);
+	}
+}
+
+bool CDROM_Interface_Image::SectorCache::read(BinaryFile *file, Bit8u *buffer, int seek, int count)
+{
+	if (seek < 0 || count < 0) return false;
+	SDL_mutexP(mutex);
+	// follow the file with the worker when it is read sequentially
+	Bit32u number = (Bit32u)seek >> CACHE_BLOCK_SHIFT;
+	if (number == file->lastBlock + 1) file->streak++;
+	else if (number != file->lastBlock) file->streak = 0;
+	file->lastBlock = number;
+	if (thread && file->streak >= READAHEAD_STREAK) {
+		Bit32u ahead = file->aheadBlock;
+		if (ahead < number || ahead > number + READAHEAD_BLOCKS) ahead = number;
+		if (ahead < number + READAHEAD_BLOCKS) {
+			while (ahead < number + READAHEAD_BLOCKS) {
+				Request request = { file, ++ahead };
+				queue.push_back(request);
+			}
+			file->aheadBlock = ahead;
+			SDL_CondSignal(work);
+		}
+	}
+
+	bool success = true;
+	while (count > 0) {
+		number = (Bit32u)seek >> CACHE_BLOCK_SHIFT;
+		Bitu offset = (Bitu)seek & (CACHE_BLOCK_SIZE - 1);
+		Bitu part = CACHE_BLOCK_SIZE - offset;
+		if (part > (Bitu)count) part = count;
+		Block *block = get(file, number);
+		if (!block || offset + part > block->length) {
+			success = false;
+			break;
+		}
+		memcpy(buffer, &block->data[offset], part);
+		buffer += part;
+		seek += (int)part;
+		count -= (int)part;
+	}
+	SDL_mutexV(mutex);
+	return success;
+}
+
+// remove all blocks of a file that is closed
+void CDROM_Interface_Image::SectorCache::purge(BinaryFile *file)
+{
+	SDL_mutexP(mutex);
+	for (std::deque<Request>::iterator it = queue.begin(); it != queue.end();) {
+		if (it->file == file) it = queue.erase(it);
+		else ++it;
+	}
+	for (int i = 0; i < CACHE_BLOCKS; i++) {
+		while (blocks[i].file == file && blocks[i].pending) SDL_CondWait(done, mutex);
+		if (blocks[i].file == file) drop(&blocks[i]);
+	}
+	SDL_mutexV(mutex);
+}
+
+int CDROM_Interface_Image::SectorCache::workerThread(void *data)
+{
+	SectorCache *cache = (SectorCache*)data;
+	SDL_mutexP(cache->mutex);
+	while (!cache->stop) {
+		if (cache->queue.empty()) {
+			SDL_CondWait(cache->work, cache->mutex);
+			continue;
+		}
+		Request request = cache->queue.front();
+		cache->queue.pop_front();
+		if (cache->index.find(key(request.file, request.number)) == cache->index.end())
+			cache->fill(request.file, request.number);
+	}
+	SDL_mutexV(cache->mutex);
+	return 0;
+}
+
 CDROM_Interface_Image::BinaryFile::BinaryFile(const char *filename, bool &error)
 {
+	static Bit32u nextCacheId = 0;
 	file = new ifstream(filename, ios::in | ios::binary);
 	error = (file == NULL) || (file->fail());
+	fileMutex = SDL_CreateMutex();
+	cacheId = nextCacheId++;
+	lastBlock = aheadBlock = 0;
+	streak = 0;
+	if (!sectorCache) sectorCache = new SectorCache();
+	sectorCache->users++;
 }
 
 CDROM_Interface_Image::BinaryFile::~BinaryFile()
 {
+	sectorCache->purge(this);
+	if (--sectorCache->users == 0) {
+		delete sectorCache;
+		sectorCache = NULL;
+	}
+	SDL_DestroyMutex(fileMutex);
 	delete file;
 	file = NULL;
 }
 
 bool CDROM_Interface_Image::BinaryFile::read(Bit8u *buffer, int seek, int count)
 {
-	file->seekg(seek, ios::beg);
-	file->read((char*)buffer, count);
-	return !(file->fail());
+	return sectorCache->read(this, buffer, seek, count);
+}
+
+// read a block of the file for the sector cache, the last one may be short
+bool CDROM_Interface_Image::BinaryFile::readBlock(Bit8u *buffer, Bit32u block, Bitu &length)
+{
+	SDL_mutexP(fileMutex);
+	file->clear();
+	file->seekg((streamoff)block << CACHE_BLOCK_SHIFT, ios::beg);
+	file->read((char*)buffer, CACHE_BLOCK_SIZE);
+	length = (Bitu)file->gcount();
+	file->clear();
+	SDL_mutexV(fileMutex);
+	return length > 0;
 }
 
 int CDROM_Interface_Image::BinaryFile::getLength()
 {
+	SDL_mutexP(fileMutex);
+	file->clear();
 	file->seekg(0, ios::end);
 	int length = (int)file->tellg();
-	if (file->fail()) return -1;
+	if (file->fail()) length = -1;
+	SDL_mutexV(fileMutex);
 	return length;
 }
 
@@ -74,6 +342,7 @@ int CDROM_Interface_Image::BinaryFile::getLength()
 CDROM_Interface_Image::AudioFile::AudioFile(const char *filename, bool &error)
 {
 	Sound_AudioInfo desired = {AUDIO_S16, 2, 44100};
+	mutex = SDL_CreateMutex();
 	sample = Sound_NewSampleFromFile(filename, &desired, RAW_SECTOR_SIZE);
 	lastCount = RAW_SECTOR_SIZE;
 	lastSeek = 0;
@@ -83,17 +352,26 @@ CDROM_Interface_Image::AudioFile::AudioFile(const char *filename, bool &error)
 CDROM_Interface_Image::AudioFile::~AudioFile()
 {
 	Sound_FreeSample(sample);
+	SDL_DestroyMutex(mutex);
 }
 
+// the decoder thread and the emulation thread can both read audio tracks
 bool CDROM_Interface_Image::AudioFile::read(Bit8u *buffer, int seek, int count)
 {
+	SDL_mutexP(mutex);
 	if (lastCount != count) {
 		int success = Sound_SetBufferSize(sample, count);
-		if (!success) return false;
+		if (!success) {
+			SDL_mutexV(mutex);
+			return false;
+		}
 	}
 	if (lastSeek != (seek - count)) {
 		int success = Sound_Seek(sample, (int)((double)(seek) / 176.4f));
-		if (!success) return false;
+		if (!success) {
+			SDL_mutexV(mutex);
+			return false;
+		}
 	}
 	lastSeek = seek;
 	int bytes = Sound_Decode(sample);
@@ -103,27 +381,38 @@ bool CDROM_Interface_Image::AudioFile::read(Bit8u *buffer, int seek, int count)
 	} else {
 		memcpy(buffer, sample->buffer, count);
 	}
-	
-	return !(sample->flags & SOUND_SAMPLEFLAG_ERROR);
+	bool success = !(sample->flags & SOUND_SAMPLEFLAG_ERROR);
+	SDL_mutexV(mutex);
+	return success;
 }
 
 int CDROM_Interface_Image::AudioFile::getLength()
 {
 #ifdef __LIBRETRO__
-	return lround(Sound_Duration(sample) * 176.4f);
+	SDL_mutexP(mutex);
+	int length = lround(Sound_Duration(sample) * 176.4f);
+	SDL_mutexV(mutex);
+	return length;
 #else
 	int time = 1;
 	int shift = 0;
 	if (!(sample->flags & SOUND_SAMPLEFLAG_CANSEEK)) return -1;
 	
+	SDL_mutexP(mutex);
 	while (true) {
 		int success = Sound_Seek(sample, (unsigned int)(shift + time));
 		if (!success) {
-			if (time == 1) return lround((double)shift * 176.4f);
+			if (time == 1) {
+				SDL_mutexV(mutex);
+				return lround((double)shift * 176.4f);
+			}
 			shift += time >> 1;
 			time = 1;
 		} else {
-			if (time > ((numeric_limits<int>::max() - shift) / 2)) return -1;
+			if (time > ((numeric_limits<int>::max() - shift) / 2)) {
+				SDL_mutexV(mutex);
+				return -1;
+			}
 			time = time << 1;
 		}
 	}
@@ -134,8 +423,33 @@ int CDROM_Interface_Image::AudioFile::getLength()
 // initialize static members
 int CDROM_Interface_Image::refCount = 0;
 CDROM_Interface_Image* CDROM_Interface_Image::images[26] = {};
+CDROM_Interface_Image::SectorCache* CDROM_Interface_Image::sectorCache = NULL;
 CDROM_Interface_Image::imagePlayer CDROM_Interface_Image::player = {
-	NULL, NULL, NULL, {0}, 0, 0, 0, false, false, false, { {0,0,0,0},{0,0,0,0} } };
+	NULL, NULL, NULL, {0}, 0, 0, 0, false, false, false, { {0,0,0,0},{0,0,0,0} },
+	NULL, NULL, NULL, 0, false, false };
+
+// sectors the decoder thread can be ahead of the mixer
+#define CDAUDIO_SLOTS 32
+
+/*
+	CD audio is read and decoded by a thread into a ring of sectors, so the
+	mixer callback only has to copy it. The thread is the only one to write
+	to the ring and the callback the only one to read from it, the two
+	positions are all they share. Every sector carries the generation of the
+	play request it was decoded for, the callback skips the ones of requests
+	that got replaced.
+*/
+static struct {
+	struct {
+		Bit32u generation;
+		int frame;
+		bool success;		// false ends the playback
+		Bit8u data[RAW_SECTOR_SIZE];
+	} slots[CDAUDIO_SLOTS];
+	std::atomic<Bitu> readPos;
+	std::atomic<Bitu> writePos;
+	std::atomic<bool> threadWaiting;	// the thread waits for a free slot
+} cdaudio_ring;
 
 	
 CDROM_Interface_Image::CDROM_Interface_Image(Bit8u subUnit)
@@ -144,10 +458,15 @@ CDROM_Interface_Image::CDROM_Interface_Image(Bit8u subUnit)
 	images[subUnit] = this;
 	if (refCount == 0) {
 		player.mutex = SDL_CreateMutex();
+		player.workCond = SDL_CreateCond();
+		player.dataCond = SDL_CreateCond();
+		player.stop = false;
+		player.thread = SDL_CreateThread(CDAudioThread, NULL);
 		if (!player.channel) {
 			player.channel = MIXER_AddChannel(&CDAudioCallBack, 44100, "CDAUDIO");
 		}
 		player.channel->Enable(true);
+		SNAPSHOT_Register("CDAUDIO",1,SaveState,LoadState);
 	}
 	refCount++;
 }
@@ -155,14 +474,83 @@ CDROM_Interface_Image::CDROM_Interface_Image(Bit8u subUnit)
 CDROM_Interface_Image::~CDROM_Interface_Image()
 {
 	refCount--;
-	if (player.cd == this) player.cd = NULL;
+	SDL_mutexP(player.mutex);
+	if (player.cd == this) {
+		player.cd = NULL;
+		player.isPlaying = false;
+		player.generation++;
+		SDL_CondSignal(player.workCond);
+	}
+	// make sure the decoder thread is done with the tracks, it can still be
+	// reading from this image for a request that another image replaced
+	while (player.busy) SDL_CondWait(player.dataCond, player.mutex);
+	SDL_mutexV(player.mutex);
 	ClearTracks();
 	if (refCount == 0) {
+		SNAPSHOT_Unregister("CDAUDIO");
+		if (player.thread) {
+			SDL_mutexP(player.mutex);
+			player.stop = true;
+			SDL_CondSignal(player.workCond);
+			SDL_mutexV(player.mutex);
+			SDL_WaitThread(player.thread, NULL);
+			player.thread = NULL;
+		}
+		SDL_DestroyCond(player.dataCond);
+		SDL_DestroyCond(player.workCond);
 		SDL_DestroyMutex(player.mutex);
 		player.channel->Enable(false);
 	}
 }
 
+void CDROM_Interface_Image::SaveState(SnapshotWriter& writer)
+{
+	// the decoder thread starts over at currFrame after loading, so only
+	// what the callback has taken from the ring is saved
+	writer.Write((Bit8u)(player.cd ? player.cd->subUnit : 0xff));
+	writer.Write(player.currFrame);
+	writer.Write(player.targetFrame);
+	writer.Write(player.isPlaying);
+	writer.Write(player.isPaused);
+	writer.Write(player.ctrlUsed);
+	writer.WriteStruct(&player.ctrlData, sizeof(player.ctrlData));
+	writer.Write(player.bufLen);
+	writer.WriteBlock(player.buffer, player.bufLen);
+}
+
+bool CDROM_Interface_Image::LoadState(SnapshotReader& reader, Bit16u /*version*/)
+{
+	Bit8u unit;
+	int currFrame, targetFrame, bufLen;
+	bool isPlaying, isPaused, ctrlUsed;
+	TCtrl ctrlData;
+	if (!reader.Read(unit) || !reader.Read(currFrame) || !reader.Read(targetFrame) ||
+	    !reader.Read(isPlaying) || !reader.Read(isPaused) || !reader.Read(ctrlUsed) ||
+	    !reader.ReadStruct(&ctrlData, sizeof(ctrlData)) || !reader.Read(bufLen)) return false;
+	if (bufLen < 0 || bufLen > (int)sizeof(player.buffer)) return false;
+	if (unit != 0xff && (unit >= 26 || !images[unit])) {
+		LOG_MSG("SNAPSHOT: CD audio plays from an image that isn't mounted");
+		return false;
+	}
+	SDL_mutexP(player.mutex);
+	if (!reader.ReadBlock(player.buffer, bufLen)) {
+		SDL_mutexV(player.mutex);
+		return false;
+	}
+	player.cd = (unit != 0xff) ? images[unit] : NULL;
+	player.currFrame = currFrame;
+	player.targetFrame = targetFrame;
+	player.isPlaying = isPlaying;
+	player.isPaused = isPaused;
+	player.ctrlUsed = ctrlUsed;
+	player.ctrlData = ctrlData;
+	player.bufLen = bufLen;
+	player.generation++;
+	SDL_CondSignal(player.workCond);
+	SDL_mutexV(player.mutex);
+	return true;
+}
+
 void CDROM_Interface_Image::InitNewMedia()
 {
 }
@@ -247,6 +635,9 @@ bool CDROM_Interface_Image::PlayAudioSector(unsigned long start,unsigned long le
 		//Real drives either fail or succeed as well
 	} else player.isPlaying = true;
 	player.isPaused = false;
+	// the decoder thread starts over at the new position
+	player.generation++;
+	SDL_CondSignal(player.workCond);
 	SDL_mutexV(player.mutex);
 	return true;
 }
@@ -273,18 +664,15 @@ void CDROM_Interface_Image::ChannelControl(TCtrl ctrl)
 bool CDROM_Interface_Image::ReadSectors(PhysPt buffer, bool raw, unsigned long sector, unsigned long num)
 {
 	int sectorSize = raw ? RAW_SECTOR_SIZE : COOKED_SECTOR_SIZE;
-	Bitu buflen = num * sectorSize;
-	Bit8u* buf = new Bit8u[buflen];
+	Bit8u buf[RAW_SECTOR_SIZE];
 	
 	bool success = true; //Gobliiins reads 0 sectors
 	for(unsigned long i = 0; i < num; i++) {
-		success = ReadSector(&buf[i * sectorSize], raw, sector + i);
+		success = ReadSector(buf, raw, sector + i);
 		if (!success) break;
+		MEM_BlockWrite(buffer + i * sectorSize, buf, sectorSize);
 	}
 
-	MEM_BlockWrite(buffer, buf, buflen);
-	delete[] buf;
-
 	return success;
 }
 
@@ -321,6 +709,25 @@ bool CDROM_Interface_Image::ReadSector(Bit8u *buffer, bool raw, unsigned long se
 	return tracks[track].file->read(buffer, seek, length);
 }
 
+bool CDROM_Interface_Image::ReadSectorsHost(Bit8u *buffer, bool raw, unsigned long sector, unsigned long num)
+{
+	int track = GetTrack(sector) - 1;
+	if (track < 0) return false;
+	
+	// cooked sectors that follow each other in one track are read at once
+	if (!raw && tracks[track].sectorSize == COOKED_SECTOR_SIZE && !tracks[track].mode2
+	    && sector + num <= (unsigned long)tracks[track + 1].start) {
+		int seek = tracks[track].skip + (sector - tracks[track].start) * COOKED_SECTOR_SIZE;
+		return tracks[track].file->read(buffer, seek, num * COOKED_SECTOR_SIZE);
+	}
+	
+	int length = (raw ? RAW_SECTOR_SIZE : COOKED_SECTOR_SIZE);
+	for (unsigned long i = 0; i < num; i++) {
+		if (!ReadSector(buffer + i * length, raw, sector + i)) return false;
+	}
+	return true;
+}
+
 void CDROM_Interface_Image::CDAudioCallBack(Bitu len)
 {
 	len *= 4;       // 16 bit, stereo
@@ -330,20 +737,49 @@ void CDROM_Interface_Image::CDAudioCallBack(Bitu len)
 		return;
 	}
 	
-	SDL_mutexP(player.mutex);
 	while (player.bufLen < (Bits)len) {
-		bool success;
-		if (player.targetFrame > player.currFrame)
-			success = player.cd->ReadSector(&player.buffer[player.bufLen], true, player.currFrame);
-		else success = false;
-		
-		if (success) {
-			player.currFrame++;
-			player.bufLen += RAW_SECTOR_SIZE;
-		} else {
-			memset(&player.buffer[player.bufLen], 0, len - player.bufLen);
-			player.bufLen = len;
-			player.isPlaying = false;
+		if (!player.thread) {
+			// no decoder thread, read the sector right here
+			bool success = player.cd && player.currFrame < player.targetFrame &&
+				player.cd->ReadSector(&player.buffer[player.bufLen], true, player.currFrame);
+			if (success) {
+				player.currFrame++;
+				player.bufLen += RAW_SECTOR_SIZE;
+			} else {
+				memset(&player.buffer[player.bufLen], 0, len - player.bufLen);
+				player.bufLen = len;
+				player.isPlaying = false;
+			}
+			continue;
+		}
+		Bitu readPos = cdaudio_ring.readPos.load(std::memory_order_relaxed);
+		if (readPos == cdaudio_ring.writePos.load(std::memory_order_acquire)) {
+			// wait for the decoder thread to catch up, padding with silence
+			// would make the output depend on how fast the host reads
+			SDL_mutexP(player.mutex);
+			while (readPos == cdaudio_ring.writePos.load(std::memory_order_acquire))
+				SDL_CondWait(player.dataCond, player.mutex);
+			SDL_mutexV(player.mutex);
+		}
+		const auto &slot = cdaudio_ring.slots[readPos % CDAUDIO_SLOTS];
+		if (slot.generation == player.generation) {
+			if (slot.success) {
+				memcpy(&player.buffer[player.bufLen], slot.data, RAW_SECTOR_SIZE);
+				player.currFrame = slot.frame + 1;
+				player.bufLen += RAW_SECTOR_SIZE;
+			} else {
+				memset(&player.buffer[player.bufLen], 0, len - player.bufLen);
+				player.bufLen = len;
+				player.isPlaying = false;
+			}
+		}
+		cdaudio_ring.readPos.store(readPos + 1);
+		// wake the thread up once half of the ring is free again
+		if (cdaudio_ring.threadWaiting.load() &&
+			cdaudio_ring.writePos.load(std::memory_order_relaxed) - readPos <= CDAUDIO_SLOTS / 2 + 1) {
+			SDL_mutexP(player.mutex);
+			SDL_CondSignal(player.workCond);
+			SDL_mutexV(player.mutex);
 		}
 	}
 	if (player.ctrlUsed) {
@@ -369,7 +805,59 @@ void CDROM_Interface_Image::CDAudioCallBack(Bitu len)
 #endif
 	memmove(player.buffer, &player.buffer[len], player.bufLen - len);
 	player.bufLen -= len;
+}
+
+int CDROM_Interface_Image::CDAudioThread(void * /*data*/)
+{
+	CDROM_Interface_Image *cd = NULL;
+	Bit32u generation = 0;
+	int frame = 0;
+	int targetFrame = 0;
+	bool finished = true;
+
+	SDL_mutexP(player.mutex);
+	while (!player.stop) {
+		if (generation != player.generation) {
+			// a new play request
+			generation = player.generation;
+			cd = player.cd;
+			frame = player.currFrame;
+			targetFrame = player.targetFrame;
+			finished = !cd || !player.isPlaying;
+		}
+		if (finished) {
+			SDL_CondWait(player.workCond, player.mutex);
+			continue;
+		}
+		Bitu writePos = cdaudio_ring.writePos.load(std::memory_order_relaxed);
+		if (writePos - cdaudio_ring.readPos.load() >= CDAUDIO_SLOTS) {
+			cdaudio_ring.threadWaiting.store(true);
+			if (writePos - cdaudio_ring.readPos.load() > CDAUDIO_SLOTS / 2)
+				SDL_CondWait(player.workCond, player.mutex);
+			cdaudio_ring.threadWaiting.store(false);
+			continue;
+		}
+
+		// the slot isn't visible to the callback until writePos moves on
+		auto &slot = cdaudio_ring.slots[writePos % CDAUDIO_SLOTS];
+		player.busy = true;
+		SDL_mutexV(player.mutex);
+		bool success = frame < targetFrame && cd->ReadSector(slot.data, true, frame);
+		SDL_mutexP(player.mutex);
+		player.busy = false;
+
+		if (generation == player.generation) {
+			slot.generation = generation;
+			slot.frame = frame;
+			slot.success = success;
+			cdaudio_ring.writePos.store(writePos + 1, std::memory_order_release);
+			frame++;
+			finished = !success;
+		}
+		SDL_CondBroadcast(player.dataCond);
+	}
 	SDL_mutexV(player.mutex);
+	return 0;
 }
 
 bool CDROM_Interface_Image::LoadIsoFile(char* filename)
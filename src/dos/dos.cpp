@@ -30,6 +30,7 @@
 #include "setup.h"
 #include "support.h"
 #include "serialport.h"
+#include "snapshot.h"
 
 DOS_Block dos;
 DOS_InfoBlock dos_infoblock;
@@ -1271,6 +1272,151 @@ static Bitu DOS_26Handler(void) {
 }
 
 
+/* The host side of DOS: the drives have to be the same ones that were mounted
+ * when the snapshot was taken, the open files are opened again on them */
+static void DOS_SaveState(SnapshotWriter& writer) {
+	for (Bitu i=0;i<DOS_DRIVES;i++) {
+		writer.Write((Bit8u)(Drives[i] ? 1 : 0));
+		if (!Drives[i]) continue;
+		writer.WriteString(Drives[i]->GetInfo());
+		writer.WriteString(Drives[i]->curdir);
+	}
+	for (Bitu i=0;i<DOS_FILES;i++) {
+		DOS_File * file=Files[i];
+		if (!file) {
+			writer.Write((Bit8u)0);
+			continue;
+		}
+		writer.Write((Bit8u)(file->GetDrive()==0xff ? 1 : 2));
+		writer.WriteString(file->GetName());
+		writer.Write(file->GetDrive());
+		writer.Write(file->flags);
+		writer.Write(file->time);
+		writer.Write(file->date);
+		writer.Write(file->attr);
+		writer.Write((Bit32s)file->refCtr);
+		writer.Write(file->open);
+		Bit32u pos=0;
+		if (file->GetDrive()!=0xff && file->IsOpen()) file->Seek(&pos,DOS_SEEK_CUR);
+		writer.Write(pos);
+	}
+	writer.Write(dos.date);
+	writer.Write(dos.version);
+	writer.Write(dos.firstMCB);
+	writer.Write(dos.errorcode);
+	writer.Write(dos.env);
+	writer.Write(dos.cpmentry);
+	writer.Write(dos.return_code);
+	writer.Write(dos.return_mode);
+	writer.Write(dos.current_drive);
+	writer.Write(dos.verify);
+	writer.Write(dos.breakcheck);
+	writer.Write(dos.echo);
+	writer.Write(dos.direct_output);
+	writer.Write(dos.internal_output);
+	writer.Write(dos.loaded_codepage);
+	writer.Write(DOS_GetMemAllocStrategy());
+}
+
+/* Close the files of the table that aren't also in keep */
+static void DOS_CloseFiles(DOS_File * * files,DOS_File * const * keep) {
+	for (Bitu i=0;i<DOS_FILES;i++) {
+		if (!files[i] || files[i]==keep[i]) continue;
+		if (files[i]->IsOpen()) files[i]->Close();
+		delete files[i];
+		files[i]=0;
+	}
+}
+
+static bool DOS_LoadState(SnapshotReader& reader,Bit16u /*version*/) {
+	char name[DOS_PATHLENGTH];
+	char info[256];
+	char curdir[DOS_DRIVES][DOS_PATHLENGTH];
+	for (Bitu i=0;i<DOS_DRIVES;i++) {
+		Bit8u present;
+		if (!reader.Read(present)) return false;
+		if (!present) {
+			if (!Drives[i]) continue;
+			LOG_MSG("SNAPSHOT: Drive %c: wasn't mounted",(char)('A'+i));
+			return false;
+		}
+		if (!reader.ReadString(info,sizeof(info)) || !reader.ReadString(curdir[i],DOS_PATHLENGTH)) return false;
+		if (!Drives[i] || strcmp(info,Drives[i]->GetInfo())) {
+			LOG_MSG("SNAPSHOT: Drive %c: isn't mounted as \"%s\"",(char)('A'+i),info);
+			return false;
+		}
+	}
+
+	/* Open everything first, so a file that is gone leaves the table alone.
+	 * A file that is still open the same way is kept, loading the last
+	 * snapshot again and again doesn't have to reopen all files. */
+	DOS_File * files[DOS_FILES]={0};
+	Bit32u pos[DOS_FILES];
+	const Bit16u olderror=dos.errorcode;
+	bool ok=true;
+	for (Bitu i=0;ok && i<DOS_FILES;i++) {
+		Bit8u kind,drive;
+		Bit32u flags;
+		Bit16u time,date,attr;
+		Bit32s refs;
+		bool open;
+		if (!reader.Read(kind)) break;
+		if (!kind) continue;
+		if (!reader.ReadString(name,sizeof(name)) || !reader.Read(drive) || !reader.Read(flags) ||
+		    !reader.Read(time) || !reader.Read(date) || !reader.Read(attr) ||
+		    !reader.Read(refs) || !reader.Read(open) || !reader.Read(pos[i])) break;
+		DOS_File * file=Files[i];
+		if (file && file->IsName(name) && file->GetDrive()==(kind==1 ? 0xff : drive) &&
+		    file->flags==flags && file->IsOpen()==open) {
+			files[i]=file;
+		} else if (kind==1) {
+			for (Bitu dev=0;dev<DOS_DEVICES;dev++) {
+				if (Devices[dev] && Devices[dev]->IsName(name)) {
+					files[i]=new DOS_Device(*Devices[dev]);
+					break;
+				}
+			}
+		} else if (drive<DOS_DRIVES && Drives[drive] && Drives[drive]->FileOpen(&files[i],name,flags)) {
+			files[i]->SetDrive(drive);
+			if (!files[i]->GetName()) files[i]->SetName(name);
+			if (!open) files[i]->Close();
+		}
+		if (!files[i]) {
+			LOG_MSG("SNAPSHOT: Could not open %s again",name);
+			ok=false;
+			break;
+		}
+		files[i]->flags=flags;
+		files[i]->time=time;
+		files[i]->date=date;
+		files[i]->attr=attr;
+		files[i]->refCtr=refs;
+	}
+	dos.errorcode=olderror;
+	Bit16u strategy;
+	if (!ok || reader.Failed() || !reader.Read(dos.date) || !reader.Read(dos.version) ||
+	    !reader.Read(dos.firstMCB) || !reader.Read(dos.errorcode) || !reader.Read(dos.env) ||
+	    !reader.Read(dos.cpmentry) || !reader.Read(dos.return_code) || !reader.Read(dos.return_mode) ||
+	    !reader.Read(dos.current_drive) || !reader.Read(dos.verify) || !reader.Read(dos.breakcheck) ||
+	    !reader.Read(dos.echo) || !reader.Read(dos.direct_output) || !reader.Read(dos.internal_output) ||
+	    !reader.Read(dos.loaded_codepage) || !reader.Read(strategy)) {
+		DOS_CloseFiles(files,Files);
+		return false;
+	}
+	DOS_SetMemAllocStrategy(strategy);
+
+	/* Now the drives and the files can be switched over */
+	for (Bitu i=0;i<DOS_DRIVES;i++) {
+		if (Drives[i]) Drives[i]->SetDir(curdir[i]);
+	}
+	DOS_CloseFiles(Files,files);
+	for (Bitu i=0;i<DOS_FILES;i++) {
+		Files[i]=files[i];
+		if (files[i] && files[i]->GetDrive()!=0xff && files[i]->IsOpen()) files[i]->Seek(&pos[i],DOS_SEEK_SET);
+	}
+	return true;
+}
+
 class DOS:public Module_base{
 private:
 	CALLBACK_HandlerObject callback[7];
@@ -1321,8 +1467,10 @@ public:
 		dos.version.minor=0;
 		dos.direct_output=false;
 		dos.internal_output=false;
+		SNAPSHOT_Register("DOS",1,DOS_SaveState,DOS_LoadState);
 	}
 	~DOS(){
+		SNAPSHOT_Unregister("DOS");
 		for (Bit16u i=0;i<DOS_DRIVES;i++) delete Drives[i];
 	}
 };
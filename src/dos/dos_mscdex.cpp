@@ -27,6 +27,7 @@
 #include "support.h"
 #include "bios_disk.h"
 #include "cpu.h"
+#include "snapshot.h"
 
 #include "cdrom.h"
 
@@ -161,6 +162,9 @@ public:
 
 	bool		ChannelControl		(Bit8u subUnit, TCtrl ctrl);
 	bool		GetChannelControl	(Bit8u subUnit, TCtrl& ctrl);
+
+	void		SaveState			(SnapshotWriter& writer);
+	bool		LoadState			(SnapshotReader& reader);
 };
 
 CMscdex::CMscdex(void) {
@@ -1337,7 +1341,32 @@ void MSCDEX_SetCDInterface(int intNr, int numCD) {
 	forceCD	= numCD;
 }
 
+void CMscdex::SaveState(SnapshotWriter& writer) {
+	writer.Write(numDrives);
+	writer.WriteStruct(dinfo,sizeof(dinfo));
+}
+
+bool CMscdex::LoadState(SnapshotReader& reader) {
+	Bit16u drives;
+	if (!reader.Read(drives)) return false;
+	if (drives!=numDrives) {
+		LOG_MSG("SNAPSHOT: Different number of CD-ROM drives mounted");
+		return false;
+	}
+	return reader.ReadStruct(dinfo,sizeof(dinfo));
+}
+
+static void MSCDEX_SaveState(SnapshotWriter& writer) {
+	mscdex->SaveState(writer);
+	writer.Write(curReqheaderPtr);
+}
+
+static bool MSCDEX_LoadState(SnapshotReader& reader,Bit16u /*version*/) {
+	return mscdex->LoadState(reader) && reader.Read(curReqheaderPtr);
+}
+
 void MSCDEX_ShutDown(Section* /*sec*/) {
+	SNAPSHOT_Unregister("MSCDEX");
 	delete mscdex;
 	mscdex = 0;
 	curReqheaderPtr = 0;
@@ -1354,4 +1383,5 @@ void MSCDEX_Init(Section* sec) {
 	DOS_AddMultiplexHandler(MSCDEX_Handler);
 	/* Create MSCDEX */
 	mscdex = new CMscdex;
+	SNAPSHOT_Register("MSCDEX",1,MSCDEX_SaveState,MSCDEX_LoadState);
 }
@@ -747,6 +747,7 @@ public:
 				if(usefile != NULL) {
 					if(diskSwap[i] != NULL) delete diskSwap[i];
 					diskSwap[i] = new imageDisk(usefile, temp_line.c_str(), floppysize, false);
+					diskSwap[i]->AttachDelta();
 					if (usefile_1==NULL) {
 						usefile_1=usefile;
 						rombytesize_1=rombytesize;
@@ -1272,6 +1273,7 @@ public:
 		std::string fstype = "fat";
 		cmd->FindString("-t",type,true);
 		cmd->FindString("-fs",fstype,true);
+		bool readonly = cmd->FindExist("-ro",true);
 		if(type == "cdrom") type = "iso"; //Tiny hack for people who like to type -t cdrom
 
 		//Check type and exit early.
@@ -1407,7 +1409,7 @@ public:
 
 		if(fstype=="fat") {
 			if (imgsizedetect) {
-				FILE * diskfile = fopen_wrap(temp_line.c_str(), "rb+");
+				FILE * diskfile = fopen_wrap(temp_line.c_str(), (readonly || DISK_DeltaEnabled()) ? "rb" : "rb+");
 				if (!diskfile) {
 					WriteOut(MSG_Get("PROGRAM_IMGMOUNT_INVALID_IMAGE"));
 					return;
@@ -1446,7 +1448,7 @@ public:
 			std::vector<DOS_Drive*>::size_type ct;
 			
 			for (i = 0; i < paths.size(); i++) {
-				DOS_Drive* newDrive = new fatDrive(paths[i].c_str(),sizes[0],sizes[1],sizes[2],sizes[3],0);
+				DOS_Drive* newDrive = new fatDrive(paths[i].c_str(),sizes[0],sizes[1],sizes[2],sizes[3],0,readonly);
 				imgDisks.push_back(newDrive);
 				if(!(dynamic_cast<fatDrive*>(newDrive))->created_successfully) {
 					WriteOut(MSG_Get("PROGRAM_IMGMOUNT_CANT_CREATE"));
@@ -1554,7 +1556,8 @@ public:
 			WriteOut(MSG_Get("PROGRAM_MOUNT_STATUS_2"), drive, tmp.c_str());
 
 		} else if (fstype == "none") {
-			FILE *newDisk = fopen_wrap(temp_line.c_str(), "rb+");
+			bool delta = !readonly && DISK_DeltaEnabled();
+			FILE *newDisk = fopen_wrap(temp_line.c_str(), (readonly || delta) ? "rb" : "rb+");
 			if (!newDisk) {
 				WriteOut(MSG_Get("PROGRAM_IMGMOUNT_INVALID_IMAGE"));
 				return;
@@ -1570,6 +1573,8 @@ public:
 			}
 
 			imageDisk * newImage = new imageDisk(newDisk, temp_line.c_str(), imagesize, hdd);
+			if (delta) newImage->AttachDelta();
+			else if (readonly) newImage->AttachOverlay();
 
 			if (hdd) newImage->Set_Geometry(sizes[2],sizes[3],sizes[1],sizes[0]);
 			if(imageDiskList[drive - '0'] != NULL) delete imageDiskList[drive - '0'];
@@ -1843,7 +1848,10 @@ void DOS_SetupPrograms(void) {
 		"\n"
 		"For \033[33mhardrive\033[0m images: Must specify drive geometry for hard drives:\n"
 		"bytes_per_sector, sectors_per_cylinder, heads_per_cylinder, cylinder_count.\n"
-		"\033[34;1mIMGMOUNT drive-letter location-of-image -size bps,spc,hpc,cyl\033[0m\n");
+		"\033[34;1mIMGMOUNT drive-letter location-of-image -size bps,spc,hpc,cyl\033[0m\n"
+		"\n"
+		"Add \033[34;1m-ro\033[0m to leave the image file untouched, writes are then lost on unmount\n"
+		"instead of going to the image or its delta file.\n");
 	MSG_Add("PROGRAM_IMGMOUNT_INVALID_IMAGE","Could not load image file.\n"
 		"Check that the path is correct and the image is accessible.\n");
 	MSG_Add("PROGRAM_IMGMOUNT_INVALID_GEOMETRY","Could not extract drive geometry from image.\n"
@@ -26,6 +26,9 @@
 #include <vector>
 #include <iterator>
 #include <algorithm>
+#ifdef __LIBRETRO__
+#include "libretro_profiler.h"
+#endif
 
 #if defined (WIN32)   /* Win 32 */
 #define WIN32_LEAN_AND_MEAN        // Exclude rarely-used stuff from 
@@ -60,9 +63,151 @@ bool SortByDirNameRev(DOS_Drive_Cache::CFileInfo* const &a, DOS_Drive_Cache::CFi
 	return strcmp(a->shortname,b->shortname)>0;
 }
 
+// Compares entry numbers with one of the above
+struct DOS_Drive_Cache::CSortByInfo {
+	CSortByInfo(DOS_Drive_Cache* _cache, bool (*_compare)(CFileInfo* const &a, CFileInfo* const &b))
+		: cache(_cache), compare(_compare) {}
+	bool operator()(Bit32u a, Bit32u b) const {
+		return compare(cache->Info(a),cache->Info(b));
+	}
+	DOS_Drive_Cache* cache;
+	bool (*compare)(CFileInfo* const &a, CFileInfo* const &b);
+};
+
+// The hash tables use open addressing and are kept at most half full
+static Bit32u NameHash(const char* name, bool longName) {
+	Bit32u hash = 2166136261u;
+	for (; *name; name++) {
+#if defined (WIN32) || defined (OS2)                        /* Win 32 & OS/2*/
+		hash ^= longName ? (Bit8u)tolower(*name) : (Bit8u)*name;
+#else
+		hash ^= (Bit8u)*name;
+#endif
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+#define NAME_BLOCKSIZE 16384
+
+// Every name in the pool is preceded by the number of entries that use it,
+// and takes a multiple of 4 bytes so the counts stay aligned
+#define NAME_REFS(name) (((Bit32u*)(name))[-1])
+#define NAME_SIZE(len) ((sizeof(Bit32u)+(len)+3) & ~(size_t)3)
+
+const char* DOS_Drive_Cache::InternName(const char* name) {
+	if (nameCount*2 >= nameIndex.size()) {
+		// grow the table and put all names in again
+		std::vector<const char*> oldIndex(nameIndex.size() ? nameIndex.size()*2 : 256,0);
+		oldIndex.swap(nameIndex);
+		size_t mask = nameIndex.size()-1;
+		for (Bitu i=0; i<oldIndex.size(); i++) {
+			if (!oldIndex[i]) continue;
+			size_t pos = NameHash(oldIndex[i],false) & mask;
+			while (nameIndex[pos]) pos = (pos+1) & mask;
+			nameIndex[pos] = oldIndex[i];
+		}
+	}
+	size_t mask = nameIndex.size()-1;
+	size_t pos = NameHash(name,false) & mask;
+	for (; nameIndex[pos]; pos = (pos+1) & mask) {
+		if (strcmp(name,nameIndex[pos]) == 0) {
+			NAME_REFS(nameIndex[pos])++;
+			return nameIndex[pos];
+		}
+	}
+	// not seen before, store it
+	size_t len = strlen(name)+1;
+	size_t size = NAME_SIZE(len);
+	if (nameBlocks.empty() || nameBlockUsed+size > NAME_BLOCKSIZE) {
+		nameBlocks.push_back(new char[NAME_BLOCKSIZE]);
+		nameBlockUsed = 0;
+	}
+	char* copy = nameBlocks.back()+nameBlockUsed+sizeof(Bit32u);
+	memcpy(copy,name,len);
+	NAME_REFS(copy) = 1;
+	nameBlockUsed += size;
+	nameIndex[pos] = copy;
+	nameCount++;
+	nameLiveSize += size;
+	return copy;
+}
+
+void DOS_Drive_Cache::ReleaseName(const char* name) {
+	if (--NAME_REFS(name)) return;
+	// last user gone, take it out of the table. The following names that
+	// would have been placed where it was move up.
+	size_t mask = nameIndex.size()-1;
+	size_t pos = NameHash(name,false) & mask;
+	while (nameIndex[pos] != name) pos = (pos+1) & mask;
+	size_t hole = pos;
+	for (pos = (pos+1) & mask; nameIndex[pos]; pos = (pos+1) & mask) {
+		size_t home = NameHash(nameIndex[pos],false) & mask;
+		if (((pos-home) & mask) >= ((pos-hole) & mask)) {
+			nameIndex[hole] = nameIndex[pos];
+			hole = pos;
+		}
+	}
+	nameIndex[hole] = 0;
+	nameCount--;
+	size_t size = NAME_SIZE(strlen(name)+1);
+	nameLiveSize -= size;
+	nameDeadSize += size;
+}
+
+void DOS_Drive_Cache::CompactNames(void) {
+	// store the names of the remaining entries again and free the rest
+	std::vector<char*> oldBlocks;
+	oldBlocks.swap(nameBlocks);
+	nameIndex.clear();
+	nameCount = 0;
+	nameLiveSize = 0;
+	nameDeadSize = 0;
+	for (Bit32u nr=1; nr<infoCount; nr++) {
+		CFileInfo* info = Info(nr);
+		if (info->orgname) info->orgname = InternName(info->orgname);
+	}
+	for (Bitu i=0; i<oldBlocks.size(); i++) delete[] oldBlocks[i];
+}
+
+void DOS_Drive_Cache::TrimNames(void) {
+	// compact once the names of deleted entries take more room than the
+	// ones in use, so the work is paid for by the deletions
+	if (nameDeadSize > NAME_BLOCKSIZE && nameDeadSize > nameLiveSize) CompactNames();
+}
+
+Bit32u DOS_Drive_Cache::NewFileInfo(const char* orgname) {
+	Bit32u nr;
+	if (!freeInfos.empty()) {
+		nr = freeInfos.back();
+		freeInfos.pop_back();
+	} else {
+		if ((infoCount >> FILEINFO_BLOCKSHIFT) >= infoBlocks.size())
+			infoBlocks.push_back(new CFileInfo[1 << FILEINFO_BLOCKSHIFT]);
+		nr = infoCount++;
+	}
+	CFileInfo* info = Info(nr);
+	info->orgname = InternName(orgname);
+	info->shortname[0] = 0;
+	info->isOverlayDir = info->isDir = false;
+	info->id = MAX_OPENDIRS;
+	info->shortNr = 0;
+	info->contents = 0;
+	return nr;
+}
+
+DOS_Drive_Cache::CDirInfo* DOS_Drive_Cache::GetContents(CFileInfo* dir) {
+	if (!dir->contents) dir->contents = new CDirInfo;
+	return dir->contents;
+}
+
 DOS_Drive_Cache::DOS_Drive_Cache(void) {
-	dirBase			= new CFileInfo;
-	save_dir		= 0;
+	infoCount		= 1;
+	nameBlockUsed	= 0;
+	nameCount		= 0;
+	nameLiveSize	= 0;
+	nameDeadSize	= 0;
+	dirBase			= NewFileInfo("");
 	srchNr			= 0;
 	label[0]		= 0;
 	basePath[0]		= 0;
@@ -73,8 +218,12 @@ DOS_Drive_Cache::DOS_Drive_Cache(void) {
 }
 
 DOS_Drive_Cache::DOS_Drive_Cache(const char* path) {
-	dirBase			= new CFileInfo;
-	save_dir		= 0;
+	infoCount		= 1;
+	nameBlockUsed	= 0;
+	nameCount		= 0;
+	nameLiveSize	= 0;
+	nameDeadSize	= 0;
+	dirBase			= NewFileInfo("");
 	srchNr			= 0;
 	label[0]		= 0;
 	basePath[0]		= 0;
@@ -88,6 +237,8 @@ DOS_Drive_Cache::DOS_Drive_Cache(const char* path) {
 DOS_Drive_Cache::~DOS_Drive_Cache(void) {
 	Clear();
 	for (Bit32u i=0; i<MAX_OPENDIRS; i++) { DeleteFileInfo(dirFindFirst[i]); dirFindFirst[i]=0; };
+	for (Bitu i=0; i<infoBlocks.size(); i++) delete[] infoBlocks[i];
+	for (Bitu i=0; i<nameBlocks.size(); i++) delete[] nameBlocks[i];
 }
 
 void DOS_Drive_Cache::Clear(void) {
@@ -99,8 +250,10 @@ void DOS_Drive_Cache::Clear(void) {
 void DOS_Drive_Cache::EmptyCache(void) {
 	// Empty Cache and reinit
 	Clear();
-	dirBase		= new CFileInfo;
-	save_dir	= 0;
+	CompactNames();
+	dirBase		= NewFileInfo("");
+	pathList.clear();
+	pathIndex.clear();
 	srchNr		= 0;
 	if (basePath[0] != 0) SetBaseDir(basePath);
 }
@@ -184,7 +337,7 @@ char* DOS_Drive_Cache::GetExpandName(const char* path) {
 	if (pos) {
 		// Last Entry = File
 		strcpy(dir,pos+1); 
-		GetLongName(dirInfo, dir);
+		GetLongNameInfo(dirInfo, dir);
 		strcat(work,dir);
 	}
 
@@ -214,7 +367,7 @@ void DOS_Drive_Cache::AddEntry(const char* path, bool checkExists) {
 		strcpy(file,pos+1);	
 		// Check if file already exists, then don't add new entry...
 		if (checkExists) {
-			if (GetLongName(dir,file)>=0) return;
+			if (GetLongNameInfo(dir,file)) return;
 		}
 
 		CreateEntry(dir,file,false);
@@ -224,8 +377,8 @@ void DOS_Drive_Cache::AddEntry(const char* path, bool checkExists) {
 			Bit32u i;
 			// Check if there are any open search dir that are affected by this...
 			if (dir) for (i=0; i<MAX_OPENDIRS; i++) {
-				if ((dirSearch[i]==dir) && ((Bit32u)index<=dirSearch[i]->nextEntry)) 
-					dirSearch[i]->nextEntry++;
+				if ((dirSearch[i]==dir) && ((Bit32u)index<=dir->contents->nextEntry)) 
+					dir->contents->nextEntry++;
 			}
 		}
 		//		LOG_DEBUG("DIR: Added Entry %s",path);
@@ -263,11 +416,11 @@ void DOS_Drive_Cache::AddEntryDirOverlay(const char* path, bool checkExists) {
 		strcpy(file,pos + 1);	
 		// Check if directory already exists, then don't add new entry...
 		if (checkExists) {
-			Bits index = GetLongName(dir,file);
-			if (index >= 0) {
+			CFileInfo* info = GetLongNameInfo(dir,file);
+			if (info) {
 				//directory already exists, but most likely empty. 
-				dir = dir->fileList[index];
-				if (dir->isOverlayDir && dir->fileList.empty()) {
+				dir = info;
+				if (dir->isOverlayDir && GetContents(dir)->fileList.empty()) {
 					//maybe care about searches ? but this function should only run on cache inits/refreshes.
 					//add dot entries
 					CreateEntry(dir,".",true);
@@ -278,18 +431,17 @@ void DOS_Drive_Cache::AddEntryDirOverlay(const char* path, bool checkExists) {
 		}
 
 		CreateEntry(dir,file,true);
-		
 
 		Bits index = GetLongName(dir,file);
 		if (index>=0) {
 			Bit32u i;
 			// Check if there are any open search dir that are affected by this...
 			if (dir) for (i=0; i<MAX_OPENDIRS; i++) {
-				if ((dirSearch[i]==dir) && ((Bit32u)index<=dirSearch[i]->nextEntry)) 
-					dirSearch[i]->nextEntry++;
+				if ((dirSearch[i]==dir) && ((Bit32u)index<=dir->contents->nextEntry)) 
+					dir->contents->nextEntry++;
 			}
 
-			dir = dir->fileList[index];
+			dir = Info(dir->contents->fileList[index]);
 			dir->isOverlayDir = true;
 			CreateEntry(dir,".",true);
 			CreateEntry(dir,"..",true);
@@ -302,7 +454,7 @@ void DOS_Drive_Cache::AddEntryDirOverlay(const char* path, bool checkExists) {
 
 void DOS_Drive_Cache::DeleteEntry(const char* path, bool ignoreLastDir) {
 	CacheOut(path,ignoreLastDir);
-	if (dirSearch[srchNr] && (dirSearch[srchNr]->nextEntry>0)) dirSearch[srchNr]->nextEntry--;
+	if (dirSearch[srchNr] && (GetContents(dirSearch[srchNr])->nextEntry>0)) dirSearch[srchNr]->contents->nextEntry--;
 
 	if (!ignoreLastDir) {
 		// Check if there are any open search dir that are affected by this...
@@ -310,8 +462,8 @@ void DOS_Drive_Cache::DeleteEntry(const char* path, bool ignoreLastDir) {
 		char expand	[CROSS_LEN];
 		CFileInfo* dir = FindDirInfo(path,expand);
 		if (dir) for (i=0; i<MAX_OPENDIRS; i++) {
-			if ((dirSearch[i]==dir) && (dirSearch[i]->nextEntry>0)) 
-				dirSearch[i]->nextEntry--;
+			if ((dirSearch[i]==dir) && (GetContents(dir)->nextEntry>0)) 
+				dir->contents->nextEntry--;
 		}	
 	}
 }
@@ -338,18 +490,22 @@ void DOS_Drive_Cache::CacheOut(const char* path, bool ignoreLastDir) {
 //	LOG_DEBUG("DIR: Caching out %s : dir %s",expand,dir->orgname);
 	// delete file objects...
 	//Maybe check if it is a file and then only delete the file and possibly the long name. instead of all objects in the dir.
-	for(Bit32u i=0; i<dir->fileList.size(); i++) {
-		if (dirSearch[srchNr]==dir->fileList[i]) dirSearch[srchNr] = 0;
-		DeleteFileInfo(dir->fileList[i]); dir->fileList[i] = 0;
+	CDirInfo* contents = GetContents(dir);
+	for(Bit32u i=0; i<contents->fileList.size(); i++) {
+		if (dirSearch[srchNr]==Info(contents->fileList[i])) dirSearch[srchNr] = 0;
+		DeleteFileInfo(contents->fileList[i]); contents->fileList[i] = 0;
 	}
 	// clear lists
-	dir->fileList.clear();
-	dir->longNameList.clear();
-	save_dir = 0;
+	contents->fileList.clear();
+	contents->longNameList.clear();
+	contents->shortIndex.clear();
+	contents->longIndex.clear();
+	contents->generation++;
+	TrimNames();
 }
 
 bool DOS_Drive_Cache::IsCachedIn(CFileInfo* curDir) {
-	return (curDir->isOverlayDir || curDir->fileList.size()>0);
+	return (curDir->isOverlayDir || (curDir->contents && curDir->contents->fileList.size()>0));
 }
 
 
@@ -361,21 +517,10 @@ bool DOS_Drive_Cache::GetShortName(const char* fullname, char* shortname) {
 	const char* pos = strrchr(fullname,CROSS_FILESPLIT);
 	if (pos) pos++; else return false;
 
-	std::vector<CFileInfo*>::size_type filelist_size = curDir->longNameList.size();
-	if (GCC_UNLIKELY(filelist_size<=0)) return false;
-
-	// The orgname part of the list is not sorted (shortname is)! So we can only walk through it.
-	for(Bitu i = 0; i < filelist_size; i++) {
-#if defined (WIN32) || defined (OS2)                        /* Win 32 & OS/2*/
-		if (strcasecmp(pos,curDir->longNameList[i]->orgname) == 0) {
-#else
-		if (strcmp(pos,curDir->longNameList[i]->orgname) == 0) {
-#endif
-			strcpy(shortname,curDir->longNameList[i]->shortname);
-			return true;
-		}
-	}
-	return false;
+	CFileInfo* info = IndexFind(GetContents(curDir)->longIndex,pos,true);
+	if (!info) return false;
+	strcpy(shortname,info->shortname);
+	return true;
 }
 
 int DOS_Drive_Cache::CompareShortname(const char* compareName, const char* shortName) {
@@ -410,7 +555,8 @@ int DOS_Drive_Cache::CompareShortname(const char* compareName, const char* short
 }
 
 Bitu DOS_Drive_Cache::CreateShortNameID(CFileInfo* curDir, const char* name) {
-	std::vector<CFileInfo*>::size_type filelist_size = curDir->longNameList.size();
+	const std::vector<Bit32u>& longNameList = GetContents(curDir)->longNameList;
+	std::vector<Bit32u>::size_type filelist_size = longNameList.size();
 	if (GCC_UNLIKELY(filelist_size<=0)) return 1;	// shortener IDs start with 1
 
 	Bitu foundNr	= 0;	
@@ -420,16 +566,16 @@ Bitu DOS_Drive_Cache::CreateShortNameID(CFileInfo* curDir, const char* name) {
 
 	while (low<=high) {
 		mid = (low+high)/2;
-		res = CompareShortname(name,curDir->longNameList[mid]->shortname);
+		res = CompareShortname(name,Info(longNameList[mid])->shortname);
 		
 		if (res>0)	low  = mid+1; else
 		if (res<0)	high = mid-1; 
 		else {
 			// any more same x chars in next entries ?	
 			do {
-				foundNr = curDir->longNameList[mid]->shortNr;
+				foundNr = Info(longNameList[mid])->shortNr;
 				mid++;
-			} while((Bitu)mid<curDir->longNameList.size() && (CompareShortname(name,curDir->longNameList[mid]->shortname)==0));
+			} while((Bitu)mid<longNameList.size() && (CompareShortname(name,Info(longNameList[mid])->shortname)==0));
 			break;
 		};
 	}
@@ -456,13 +602,13 @@ bool DOS_Drive_Cache::RemoveTrailingDot(char* shortname) {
 
 
 // From the Wine project
-static Bits wine_hash_short_file_name( char* name, char* buffer )
+static Bits wine_hash_short_file_name( const char* name, char* buffer )
 {
 	static const char hash_chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ012345";
 	static const char invalid_chars[] = { '*','?','<','>','|','"','+','=',',',';','[',']',' ','\345','~','.',0 };
-	char* p;
-	char* ext;
-	char* end = name + strlen(name);
+	const char* p;
+	const char* ext;
+	const char* end = name + strlen(name);
 	char* dst;
 	unsigned short hash;
 	int i;
@@ -503,42 +649,90 @@ static Bits wine_hash_short_file_name( char* name, char* buffer )
 #endif
 
 Bits DOS_Drive_Cache::GetLongName(CFileInfo* curDir, char* shortName) {
-	std::vector<CFileInfo*>::size_type filelist_size = curDir->fileList.size();
-	if (GCC_UNLIKELY(filelist_size<=0)) return -1;
+	CFileInfo* info = GetLongNameInfo(curDir,shortName);
+	if (!info) return -1;
+	// Return array number of element, the list is sorted by short name
+	const std::vector<Bit32u>& fileList = curDir->contents->fileList;
+	Bits low	= 0;
+	Bits high	= (Bits)(fileList.size()-1);
+	while (low<high) {
+		Bits mid = (low+high)/2;
+		if (strcmp(Info(fileList[mid])->shortname,info->shortname)<0) low = mid+1;
+		else high = mid;
+	}
+	while (Info(fileList[low]) != info) low++;
+	return low;
+}
+
+DOS_Drive_Cache::CFileInfo* DOS_Drive_Cache::GetLongNameInfo(CFileInfo* curDir, char* shortName) {
+	if (!curDir->contents) return 0;
+	const std::vector<Bit32u>& fileList = curDir->contents->fileList;
+	std::vector<Bit32u>::size_type filelist_size = fileList.size();
+	if (GCC_UNLIKELY(filelist_size<=0)) return 0;
 
 	// Remove dot, if no extension...
 	RemoveTrailingDot(shortName);
-	// Search long name and return array number of element
-	Bits low	= 0;
-	Bits high	= (Bits)(filelist_size-1);
-	Bits mid,res;
-	while (low<=high) {
-		mid = (low+high)/2;
-		res = strcmp(shortName,curDir->fileList[mid]->shortname);
-		if (res>0)	low  = mid+1; else
-		if (res<0)	high = mid-1; else
-		{	// Found
-			strcpy(shortName,curDir->fileList[mid]->orgname);
-			return mid;
-		};
+	// Search long name
+	CFileInfo* info = IndexFind(curDir->contents->shortIndex,shortName,false);
+	if (info) {
+		strcpy(shortName,info->orgname);
+		return info;
 	}
 #ifdef WINE_DRIVE_SUPPORT
-	if (strlen(shortName) < 8 || shortName[4] != '~' || shortName[5] == '.' || shortName[6] == '.' || shortName[7] == '.') return -1; // not available
+	if (strlen(shortName) < 8 || shortName[4] != '~' || shortName[5] == '.' || shortName[6] == '.' || shortName[7] == '.') return 0; // not available
 	// else it's most likely a Wine style short name ABCD~###, # = not dot  (length at least 8) 
 	// The above test is rather strict as the following loop can be really slow if filelist_size is large.
 	char buff[CROSS_LEN];
 	for (Bitu i = 0; i < filelist_size; i++) {
-		res = wine_hash_short_file_name(curDir->fileList[i]->orgname,buff);
+		CFileInfo* info = Info(fileList[i]);
+		Bits res = wine_hash_short_file_name(info->orgname,buff);
 		buff[res] = 0;
 		if (!strcmp(shortName,buff)) {	
 			// Found
-			strcpy(shortName,curDir->fileList[i]->orgname);
-			return (Bits)i;
+			strcpy(shortName,info->orgname);
+			return info;
 		}
 	}
 #endif
 	// not available
-	return -1;
+	return 0;
+}
+
+void DOS_Drive_Cache::IndexInsert(std::vector<Bit32u>& index, Bit32u nr, bool longName) {
+	size_t mask = index.size()-1;
+	CFileInfo* info = Info(nr);
+	size_t pos = NameHash(longName ? info->orgname : info->shortname,longName) & mask;
+	while (index[pos]) pos = (pos+1) & mask;
+	index[pos] = nr;
+}
+
+void DOS_Drive_Cache::IndexAdd(std::vector<Bit32u>& index, const std::vector<Bit32u>& list, Bit32u nr, bool longName) {
+	// list already contains nr
+	if (list.size()*2 > index.size()) {
+		// grow the table and put all entries of the list in again
+		std::vector<Bit32u>::size_type size = 16;
+		while (size < list.size()*4) size *= 2;
+		index.assign(size,0);
+		for (Bitu i=0; i<list.size(); i++) IndexInsert(index,list[i],longName);
+	} else IndexInsert(index,nr,longName);
+}
+
+DOS_Drive_Cache::CFileInfo* DOS_Drive_Cache::IndexFind(const std::vector<Bit32u>& index, const char* name, bool longName) {
+	if (index.empty()) return 0;
+	size_t mask = index.size()-1;
+	for (size_t pos = NameHash(name,longName) & mask; index[pos]; pos = (pos+1) & mask) {
+		CFileInfo* info = Info(index[pos]);
+		if (!longName) {
+			if (strcmp(name,info->shortname) == 0) return info;
+#if defined (WIN32) || defined (OS2)                        /* Win 32 & OS/2*/
+		} else if (strcasecmp(name,info->orgname) == 0) {
+#else
+		} else if (strcmp(name,info->orgname) == 0) {
+#endif
+			return info;
+		}
+	}
+	return 0;
 }
 
 bool DOS_Drive_Cache::RemoveSpaces(char* str) {
@@ -552,7 +746,8 @@ bool DOS_Drive_Cache::RemoveSpaces(char* str) {
 	return (curpos!=chkpos);
 }
 
-void DOS_Drive_Cache::CreateShortName(CFileInfo* curDir, CFileInfo* info) {
+void DOS_Drive_Cache::CreateShortName(CFileInfo* curDir, Bit32u nr) {
+	CFileInfo* info		= Info(nr);
 	Bits	len			= 0;
 	bool	createShort = false;
 
@@ -585,7 +780,7 @@ void DOS_Drive_Cache::CreateShortName(CFileInfo* curDir, CFileInfo* info) {
 	if (!createShort) {
 		char buffer[CROSS_LEN];
 		strcpy(buffer,tmpName);
-		createShort = (GetLongName(curDir,buffer)>=0);
+		createShort = (GetLongNameInfo(curDir,buffer)!=0);
 	}
 
 	if (createShort) {
@@ -613,28 +808,30 @@ void DOS_Drive_Cache::CreateShortName(CFileInfo* curDir, CFileInfo* info) {
 		}
 
 		// keep list sorted for CreateShortNameID to work correctly
-		if (curDir->longNameList.size()>0) {
-			if (!(strcmp(info->shortname,curDir->longNameList.back()->shortname)<0)) {
+		CDirInfo* contents = GetContents(curDir);
+		if (contents->longNameList.size()>0) {
+			if (!(strcmp(info->shortname,Info(contents->longNameList.back())->shortname)<0)) {
 				// append at end of list
-				curDir->longNameList.push_back(info);
+				contents->longNameList.push_back(nr);
 			} else {
 				// look for position where to insert this element
 				bool found=false;
-				std::vector<CFileInfo*>::iterator it;
-				for (it=curDir->longNameList.begin(); it!=curDir->longNameList.end(); ++it) {
-					if (strcmp(info->shortname,(*it)->shortname)<0) {
+				std::vector<Bit32u>::iterator it;
+				for (it=contents->longNameList.begin(); it!=contents->longNameList.end(); ++it) {
+					if (strcmp(info->shortname,Info(*it)->shortname)<0) {
 						found = true;
 						break;
 					}
 				}
 				// Put it in longname list...
-				if (found) curDir->longNameList.insert(it,info);
-				else curDir->longNameList.push_back(info);
+				if (found) contents->longNameList.insert(it,nr);
+				else contents->longNameList.push_back(nr);
 			}
 		} else {
 			// empty file list, append
-			curDir->longNameList.push_back(info);
+			contents->longNameList.push_back(nr);
 		}
+		IndexAdd(contents->longIndex,contents->longNameList,nr,true);
 	} else {
 		strcpy(info->shortname,tmpName);
 	}
@@ -649,13 +846,20 @@ DOS_Drive_Cache::CFileInfo* DOS_Drive_Cache::FindDirInfo(const char* path, char*
 	char		work [CROSS_LEN];
 	const char*	start = path;
 	const char*		pos;
-	CFileInfo*	curDir = dirBase;
+	CFileInfo*	curDir = Info(dirBase);
 	Bit16u		id;
 
-	if (save_dir && (strcmp(path,save_path)==0)) {
-		strcpy(expandedPath,save_expanded);
-		return save_dir;
-	};
+	// Resolved before ?
+	pathKey.assign(path);
+	std::unordered_map<std::string,CPathList::iterator>::iterator saved = pathIndex.find(pathKey);
+	if (saved != pathIndex.end() && IsPathCurrent(*saved->second)) {
+		pathList.splice(pathList.begin(),pathList,saved->second);
+		strcpy(expandedPath,saved->second->expanded.c_str());
+		return saved->second->dir;
+	}
+#ifdef __LIBRETRO__
+	profiler::count(profiler::Counter::PathCacheMisses);
+#endif
 
 //	LOG_DEBUG("DIR: Find %s",path);
 
@@ -679,6 +883,7 @@ DOS_Drive_Cache::CFileInfo* DOS_Drive_Cache::FindDirInfo(const char* path, char*
 		};
 	};
 
+	pathDirs.clear();
 	do {
 //		bool errorcheck = false;
 		pos = strchr(start,CROSS_FILESPLIT);
@@ -686,8 +891,10 @@ DOS_Drive_Cache::CFileInfo* DOS_Drive_Cache::FindDirInfo(const char* path, char*
 		else	 { strcpy(dir,start); };
  
 		// Path found
-		Bits nextDir = GetLongName(curDir,dir);
+		CFileInfo* nextDir = GetLongNameInfo(curDir,dir);
 		strcat(expandedPath,dir);
+		CPathDir walked = { curDir, GetContents(curDir)->generation };
+		pathDirs.push_back(walked);
 
 		// Error check
 /*		if ((errorcheck) && (nextDir<0)) {
@@ -695,9 +902,8 @@ DOS_Drive_Cache::CFileInfo* DOS_Drive_Cache::FindDirInfo(const char* path, char*
 		};
 */
 		// Follow Directory
-		if ((nextDir>=0) && curDir->fileList[nextDir]->isDir) {
-			curDir = curDir->fileList[nextDir];
-			strcpy (curDir->orgname,dir);
+		if (nextDir && nextDir->isDir) {
+			curDir = nextDir;
 			if (!IsCachedIn(curDir)) {
 				if (OpenDir(curDir,expandedPath,id)) {
 					char buffer[CROSS_LEN];
@@ -718,19 +924,40 @@ DOS_Drive_Cache::CFileInfo* DOS_Drive_Cache::FindDirInfo(const char* path, char*
 		}
 	} while (pos);
 
-	// Save last result for faster access next time
-	strcpy(save_path,path);
-	strcpy(save_expanded,expandedPath);
-	save_dir = curDir;
+	// Save result for faster access next time, reusing the least recently used entry
+	if (saved == pathIndex.end()) {
+		if (pathList.size() < MAX_CACHEDPATHS) {
+			pathList.push_front(CPathEntry());
+		} else {
+			pathIndex.erase(pathList.back().path);
+			pathList.splice(pathList.begin(),pathList,--pathList.end());
+		}
+		pathList.front().path = pathKey;
+		saved = pathIndex.insert(std::make_pair(pathKey,pathList.begin())).first;
+	} else pathList.splice(pathList.begin(),pathList,saved->second);
+	CPathEntry& entry = pathList.front();
+	entry.expanded = expandedPath;
+	entry.dir = curDir;
+	entry.dirs = pathDirs;
 
 	return curDir;
 }
 
+bool DOS_Drive_Cache::IsPathCurrent(const CPathEntry& entry) {
+	// A directory that is cached out or deleted changes the generation of
+	// its parent first, so the ones after a changed directory aren't looked at
+	for (Bitu i=0; i<entry.dirs.size(); i++) {
+		const CDirInfo* contents = entry.dirs[i].dir->contents;
+		if (!contents || contents->generation != entry.dirs[i].generation) return false;
+	}
+	return true;
+}
+
 bool DOS_Drive_Cache::OpenDir(const char* path, Bit16u& id) {
 	char expand[CROSS_LEN] = {0};
 	CFileInfo* dir = FindDirInfo(path,expand);
 	if (OpenDir(dir,expand,id)) {
-		dirSearch[id]->nextEntry = 0;
+		GetContents(dirSearch[id])->nextEntry = 0;
 		return true;
 	}
 	return false;
@@ -764,49 +991,52 @@ bool DOS_Drive_Cache::OpenDir(CFileInfo* dir, const char* expand, Bit16u& id) {
 }
 
 void DOS_Drive_Cache::CreateEntry(CFileInfo* dir, const char* name, bool is_directory) {
-	CFileInfo* info = new CFileInfo;
-	strcpy(info->orgname, name);				
+	Bit32u nr = NewFileInfo(name);
+	CFileInfo* info = Info(nr);
 	info->shortNr = 0;
 	info->isDir = is_directory;
 
 	// Check for long filenames...
-	CreateShortName(dir, info);		
+	CreateShortName(dir, nr);		
 
 	bool found = false;
 
 	// keep list sorted (so GetLongName works correctly, used by CreateShortName in this routine)
-	if (dir->fileList.size()>0) {
-		if (!(strcmp(info->shortname,dir->fileList.back()->shortname)<0)) {
+	CDirInfo* contents = GetContents(dir);
+	if (contents->fileList.size()>0) {
+		if (!(strcmp(info->shortname,Info(contents->fileList.back())->shortname)<0)) {
 			// append at end of list
-			dir->fileList.push_back(info);
+			contents->fileList.push_back(nr);
 		} else {
 			// look for position where to insert this element
-			std::vector<CFileInfo*>::iterator it;
-			for (it=dir->fileList.begin(); it!=dir->fileList.end(); ++it) {
-				if (strcmp(info->shortname,(*it)->shortname)<0) {
+			std::vector<Bit32u>::iterator it;
+			for (it=contents->fileList.begin(); it!=contents->fileList.end(); ++it) {
+				if (strcmp(info->shortname,Info(*it)->shortname)<0) {
 					found = true;
 					break;
 				}
 			}
 			// Put file in lists
-			if (found) dir->fileList.insert(it,info);
-			else dir->fileList.push_back(info);
+			if (found) contents->fileList.insert(it,nr);
+			else contents->fileList.push_back(nr);
 		}
 	} else {
 		// empty file list, append
-		dir->fileList.push_back(info);
+		contents->fileList.push_back(nr);
 	}
+	IndexAdd(contents->shortIndex,contents->fileList,nr,false);
+	contents->generation++;
 }
 
 void DOS_Drive_Cache::CopyEntry(CFileInfo* dir, CFileInfo* from) {
-	CFileInfo* info = new CFileInfo;
+	Bit32u nr = NewFileInfo(from->orgname);
+	CFileInfo* info = Info(nr);
 	// just copy things into new fileinfo
-	strcpy(info->orgname, from->orgname);				
 	strcpy(info->shortname, from->shortname);				
 	info->shortNr = from->shortNr;
 	info->isDir = from->isDir;
 
-	dir->fileList.push_back(info);
+	GetContents(dir)->fileList.push_back(nr);
 }
 
 bool DOS_Drive_Cache::ReadDir(Bit16u id, char* &result) {
@@ -842,11 +1072,11 @@ bool DOS_Drive_Cache::ReadDir(Bit16u id, char* &result) {
 			return false;
 		} else {	
 			char buffer[128];
-			sprintf(buffer,"DIR: Caching in %s (%d Files)",dirPath,dirSearch[srchNr]->fileList.size());
+			sprintf(buffer,"DIR: Caching in %s (%d Files)",dirPath,dirSearch[srchNr]->contents->fileList.size());
 			LOG_DEBUG(buffer);
 		};*/
 	};
-	if (SetResult(dirSearch[id], result, dirSearch[id]->nextEntry)) return true;
+	if (SetResult(dirSearch[id], result, GetContents(dirSearch[id])->nextEntry)) return true;
 	if (dirSearch[id]) {
 		dirSearch[id]->id = MAX_OPENDIRS;
 		dirSearch[id] = 0;
@@ -859,12 +1089,13 @@ bool DOS_Drive_Cache::SetResult(CFileInfo* dir, char* &result, Bitu entryNr)
 	static char res[CROSS_LEN] = { 0 };
 
 	result = res;
-	if (entryNr>=dir->fileList.size()) return false;
-	CFileInfo* info = dir->fileList[entryNr];
+	CDirInfo* contents = GetContents(dir);
+	if (entryNr>=contents->fileList.size()) return false;
+	CFileInfo* info = Info(contents->fileList[entryNr]);
 	// copy filename, short version
 	strcpy(res,info->shortname);
 	// Set to next Entry
-	dir->nextEntry = entryNr+1;
+	contents->nextEntry = entryNr+1;
 	return true;
 }
 
@@ -899,20 +1130,23 @@ bool DOS_Drive_Cache::FindFirst(char* path, Bit16u& id) {
 		}
 	   
 	}		
-	dirFindFirst[dirFindFirstID] = new CFileInfo();
-	dirFindFirst[dirFindFirstID]-> nextEntry	= 0;
+	dirFindFirst[dirFindFirstID] = NewFileInfo("");
+	CFileInfo* findFirst = Info(dirFindFirst[dirFindFirstID]);
+	CDirInfo* contents = GetContents(findFirst);
 
 	// Copy entries to use with FindNext
-	for (Bitu i=0; i<dirSearch[dirID]->fileList.size(); i++) {
-		CopyEntry(dirFindFirst[dirFindFirstID],dirSearch[dirID]->fileList[i]);
+	const std::vector<Bit32u>& fileList = GetContents(dirSearch[dirID])->fileList;
+	contents->fileList.reserve(fileList.size());
+	for (Bitu i=0; i<fileList.size(); i++) {
+		CopyEntry(findFirst,Info(fileList[i]));
 	}
 	// Now re-sort the fileList accordingly to output
 	switch (sortDirType) {
 		case ALPHABETICAL		: break;
-//		case ALPHABETICAL		: std::sort(dirFindFirst[dirFindFirstID]->fileList.begin(), dirFindFirst[dirFindFirstID]->fileList.end(), SortByName);		break;
-		case DIRALPHABETICAL	: std::sort(dirFindFirst[dirFindFirstID]->fileList.begin(), dirFindFirst[dirFindFirstID]->fileList.end(), SortByDirName);		break;
-		case ALPHABETICALREV	: std::sort(dirFindFirst[dirFindFirstID]->fileList.begin(), dirFindFirst[dirFindFirstID]->fileList.end(), SortByNameRev);		break;
-		case DIRALPHABETICALREV	: std::sort(dirFindFirst[dirFindFirstID]->fileList.begin(), dirFindFirst[dirFindFirstID]->fileList.end(), SortByDirNameRev);	break;
+//		case ALPHABETICAL		: std::sort(contents->fileList.begin(), contents->fileList.end(), CSortByInfo(this,SortByName));		break;
+		case DIRALPHABETICAL	: std::sort(contents->fileList.begin(), contents->fileList.end(), CSortByInfo(this,SortByDirName));		break;
+		case ALPHABETICALREV	: std::sort(contents->fileList.begin(), contents->fileList.end(), CSortByInfo(this,SortByNameRev));		break;
+		case DIRALPHABETICALREV	: std::sort(contents->fileList.begin(), contents->fileList.end(), CSortByInfo(this,SortByDirNameRev));	break;
 		case NOSORT				: break;
 	}
 
@@ -927,7 +1161,8 @@ bool DOS_Drive_Cache::FindNext(Bit16u id, char* &result) {
 		LOG(LOG_MISC,LOG_ERROR)("DIRCACHE: FindFirst/Next failure : ID out of range: %04X",id);
 		return false;
 	}
-	if (!SetResult(dirFindFirst[id], result, dirFindFirst[id]->nextEntry)) {
+	CFileInfo* findFirst = Info(dirFindFirst[id]);
+	if (!SetResult(findFirst, result, findFirst->contents->nextEntry)) {
 		// free slot
 		DeleteFileInfo(dirFindFirst[id]); dirFindFirst[id] = 0;
 		return false;
@@ -935,19 +1170,20 @@ bool DOS_Drive_Cache::FindNext(Bit16u id, char* &result) {
 	return true;
 }
 
-void DOS_Drive_Cache::ClearFileInfo(CFileInfo *dir) {
-	for(Bit32u i=0; i<dir->fileList.size(); i++) {
-		if (CFileInfo *info = dir->fileList[i])
-			ClearFileInfo(info);
+void DOS_Drive_Cache::DeleteFileInfo(Bit32u nr) {
+	if (!nr) return;
+	CFileInfo* dir = Info(nr);
+	if (CDirInfo* contents = dir->contents) {
+		for(Bit32u i=0; i<contents->fileList.size(); i++)
+			DeleteFileInfo(contents->fileList[i]);
+		delete contents;
+		dir->contents = 0;
 	}
 	if (dir->id != MAX_OPENDIRS) {
 		dirSearch[dir->id] = 0;
 		dir->id = MAX_OPENDIRS;
 	}
-}
-
-void DOS_Drive_Cache::DeleteFileInfo(CFileInfo *dir) {
-	if (dir)
-		ClearFileInfo(dir);
-	delete dir;
+	ReleaseName(dir->orgname);
+	dir->orgname = 0;
+	freeInfos.push_back(nr);
 }
@@ -21,6 +21,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <algorithm>
 #include "dosbox.h"
 #include "dos_inc.h"
 #include "drives.h"
@@ -60,6 +61,9 @@ public:
 	bool loadedSector;
 	fatDrive *myDrive;
 private:
+	void LoadSector(void);
+	Bit32u TransferSectors(Bit8u * data, Bit32u count, bool write);
+	bool AllocateUpTo(Bit32u endpos);
 	enum { NONE,READ,WRITE } last_action;
 	Bit16u info;
 };
@@ -99,56 +103,93 @@ fatFile::fatFile(const char* /*name*/, Bit32u startCluster, Bit32u fileLen, fatD
 	}
 }
 
+/* Loads the sector seekpos is in, if the file has one allocated there */
+void fatFile::LoadSector(void) {
+	currentSector = myDrive->getAbsoluteSectFromBytePos(firstCluster, seekpos);
+	if (currentSector == 0) {
+		loadedSector = false;
+		return;
+	}
+	curSectOff = seekpos % myDrive->getSectorSize();
+	myDrive->readSector(currentSector, sectorBuffer);
+	loadedSector = true;
+}
+
+/* Transfers whole sectors starting at seekpos (which must be sector aligned)
+ * straight between the disk and data. Sectors that are consecutive on disk are
+ * done with a single access. Returns the number of sectors transferred, which
+ * is less than count if the cluster chain ends early. */
+Bit32u fatFile::TransferSectors(Bit8u * data, Bit32u count, bool write) {
+	Bit32u sectSize = myDrive->getSectorSize();
+	Bit32u done = 0;
+	while (done < count) {
+		Bit32u first = myDrive->getAbsoluteSectFromBytePos(firstCluster, seekpos + done * sectSize);
+		if (first == 0) break;
+		Bit32u run = 1;
+		while (done + run < count &&
+		       myDrive->getAbsoluteSectFromBytePos(firstCluster, seekpos + (done + run) * sectSize) == first + run)
+			run++;
+		if (write) myDrive->writeSectors(first, run, data + done * sectSize);
+		else myDrive->readSectors(first, run, data + done * sectSize);
+		done += run;
+	}
+	return done;
+}
+
 bool fatFile::Read(Bit8u * data, Bit16u *size) {
 	if ((this->flags & 0xf) == OPEN_WRITE) {	// check if file opened in write-only mode
 		DOS_SetError(DOSERR_ACCESS_DENIED);
 		return false;
 	}
-	Bit16u sizedec, sizecount;
 	if(seekpos >= filelength) {
 		*size = 0;
 		return true;
 	}
 
-	if (!loadedSector) {
-		currentSector = myDrive->getAbsoluteSectFromBytePos(firstCluster, seekpos);
-		if(currentSector == 0) {
-			/* EOC reached before EOF */
-			*size = 0;
-			loadedSector = false;
-			return true;
-		}
-		curSectOff = seekpos % myDrive->getSectorSize();
-		myDrive->readSector(currentSector, sectorBuffer);
-		loadedSector = true;
-	}
+	Bit32u sectSize = myDrive->getSectorSize();
+	Bit32u sizedec = *size;
+	Bit16u sizecount = 0;
+	if (sizedec > filelength - seekpos) sizedec = filelength - seekpos;
 
-	sizedec = *size;
-	sizecount = 0;
 	while(sizedec != 0) {
-		if(seekpos >= filelength) {
-			*size = sizecount;
-			return true; 
+		if (seekpos % sectSize == 0 && sizedec >= sectSize) {
+			Bit32u count = TransferSectors(&data[sizecount], sizedec / sectSize, false);
+			loadedSector = false;
+			if (count == 0) {
+				/* EOC reached before EOF */
+				break;
+			}
+			seekpos += count * sectSize;
+			sizecount += (Bit16u)(count * sectSize);
+			sizedec -= count * sectSize;
+			continue;
 		}
-		data[sizecount++] = sectorBuffer[curSectOff++];
-		seekpos++;
-		if(curSectOff >= myDrive->getSectorSize()) {
-			currentSector = myDrive->getAbsoluteSectFromBytePos(firstCluster, seekpos);
-			if(currentSector == 0) {
+		if (!loadedSector) {
+			LoadSector();
+			if (!loadedSector) {
 				/* EOC reached before EOF */
 				//LOG_MSG("EOC reached before EOF, seekpos %d, filelen %d", seekpos, filelength);
-				*size = sizecount;
-				loadedSector = false;
-				return true;
+				break;
 			}
-			curSectOff = 0;
-			myDrive->readSector(currentSector, sectorBuffer);
-			loadedSector = true;
-			//LOG_MSG("Reading absolute sector at %d for seekpos %d", currentSector, seekpos);
 		}
-		--sizedec;
+		Bit32u chunk = sectSize - curSectOff;
+		if (chunk > sizedec) chunk = sizedec;
+		memcpy(&data[sizecount], &sectorBuffer[curSectOff], chunk);
+		curSectOff += chunk;
+		seekpos += chunk;
+		sizecount += (Bit16u)chunk;
+		sizedec -= chunk;
+		if (curSectOff >= sectSize) loadedSector = false;
+	}
+	*size = sizecount;
+	return true;
+}
+
+/* Makes sure the cluster chain covers everything before endpos */
+bool fatFile::AllocateUpTo(Bit32u endpos) {
+	while (myDrive->getAbsoluteSectFromBytePos(firstCluster, endpos - 1) == 0) {
+		if (myDrive->appendCluster(firstCluster) == 0) return false;
 	}
-	*size =sizecount;
 	return true;
 }
 
@@ -190,6 +231,22 @@ bool fatFile::Write(Bit8u * data, Bit16u *size) {
 	}
 
 	while(sizedec != 0) {
+		/* Whole sectors are written straight from the caller's buffer. Empty
+		 * files get their first cluster allocated below. */
+		Bit32u sectSize = myDrive->getSectorSize();
+		if (seekpos % sectSize == 0 && sizedec >= sectSize && filelength != 0) {
+			Bit32u count = sizedec / sectSize;
+			if (AllocateUpTo(seekpos + count * sectSize)) {
+				count = TransferSectors(&data[sizecount], count, true);
+				seekpos += count * sectSize;
+				sizecount += (Bit16u)(count * sectSize);
+				sizedec -= (Bit16u)(count * sectSize);
+				if (seekpos > filelength) filelength = seekpos;
+				LoadSector();
+				continue;
+			}
+			/* Out of space, fill what is left a byte at a time */
+		}
 		/* Increase filesize if necessary */
 		if(seekpos >= filelength) {
 			if(filelength == 0) {
@@ -217,6 +274,9 @@ bool fatFile::Write(Bit8u * data, Bit16u *size) {
 				loadedSector = true;
 			}
 			filelength = seekpos+1;
+		} else if (!loadedSector) {
+			LoadSector();
+			if (!loadedSector) goto finalizeWrite;
 		}
 		sectorBuffer[curSectOff++] = data[sizecount++];
 		seekpos++;
@@ -316,17 +376,11 @@ Bit32u fatDrive::getClusterValue(Bit32u clustNum) {
 	fatsectnum = bootbuffer.reservedsectors + (fatoffset / bootbuffer.bytespersector) + partSectOff;
 	fatentoff = fatoffset % bootbuffer.bytespersector;
 
-	if(curFatSect != fatsectnum) {
-		/* Load two sectors at once for FAT12 */
-		readSector(fatsectnum, &fatSectBuffer[0]);
-		if (fattype==FAT12)
-			readSector(fatsectnum+1, &fatSectBuffer[512]);
-		curFatSect = fatsectnum;
-	}
+	Bit8u * fatSect = getFatSectors(fatsectnum);
 
 	switch(fattype) {
 		case FAT12:
-			clustValue = var_read((Bit16u *)&fatSectBuffer[fatentoff]);
+			clustValue = var_read((Bit16u *)&fatSect[fatentoff]);
 			if(clustNum & 0x1) {
 				clustValue >>= 4;
 			} else {
@@ -334,10 +388,10 @@ Bit32u fatDrive::getClusterValue(Bit32u clustNum) {
 			}
 			break;
 		case FAT16:
-			clustValue = var_read((Bit16u *)&fatSectBuffer[fatentoff]);
+			clustValue = var_read((Bit16u *)&fatSect[fatentoff]);
 			break;
 		case FAT32:
-			clustValue = var_read((Bit32u *)&fatSectBuffer[fatentoff]);
+			clustValue = var_read((Bit32u *)&fatSect[fatentoff]);
 			break;
 	}
 
@@ -363,17 +417,11 @@ void fatDrive::setClusterValue(Bit32u clustNum, Bit32u clustValue) {
 	fatsectnum = bootbuffer.reservedsectors + (fatoffset / bootbuffer.bytespersector) + partSectOff;
 	fatentoff = fatoffset % bootbuffer.bytespersector;
 
-	if(curFatSect != fatsectnum) {
-		/* Load two sectors at once for FAT12 */
-		readSector(fatsectnum, &fatSectBuffer[0]);
-		if (fattype==FAT12)
-			readSector(fatsectnum+1, &fatSectBuffer[512]);
-		curFatSect = fatsectnum;
-	}
+	Bit8u * fatSect = getFatSectors(fatsectnum);
 
 	switch(fattype) {
 		case FAT12: {
-			Bit16u tmpValue = var_read((Bit16u *)&fatSectBuffer[fatentoff]);
+			Bit16u tmpValue = var_read((Bit16u *)&fatSect[fatentoff]);
 			if(clustNum & 0x1) {
 				clustValue &= 0xfff;
 				clustValue <<= 4;
@@ -385,25 +433,156 @@ void fatDrive::setClusterValue(Bit32u clustNum, Bit32u clustValue) {
 				tmpValue &= 0xf000;
 				tmpValue |= (Bit16u)clustValue;
 			}
-			var_write((Bit16u *)&fatSectBuffer[fatentoff], tmpValue);
+			var_write((Bit16u *)&fatSect[fatentoff], tmpValue);
 			break;
 			}
 		case FAT16:
-			var_write((Bit16u *)&fatSectBuffer[fatentoff], (Bit16u)clustValue);
+			var_write((Bit16u *)&fatSect[fatentoff], (Bit16u)clustValue);
 			break;
 		case FAT32:
-			var_write((Bit32u *)&fatSectBuffer[fatentoff], clustValue);
+			var_write((Bit32u *)&fatSect[fatentoff], clustValue);
 			break;
 	}
+	bool crossesSector = fattype==FAT12 && fatentoff>=511;
+	writingFat = true;
 	for(int fc=0;fc<bootbuffer.fatcopies;fc++) {
-		writeSector(fatsectnum + (fc * bootbuffer.sectorsperfat), &fatSectBuffer[0]);
-		if (fattype==FAT12) {
-			if (fatentoff>=511)
-				writeSector(fatsectnum+1+(fc * bootbuffer.sectorsperfat), &fatSectBuffer[512]);
+		writeSector(fatsectnum + (fc * bootbuffer.sectorsperfat), &fatSect[0]);
+		if (crossesSector)
+			writeSector(fatsectnum+1+(fc * bootbuffer.sectorsperfat), &fatSect[512]);
+	}
+	writingFat = false;
+
+	/* Other cached blocks that hold a copy of the written sectors are stale now */
+	Bit32u relsect = fatsectnum - bootbuffer.reservedsectors - partSectOff;
+	Bit32u block = relsect / FAT_CACHE_SECTORS;
+	if (relsect % FAT_CACHE_SECTORS == 0 && block > 0) {
+		FatCacheBlock & prev = fatCache[(block-1) % FAT_CACHE_BLOCKS];
+		if (prev.block == block-1) prev.block = 0xffffffff;
+	}
+	if (crossesSector && (relsect+1) % FAT_CACHE_SECTORS == 0) {
+		FatCacheBlock & next = fatCache[(block+1) % FAT_CACHE_BLOCKS];
+		if (next.block == block+1) next.block = 0xffffffff;
+	}
+
+	truncateCachedChains(clustNum);
+}
+
+bool fatDrive::isEndOfChain(Bit32u clustValue) {
+	switch(fattype) {
+		case FAT12:
+			return clustValue >= 0xff8;
+		case FAT16:
+			return clustValue >= 0xfff8;
+		case FAT32:
+			return clustValue >= 0xfffffff8;
+	}
+	return true;
+}
+
+/* Returns the cached data of a FAT sector, followed by the next sector */
+Bit8u * fatDrive::getFatSectors(Bit32u fatsectnum) {
+	Bit32u fatStart = bootbuffer.reservedsectors + partSectOff;
+	Bit32u relsect = fatsectnum - fatStart;
+	Bit32u block = relsect / FAT_CACHE_SECTORS;
+	FatCacheBlock & entry = fatCache[block % FAT_CACHE_BLOCKS];
+	if (entry.block != block) {
+		readSectors(fatStart + block * FAT_CACHE_SECTORS, FAT_CACHE_SECTORS + 1, entry.data);
+		entry.block = block;
+	}
+	return &entry.data[(relsect % FAT_CACHE_SECTORS) * 512];
+}
+
+/* Returns the cluster at position clustIndex of the chain starting at
+ * startClustNum, or 0 if the chain ends before that */
+Bit32u fatDrive::getChainCluster(Bit32u startClustNum, Bit32u clustIndex) {
+	/* The first two FAT entries are reserved and always read as end of chain */
+	if (startClustNum < 2) return 0;
+
+	CachedChain * chain = 0;
+	CachedChain * oldest = &chainCache[0];
+	for (Bitu i = 0; i < CHAIN_CACHE_ENTRIES; i++) {
+		if (chainCache[i].start == startClustNum) {
+			chain = &chainCache[i];
+			break;
+		}
+		if (chainCache[i].lastUse < oldest->lastUse) oldest = &chainCache[i];
+	}
+	if (!chain) {
+		chain = oldest;
+		chain->start = startClustNum;
+		chain->length = 1;
+		chain->complete = false;
+		chain->runs.clear();
+		ClusterRun first = { 0, startClustNum, 1 };
+		chain->runs.push_back(first);
+	}
+	chain->lastUse = ++chainCacheClock;
+
+	while (clustIndex >= chain->length) {
+		if (chain->complete) return 0;
+		ClusterRun & last = chain->runs.back();
+		Bit32u nextClust = getClusterValue(last.cluster + last.count - 1);
+		if (isEndOfChain(nextClust)) {
+			//LOG_MSG("End of cluster chain reached before end of logical sector seek!");
+			if (clustIndex == chain->length && fattype == FAT12) {
+				LOG(LOG_DOSMISC,LOG_ERROR)("End of cluster chain reached, but maybe good afterall ?");
+			}
+			chain->complete = true;
+			return 0;
+		}
+		if (nextClust == last.cluster + last.count) {
+			last.count++;
+		} else {
+			ClusterRun run = { chain->length, nextClust, 1 };
+			chain->runs.push_back(run);
+		}
+		chain->length++;
+	}
+
+	/* Last run that starts at or before clustIndex */
+	size_t lo = 0, hi = chain->runs.size();
+	while (hi - lo > 1) {
+		size_t mid = (lo + hi) / 2;
+		if (chain->runs[mid].index <= clustIndex) lo = mid;
+		else hi = mid;
+	}
+	const ClusterRun & run = chain->runs[lo];
+	return run.cluster + (clustIndex - run.index);
+}
+
+/* The FAT entry of clustNum changed, forget what follows it in cached chains */
+void fatDrive::truncateCachedChains(Bit32u clustNum) {
+	for (Bitu i = 0; i < CHAIN_CACHE_ENTRIES; i++) {
+		CachedChain & chain = chainCache[i];
+		if (!chain.start) continue;
+		for (size_t r = 0; r < chain.runs.size(); r++) {
+			ClusterRun & run = chain.runs[r];
+			if (clustNum < run.cluster || clustNum >= run.cluster + run.count) continue;
+			run.count = clustNum - run.cluster + 1;
+			chain.length = run.index + run.count;
+			chain.complete = false;
+			chain.runs.resize(r + 1);
+			break;
 		}
 	}
 }
 
+void fatDrive::SectorsWritten(Bit32u sectnum, Bit32u count) {
+	if (writingFat) return;
+	Bit32u fatStart = bootbuffer.reservedsectors + partSectOff;
+	if (sectnum < firstRootDirSect && sectnum + count > fatStart) EmptyCache();
+}
+
+void fatDrive::EmptyCache(void) {
+	for (Bitu i = 0; i < FAT_CACHE_BLOCKS; i++) fatCache[i].block = 0xffffffff;
+	for (Bitu i = 0; i < CHAIN_CACHE_ENTRIES; i++) {
+		chainCache[i].start = 0;
+		chainCache[i].lastUse = 0;
+		chainCache[i].runs.clear();
+	}
+	chainCacheClock = 0;
+}
+
 bool fatDrive::getEntryName(char *fullname, char *entname) {
 	char dirtoken[DOS_PATHLENGTH];
 
@@ -528,6 +707,26 @@ Bit8u fatDrive::writeSector(Bit32u sectnum, void * data) {
 	return loadedDisk->Write_Sector(head, cylinder, sector, data);
 }
 
+Bit8u fatDrive::readSectors(Bit32u sectnum, Bit32u count, void * data) {
+	if (absolute) return loadedDisk->Read_AbsoluteSectors(sectnum, count, data);
+	Bit8u * dest = (Bit8u *)data;
+	for (Bit32u i = 0; i < count; i++) {
+		Bit8u ret = readSector(sectnum + i, dest + i * bootbuffer.bytespersector);
+		if (ret) return ret;
+	}
+	return 0;
+}
+
+Bit8u fatDrive::writeSectors(Bit32u sectnum, Bit32u count, void * data) {
+	if (absolute) return loadedDisk->Write_AbsoluteSectors(sectnum, count, data);
+	Bit8u * src = (Bit8u *)data;
+	for (Bit32u i = 0; i < count; i++) {
+		Bit8u ret = writeSector(sectnum + i, src + i * bootbuffer.bytespersector);
+		if (ret) return ret;
+	}
+	return 0;
+}
+
 Bit32u fatDrive::getSectorCount(void) {
 	if (bootbuffer.totalsectorcount != 0)
 		return (Bit32u)bootbuffer.totalsectorcount;
@@ -548,36 +747,13 @@ Bit32u fatDrive::getAbsoluteSectFromBytePos(Bit32u startClustNum, Bit32u bytePos
 }
 
 Bit32u fatDrive::getAbsoluteSectFromChain(Bit32u startClustNum, Bit32u logicalSector) {
-	Bit32s skipClust = logicalSector / bootbuffer.sectorspercluster;
+	Bit32u skipClust = logicalSector / bootbuffer.sectorspercluster;
 	Bit32u sectClust = logicalSector % bootbuffer.sectorspercluster;
 
 	Bit32u currentClust = startClustNum;
-	Bit32u testvalue;
-
-	while(skipClust!=0) {
-		bool isEOF = false;
-		testvalue = getClusterValue(currentClust);
-		switch(fattype) {
-			case FAT12:
-				if(testvalue >= 0xff8) isEOF = true;
-				break;
-			case FAT16:
-				if(testvalue >= 0xfff8) isEOF = true;
-				break;
-			case FAT32:
-				if(testvalue >= 0xfffffff8) isEOF = true;
-				break;
-		}
-		if((isEOF) && (skipClust>=1)) {
-			//LOG_MSG("End of cluster chain reached before end of logical sector seek!");
-			if (skipClust == 1 && fattype == FAT12) {
-				//break;
-				LOG(LOG_DOSMISC,LOG_ERROR)("End of cluster chain reached, but maybe good afterall ?");
-			}
-			return 0;
-		}
-		currentClust = testvalue;
-		--skipClust;
+	if (skipClust != 0) {
+		currentClust = getChainCluster(startClustNum, skipClust);
+		if (currentClust == 0) return 0;
 	}
 
 	return (getClustFirstSect(currentClust) + sectClust);
@@ -692,8 +868,10 @@ bool fatDrive::allocateCluster(Bit32u useCluster, Bit32u prevCluster) {
 	return true;
 }
 
-fatDrive::fatDrive(const char *sysFilename, Bit32u bytesector, Bit32u cylsector, Bit32u headscyl, Bit32u cylinders, Bit32u startSector) {
+fatDrive::fatDrive(const char *sysFilename, Bit32u bytesector, Bit32u cylsector, Bit32u headscyl, Bit32u cylinders, Bit32u startSector, bool readonly) {
 	created_successfully = true;
+	loadedDisk = NULL;
+	writingFat = false;
 	FILE *diskfile;
 	Bit32u filesize;
 	bool is_hdd;
@@ -705,7 +883,10 @@ fatDrive::fatDrive(const char *sysFilename, Bit32u bytesector, Bit32u cylsector,
 		imgDTA    = new DOS_DTA(imgDTAPtr);
 	}
 
-	diskfile = fopen_wrap(sysFilename, "rb+");
+	/* The changes to a read-only image are kept in memory. With a delta the
+	 * image is only read as well. */
+	bool delta = !readonly && DISK_DeltaEnabled();
+	diskfile = fopen_wrap(sysFilename, (readonly || delta) ? "rb" : "rb+");
 	if(!diskfile) {created_successfully = false;return;}
 	fseek(diskfile, 0L, SEEK_END);
 	filesize = (Bit32u)ftell(diskfile) / 1024L;
@@ -717,6 +898,8 @@ fatDrive::fatDrive(const char *sysFilename, Bit32u bytesector, Bit32u cylsector,
 		created_successfully = false;
 		return;
 	}
+	if(delta) loadedDisk->AttachDelta();
+	else if(readonly) loadedDisk->AttachOverlay();
 
 	if(is_hdd) {
 		/* Set user specified harddrive parameters */
@@ -877,8 +1060,10 @@ fatDrive::fatDrive(const char *sysFilename, Bit32u bytesector, Bit32u cylsector,
 	/* There is no cluster 0, this means we are in the root directory */
 	cwdDirCluster = 0;
 
-	memset(fatSectBuffer,0,1024);
-	curFatSect = 0xffffffff;
+	fatCache.resize(FAT_CACHE_BLOCKS);
+	chainCacheClock = 0;
+	EmptyCache();
+	loadedDisk->cacheOwner = this;
 
 	strcpy(info, "fatDrive ");
 	strcat(info, sysFilename);
@@ -920,6 +1105,10 @@ Bit32u fatDrive::getFirstFreeClust(void) {
 bool fatDrive::isRemote(void) {	return false; }
 bool fatDrive::isRemovable(void) { return false; }
 
+fatDrive::~fatDrive() {
+	if (loadedDisk && loadedDisk->cacheOwner == this) loadedDisk->cacheOwner = NULL;
+}
+
 Bits fatDrive::UnMount(void) {
 	delete this;
 	return 0;
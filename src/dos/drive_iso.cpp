@@ -24,6 +24,8 @@
 #include "dos_system.h"
 #include "support.h"
 #include "drives.h"
+#include "setup.h"
+#include "control.h"
 
 #define FLAGS1	((iso) ? de.fileFlags : de.timeZone)
 #define FLAGS2	((iso) ? de->fileFlags : de->timeZone)
@@ -67,35 +69,35 @@ bool isoFile::Read(Bit8u *data, Bit16u *size) {
 		*size = (Bit16u)(fileEnd - filePos);
 	
 	Bit16u nowSize = 0;
-	int sector = filePos / ISO_FRAMESIZE;
-	Bit16u sectorPos = (Bit16u)(filePos % ISO_FRAMESIZE);
-	
-	if (sector != cachedSector) {
-		if (drive->readSector(buffer, sector)) cachedSector = sector;
-		else { *size = 0; cachedSector = -1; }
-	}
 	while (nowSize < *size) {
-		Bit16u remSector = ISO_FRAMESIZE - sectorPos;
+		int sector = filePos / ISO_FRAMESIZE;
+		Bit16u sectorPos = (Bit16u)(filePos % ISO_FRAMESIZE);
 		Bit16u remSize = *size - nowSize;
-		if(remSector < remSize) {
-			memcpy(&data[nowSize], &buffer[sectorPos], remSector);
-			nowSize += remSector;
-			sectorPos = 0;
-			sector++;
-			cachedSector++;
-			if (!drive->readSector(buffer, sector)) {
-				*size = nowSize;
+		if (sectorPos == 0 && remSize >= ISO_FRAMESIZE) {
+			// whole sectors are read straight into the destination at once
+			Bit16u runSize = remSize - remSize % ISO_FRAMESIZE;
+			if (drive->readSectors(&data[nowSize], sector, runSize / ISO_FRAMESIZE)) {
+				nowSize += runSize;
+				filePos += runSize;
+				continue;
+			}
+			// read the run sector by sector to find the one that fails
+		}
+		if (sector != cachedSector) {
+			if (drive->readSector(buffer, sector)) cachedSector = sector;
+			else {
 				cachedSector = -1;
+				break;
 			}
-		} else {
-			memcpy(&data[nowSize], &buffer[sectorPos], remSize);
-			nowSize += remSize;
 		}
-			
+		Bit16u remSector = ISO_FRAMESIZE - sectorPos;
+		if (remSector > remSize) remSector = remSize;
+		memcpy(&data[nowSize], &buffer[sectorPos], remSector);
+		nowSize += remSector;
+		filePos += remSector;
 	}
 	
 	*size = nowSize;
-	filePos += *size;
 	return true;
 }
 
@@ -151,7 +153,11 @@ isoDrive::isoDrive(char driveLetter, const char *fileName, Bit8u mediaid, int &e
 	this->discLabel[0] = '\0';
 	nextFreeDirIterator = 0;
 	memset(dirIterators, 0, sizeof(dirIterators));
-	memset(sectorHashEntries, 0, sizeof(sectorHashEntries));
+	Section_prop *section = static_cast<Section_prop *>(control->GetSection("dos"));
+	sectorCacheSets = (section->Get_int("isocache") + ISO_CACHE_WAYS - 1) / ISO_CACHE_WAYS;
+	sectorCache = new SectorCacheEntry[sectorCacheSets * ISO_CACHE_WAYS];
+	memset(sectorCache, 0, sizeof(SectorCacheEntry) * sectorCacheSets * ISO_CACHE_WAYS);
+	sectorCacheClock = 0;
 	memset(&rootEntry, 0, sizeof(isoDirEntry));
 	
 	safe_strncpy(this->fileName, fileName, CROSS_LEN);
@@ -179,7 +185,9 @@ isoDrive::isoDrive(char driveLetter, const char *fileName, Bit8u mediaid, int &e
 	}
 }
 
-isoDrive::~isoDrive() { }
+isoDrive::~isoDrive() {
+	delete[] sectorCache;
+}
 
 int isoDrive::UpdateMscdex(char driveLetter, const char* path, Bit8u& subUnit) {
 	if (MSCDEX_HasDrive(driveLetter)) {
@@ -450,20 +458,29 @@ void isoDrive::FreeDirIterator(const int dirIterator) {
 }
 
 bool isoDrive::ReadCachedSector(Bit8u** buffer, const Bit32u sector) {
-	// get hash table entry
-	int pos = sector % ISO_MAX_HASH_TABLE_SIZE;
-	SectorHashEntry& he = sectorHashEntries[pos];
-	
-	// check if the entry is valid and contains the correct sector
-	if (!he.valid || he.sector != sector) {
-		if (!CDROM_Interface_Image::images[subUnit]->ReadSector(he.data, false, sector)) {
-			return false;
+	// look for the sector in its set, remember the least recently used entry
+	SectorCacheEntry* set = &sectorCache[(sector % sectorCacheSets) * ISO_CACHE_WAYS];
+	SectorCacheEntry* victim = &set[0];
+	for (int i = 0; i < ISO_CACHE_WAYS; i++) {
+		SectorCacheEntry& ce = set[i];
+		if (ce.valid && ce.sector == sector) {
+			ce.lastUsed = ++sectorCacheClock;
+			*buffer = ce.data;
+			return true;
 		}
-		he.valid = true;
-		he.sector = sector;
+		if (!ce.valid) {
+			if (victim->valid) victim = &ce;
+		} else if (victim->valid && ce.lastUsed < victim->lastUsed) victim = &ce;
 	}
 	
-	*buffer = he.data;
+	if (!CDROM_Interface_Image::images[subUnit]->ReadSector(victim->data, false, sector)) {
+		victim->valid = false;
+		return false;
+	}
+	victim->valid = true;
+	victim->sector = sector;
+	victim->lastUsed = ++sectorCacheClock;
+	*buffer = victim->data;
 	return true;
 }
 
@@ -471,6 +488,10 @@ inline bool isoDrive :: readSector(Bit8u *buffer, Bit32u sector) {
 	return CDROM_Interface_Image::images[subUnit]->ReadSector(buffer, false, sector);
 }
 
+bool isoDrive :: readSectors(Bit8u *buffer, Bit32u sector, Bit32u count) {
+	return CDROM_Interface_Image::images[subUnit]->ReadSectorsHost(buffer, false, sector, count);
+}
+
 int isoDrive :: readDirEntry(isoDirEntry *de, Bit8u *data) {	
 	// copy data into isoDirEntry struct, data[0] = length of DirEntry
 //	if (data[0] > sizeof(isoDirEntry)) return -1;//check disabled as isoDirentry is currently 258 bytes large. So it always fits
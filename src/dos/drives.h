@@ -151,7 +151,8 @@ struct partTable {
 class imageDisk;
 class fatDrive : public DOS_Drive {
 public:
-	fatDrive(const char * sysFilename, Bit32u bytesector, Bit32u cylsector, Bit32u headscyl, Bit32u cylinders, Bit32u startSector);
+	fatDrive(const char * sysFilename, Bit32u bytesector, Bit32u cylsector, Bit32u headscyl, Bit32u cylinders, Bit32u startSector, bool readonly = false);
+	~fatDrive();
 	virtual bool FileOpen(DOS_File * * file,char * name,Bit32u flags);
 	virtual bool FileCreate(DOS_File * * file,char * name,Bit16u attributes);
 	virtual bool FileUnlink(char * name);
@@ -169,10 +170,12 @@ public:
 	virtual bool isRemote(void);
 	virtual bool isRemovable(void);
 	virtual Bits UnMount(void);
-	virtual void EmptyCache(void){}
+	virtual void EmptyCache(void);
 public:
 	Bit8u readSector(Bit32u sectnum, void * data);
 	Bit8u writeSector(Bit32u sectnum, void * data);
+	Bit8u readSectors(Bit32u sectnum, Bit32u count, void * data);
+	Bit8u writeSectors(Bit32u sectnum, Bit32u count, void * data);
 	Bit32u getAbsoluteSectFromBytePos(Bit32u startClustNum, Bit32u bytePos);
 	Bit32u getSectorCount(void);
 	Bit32u getSectorSize(void);
@@ -182,6 +185,8 @@ public:
 	Bit32u appendCluster(Bit32u startCluster);
 	void deleteClustChain(Bit32u startCluster, Bit32u bytePos);
 	Bit32u getFirstFreeClust(void);
+	/* Called by loadedDisk for every write, drops the caches if the FAT changed */
+	void SectorsWritten(Bit32u sectnum, Bit32u count);
 	bool directoryBrowse(Bit32u dirClustNumber, direntry *useEntry, Bit32s entNum, Bit32s start=0);
 	bool directoryChange(Bit32u dirClustNumber, direntry *useEntry, Bit32s entNum);
 	imageDisk *loadedDisk;
@@ -190,6 +195,10 @@ public:
 private:
 	Bit32u getClusterValue(Bit32u clustNum);
 	void setClusterValue(Bit32u clustNum, Bit32u clustValue);
+	bool isEndOfChain(Bit32u clustValue);
+	Bit8u * getFatSectors(Bit32u fatsectnum);
+	Bit32u getChainCluster(Bit32u startClustNum, Bit32u clustIndex);
+	void truncateCachedChains(Bit32u clustNum);
 	Bit32u getClustFirstSect(Bit32u clustNum);
 	bool FindNextInternal(Bit32u dirClustNumber, DOS_DTA & dta, direntry *foundEntry);
 	bool getDirClustNum(char * dir, Bit32u * clustNum, bool parDir);
@@ -220,8 +229,35 @@ private:
 	Bit32u cwdDirCluster;
 	Bit32u dirPosition; /* Position in directory search */
 
-	Bit8u fatSectBuffer[1024];
-	Bit32u curFatSect;
+	/* The FAT is cached in blocks of sectors. A block holds one sector more
+	 * than it covers, so FAT12 entries that cross into the next sector can
+	 * be read from it directly. */
+	enum { FAT_CACHE_BLOCKS = 32, FAT_CACHE_SECTORS = 8 };
+	struct FatCacheBlock {
+		Bit32u block;		/* 0xffffffff when unused */
+		Bit8u data[(FAT_CACHE_SECTORS+1)*512];
+	};
+	std::vector<FatCacheBlock> fatCache;
+
+	/* Cluster chains of recently used files and directories, stored as runs
+	 * of consecutive clusters. Finding the cluster at some offset into a
+	 * file then doesn't have to follow the chain from its start. */
+	struct ClusterRun {
+		Bit32u index;		/* position of the first cluster in the chain */
+		Bit32u cluster;
+		Bit32u count;
+	};
+	struct CachedChain {
+		Bit32u start;		/* 0 when unused */
+		Bit32u lastUse;
+		Bit32u length;		/* clusters known so far */
+		bool complete;		/* length covers the whole chain */
+		std::vector<ClusterRun> runs;
+	};
+	enum { CHAIN_CACHE_ENTRIES = 16 };
+	CachedChain chainCache[CHAIN_CACHE_ENTRIES];
+	Bit32u chainCacheClock;
+	bool writingFat;		/* setClusterValue() keeps the caches up to date itself */
 };
 
 
@@ -321,7 +357,7 @@ struct isoDirEntry {
 #define IS_ASSOC(fileFlags)	(fileFlags & ISO_ASSOCIATED)
 #define IS_DIR(fileFlags)	(fileFlags & ISO_DIRECTORY)
 #define IS_HIDDEN(fileFlags)	(fileFlags & ISO_HIDDEN)
-#define ISO_MAX_HASH_TABLE_SIZE 	100
+#define ISO_CACHE_WAYS			4
 
 class isoDrive : public DOS_Drive {
 public:
@@ -346,6 +382,7 @@ public:
 	virtual bool isRemovable(void);
 	virtual Bits UnMount(void);
 	bool readSector(Bit8u *buffer, Bit32u sector);
+	bool readSectors(Bit8u *buffer, Bit32u sector, Bit32u count);
 	virtual char const* GetLabel(void) {return discLabel;};
 	virtual void Activate(void);
 private:
@@ -369,11 +406,16 @@ private:
 	
 	int nextFreeDirIterator;
 	
-	struct SectorHashEntry {
+	// directory sectors, each sector number maps to a set of ISO_CACHE_WAYS
+	// entries and the least recently used entry of the set is replaced
+	struct SectorCacheEntry {
 		bool valid;
 		Bit32u sector;
+		Bit32u lastUsed;
 		Bit8u data[ISO_FRAMESIZE];
-	} sectorHashEntries[ISO_MAX_HASH_TABLE_SIZE];
+	} *sectorCache;
+	Bit32u sectorCacheSets;
+	Bit32u sectorCacheClock;
 
 	bool iso;
 	bool dataCD;
@@ -356,11 +356,19 @@ void DOSBOX_SetNormalLoop() {
 	loop=Normal_Loop;
 }
 
+static Bitu run_depth=0;
+
 void DOSBOX_RunMachine(void){
 	Bitu ret;
+	run_depth++;
 	do {
 		ret=(*loop)();
 	} while (!ret);
+	run_depth--;
+}
+
+Bitu DOSBOX_RunDepth(void) {
+	return run_depth;
 }
 
 void DOSBOX_UnlockSpeed( bool pressed ) {
@@ -531,11 +539,18 @@ void DOSBOX_Init(void) {
 #if (C_DYNAMIC_X86) || (C_DYNREC)
 		"dynamic",
 #endif
-		"normal", "simple",0 };
+		"normal", "simple", "cached",0 };
 	Pstring = secprop->Add_string("core",Property::Changeable::WhenIdle,"auto");
 	Pstring->Set_values(cores);
 	Pstring->Set_help("CPU Core used in emulation. auto will switch to dynamic if available and\n"
-		"appropriate.");
+		"appropriate, else to cached. cached is an interpreter that keeps the decoded instructions.");
+
+#if (C_DYNAMIC_X86) || (C_DYNREC)
+	Pint = secprop->Add_int("dynamic_cache",Property::Changeable::OnlyAtStart,8);
+	Pint->SetMinMax(8,256);
+	Pint->Set_help("Size in MB the code cache of the dynamic core can grow to. When it is full,\n"
+		"the code of the pages that were run the longest time ago is thrown away.");
+#endif
 
 	const char* cputype_values[] = { "auto", "386", "386_slow", "486_slow", "pentium_slow", "386_prefetch", 0};
 	Pstring = secprop->Add_string("cputype",Property::Changeable::Always,"auto");
@@ -641,6 +656,22 @@ void DOSBOX_Init(void) {
 	Pint->Set_help("How many milliseconds of data to keep on top of the blocksize.");
 #endif
 
+	const char* resamplers[] = { "linear", "sinc", 0 };
+	Pstring = secprop->Add_string("resampler",Property::Changeable::OnlyAtStart,"linear");
+	Pstring->Set_values(resamplers);
+	Pstring->Set_help("How devices that don't run at the mixer rate are resampled.\n"
+	                  "  'linear'  interpolates between two samples.\n"
+	                  "  'sinc'    uses a windowed sinc filter, cleaner but slightly slower.");
+
+	Pstring = secprop->Add_string("channelresampler",Property::Changeable::OnlyAtStart,"");
+	Pstring->Set_help("Resamplers for single channels, overriding the resampler setting.\n"
+	                  "A list of channel:resampler pairs, for example 'SB:sinc CDAUDIO:linear'.\n"
+	                  "The MIXER command lists the names of the channels.");
+
+	Pbool = secprop->Add_bool("smoothdrift",Property::Changeable::OnlyAtStart,false);
+	Pbool->Set_help("Interpolate between frames when the output gets stretched to follow the audio device,\n"
+	                "instead of dropping or repeating frames.");
+
 	secprop=control->AddSection_prop("midi",&MIDI_Init,true);//done
 	secprop->AddInitFunction(&MPU401_Init,true);//done
 
@@ -861,6 +892,11 @@ void DOSBOX_Init(void) {
 	Pstring = secprop->Add_string("keyboardlayout",Property::Changeable::WhenIdle, "auto");
 	Pstring->Set_help("Language code of the keyboard layout (or none).");
 
+	Pint = secprop->Add_int("isocache",Property::Changeable::WhenIdle,256);
+	Pint->SetMinMax(16,16384);
+	Pint->Set_help("Number of directory sectors (2 kB each) that are cached for every\n"
+		"CD image mounted with imgmount -t iso.");
+
 	// Mscdex
 	secprop->AddInitFunction(&MSCDEX_Init);
 	secprop->AddInitFunction(&DRIVES_Init);
@@ -26,6 +26,7 @@
 #include "mem.h"
 #include "fpu.h"
 #include "cpu.h"
+#include "snapshot.h"
 
 FPU_rec fpu;
 
@@ -626,8 +627,17 @@ void FPU_ESC7_Normal(Bitu rm) {
 }
 
 
+static void FPU_SaveState(SnapshotWriter& writer) {
+	writer.WriteStruct(&fpu,sizeof(fpu));
+}
+
+static bool FPU_LoadState(SnapshotReader& reader,Bit16u /*version*/) {
+	return reader.ReadStruct(&fpu,sizeof(fpu));
+}
+
 void FPU_Init(Section*) {
 	FPU_FINIT();
+	SNAPSHOT_Register("FPU",1,FPU_SaveState,FPU_LoadState);
 }
 
 #endif
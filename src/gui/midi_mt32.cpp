@@ -8,6 +8,10 @@
 
 #include "midi_mt32.h"
 
+#ifdef __LIBRETRO__
+#include "libretro_profiler.h"
+#endif
+
 static const Bitu MILLIS_PER_SECOND = 1000;
 
 MidiHandler_mt32 &MidiHandler_mt32::GetInstance() {
@@ -174,6 +178,9 @@ void MidiHandler_mt32::PlaySysex(Bit8u *sysex, Bitu len) {
 }
 
 void MidiHandler_mt32::mixerCallBack(Bitu len) {
+#ifdef __LIBRETRO__
+	profiler::Scope profile_scope(profiler::Section::Midi);
+#endif
 	MidiHandler_mt32::GetInstance().handleMixerCallBack(len);
 }
 
@@ -28,6 +28,7 @@
 #include "mem.h"
 #include "dbopl.h"
 #include "cpu.h"
+#include "snapshot.h"
 
 #include "mame/emu.h"
 #include "mame/fmopl.h"
@@ -734,12 +735,63 @@ void Module::Init( Mode m ) {
 	}
 }
 
+void Module::SaveState( SnapshotWriter& writer ) {
+	writer.Write( (Bit8u)mode );
+	writer.Write( reg.normal );
+	writer.WriteStruct( &ctrl, sizeof(ctrl) );
+	writer.Write( lastUsed );
+	writer.WriteStruct( cache, sizeof(cache) );
+	writer.WriteStruct( chip, sizeof(chip) );
+}
+
+bool Module::LoadState( SnapshotReader& reader ) {
+	Bit8u saved_mode;
+	if ( !reader.Read( saved_mode ) || saved_mode != mode )
+		return false;
+	RegisterCache regs;
+	if ( !reader.Read( reg.normal ) || !reader.ReadStruct( &ctrl, sizeof(ctrl) ) ||
+		!reader.Read( lastUsed ) || !reader.ReadStruct( regs, sizeof(regs) ) ||
+		!reader.ReadStruct( chip, sizeof(chip) ) )
+		return false;
+	//Rebuild the synth from the register file, mode bits first and key on last
+	const Bit32u banks = ( mode == MODE_OPL2 ) ? 1 : 2;
+	if ( banks == 2 ) {
+		handler->WriteReg( 0x105, regs[0x105] );
+		handler->WriteReg( 0x104, regs[0x104] );
+	}
+	for ( Bit32u bank = 0; bank < banks; bank++ ) {
+		for ( Bit32u i = 0x01; i <= 0xff; i++ ) {
+			const Bit32u addr = bank * 0x100 + i;
+			if ( bank == 0 && i >= 0x02 && i <= 0x04 ) continue;	//Timers, restored with the chips
+			if ( bank == 1 && ( i == 0x04 || i == 0x05 ) ) continue;	//Written above
+			if ( i >= 0xb0 && i <= 0xb8 ) continue;
+			handler->WriteReg( addr, regs[addr] );
+		}
+	}
+	for ( Bit32u bank = 0; bank < banks; bank++ ) {
+		for ( Bit32u i = 0xb0; i <= 0xb8; i++ )
+			handler->WriteReg( bank * 0x100 + i, regs[bank * 0x100 + i] );
+	}
+	memcpy( cache, regs, sizeof(cache) );
+	if ( ctrl.mixer && mode == MODE_OPL3GOLD )
+		mixerChan->SetVolume( (float)(ctrl.lvol&0x1f)/31.0f, (float)(ctrl.rvol&0x1f)/31.0f );
+	return true;
+}
+
 }; //namespace
 
 
 
 static Adlib::Module* module = 0;
 
+static void OPL_SaveState(SnapshotWriter& writer) {
+	module->SaveState( writer );
+}
+
+static bool OPL_LoadState(SnapshotReader& reader,Bit16u /*version*/) {
+	return module->LoadState( reader );
+}
+
 static void OPL_CallBack(Bitu len) {
 	module->handler->Generate( module->mixerChan, len );
 	//Disable the sound generation after 30 seconds of silence
@@ -917,9 +969,11 @@ OPL_Mode Module::oplmode=OPL_none;
 void OPL_Init(Section* sec,OPL_Mode oplmode) {
 	Adlib::Module::oplmode = oplmode;
 	module = new Adlib::Module( sec );
+	SNAPSHOT_Register("OPL",1,OPL_SaveState,OPL_LoadState);
 }
 
 void OPL_ShutDown(Section* /*sec*/){
+	SNAPSHOT_Unregister("OPL");
 	delete module;
 	module = 0;
 
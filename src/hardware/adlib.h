@@ -27,6 +27,8 @@
 #include "pic.h"
 #include "hardware.h"
 
+class SnapshotWriter;
+class SnapshotReader;
 
 namespace Adlib {
 
@@ -184,6 +186,8 @@ public:
 	void PortWrite( Bitu port, Bitu val, Bitu iolen );
 	Bitu PortRead( Bitu port, Bitu iolen );
 	void Init( Mode m );
+	void SaveState( SnapshotWriter& writer );
+	bool LoadState( SnapshotReader& reader );
 
 	Module( Section* configuration); 
 	~Module();
@@ -28,6 +28,7 @@
 #include "bios_disk.h"
 #include "setup.h"
 #include "cross.h" //fmod on certain platforms
+#include "snapshot.h"
 
 static struct {
 	Bit8u regs[0x40];
@@ -287,6 +288,13 @@ void CMOS_SetRegister(Bitu regNr, Bit8u val) {
 	cmos.regs[regNr] = val;
 }
 
+static void CMOS_SaveState(SnapshotWriter& writer) {
+	writer.WriteStruct(&cmos,sizeof(cmos));
+}
+
+static bool CMOS_LoadState(SnapshotReader& reader,Bit16u /*version*/) {
+	return reader.ReadStruct(&cmos,sizeof(cmos));
+}
 
 class CMOS:public Module_base{
 private:
@@ -315,6 +323,10 @@ public:
 		cmos.regs[0x18]=(Bit8u)(exsize >> 8);
 		cmos.regs[0x30]=(Bit8u)exsize;
 		cmos.regs[0x31]=(Bit8u)(exsize >> 8);
+		SNAPSHOT_Register("CMOS",1,CMOS_SaveState,CMOS_LoadState);
+	}
+	~CMOS(){
+		SNAPSHOT_Unregister("CMOS");
 	}
 };
 
@@ -25,6 +25,7 @@
 #include "pic.h"
 #include "paging.h"
 #include "setup.h"
+#include "snapshot.h"
 
 DmaController *DmaControllers[2];
 
@@ -348,6 +349,67 @@ again:
 	return done;
 }
 
+void DmaController::SaveState(SnapshotWriter& writer) {
+	writer.Write(flipflop);
+	for (Bitu i=0;i<4;i++) {
+		DmaChannel * chan=DmaChannels[i];
+		writer.Write(chan->pagebase);
+		writer.Write(chan->baseaddr);
+		writer.Write(chan->curraddr);
+		writer.Write(chan->basecnt);
+		writer.Write(chan->currcnt);
+		writer.Write(chan->pagenum);
+		writer.Write(chan->increment);
+		writer.Write(chan->autoinit);
+		writer.Write(chan->masked);
+		writer.Write(chan->tcount);
+		writer.Write(chan->request);
+		writer.WriteFunc(chan->callback);
+	}
+}
+
+bool DmaController::LoadState(SnapshotReader& reader) {
+	reader.Read(flipflop);
+	for (Bitu i=0;i<4;i++) {
+		DmaChannel * chan=DmaChannels[i];
+		reader.Read(chan->pagebase);
+		reader.Read(chan->baseaddr);
+		reader.Read(chan->curraddr);
+		reader.Read(chan->basecnt);
+		reader.Read(chan->currcnt);
+		reader.Read(chan->pagenum);
+		reader.Read(chan->increment);
+		reader.Read(chan->autoinit);
+		reader.Read(chan->masked);
+		reader.Read(chan->tcount);
+		reader.Read(chan->request);
+		reader.ReadFunc(chan->callback);
+	}
+	return !reader.Failed();
+}
+
+static void DMA_SaveState(SnapshotWriter& writer) {
+	writer.Write((Bit32u)dma_wrapping);
+	writer.WriteStruct(ems_board_mapping,sizeof(ems_board_mapping));
+	for (Bitu i=0;i<2;i++) {
+		writer.Write((bool)(DmaControllers[i]!=NULL));
+		if (DmaControllers[i]) DmaControllers[i]->SaveState(writer);
+	}
+}
+
+static bool DMA_LoadState(SnapshotReader& reader,Bit16u /*version*/) {
+	Bit32u wrapping;
+	if (!reader.Read(wrapping) || !reader.ReadStruct(ems_board_mapping,sizeof(ems_board_mapping))) return false;
+	dma_wrapping=wrapping;
+	for (Bitu i=0;i<2;i++) {
+		bool present;
+		if (!reader.Read(present)) return false;
+		if (present != (DmaControllers[i]!=NULL)) return false;
+		if (present && !DmaControllers[i]->LoadState(reader)) return false;
+	}
+	return true;
+}
+
 class DMA:public Module_base{
 public:
 	DMA(Section* configuration):Module_base(configuration){
@@ -381,8 +443,10 @@ public:
 			DmaControllers[1]->DMA_WriteHandler[0x11].Install(0x8f,DMA_Write_Port,IO_MB,1);
 			DmaControllers[1]->DMA_ReadHandler[0x11].Install(0x8f,DMA_Read_Port,IO_MB,1);
 		}
+		SNAPSHOT_Register("DMA",1,DMA_SaveState,DMA_LoadState);
 	}
 	~DMA(){
+		SNAPSHOT_Unregister("DMA");
 		if (DmaControllers[0]) {
 			delete DmaControllers[0];
 			DmaControllers[0]=NULL;
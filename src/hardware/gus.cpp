@@ -29,6 +29,7 @@
 #include "shell.h"
 #include "math.h"
 #include "regs.h"
+#include "snapshot.h"
 using namespace std;
 
 //Extra bits of precision over normal gus
@@ -803,6 +804,54 @@ static void MakeTables(void) {
 	}
 }
 
+static void GUS_SaveState(SnapshotWriter& writer) {
+	writer.WriteStruct(&myGUS,sizeof(myGUS));
+	writer.Write(adlib_commandreg);
+	writer.WriteBlock(GUSRam,GUSRAM_SIZE);
+	writer.Write((Bit8u)(curchan ? curchan->channum : 0xff));
+	for (Bitu i=0;i<32;i++) {
+		GUSChannels * chan=guschan[i];
+		writer.Write(chan->WaveStart);
+		writer.Write(chan->WaveEnd);
+		writer.Write(chan->WaveAddr);
+		writer.Write(chan->WaveAdd);
+		writer.Write(chan->WaveCtrl);
+		writer.Write(chan->RampStart);
+		writer.Write(chan->RampEnd);
+		writer.Write(chan->RampVol);
+		writer.Write(chan->RampAdd);
+		writer.Write(chan->RampAddReal);
+		writer.Write(chan->RampCtrl);
+		writer.Write(chan->PanPot);
+	}
+}
+
+static bool GUS_LoadState(SnapshotReader& reader,Bit16u /*version*/) {
+	Bit8u cur;
+	if (!reader.ReadStruct(&myGUS,sizeof(myGUS)) || !reader.Read(adlib_commandreg) ||
+	    !reader.ReadBlock(GUSRam,GUSRAM_SIZE) || !reader.Read(cur)) return false;
+	curchan=(cur<32) ? guschan[cur] : NULL;
+	for (Bitu i=0;i<32;i++) {
+		GUSChannels * chan=guschan[i];
+		Bit8u panpot;
+		reader.Read(chan->WaveStart);
+		reader.Read(chan->WaveEnd);
+		reader.Read(chan->WaveAddr);
+		reader.Read(chan->WaveAdd);
+		reader.Read(chan->WaveCtrl);
+		reader.Read(chan->RampStart);
+		reader.Read(chan->RampEnd);
+		reader.Read(chan->RampVol);
+		reader.Read(chan->RampAdd);
+		reader.Read(chan->RampAddReal);
+		reader.Read(chan->RampCtrl);
+		reader.Read(panpot);
+		/* Recalculates the pan and volume tables */
+		chan->WritePanPot(panpot);
+	}
+	return !reader.Failed();
+}
+
 class GUS:public Module_base{
 private:
 	IO_ReadHandleObject ReadHandler[8];
@@ -882,6 +931,7 @@ public:
 		// Create autoexec.bat lines
 		autoexecline[0].Install(temp.str());
 		autoexecline[1].Install(std::string("SET ULTRADIR=") + section->Get_string("ultradir"));
+		SNAPSHOT_Register("GUS",1,GUS_SaveState,GUS_LoadState);
 	}
 
 
@@ -889,6 +939,7 @@ public:
 		if(!IS_EGAVGA_ARCH) return;
 		Section_prop * section=static_cast<Section_prop *>(m_configuration);
 		if(!section->Get_bool("gus")) return;
+		SNAPSHOT_Unregister("GUS");
 	
 		myGUS.gRegData=0;
 		GUSReset();
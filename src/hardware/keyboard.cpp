@@ -24,6 +24,7 @@
 #include "mem.h"
 #include "mixer.h"
 #include "timer.h"
+#include "snapshot.h"
 
 #define KEYBUFSIZE 32
 #define KEYDELAY 0.300f			//Considering 20-30 khz serial clock and 11 bits/char
@@ -380,6 +381,14 @@ static void KEYBOARD_TickHandler(void) {
 	}
 }
 
+static void KEYBOARD_SaveState(SnapshotWriter& writer) {
+	writer.WriteStruct(&keyb,sizeof(keyb));
+	writer.Write(port_61_data);
+}
+static bool KEYBOARD_LoadState(SnapshotReader& reader,Bit16u /*version*/) {
+	return reader.ReadStruct(&keyb,sizeof(keyb)) && reader.Read(port_61_data);
+}
+
 void KEYBOARD_Init(Section* /*sec*/) {
 	IO_RegisterWriteHandler(0x60,write_p60,IO_MB);
 	IO_RegisterReadHandler(0x60,read_p60,IO_MB);
@@ -400,4 +409,5 @@ void KEYBOARD_Init(Section* /*sec*/) {
 	keyb.repeat.rate = 33;
 	keyb.repeat.wait = 0;
 	KEYBOARD_ClrBuffer();
+	SNAPSHOT_Register("KEYBOARD",1,KEYBOARD_SaveState,KEYBOARD_LoadState);
 }
@@ -26,6 +26,7 @@
 
 #include "voodoo.h"
 #include "pci_bus.h"
+#include "snapshot.h"
 
 #include <string.h>
 
@@ -57,9 +58,14 @@ static struct MemoryBlock {
 		bool enabled;
 		Bit8u controlport;
 	} a20;
+	struct {
+		HostPt mem;		// copy of the ram that snapshot deltas are taken against
+		Bit32u id;
+	} base;
 } memory;
 
 HostPt MemBase;
+Bit8u * MemPageDirty;
 
 class IllegalPageHandler : public PageHandler {
 public:
@@ -126,6 +132,50 @@ static IllegalPageHandler illegal_page_handler;
 static RAMPageHandler ram_page_handler;
 static ROMPageHandler rom_page_handler;
 
+/* Installed on the ram pages that haven't changed since the snapshot base.
+ * The page is linked read only, the first write marks it dirty and hands it
+ * back to the ram handler. */
+class DirtyTrackPageHandler : public RAMPageHandler {
+public:
+	DirtyTrackPageHandler() {
+		flags=PFLAG_READABLE;
+	}
+	void writeb(PhysPt addr,Bitu val) {
+		MarkDirty(addr);
+		mem_writeb(addr,(Bit8u)val);
+	}
+	void writew(PhysPt addr,Bitu val) {
+		MarkDirty(addr);
+		mem_writew(addr,(Bit16u)val);
+	}
+	void writed(PhysPt addr,Bitu val) {
+		MarkDirty(addr);
+		mem_writed(addr,(Bit32u)val);
+	}
+	bool writeb_checked(PhysPt addr,Bitu val) {
+		MarkDirty(addr);
+		return mem_writeb_checked(addr,(Bit8u)val);
+	}
+	bool writew_checked(PhysPt addr,Bitu val) {
+		MarkDirty(addr);
+		return mem_writew_checked(addr,(Bit16u)val);
+	}
+	bool writed_checked(PhysPt addr,Bitu val) {
+		MarkDirty(addr);
+		return mem_writed_checked(addr,(Bit32u)val);
+	}
+private:
+	void MarkDirty(PhysPt addr) {
+		Bitu phys_page=PAGING_GetPhysicalPage(addr)>>12;
+		MemPageDirty[phys_page]=1;
+		if (memory.phandlers[phys_page]==this) memory.phandlers[phys_page]=&ram_page_handler;
+		// Relinked with write access on the next access
+		PAGING_UnlinkPages(addr>>12,1);
+	}
+};
+
+static DirtyTrackPageHandler dirty_track_handler;
+
 void MEM_SetLFB(Bitu page, Bitu pages, PageHandler *handler, PageHandler *mmiohandler) {
 	memory.lfb.handler=handler;
 	memory.lfb.mmiohandler=mmiohandler;
@@ -153,6 +203,8 @@ PageHandler * MEM_GetPageHandler(Bitu phys_page) {
 
 void MEM_SetPageHandler(Bitu phys_page,Bitu pages,PageHandler * handler) {
 	for (;pages>0;pages--) {
+		/* Writes through the new handler aren't tracked */
+		MemPageDirty[phys_page]=1;
 		memory.phandlers[phys_page]=handler;
 		phys_page++;
 	}
@@ -160,6 +212,7 @@ void MEM_SetPageHandler(Bitu phys_page,Bitu pages,PageHandler * handler) {
 
 void MEM_ResetPageHandler(Bitu phys_page, Bitu pages) {
 	for (;pages>0;pages--) {
+		MemPageDirty[phys_page]=1;
 		memory.phandlers[phys_page]=&ram_page_handler;
 		phys_page++;
 	}
@@ -544,6 +597,86 @@ void PreparePCJRCartRom(void) {
 
 HostPt GetMemBase(void) { return MemBase; }
 
+/* Take a copy of the ram and watch for writes from now on */
+static void MEM_NewBase(Bit32u id) {
+	if (!memory.base.mem) memory.base.mem=new Bit8u[memory.pages*MEM_PAGE_SIZE];
+	memcpy(memory.base.mem,MemBase,memory.pages*MEM_PAGE_SIZE);
+	memory.base.id=id;
+	memset(MemPageDirty,0,memory.pages);
+	for (Bitu i=0;i<memory.pages;i++) {
+		if (memory.phandlers[i]==&ram_page_handler) memory.phandlers[i]=&dirty_track_handler;
+	}
+	/* Drop the writable links so the next write to a clean page is seen */
+	PAGING_ClearTLB();
+}
+
+static bool MEM_PageChanged(Bitu page) {
+	if (MemPageDirty[page]) return true;
+	/* Code pages and the tandy video memory are written behind our back */
+	if (memory.phandlers[page]->flags & (PFLAG_HASCODE|PFLAG_HASCACHE)) return true;
+	if (IS_TANDY_ARCH && page>=0x80 && page<0xa0) return true;
+	return false;
+}
+
+static void MEM_SaveState(SnapshotWriter& writer) {
+	writer.Write((Bit32u)memory.pages);
+	if (writer.Type()==SNAPSHOT_DELTA) {
+		if (memory.base.id!=writer.Base()) MEM_NewBase(writer.Base());
+		Bit32u count=0;
+		for (Bitu i=0;i<memory.pages;i++) {
+			if (MEM_PageChanged(i)) count++;
+		}
+		writer.Write(count);
+		for (Bitu i=0;i<memory.pages;i++) {
+			if (!MEM_PageChanged(i)) continue;
+			writer.Write((Bit32u)i);
+			writer.WriteBlock(MemBase+i*MEM_PAGE_SIZE,MEM_PAGE_SIZE);
+		}
+	} else {
+		writer.WriteBlock(MemBase,memory.pages*MEM_PAGE_SIZE);
+	}
+	writer.WriteBlock(memory.mhandles,memory.pages*sizeof(MemHandle));
+	writer.Write(memory.a20.enabled);
+	writer.Write(memory.a20.controlport);
+}
+
+/* The pages of the delta are read, the other ones that changed since the base
+ * are copied back from it. Pages stay marked as dirty. */
+static bool MEM_LoadDelta(SnapshotReader& reader) {
+	Bit32u count;
+	if (reader.Base()!=memory.base.id || !reader.Read(count) || count>memory.pages) return false;
+	if (reader.Remaining() < count*(4+MEM_PAGE_SIZE)+memory.pages*sizeof(MemHandle)) return false;
+	Bitu next=0;
+	for (Bit32u i=0;i<=count;i++) {
+		Bit32u page=(Bit32u)memory.pages;
+		if (i<count && (!reader.Read(page) || page<next || page>=memory.pages)) return false;
+		for (;next<page;next++) {
+			if (MEM_PageChanged(next)) memcpy(MemBase+next*MEM_PAGE_SIZE,memory.base.mem+next*MEM_PAGE_SIZE,MEM_PAGE_SIZE);
+		}
+		if (i==count) break;
+		reader.ReadBlock(MemBase+page*MEM_PAGE_SIZE,MEM_PAGE_SIZE);
+		MemPageDirty[page]=1;
+		next=page+1;
+	}
+	return true;
+}
+
+static bool MEM_LoadState(SnapshotReader& reader,Bit16u /*version*/) {
+	Bit32u pages;
+	if (!reader.Read(pages) || pages != memory.pages) return false;
+	if (reader.Type()==SNAPSHOT_DELTA) {
+		if (!MEM_LoadDelta(reader)) return false;
+	} else {
+		if (reader.Remaining() < pages*MEM_PAGE_SIZE+pages*sizeof(MemHandle)) return false;
+		reader.ReadBlock(MemBase,pages*MEM_PAGE_SIZE);
+	}
+	reader.ReadBlock(memory.mhandles,pages*sizeof(MemHandle));
+	/* The paging section has already restored the A20 mapping */
+	reader.Read(memory.a20.enabled);
+	reader.Read(memory.a20.controlport);
+	return !reader.Failed();
+}
+
 class MEMORY:public Module_base{
 private:
 	IO_ReadHandleObject ReadHandler;
@@ -572,6 +705,11 @@ public:
 		 * (Visual C debug mode). We want zeroed memory though. */
 		memset((void*)MemBase,0,memsize*1024*1024);
 		memory.pages = (memsize*1024*1024)/4096;
+		/* One more for a word or dword write that ends behind the last page */
+		MemPageDirty = new Bit8u[memory.pages+1];
+		memset(MemPageDirty,0,memory.pages+1);
+		memory.base.mem = 0;
+		memory.base.id = 0;
 		/* Allocate the data for the different page information blocks */
 		memory.phandlers=new  PageHandler * [memory.pages];
 		memory.mhandles=new MemHandle [memory.pages];
@@ -599,9 +737,13 @@ public:
 		WriteHandler.Install(0x92,write_p92,IO_MB);
 		ReadHandler.Install(0x92,read_p92,IO_MB);
 		MEM_A20_Enable(false);
+		SNAPSHOT_Register("MEMORY",1,MEM_SaveState,MEM_LoadState);
 	}
 	~MEMORY(){
+		SNAPSHOT_Unregister("MEMORY");
 		delete [] MemBase;
+		delete [] MemPageDirty;
+		delete [] memory.base.mem;
 		delete [] memory.phandlers;
 		delete [] memory.mhandles;
 	}
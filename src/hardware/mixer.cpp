@@ -25,11 +25,20 @@
 #ifdef __LIBRETRO__
 #include <stdlib.h>
 #include "libretro_dosbox.h"
+#include "libretro_profiler.h"
 #endif
 #include <string.h>
 #include <sys/types.h>
 #include <math.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MIXER_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define MIXER_NEON 1
+#endif
+
 #if defined (WIN32)
 //Midi listing
 #ifndef WIN32_LEAN_AND_MEAN
@@ -52,6 +61,7 @@
 #include "hardware.h"
 #include "programs.h"
 #include "midi.h"
+#include "snapshot.h"
 
 #define MIXER_SSIZE 4
 
@@ -64,6 +74,10 @@
 #define FREQ_NEXT ( 1 << FREQ_SHIFT)
 #define FREQ_MASK ( FREQ_NEXT -1 )
 
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
 #define TICK_SHIFT 24
 #define TICK_NEXT ( 1 << TICK_SHIFT)
 #define TICK_MASK (TICK_NEXT -1)
@@ -94,12 +108,364 @@ static struct {
 	float mastervol[2];
 	MixerChannel * channels;
 	bool nosound;
+	bool smoothdrift;
+	MixerResamplers resampler;
+	//NAME:resampler pairs that override the resampler of single channels
+	char channel_resamplers[256];
 	Bit32u freq;
 	Bit32u blocksize;
 } mixer;
 
 Bit8u MixTemp[MIXER_BUFSIZE];
 
+/* Mixing kernels. They work on 32 bit samples and wrap around like the
+ * scalar code does when it truncates its results into mixer.work, so the
+ * vector versions give exactly the same output. */
+
+#if defined(MIXER_SSE2)
+//The low 32 bits of the products of the four lanes, SSE2 has no pmulld
+static INLINE __m128i MIXER_MulLo(__m128i a,__m128i b) {
+	__m128i even=_mm_mul_epu32(a,b);
+	__m128i odd=_mm_mul_epu32(_mm_srli_epi64(a,32),_mm_srli_epi64(b,32));
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even,_MM_SHUFFLE(0,0,2,0)),
+		_mm_shuffle_epi32(odd,_MM_SHUFFLE(0,0,2,0)));
+}
+#endif
+
+/* Add frames of samples multiplied by the channel volume to out, which
+ * holds interleaved stereo frames. Mono input goes to both sides. */
+static void MIXER_MulAdd(Bit32s * out,const Bit32s * in,Bitu frames,const Bit32s * volmul,bool stereo) {
+	Bitu i=0;
+#if defined(MIXER_SSE2)
+	const __m128i vol=_mm_set_epi32(volmul[1],volmul[0],volmul[1],volmul[0]);
+	if (stereo) {
+		for (;i+2<=frames;i+=2) {
+			__m128i sample=_mm_loadu_si128((const __m128i *)&in[i*2]);
+			__m128i work=_mm_loadu_si128((const __m128i *)&out[i*2]);
+			_mm_storeu_si128((__m128i *)&out[i*2],_mm_add_epi32(work,MIXER_MulLo(sample,vol)));
+		}
+	} else {
+		for (;i+4<=frames;i+=4) {
+			__m128i sample=_mm_loadu_si128((const __m128i *)&in[i]);
+			__m128i work0=_mm_loadu_si128((const __m128i *)&out[i*2]);
+			__m128i work1=_mm_loadu_si128((const __m128i *)&out[i*2+4]);
+			work0=_mm_add_epi32(work0,MIXER_MulLo(_mm_unpacklo_epi32(sample,sample),vol));
+			work1=_mm_add_epi32(work1,MIXER_MulLo(_mm_unpackhi_epi32(sample,sample),vol));
+			_mm_storeu_si128((__m128i *)&out[i*2],work0);
+			_mm_storeu_si128((__m128i *)&out[i*2+4],work1);
+		}
+	}
+#elif defined(MIXER_NEON)
+	const int32x2_t vol_pair=vld1_s32(volmul);
+	const int32x4_t vol=vcombine_s32(vol_pair,vol_pair);
+	if (stereo) {
+		for (;i+2<=frames;i+=2) {
+			vst1q_s32(&out[i*2],vmlaq_s32(vld1q_s32(&out[i*2]),vld1q_s32(&in[i*2]),vol));
+		}
+	} else {
+		for (;i+4<=frames;i+=4) {
+			int32x4x2_t sample=vzipq_s32(vld1q_s32(&in[i]),vld1q_s32(&in[i]));
+			vst1q_s32(&out[i*2],vmlaq_s32(vld1q_s32(&out[i*2]),sample.val[0],vol));
+			vst1q_s32(&out[i*2+4],vmlaq_s32(vld1q_s32(&out[i*2+4]),sample.val[1],vol));
+		}
+	}
+#endif
+	for (;i<frames;i++) {
+		const Bit32s left=stereo ? in[i*2] : in[i];
+		const Bit32s right=stereo ? in[i*2+1] : left;
+		out[i*2]+=(Bits)left*volmul[0];
+		out[i*2+1]+=(Bits)right*volmul[1];
+	}
+}
+
+/* Resample a stream of samples by linear interpolation and add it to out
+ * like MIXER_MulAdd. Frame n is interpolated between the samples at
+ * (counter+n*add)>>FREQ_SHIFT and the one after it. The samples have to fit
+ * in 16 bits so that the interpolation can't overflow. */
+static void MIXER_Lerp(Bit32s * out,const Bit32s * stream,Bitu frames,Bitu counter,Bitu add,const Bit32s * volmul,bool stereo) {
+	Bitu i=0;
+#if defined(MIXER_SSE2)
+	const __m128i vol=_mm_set_epi32(volmul[1],volmul[0],volmul[1],volmul[0]);
+	if (stereo) {
+		for (;i+2<=frames;i+=2) {
+			const Bitu counter1=counter+add;
+			//Both frames with the following one as left,right,next left,next right
+			__m128i frame0=_mm_loadu_si128((const __m128i *)&stream[(counter>>FREQ_SHIFT)*2]);
+			__m128i frame1=_mm_loadu_si128((const __m128i *)&stream[(counter1>>FREQ_SHIFT)*2]);
+			__m128i prev=_mm_unpacklo_epi64(frame0,frame1);
+			__m128i next=_mm_unpackhi_epi64(frame0,frame1);
+			__m128i diff_mul=_mm_set_epi32((int)(counter1&FREQ_MASK),(int)(counter1&FREQ_MASK),
+				(int)(counter&FREQ_MASK),(int)(counter&FREQ_MASK));
+			__m128i sample=_mm_add_epi32(prev,_mm_srai_epi32(MIXER_MulLo(_mm_sub_epi32(next,prev),diff_mul),FREQ_SHIFT));
+			__m128i work=_mm_loadu_si128((const __m128i *)&out[i*2]);
+			_mm_storeu_si128((__m128i *)&out[i*2],_mm_add_epi32(work,MIXER_MulLo(sample,vol)));
+			counter=counter1+add;
+		}
+	} else {
+		for (;i+4<=frames;i+=4) {
+			const Bitu counter1=counter+add,counter2=counter1+add,counter3=counter2+add;
+			//Each sample with the following one
+			__m128i pair01=_mm_unpacklo_epi32(_mm_loadl_epi64((const __m128i *)&stream[counter>>FREQ_SHIFT]),
+				_mm_loadl_epi64((const __m128i *)&stream[counter1>>FREQ_SHIFT]));
+			__m128i pair23=_mm_unpacklo_epi32(_mm_loadl_epi64((const __m128i *)&stream[counter2>>FREQ_SHIFT]),
+				_mm_loadl_epi64((const __m128i *)&stream[counter3>>FREQ_SHIFT]));
+			__m128i prev=_mm_unpacklo_epi64(pair01,pair23);
+			__m128i next=_mm_unpackhi_epi64(pair01,pair23);
+			__m128i diff_mul=_mm_set_epi32((int)(counter3&FREQ_MASK),(int)(counter2&FREQ_MASK),
+				(int)(counter1&FREQ_MASK),(int)(counter&FREQ_MASK));
+			__m128i sample=_mm_add_epi32(prev,_mm_srai_epi32(MIXER_MulLo(_mm_sub_epi32(next,prev),diff_mul),FREQ_SHIFT));
+			__m128i work0=_mm_loadu_si128((const __m128i *)&out[i*2]);
+			__m128i work1=_mm_loadu_si128((const __m128i *)&out[i*2+4]);
+			work0=_mm_add_epi32(work0,MIXER_MulLo(_mm_unpacklo_epi32(sample,sample),vol));
+			work1=_mm_add_epi32(work1,MIXER_MulLo(_mm_unpackhi_epi32(sample,sample),vol));
+			_mm_storeu_si128((__m128i *)&out[i*2],work0);
+			_mm_storeu_si128((__m128i *)&out[i*2+4],work1);
+			counter=counter3+add;
+		}
+	}
+#elif defined(MIXER_NEON)
+	const int32x2_t vol_pair=vld1_s32(volmul);
+	const int32x4_t vol=vcombine_s32(vol_pair,vol_pair);
+	if (stereo) {
+		for (;i+2<=frames;i+=2) {
+			const Bitu counter1=counter+add;
+			int32x4_t frame0=vld1q_s32(&stream[(counter>>FREQ_SHIFT)*2]);
+			int32x4_t frame1=vld1q_s32(&stream[(counter1>>FREQ_SHIFT)*2]);
+			int32x4_t prev=vcombine_s32(vget_low_s32(frame0),vget_low_s32(frame1));
+			int32x4_t next=vcombine_s32(vget_high_s32(frame0),vget_high_s32(frame1));
+			int32x4_t diff_mul=vcombine_s32(vdup_n_s32((Bit32s)(counter&FREQ_MASK)),vdup_n_s32((Bit32s)(counter1&FREQ_MASK)));
+			int32x4_t sample=vaddq_s32(prev,vshrq_n_s32(vmulq_s32(vsubq_s32(next,prev),diff_mul),FREQ_SHIFT));
+			vst1q_s32(&out[i*2],vmlaq_s32(vld1q_s32(&out[i*2]),sample,vol));
+			counter=counter1+add;
+		}
+	} else {
+		for (;i+4<=frames;i+=4) {
+			const Bitu counter1=counter+add,counter2=counter1+add,counter3=counter2+add;
+			int32x4_t pair01=vcombine_s32(vld1_s32(&stream[counter>>FREQ_SHIFT]),vld1_s32(&stream[counter1>>FREQ_SHIFT]));
+			int32x4_t pair23=vcombine_s32(vld1_s32(&stream[counter2>>FREQ_SHIFT]),vld1_s32(&stream[counter3>>FREQ_SHIFT]));
+			int32x4x2_t split=vuzpq_s32(pair01,pair23);
+			const Bit32s fractions[4]={(Bit32s)(counter&FREQ_MASK),(Bit32s)(counter1&FREQ_MASK),
+				(Bit32s)(counter2&FREQ_MASK),(Bit32s)(counter3&FREQ_MASK)};
+			int32x4_t sample=vaddq_s32(split.val[0],vshrq_n_s32(vmulq_s32(vsubq_s32(split.val[1],split.val[0]),vld1q_s32(fractions)),FREQ_SHIFT));
+			int32x4x2_t both=vzipq_s32(sample,sample);
+			vst1q_s32(&out[i*2],vmlaq_s32(vld1q_s32(&out[i*2]),both.val[0],vol));
+			vst1q_s32(&out[i*2+4],vmlaq_s32(vld1q_s32(&out[i*2+4]),both.val[1],vol));
+			counter=counter3+add;
+		}
+	}
+#endif
+	const Bitu channels=stereo ? 2:1;
+	for (;i<frames;i++) {
+		const Bit32s * sample=&stream[(counter>>FREQ_SHIFT)*channels];
+		const Bits diff_mul=counter&FREQ_MASK;
+		const Bits left=sample[0]+(((sample[channels]-sample[0])*diff_mul)>>FREQ_SHIFT);
+		const Bits right=stereo ? sample[1]+(((sample[3]-sample[1])*diff_mul)>>FREQ_SHIFT) : left;
+		out[i*2]+=left*volmul[0];
+		out[i*2+1]+=right*volmul[1];
+		counter+=add;
+	}
+}
+
+/* Mix frames of a stream into the work buffer starting at frame mixpos,
+ * resampled with MIXER_Lerp if the channel interpolates */
+static void MIXER_MixWork(const Bit32s * stream,Bitu frames,Bitu mixpos,Bitu counter,Bitu add,bool interpolate,const Bit32s * volmul,bool stereo) {
+	while (frames) {
+		mixpos&=MIXER_BUFMASK;
+		Bitu part=MIXER_BUFSIZE-mixpos;
+		if (part>frames) part=frames;
+		if (interpolate) {
+			MIXER_Lerp(mixer.work[mixpos],stream,part,counter,add,volmul,stereo);
+			counter+=part*add;
+		} else {
+			MIXER_MulAdd(mixer.work[mixpos],stream,part,volmul,stereo);
+			stream+=part*(stereo ? 2:1);
+		}
+		mixpos+=part;
+		frames-=part;
+	}
+}
+
+/* Convert values of the work buffer to clipped 16 bit samples and clear them */
+static void MIXER_ClipOut(Bit16s * out,Bit32s * work,Bitu count) {
+	Bitu i=0;
+#if defined(MIXER_SSE2)
+	const __m128i zero=_mm_setzero_si128();
+	for (;i+8<=count;i+=8) {
+		__m128i low=_mm_srai_epi32(_mm_loadu_si128((const __m128i *)&work[i]),MIXER_VOLSHIFT);
+		__m128i high=_mm_srai_epi32(_mm_loadu_si128((const __m128i *)&work[i+4]),MIXER_VOLSHIFT);
+		_mm_storeu_si128((__m128i *)&out[i],_mm_packs_epi32(low,high));
+		_mm_storeu_si128((__m128i *)&work[i],zero);
+		_mm_storeu_si128((__m128i *)&work[i+4],zero);
+	}
+#elif defined(MIXER_NEON)
+	const int32x4_t zero=vdupq_n_s32(0);
+	for (;i+8<=count;i+=8) {
+		int16x4_t low=vqmovn_s32(vshrq_n_s32(vld1q_s32(&work[i]),MIXER_VOLSHIFT));
+		int16x4_t high=vqmovn_s32(vshrq_n_s32(vld1q_s32(&work[i+4]),MIXER_VOLSHIFT));
+		vst1q_s16(&out[i],vcombine_s16(low,high));
+		vst1q_s32(&work[i],zero);
+		vst1q_s32(&work[i+4],zero);
+	}
+#endif
+	for (;i<count;i++) {
+		out[i]=MIXER_CLIP(work[i]>>MIXER_VOLSHIFT);
+		work[i]=0;
+	}
+}
+
+/* Windowed sinc resampler. A channel that uses it keeps its last
+ * MIXER_SINC_TAPS samples, an output frame is the sum of them weighted by
+ * the coefficients for where the frame lies between the two samples in the
+ * middle. So the output lags the input by half the taps. The coefficients
+ * of MIXER_SINC_PHASES positions are computed once for every cutoff that is
+ * in use and shared between the channels. */
+#define MIXER_SINC_TAPS 32
+#define MIXER_SINC_PHASE_SHIFT 8
+#define MIXER_SINC_PHASES (1 << MIXER_SINC_PHASE_SHIFT)
+#define MIXER_SINC_SHIFT 14
+
+struct MixerSincTable {
+	Bitu cutoff;			//In 1/256 of the nyquist frequency of the input
+	Bit16s coeff[MIXER_SINC_PHASES][MIXER_SINC_TAPS];
+	MixerSincTable * next;
+};
+
+struct MixerSinc {
+	const MixerSincTable * table;
+	//Every sample is stored twice, so the last MIXER_SINC_TAPS samples are
+	//always in one piece starting at pos. The 16 bit copy is what the vector
+	//dot product of 8 and 16 bit sources uses, 32 bit sources keep their full
+	//range in the wide copy.
+	Bit16s history[2][MIXER_SINC_TAPS*2];
+	Bit32s wide[2][MIXER_SINC_TAPS*2];
+	Bitu pos;
+};
+
+static MixerSincTable * mixer_sinc_tables=0;
+
+static const MixerSincTable * MIXER_SincTable(Bitu cutoff) {
+	MixerSincTable * table;
+	for (table=mixer_sinc_tables;table;table=table->next) {
+		if (table->cutoff==cutoff) return table;
+	}
+	table=new MixerSincTable;
+	table->cutoff=cutoff;
+	table->next=mixer_sinc_tables;
+	mixer_sinc_tables=table;
+	const double fc=cutoff/256.0;
+	const double half=MIXER_SINC_TAPS/2;
+	for (Bitu phase=0;phase<MIXER_SINC_PHASES;phase++) {
+		double coeff[MIXER_SINC_TAPS];
+		double sum=0;
+		for (Bitu tap=0;tap<MIXER_SINC_TAPS;tap++) {
+			//Distance of the sample from the frame, blackman windowed
+			const double t=tap-(half-1)-(double)phase/MIXER_SINC_PHASES;
+			const double x=M_PI*fc*t;
+			const double window=0.42+0.5*cos(M_PI*t/half)+0.08*cos(2*M_PI*t/half);
+			coeff[tap]=(x ? sin(x)/x : 1.0)*window;
+			sum+=coeff[tap];
+		}
+		//Scale for unity gain and put the rounding error in the center tap,
+		//so a constant level comes out unchanged
+		const Bitu center=(phase<MIXER_SINC_PHASES/2) ? (Bitu)half-1 : (Bitu)half;
+		Bits total=0;
+		for (Bitu tap=0;tap<MIXER_SINC_TAPS;tap++) {
+			table->coeff[phase][tap]=(Bit16s)floor(coeff[tap]/sum*(1 << MIXER_SINC_SHIFT)+0.5);
+			total+=table->coeff[phase][tap];
+		}
+		table->coeff[phase][center]+=(Bit16s)((1 << MIXER_SINC_SHIFT)-total);
+	}
+	return table;
+}
+
+//Free the coefficient tables, the channels that still exist go back to
+//linear interpolation
+static void MIXER_FreeSincTables(void) {
+	for (MixerChannel * chan=mixer.channels;chan;chan=chan->next) {
+		delete chan->sinc;
+		chan->sinc=0;
+		chan->resampler=MIXER_RESAMPLE_LINEAR;
+	}
+	while (mixer_sinc_tables) {
+		MixerSincTable * next=mixer_sinc_tables->next;
+		delete mixer_sinc_tables;
+		mixer_sinc_tables=next;
+	}
+}
+
+//The resampler of a channel, from the channelresampler setting or the default
+static MixerResamplers MIXER_ChannelResampler(const char * name) {
+	const size_t len=strlen(name);
+	for (const char * scan=mixer.channel_resamplers;*scan;) {
+		while (*scan==' ' || *scan==',') scan++;
+		const char * token=scan;
+		while (*scan && *scan!=' ' && *scan!=',') scan++;
+		if ((size_t)(scan-token)>len && token[len]==':' && !strncasecmp(token,name,len)) {
+			const char * value=token+len+1;
+			const size_t value_len=(size_t)(scan-value);
+			if (value_len==4 && !strncasecmp(value,"sinc",4)) return MIXER_RESAMPLE_SINC;
+			if (value_len==6 && !strncasecmp(value,"linear",6)) return MIXER_RESAMPLE_LINEAR;
+		}
+	}
+	return mixer.resampler;
+}
+
+//Fill the history with one level, so the output continues from there
+static void MIXER_SincFill(MixerSinc & sinc,Bits left,Bits right) {
+	for (Bitu i=0;i<MIXER_SINC_TAPS*2;i++) {
+		sinc.history[0][i]=MIXER_CLIP(left);
+		sinc.history[1][i]=MIXER_CLIP(right);
+		sinc.wide[0][i]=(Bit32s)left;
+		sinc.wide[1][i]=(Bit32s)right;
+	}
+	sinc.pos=0;
+}
+
+static INLINE void MIXER_SincPush(MixerSinc & sinc,Bits left,Bits right) {
+	sinc.history[0][sinc.pos]=sinc.history[0][sinc.pos+MIXER_SINC_TAPS]=MIXER_CLIP(left);
+	sinc.history[1][sinc.pos]=sinc.history[1][sinc.pos+MIXER_SINC_TAPS]=MIXER_CLIP(right);
+	sinc.wide[0][sinc.pos]=sinc.wide[0][sinc.pos+MIXER_SINC_TAPS]=(Bit32s)left;
+	sinc.wide[1][sinc.pos]=sinc.wide[1][sinc.pos+MIXER_SINC_TAPS]=(Bit32s)right;
+	sinc.pos=(sinc.pos+1)&(MIXER_SINC_TAPS-1);
+}
+
+/* The samples are 16 bit and the absolute values of the coefficients of a
+ * phase add up to less than 2.0, so the sum fits in 32 bits */
+static INLINE Bits MIXER_SincDot(const Bit16s * samples,const Bit16s * coeff) {
+#if defined(MIXER_SSE2)
+	__m128i sum=_mm_setzero_si128();
+	for (Bitu i=0;i<MIXER_SINC_TAPS;i+=8) {
+		sum=_mm_add_epi32(sum,_mm_madd_epi16(_mm_loadu_si128((const __m128i *)&samples[i]),
+			_mm_loadu_si128((const __m128i *)&coeff[i])));
+	}
+	sum=_mm_add_epi32(sum,_mm_shuffle_epi32(sum,_MM_SHUFFLE(1,0,3,2)));
+	sum=_mm_add_epi32(sum,_mm_shuffle_epi32(sum,_MM_SHUFFLE(2,3,0,1)));
+	return _mm_cvtsi128_si32(sum) >> MIXER_SINC_SHIFT;
+#elif defined(MIXER_NEON)
+	int32x4_t sum=vdupq_n_s32(0);
+	for (Bitu i=0;i<MIXER_SINC_TAPS;i+=8) {
+		const int16x8_t sample=vld1q_s16(&samples[i]);
+		const int16x8_t factor=vld1q_s16(&coeff[i]);
+		sum=vmlal_s16(sum,vget_low_s16(sample),vget_low_s16(factor));
+		sum=vmlal_s16(sum,vget_high_s16(sample),vget_high_s16(factor));
+	}
+	const int32x2_t pair=vadd_s32(vget_low_s32(sum),vget_high_s32(sum));
+	return vget_lane_s32(vpadd_s32(pair,pair),0) >> MIXER_SINC_SHIFT;
+#else
+	Bit32s sum=0;
+	for (Bitu i=0;i<MIXER_SINC_TAPS;i++) sum+=samples[i]*coeff[i];
+	return sum >> MIXER_SINC_SHIFT;
+#endif
+}
+
+/* The samples of 32 bit sources can use the full range, so they are summed
+ * in 64 bits */
+static INLINE Bits MIXER_SincDotWide(const Bit32s * samples,const Bit16s * coeff) {
+	Bit64s sum=0;
+	for (Bitu i=0;i<MIXER_SINC_TAPS;i++) sum+=(Bit64s)samples[i]*coeff[i];
+	return (Bits)(sum >> MIXER_SINC_SHIFT);
+}
+
 MixerChannel * MIXER_AddChannel(MIXER_Handler handler,Bitu freq,const char * name) {
 	MixerChannel * chan=new MixerChannel();
 
@@ -115,7 +481,10 @@ MixerChannel * MIXER_AddChannel(MIXER_Handler handler,Bitu freq,const char * nam
 	chan->SetVolume(1,1);
 	chan->enabled=false;
 	chan->interpolate = false;
+	chan->resampler = MIXER_RESAMPLE_LINEAR;
+	chan->sinc = 0;
 	chan->SetFreq(freq); //Sets interpolate as well.
+	chan->SetResampler(MIXER_ChannelResampler(name));
 	chan->last_samples_were_silence = true;
 	chan->last_samples_were_stereo = false;
 	chan->offset[0] = 0;
@@ -139,6 +508,7 @@ void MIXER_DelChannel(MixerChannel* delchan) {
 	while (chan) {
 		if (chan==delchan) {
 			*where=chan->next;
+			delete delchan->sinc;
 			delete delchan;
 			return;
 		}
@@ -182,6 +552,27 @@ void MixerChannel::SetFreq(Bitu freq) {
 	} else {
 		interpolate = false;
 	}
+	SetResampler(resampler);
+}
+
+void MixerChannel::SetResampler(MixerResamplers _resampler) {
+	resampler = _resampler;
+	//Only channels that don't run at the mixer rate need it
+	if (resampler == MIXER_RESAMPLE_SINC && interpolate) {
+		//Cut off below the lower of the two nyquist frequencies, leaving
+		//the filter some room to fall off
+		Bitu cutoff = freq_add ? (230 << FREQ_SHIFT) / freq_add : 230;
+		if (cutoff > 230) cutoff = 230;
+		if (cutoff < 1) cutoff = 1;
+		if (!sinc) {
+			sinc = new MixerSinc;
+			MIXER_SincFill(*sinc, prevSample[0], prevSample[1]);
+		}
+		sinc->table = MIXER_SincTable(cutoff);
+	} else if (sinc) {
+		delete sinc;
+		sinc = 0;
+	}
 }
 
 void MixerChannel::Mix(Bitu _needed) {
@@ -229,6 +620,8 @@ void MixerChannel::AddSilence(void) {
 				freq_counter = FREQ_NEXT;
 			} 
 		}
+		//Continue from the level the silence ended at
+		if (sinc) MIXER_SincFill(*sinc, prevSample[0], prevSample[1]);
 	}
 	last_samples_were_silence = true;
 	offset[0] = offset[1] = 0;
@@ -238,9 +631,129 @@ void MixerChannel::AddSilence(void) {
 #define MIXER_UPRAMP_STEPS 0
 #define MIXER_UPRAMP_SAVE 512
 
+//Read a sample of the incoming data, 16bit and 32bit both contain 16bit data internally
+template<class Type,bool signeddata,bool nativeorder>
+static INLINE Bits MIXER_ReadSample(const Type * data) {
+	if ( sizeof( Type) == 1) {
+		if (!signeddata) return (((Bit8s)(data[0] ^ 0x80)) << 8);
+		else return (data[0] << 8);
+	} else if (signeddata) {
+		if (nativeorder) return data[0];
+		else if ( sizeof( Type) == 2) return (Bit16s)host_readw((HostPt)data);
+		else return (Bit32s)host_readd((HostPt)data);
+	} else {
+		if (nativeorder) return (Bits)data[0]-32768;
+		else if ( sizeof( Type) == 2) return (Bits)host_readw((HostPt)data)-32768;
+		else return (Bits)host_readd((HostPt)data)-32768;
+	}
+}
+
+#define MIXER_BULK_MIN 16		//samples left before the rest is mixed in bulk
+#define MIXER_BULK_MAX 256		//samples converted at once
+
+static INLINE bool MIXER_Fits16(Bits sample) {
+	return sample >= MIN_AUDIO && sample <= MAX_AUDIO;
+}
+
+/* Mix up to MIXER_BULK_MAX of the samples at pos like the loop in AddSamples
+ * would, it is called when that loop is about to write the frame at mixpos.
+ * The samples are converted first and then resampled and mixed by the
+ * kernels. Returns false if the samples of the channel don't allow that. */
+template<class Type,bool stereo,bool signeddata,bool nativeorder>
+static bool MIXER_AddBulk(MixerChannel & chan,Bitu len,const Type * data,Bitu & pos,Bitu & mixpos) {
+	const Bitu channels=stereo ? 2:1;
+	if (!chan.interpolate && chan.freq_add!=FREQ_NEXT) return false;
+	//Interpolating 32 bit values would overflow
+	if (sizeof(Type)>2 || !MIXER_Fits16(chan.prevSample[0]) || !MIXER_Fits16(chan.nextSample[0])) return false;
+	if (stereo && (!MIXER_Fits16(chan.prevSample[1]) || !MIXER_Fits16(chan.nextSample[1]))) return false;
+
+	//The stream starts with the two samples the channel already has
+	Bit32s stream[(MIXER_BULK_MAX+2)*2];
+	Bitu count=len-pos;
+	if (count>MIXER_BULK_MAX) count=MIXER_BULK_MAX;
+	stream[0]=(Bit32s)chan.prevSample[0];
+	stream[channels]=(Bit32s)chan.nextSample[0];
+	if (stereo) {
+		stream[1]=(Bit32s)chan.prevSample[1];
+		stream[3]=(Bit32s)chan.nextSample[1];
+	}
+	for (Bitu i=0;i<count*channels;i++)
+		stream[2*channels+i]=(Bit32s)MIXER_ReadSample<Type,signeddata,nativeorder>(&data[pos*channels+i]);
+
+	//Frame n uses the stream at (freq_counter+n*freq_add)>>FREQ_SHIFT, the
+	//frame that would need the sample after the stream is left to the loop
+	const Bitu start=chan.freq_counter;
+	const Bitu frames=(((count+1)<<FREQ_SHIFT)-1-start)/chan.freq_add+1;
+	MIXER_MixWork(stream,frames,mixpos,start,chan.freq_add,chan.interpolate,chan.volmul,stereo);
+
+	//Leave the channel as the loop would have after reading all of the stream
+	chan.prevSample[0]=stream[count*channels];
+	chan.nextSample[0]=stream[(count+1)*channels];
+	if (stereo) {
+		chan.prevSample[1]=stream[count*2+1];
+		chan.nextSample[1]=stream[count*2+3];
+	}
+	chan.freq_counter=start+frames*chan.freq_add-(count<<FREQ_SHIFT);
+	chan.done+=frames;
+	pos+=count;
+	mixpos+=frames;
+	return true;
+}
+
+/* AddSamples for channels that resample with the sinc resampler */
+template<class Type,bool stereo,bool signeddata,bool nativeorder>
+static void MIXER_AddSinc(MixerChannel & chan,Bitu len,const Type * data) {
+	MixerSinc & sinc=*chan.sinc;
+	Bitu mixpos=mixer.pos+chan.done;
+	Bitu pos=0;
+	while (1) {
+		while (chan.freq_counter>=FREQ_NEXT) {
+			if (pos>=len) {
+				//The samples in the middle are the ones being resampled
+				const Bitu middle=sinc.pos+MIXER_SINC_TAPS/2;
+				chan.prevSample[0]=sinc.wide[0][middle-1];
+				chan.prevSample[1]=sinc.wide[1][middle-1];
+				chan.nextSample[0]=sinc.wide[0][middle];
+				chan.nextSample[1]=sinc.wide[1][middle];
+				chan.last_samples_were_silence=false;
+				return;
+			}
+			chan.freq_counter-=FREQ_NEXT;
+			if (stereo) {
+				MIXER_SincPush(sinc,MIXER_ReadSample<Type,signeddata,nativeorder>(&data[pos*2+0]),
+					MIXER_ReadSample<Type,signeddata,nativeorder>(&data[pos*2+1]));
+			} else {
+				const Bits sample=MIXER_ReadSample<Type,signeddata,nativeorder>(&data[pos]);
+				MIXER_SincPush(sinc,sample,sample);
+			}
+			pos++;
+		}
+		const Bit16s * coeff=sinc.table->coeff[(chan.freq_counter&FREQ_MASK)>>(FREQ_SHIFT-MIXER_SINC_PHASE_SHIFT)];
+		mixpos&=MIXER_BUFMASK;
+		Bit32s * write=mixer.work[mixpos];
+		Bits left,right;
+		if (sizeof(Type)>2) {
+			left=MIXER_SincDotWide(&sinc.wide[0][sinc.pos],coeff);
+			right=stereo ? MIXER_SincDotWide(&sinc.wide[1][sinc.pos],coeff) : left;
+		} else {
+			left=MIXER_SincDot(&sinc.history[0][sinc.pos],coeff);
+			right=stereo ? MIXER_SincDot(&sinc.history[1][sinc.pos],coeff) : left;
+		}
+		write[0]+=left*chan.volmul[0];
+		write[1]+=right*chan.volmul[1];
+		chan.freq_counter+=chan.freq_add;
+		mixpos++;
+		chan.done++;
+	}
+}
+
 template<class Type,bool stereo,bool signeddata,bool nativeorder>
 inline void MixerChannel::AddSamples(Bitu len, const Type* data) {
 	last_samples_were_stereo = stereo;
+	if (sinc) {
+		MIXER_AddSinc<Type,stereo,signeddata,nativeorder>(*this,len,data);
+		return;
+	}
 
 	//Position where to write the data
 	Bitu mixpos = mixer.pos + done;
@@ -269,75 +782,11 @@ inline void MixerChannel::AddSamples(Bitu len, const Type* data) {
 			if (stereo) {
 				prevSample[1] = nextSample[1];
 			}
-			if ( sizeof( Type) == 1) {
-				if (!signeddata) {
-					if (stereo) {
-						nextSample[0]=(((Bit8s)(data[pos*2+0] ^ 0x80)) << 8);
-						nextSample[1]=(((Bit8s)(data[pos*2+1] ^ 0x80)) << 8);
-					} else {
-						nextSample[0]=(((Bit8s)(data[pos] ^ 0x80)) << 8);
-					}
-				} else {
-					if (stereo) {
-						nextSample[0]=(data[pos*2+0] << 8);
-						nextSample[1]=(data[pos*2+1] << 8);
-					} else {
-						nextSample[0]=(data[pos] << 8);
-					}
-				}
-			//16bit and 32bit both contain 16bit data internally
-			} else  {
-				if (signeddata) {
-					if (stereo) {
-						if (nativeorder) {
-							nextSample[0]=data[pos*2+0];
-							nextSample[1]=data[pos*2+1];
-						} else {
-							if ( sizeof( Type) == 2) {
-								nextSample[0]=(Bit16s)host_readw((HostPt)&data[pos*2+0]);
-								nextSample[1]=(Bit16s)host_readw((HostPt)&data[pos*2+1]);
-							} else {
-								nextSample[0]=(Bit32s)host_readd((HostPt)&data[pos*2+0]);
-								nextSample[1]=(Bit32s)host_readd((HostPt)&data[pos*2+1]);
-							}
-						}
-					} else {
-						if (nativeorder) {
-							nextSample[0] = data[pos];
-						} else {
-							if ( sizeof( Type) == 2) {
-								nextSample[0]=(Bit16s)host_readw((HostPt)&data[pos]);
-							} else {
-								nextSample[0]=(Bit32s)host_readd((HostPt)&data[pos]);
-							}
-						}
-					}
-				} else {
-					if (stereo) {
-						if (nativeorder) {
-							nextSample[0]=(Bits)data[pos*2+0]-32768;
-							nextSample[1]=(Bits)data[pos*2+1]-32768;
-						} else {
-							if ( sizeof( Type) == 2) {
-								nextSample[0]=(Bits)host_readw((HostPt)&data[pos*2+0])-32768;
-								nextSample[1]=(Bits)host_readw((HostPt)&data[pos*2+1])-32768;
-							} else {
-								nextSample[0]=(Bits)host_readd((HostPt)&data[pos*2+0])-32768;
-								nextSample[1]=(Bits)host_readd((HostPt)&data[pos*2+1])-32768;
-							}
-						}
-					} else {
-						if (nativeorder) {
-							nextSample[0]=(Bits)data[pos]-32768;
-						} else {
-							if ( sizeof( Type) == 2) {
-								nextSample[0]=(Bits)host_readw((HostPt)&data[pos])-32768;
-							} else {
-								nextSample[0]=(Bits)host_readd((HostPt)&data[pos])-32768;
-							}
-						}
-					}
-				}
+			if (stereo) {
+				nextSample[0]=MIXER_ReadSample<Type,signeddata,nativeorder>(&data[pos*2+0]);
+				nextSample[1]=MIXER_ReadSample<Type,signeddata,nativeorder>(&data[pos*2+1]);
+			} else {
+				nextSample[0]=MIXER_ReadSample<Type,signeddata,nativeorder>(&data[pos]);
 			}
 			//This sample has been handled now, increase position
 			pos++;
@@ -356,6 +805,11 @@ inline void MixerChannel::AddSamples(Bitu len, const Type* data) {
 			}
 #endif
 		}
+#if MIXER_UPRAMP_STEPS == 0
+		//Hand the rest to the kernels when there is enough of it
+		if (len - pos >= MIXER_BULK_MIN &&
+			MIXER_AddBulk<Type,stereo,signeddata,nativeorder>(*this,len,data,pos,mixpos)) continue;
+#endif
 		//Where to write
 		mixpos &= MIXER_BUFMASK;
 		Bit32s* write = mixer.work[mixpos];
@@ -497,6 +951,9 @@ static Bit32u calc_tickadd(Bit32u freq) {
 
 /* Mix a certain amount of new samples */
 static void MIXER_MixData(Bitu needed) {
+#ifdef __LIBRETRO__
+	profiler::Scope profile_scope(profiler::Section::Mixer);
+#endif
 	MixerChannel * chan=mixer.channels;
 	while (chan) {
 		chan->Mix(needed);
@@ -562,6 +1019,9 @@ static void SDLCALL
 void
 #endif
 MIXER_CallBack(void * /*userdata*/, Uint8 *stream, int len) {
+#ifdef __LIBRETRO__
+	profiler::Scope profile_scope(profiler::Section::Mixer);
+#endif
 	Bitu need=(Bitu)len/MIXER_SSIZE;
 	Bit16s * output=(Bit16s *)stream;
 	Bitu reduce;
@@ -640,7 +1100,20 @@ MIXER_CallBack(void * /*userdata*/, Uint8 *stream, int len) {
 	pos = mixer.pos;
 	mixer.pos = (mixer.pos + reduce) & MIXER_BUFMASK;
 	if(need != reduce) {
-		while (need--) {
+		if (mixer.smoothdrift) {
+			//Interpolate between the frames instead of dropping or repeating them
+			while (need--) {
+				Bitu offset = index >> INDEX_SHIFT_LOCAL;
+				Bitu i = (pos + offset) & MIXER_BUFMASK;
+				Bitu j = (offset + 1 < reduce) ? ((i + 1) & MIXER_BUFMASK) : i;
+				Bit64s diff_mul = index & ((1 << INDEX_SHIFT_LOCAL) - 1);
+				index += index_add;
+				sample = mixer.work[i][0] + (Bits)(((Bit64s)(mixer.work[j][0] - mixer.work[i][0]) * diff_mul) >> INDEX_SHIFT_LOCAL);
+				*output++ = MIXER_CLIP(sample >> MIXER_VOLSHIFT);
+				sample = mixer.work[i][1] + (Bits)(((Bit64s)(mixer.work[j][1] - mixer.work[i][1]) * diff_mul) >> INDEX_SHIFT_LOCAL);
+				*output++ = MIXER_CLIP(sample >> MIXER_VOLSHIFT);
+			}
+		} else while (need--) {
 			Bitu i = (pos + (index >> INDEX_SHIFT_LOCAL )) & MIXER_BUFMASK;
 			index += index_add;
 			sample=mixer.work[i][0]>>MIXER_VOLSHIFT;
@@ -656,22 +1129,122 @@ MIXER_CallBack(void * /*userdata*/, Uint8 *stream, int len) {
 			pos++;
 		}
 	} else {
-		while (reduce--) {
+		while (reduce) {
 			pos &= MIXER_BUFMASK;
-			sample=mixer.work[pos][0]>>MIXER_VOLSHIFT;
-			*output++=MIXER_CLIP(sample);
-			sample=mixer.work[pos][1]>>MIXER_VOLSHIFT;
-			*output++=MIXER_CLIP(sample);
-			mixer.work[pos][0]=0;
-			mixer.work[pos][1]=0;
-			pos++;
+			Bitu part = MIXER_BUFSIZE - pos;
+			if (part > reduce) part = reduce;
+			MIXER_ClipOut(output,mixer.work[pos],part*2);
+			output += part*2;
+			pos += part;
+			reduce -= part;
 		}
 	}
 }
 
 #undef INDEX_SHIFT_LOCAL
 
+static void MIXER_SaveState(SnapshotWriter& writer) {
+	writer.Write(mixer.freq);
+	writer.Write((Bit32u)mixer.done);
+	writer.Write((Bit32u)mixer.needed);
+	writer.Write(mixer.tick_add);
+	writer.Write(mixer.tick_counter);
+	writer.Write(mixer.mastervol[0]);
+	writer.Write(mixer.mastervol[1]);
+	/* Only the part of the ring buffer that holds pending samples */
+	Bitu pending=mixer.needed;
+	Bit16u count=0;
+	for (MixerChannel * chan=mixer.channels;chan;chan=chan->next) {
+		if (chan->done>pending) pending=chan->done;
+		count++;
+	}
+	if (pending>MIXER_BUFSIZE) pending=MIXER_BUFSIZE;
+	writer.Write((Bit32u)pending);
+	for (Bitu i=0;i<pending;i++) writer.WriteBlock(mixer.work[(mixer.pos+i)&MIXER_BUFMASK],sizeof(mixer.work[0]));
+	writer.Write(count);
+	for (MixerChannel * chan=mixer.channels;chan;chan=chan->next) {
+		Bit8u len=(Bit8u)strlen(chan->name);
+		writer.Write(len);
+		writer.WriteBlock(chan->name,len);
+		writer.WriteStruct(chan->volmain,sizeof(chan->volmain));
+		writer.Write(chan->scale);
+		writer.WriteStruct(chan->volmul,sizeof(chan->volmul));
+		writer.WriteStruct(chan->last,sizeof(chan->last));
+		writer.Write((Bit64u)chan->freq_add);
+		writer.Write((Bit64u)chan->freq_index);
+		writer.Write((Bit64u)chan->freq_counter);
+		writer.Write((Bit32u)chan->done);
+		writer.Write((Bit32u)chan->needed);
+		writer.WriteStruct(chan->prevSample,sizeof(chan->prevSample));
+		writer.WriteStruct(chan->nextSample,sizeof(chan->nextSample));
+		writer.WriteStruct(chan->offset,sizeof(chan->offset));
+		writer.Write(chan->interpolate);
+		writer.Write(chan->enabled);
+		writer.Write(chan->last_samples_were_stereo);
+		writer.Write(chan->last_samples_were_silence);
+	}
+}
+
+static bool MIXER_LoadState(SnapshotReader& reader,Bit16u /*version*/) {
+	Bit32u freq,done,needed,pending;
+	if (!reader.Read(freq) || freq!=mixer.freq) return false;
+	reader.Read(done);
+	reader.Read(needed);
+	reader.Read(mixer.tick_add);
+	reader.Read(mixer.tick_counter);
+	reader.Read(mixer.mastervol[0]);
+	reader.Read(mixer.mastervol[1]);
+	if (!reader.Read(pending) || pending>MIXER_BUFSIZE) return false;
+	mixer.done=done;
+	mixer.needed=needed;
+	memset(mixer.work,0,sizeof(mixer.work));
+	mixer.pos=0;
+	if (!reader.ReadBlock(mixer.work,pending*sizeof(mixer.work[0]))) return false;
+	Bit16u count;
+	if (!reader.Read(count)) return false;
+	for (Bitu i=0;i<count;i++) {
+		char name[256];
+		Bit8u len;
+		if (!reader.Read(len) || !reader.ReadBlock(name,len)) return false;
+		name[len]=0;
+		MixerChannel * chan=MIXER_FindChannel(name);
+		if (!chan) {
+			LOG_MSG("MIXER: Snapshot channel %s does not exist",name);
+			return false;
+		}
+		Bit64u freq_add,freq_index,freq_counter;
+		Bit32u chan_done,chan_needed;
+		reader.ReadStruct(chan->volmain,sizeof(chan->volmain));
+		reader.Read(chan->scale);
+		reader.ReadStruct(chan->volmul,sizeof(chan->volmul));
+		reader.ReadStruct(chan->last,sizeof(chan->last));
+		reader.Read(freq_add);
+		reader.Read(freq_index);
+		reader.Read(freq_counter);
+		reader.Read(chan_done);
+		reader.Read(chan_needed);
+		reader.ReadStruct(chan->prevSample,sizeof(chan->prevSample));
+		reader.ReadStruct(chan->nextSample,sizeof(chan->nextSample));
+		reader.ReadStruct(chan->offset,sizeof(chan->offset));
+		reader.Read(chan->interpolate);
+		reader.Read(chan->enabled);
+		reader.Read(chan->last_samples_were_stereo);
+		reader.Read(chan->last_samples_were_silence);
+		chan->freq_add=(Bitu)freq_add;
+		chan->freq_index=(Bitu)freq_index;
+		chan->freq_counter=(Bitu)freq_counter;
+		chan->done=chan_done;
+		chan->needed=chan_needed;
+		//The history of the sinc resampler isn't saved, start from the level
+		chan->SetResampler(chan->resampler);
+		if (chan->sinc) MIXER_SincFill(*chan->sinc,chan->prevSample[0],chan->prevSample[1]);
+	}
+	return !reader.Failed();
+}
+
 static void MIXER_Stop(Section* /*sec*/) {
+	SNAPSHOT_Unregister("MIXER");
+	MIXER_FreeSincTables();
 }
 
 class MIXER : public Program {
@@ -767,6 +1340,9 @@ void MIXER_Init(Section* sec) {
 	mixer.freq=section->Get_int("rate");
 	mixer.nosound=section->Get_bool("nosound");
 	mixer.blocksize=section->Get_int("blocksize");
+	mixer.resampler=strcmp(section->Get_string("resampler"),"sinc") ? MIXER_RESAMPLE_LINEAR : MIXER_RESAMPLE_SINC;
+	mixer.smoothdrift=section->Get_bool("smoothdrift");
+	safe_strncpy(mixer.channel_resamplers,section->Get_string("channelresampler"),sizeof(mixer.channel_resamplers));
 
 	/* Initialize the internal stuff */
 	mixer.channels=0;
@@ -821,6 +1397,7 @@ void MIXER_Init(Section* sec) {
 	mixer.max_needed = mixer.blocksize * 2 + 2*mixer.min_needed;
 	mixer.needed = mixer.min_needed+1;
 	PROGRAMS_MakeFile("MIXER.COM",MIXER_ProgramStart);
+	SNAPSHOT_Register("MIXER",1,MIXER_SaveState,MIXER_LoadState);
 }
 
 #ifdef __LIBRETRO__
@@ -24,6 +24,7 @@
 #include "setup.h"
 #include "cpu.h"
 #include "support.h"
+#include "snapshot.h"
 
 void MIDI_RawOutByte(Bit8u data);
 bool MIDI_Available(void);
@@ -632,6 +633,14 @@ static void MPU401_Reset(void) {
 	for (Bitu i=0;i<8;i++) {mpu.playbuf[i].type=T_OVERFLOW;mpu.playbuf[i].counter=0;}
 }
 
+static void MPU401_SaveState(SnapshotWriter& writer) {
+	writer.WriteStruct(&mpu,sizeof(mpu));
+}
+
+static bool MPU401_LoadState(SnapshotReader& reader,Bit16u /*version*/) {
+	return reader.ReadStruct(&mpu,sizeof(mpu));
+}
+
 class MPU401:public Module_base{
 private:
 	IO_ReadHandleObject ReadHandler[2];
@@ -648,6 +657,7 @@ public:
 		if (!MIDI_Available()) return;
 		/*Enabled and there is a Midi */
 		installed = true;
+		SNAPSHOT_Register("MPU401",1,MPU401_SaveState,MPU401_LoadState);
 
 		WriteHandler[0].Install(0x330,&MPU401_WriteData,IO_MB);
 		WriteHandler[1].Install(0x331,&MPU401_WriteCommand,IO_MB);
@@ -668,6 +678,7 @@ public:
 	}
 	~MPU401(){
 		if(!installed) return;
+		SNAPSHOT_Unregister("MPU401");
 		Section_prop * section=static_cast<Section_prop *>(m_configuration);
 		if(strcasecmp(section->Get_string("mpu401"),"intelligent")) return;
 		PIC_SetIRQMask(mpu.irq,true);
@@ -23,6 +23,7 @@
 #include "timer.h"
 #include "setup.h"
 #include "pic.h"
+#include "snapshot.h"
 
 
 #ifndef PI
@@ -320,6 +321,20 @@ static void PCSPEAKER_CallBack(Bitu len) {
 	} 
 
 }
+static void PCSPEAKER_SaveState(SnapshotWriter& writer) {
+	writer.WriteStruct(&spkr,sizeof(spkr));
+	writer.Write((Bit8u)(spkr.chan && spkr.chan->enabled));
+}
+
+static bool PCSPEAKER_LoadState(SnapshotReader& reader,Bit16u /*version*/) {
+	MixerChannel * chan=spkr.chan;
+	Bit8u enabled;
+	if (!reader.ReadStruct(&spkr,sizeof(spkr)) || !reader.Read(enabled)) return false;
+	spkr.chan=chan;
+	if (spkr.chan) spkr.chan->Enable(enabled!=0);
+	return true;
+}
+
 class PCSPEAKER:public Module_base {
 private:
 	MixerObject MixerChan;
@@ -342,10 +357,12 @@ public:
 		spkr.used=0;
 		/* Register the sound channel */
 		spkr.chan=MixerChan.Install(&PCSPEAKER_CallBack,spkr.rate,"SPKR");
+		SNAPSHOT_Register("SPEAKER",1,PCSPEAKER_SaveState,PCSPEAKER_LoadState);
 	}
 	~PCSPEAKER(){
 		Section_prop * section=static_cast<Section_prop *>(m_configuration);
 		if(!section->Get_bool("pcspeaker")) return;
+		SNAPSHOT_Unregister("SPEAKER");
 	}
 };
 static PCSPEAKER* test;
@@ -23,8 +23,14 @@
 #include "pic.h"
 #include "timer.h"
 #include "setup.h"
+#include "snapshot.h"
+#include <algorithm>
+#include <vector>
+#ifdef __LIBRETRO__
+#include "libretro_profiler.h"
+#endif
 
-#define PIC_QUEUESIZE 512
+#define PIC_QUEUEGROW 512		// entries added to the queue when it is full
 
 struct PIC_Controller {
 	Bitu icw_words;
@@ -168,15 +174,42 @@ struct PICEntry {
 	float index;
 	Bitu value;
 	PIC_EventHandler pic_event;
-	PICEntry * next;
+	PICEntry * next;		// free list, or the next event of the same handler
+	PICEntry * prev;
+	Bit64u order;			// events with the same index run in the order they were added
+	Bitu heap_pos;			// where in the heap the event is
+	Bitu handler_slot;		// which list of events by handler it is in
 };
 
+/* The pending events are kept in a binary heap with the next one to run at
+ * the top. Every event is also linked into a list of the events of its
+ * handler, so those can be removed without going through the whole queue.
+ * The entries are allocated PIC_QUEUEGROW at a time and never move, the
+ * heap has room for all of them. */
 static struct {
-	PICEntry entries[PIC_QUEUESIZE];
+	std::vector<PICEntry *> blocks;
 	PICEntry * free_entry;
-	PICEntry * next_entry;
+	PICEntry * * heap;
+	Bitu size;
+	Bitu used;
+	Bit64u order;
 } pic_queue;
 
+#define PIC_NO_SLOT (~(Bitu)0)
+
+struct PICHandlerSlot {
+	PIC_EventHandler handler;
+	PICEntry * first;
+};
+
+/* Open addressing hash table of the handlers that have had events, it is
+ * kept at most half full */
+static struct {
+	PICHandlerSlot * slots;
+	Bitu size;
+	Bitu used;
+} pic_handlers;
+
 static void write_command(Bitu port,Bitu val,Bitu /*iolen*/) {
 	PIC_Controller * pic = &pics[port==0x20 ? 0 : 1];
 
@@ -370,41 +403,149 @@ void PIC_SetIRQMask(Bitu irq, bool masked) {
 	pic->set_imr(newmask);
 }
 
-static void AddEntry(PICEntry * entry) {
-	PICEntry * find_entry=pic_queue.next_entry;
-	if (GCC_UNLIKELY(find_entry ==0)) {
-		entry->next=0;
-		pic_queue.next_entry=entry;
-	} else if (find_entry->index>entry->index) {
-		pic_queue.next_entry=entry;
-		entry->next=find_entry;
-	} else while (find_entry) {
-		if (find_entry->next) {
-			/* See if the next index comes later than this one */
-			if (find_entry->next->index > entry->index) {
-				entry->next=find_entry->next;
-				find_entry->next=entry;
-				break;
-			} else {
-				find_entry=find_entry->next;
-			}
-		} else {
-			entry->next=find_entry->next;
-			find_entry->next=entry;
-			break;
-		}
+static INLINE bool EntryBefore(const PICEntry * a,const PICEntry * b) {
+	if (a->index!=b->index) return a->index<b->index;
+	return a->order<b->order;
+}
+
+static INLINE void HeapPlace(PICEntry * entry,Bitu pos) {
+	pic_queue.heap[pos]=entry;
+	entry->heap_pos=pos;
+}
+
+static void HeapUp(PICEntry * entry) {
+	Bitu pos=entry->heap_pos;
+	while (pos) {
+		Bitu parent=(pos-1)/2;
+		if (!EntryBefore(entry,pic_queue.heap[parent])) break;
+		HeapPlace(pic_queue.heap[parent],pos);
+		pos=parent;
+	}
+	HeapPlace(entry,pos);
+}
+
+static void HeapDown(PICEntry * entry) {
+	Bitu pos=entry->heap_pos;
+	for (;;) {
+		Bitu child=pos*2+1;
+		if (child>=pic_queue.used) break;
+		if (child+1<pic_queue.used && EntryBefore(pic_queue.heap[child+1],pic_queue.heap[child])) child++;
+		if (!EntryBefore(pic_queue.heap[child],entry)) break;
+		HeapPlace(pic_queue.heap[child],pos);
+		pos=child;
+	}
+	HeapPlace(entry,pos);
+}
+
+static INLINE Bitu HandlerHash(PIC_EventHandler handler) {
+	return ((Bitu)(uintptr_t)handler>>4)&(pic_handlers.size-1);
+}
+
+/* The slot of a handler, or PIC_NO_SLOT if it never had an event */
+static Bitu FindHandlerSlot(PIC_EventHandler handler) {
+	if (!pic_handlers.size) return PIC_NO_SLOT;
+	Bitu slot=HandlerHash(handler);
+	while (pic_handlers.slots[slot].handler) {
+		if (pic_handlers.slots[slot].handler==handler) return slot;
+		slot=(slot+1)&(pic_handlers.size-1);
+	}
+	return PIC_NO_SLOT;
+}
+
+/* Double the size of the handler table, the events are told their new slot */
+static void GrowHandlerSlots(void) {
+	PICHandlerSlot * old_slots=pic_handlers.slots;
+	Bitu old_size=pic_handlers.size;
+	pic_handlers.size=old_size ? old_size*2 : 64;
+	pic_handlers.slots=(PICHandlerSlot *)calloc(pic_handlers.size,sizeof(PICHandlerSlot));
+	if (!pic_handlers.slots) E_Exit("PIC: Out of memory for event handlers");
+	for (Bitu i=0;i<old_size;i++) {
+		if (!old_slots[i].handler) continue;
+		Bitu slot=HandlerHash(old_slots[i].handler);
+		while (pic_handlers.slots[slot].handler) slot=(slot+1)&(pic_handlers.size-1);
+		pic_handlers.slots[slot]=old_slots[i];
+		for (PICEntry * entry=old_slots[i].first;entry;entry=entry->next) entry->handler_slot=slot;
+	}
+	free(old_slots);
+}
+
+/* The slot of a handler, it gets one if it doesn't have one yet */
+static Bitu AddHandlerSlot(PIC_EventHandler handler) {
+	Bitu slot=FindHandlerSlot(handler);
+	if (slot!=PIC_NO_SLOT) return slot;
+	if ((pic_handlers.used+1)*2>pic_handlers.size) GrowHandlerSlots();
+	slot=HandlerHash(handler);
+	while (pic_handlers.slots[slot].handler) slot=(slot+1)&(pic_handlers.size-1);
+	pic_handlers.slots[slot].handler=handler;
+	pic_handlers.slots[slot].first=0;
+	pic_handlers.used++;
+	return slot;
+}
+
+/* Take an event out of the heap and the list of its handler */
+static void RemoveEntry(PICEntry * entry) {
+	PICEntry * last=pic_queue.heap[--pic_queue.used];
+	if (last!=entry) {
+		HeapPlace(last,entry->heap_pos);
+		HeapDown(last);
+		HeapUp(last);
 	}
-	Bits cycles=PIC_MakeCycles(pic_queue.next_entry->index-PIC_TickIndex());
+	if (entry->prev) entry->prev->next=entry->next;
+	else pic_handlers.slots[entry->handler_slot].first=entry->next;
+	if (entry->next) entry->next->prev=entry->prev;
+}
+
+/* Put an event in the list of its handler and at the end of the heap */
+static void LinkEntry(PICEntry * entry) {
+	entry->order=pic_queue.order++;
+	entry->handler_slot=AddHandlerSlot(entry->pic_event);
+	entry->prev=0;
+	entry->next=pic_handlers.slots[entry->handler_slot].first;
+	if (entry->next) entry->next->prev=entry;
+	pic_handlers.slots[entry->handler_slot].first=entry;
+	HeapPlace(entry,pic_queue.used++);
+}
+
+static void AddEntry(PICEntry * entry) {
+	LinkEntry(entry);
+	HeapUp(entry);
+#ifdef __LIBRETRO__
+	profiler::countMax(profiler::Counter::EventQueueMax,(uint32_t)pic_queue.used);
+#endif
+	/* Stop the core and have the slice planned again. Shortening the slice
+	 * in place would save the return, but the cores account for a stopped
+	 * slice differently, so the event would run at another instruction. */
+	Bits cycles=PIC_MakeCycles(pic_queue.heap[0]->index-PIC_TickIndex());
 	if (cycles<CPU_Cycles) {
 		CPU_CycleLeft+=CPU_Cycles;
 		CPU_Cycles=0;
 	}
 }
+
+static INLINE void FreeEntry(PICEntry * entry) {
+	entry->next=pic_queue.free_entry;
+	pic_queue.free_entry=entry;
+}
+
+/* Add PIC_QUEUEGROW entries to the free list and make room for them in the heap */
+static bool GrowQueue(void) {
+	PICEntry * * heap=(PICEntry * *)realloc(pic_queue.heap,(pic_queue.size+PIC_QUEUEGROW)*sizeof(PICEntry *));
+	if (!heap) return false;
+	pic_queue.heap=heap;
+	PICEntry * block=(PICEntry *)malloc(PIC_QUEUEGROW*sizeof(PICEntry));
+	if (!block) return false;
+	pic_queue.blocks.push_back(block);
+	pic_queue.size+=PIC_QUEUEGROW;
+	for (Bits i=PIC_QUEUEGROW-1;i>=0;i--) FreeEntry(&block[i]);
+	return true;
+}
 static bool InEventService = false;
+/* The entry whose handler is running, it is owned by PIC_RunQueue until the handler returns */
+static PICEntry * ServicedEntry = 0;
 static float srv_lag = 0;
 
 void PIC_AddEvent(PIC_EventHandler handler,float delay,Bitu val) {
-	if (GCC_UNLIKELY(!pic_queue.free_entry)) {
+	if (GCC_UNLIKELY(!pic_queue.free_entry) && !GrowQueue()) {
 		LOG(LOG_PIC,LOG_ERROR)("Event queue full");
 		return;
 	}
@@ -419,52 +560,28 @@ void PIC_AddEvent(PIC_EventHandler handler,float delay,Bitu val) {
 }
 
 void PIC_RemoveSpecificEvents(PIC_EventHandler handler, Bitu val) {
-	PICEntry * entry=pic_queue.next_entry;
-	PICEntry * prev_entry;
-	prev_entry = 0;
+	Bitu slot=FindHandlerSlot(handler);
+	if (slot==PIC_NO_SLOT) return;
+	PICEntry * entry=pic_handlers.slots[slot].first;
 	while (entry) {
-		if (GCC_UNLIKELY((entry->pic_event == handler)) && (entry->value == val)) {
-			if (prev_entry) {
-				prev_entry->next=entry->next;
-				entry->next=pic_queue.free_entry;
-				pic_queue.free_entry=entry;
-				entry=prev_entry->next;
-				continue;
-			} else {
-				pic_queue.next_entry=entry->next;
-				entry->next=pic_queue.free_entry;
-				pic_queue.free_entry=entry;
-				entry=pic_queue.next_entry;
-				continue;
-			}
+		PICEntry * next_entry=entry->next;
+		if (entry->value==val) {
+			RemoveEntry(entry);
+			FreeEntry(entry);
 		}
-		prev_entry=entry;
-		entry=entry->next;
+		entry=next_entry;
 	}
 }
 
 void PIC_RemoveEvents(PIC_EventHandler handler) {
-	PICEntry * entry=pic_queue.next_entry;
-	PICEntry * prev_entry;
-	prev_entry=0;
+	Bitu slot=FindHandlerSlot(handler);
+	if (slot==PIC_NO_SLOT) return;
+	PICEntry * entry=pic_handlers.slots[slot].first;
 	while (entry) {
-		if (GCC_UNLIKELY(entry->pic_event==handler)) {
-			if (prev_entry) {
-				prev_entry->next=entry->next;
-				entry->next=pic_queue.free_entry;
-				pic_queue.free_entry=entry;
-				entry=prev_entry->next;
-				continue;
-			} else {
-				pic_queue.next_entry=entry->next;
-				entry->next=pic_queue.free_entry;
-				pic_queue.free_entry=entry;
-				entry=pic_queue.next_entry;
-				continue;
-			}
-		}
-		prev_entry=entry;
-		entry=entry->next;
+		PICEntry * next_entry=entry->next;
+		RemoveEntry(entry);
+		FreeEntry(entry);
+		entry=next_entry;
 	}
 }
 
@@ -479,22 +596,31 @@ bool PIC_RunQueue(void) {
 	/* Check the queue for an entry */
 	Bits index_nd=PIC_TickIndexND();
 	InEventService = true;
-	while (pic_queue.next_entry && (pic_queue.next_entry->index*CPU_CycleMax<=index_nd)) {
-		PICEntry * entry=pic_queue.next_entry;
-		pic_queue.next_entry=entry->next;
+	while (pic_queue.used && (pic_queue.heap[0]->index*CPU_CycleMax<=index_nd)) {
+		PICEntry * entry=pic_queue.heap[0];
+		RemoveEntry(entry);
 
 		srv_lag = entry->index;
-		(entry->pic_event)(entry->value); // call the event handler
+		ServicedEntry = entry;
+		{
+#ifdef __LIBRETRO__
+			profiler::Scope profile_scope(profiler::Section::Events);
+#endif
+			(entry->pic_event)(entry->value); // call the event handler
+		}
+#ifdef __LIBRETRO__
+		profiler::count(profiler::Counter::EventsDispatched);
+#endif
+		ServicedEntry = 0;
 
 		/* Put the entry in the free list */
-		entry->next=pic_queue.free_entry;
-		pic_queue.free_entry=entry;
+		FreeEntry(entry);
 	}
 	InEventService = false;
 
 	/* Check when to set the new cycle end */
-	if (pic_queue.next_entry) {
-		Bits cycles=(Bits)(pic_queue.next_entry->index*CPU_CycleMax-index_nd);
+	if (pic_queue.used) {
+		Bits cycles=(Bits)(pic_queue.heap[0]->index*CPU_CycleMax-index_nd);
 		if (GCC_UNLIKELY(!cycles)) cycles=1;
 		if (cycles<CPU_CycleLeft) {
 			CPU_Cycles=cycles;
@@ -504,6 +630,9 @@ bool PIC_RunQueue(void) {
 	} else CPU_Cycles=CPU_CycleLeft;
 	CPU_CycleLeft-=CPU_Cycles;
 	if (PIC_IRQCheck) PIC_runIRQs();
+#ifdef __LIBRETRO__
+	profiler::count(profiler::Counter::CpuSlices);
+#endif
 	return true;
 }
 
@@ -542,12 +671,12 @@ void TIMER_AddTick(void) {
 	CPU_CycleLeft=CPU_CycleMax;
 	CPU_Cycles=0;
 	PIC_Ticks++;
-	/* Go through the list of scheduled events and lower their index with 1000 */
-	PICEntry * entry=pic_queue.next_entry;
-	while (entry) {
-		entry->index -= 1.0;
-		entry=entry->next;
-	}
+#ifdef __LIBRETRO__
+	profiler::count(profiler::Counter::EmulatedMs);
+#endif
+	/* Go through the list of scheduled events and lower their index with 1000,
+	 * that keeps them in the same order */
+	for (Bitu i=0;i<pic_queue.used;i++) pic_queue.heap[i]->index -= 1.0;
 	/* Call our list of ticker handlers */
 	TickerBlock * ticker=firstticker;
 	while (ticker) {
@@ -557,6 +686,87 @@ void TIMER_AddTick(void) {
 	}
 }
 
+/* Empty the queue, all entries but the one of a running handler are free */
+static void PIC_ResetQueue(void) {
+	if (pic_queue.blocks.empty()) GrowQueue();
+	pic_queue.free_entry=0;
+	for (Bits b=(Bits)pic_queue.blocks.size()-1;b>=0;b--) {
+		PICEntry * block=pic_queue.blocks[b];
+		for (Bits i=PIC_QUEUEGROW-1;i>=0;i--) {
+			if (&block[i]==ServicedEntry) continue;
+			FreeEntry(&block[i]);
+		}
+	}
+	pic_queue.used=0;
+	pic_queue.order=0;
+	for (Bitu i=0;i<pic_handlers.size;i++) pic_handlers.slots[i].first=0;
+}
+
+/* Give back the memory of the queue, unless an event is being run from it */
+static void PIC_FreeQueue(void) {
+	if (ServicedEntry) return;
+	for (Bitu b=0;b<pic_queue.blocks.size();b++) free(pic_queue.blocks[b]);
+	pic_queue.blocks.clear();
+	free(pic_queue.heap);
+	pic_queue.heap=0;
+	pic_queue.free_entry=0;
+	pic_queue.size=0;
+	pic_queue.used=0;
+	free(pic_handlers.slots);
+	pic_handlers.slots=0;
+	pic_handlers.size=0;
+	pic_handlers.used=0;
+}
+
+static void PIC_SaveState(SnapshotWriter& writer) {
+	writer.WriteStruct(pics,sizeof(pics));
+	writer.Write((Bit32u)PIC_IRQCheck);
+	writer.Write((Bit64u)PIC_Ticks);
+	writer.Write(srv_lag);
+	/* The events are stored in the order they run in */
+	std::vector<PICEntry *> sorted(pic_queue.heap,pic_queue.heap+pic_queue.used);
+	std::sort(sorted.begin(),sorted.end(),EntryBefore);
+	writer.Write((Bit32u)pic_queue.used);
+	for (Bitu i=0;i<pic_queue.used;i++) {
+		const PICEntry * entry=sorted[i];
+		writer.Write(entry->index);
+		writer.Write((Bit64u)entry->value);
+		writer.WriteFunc(entry->pic_event);
+	}
+}
+
+static bool PIC_LoadState(SnapshotReader& reader,Bit16u /*version*/) {
+	PIC_Controller newpics[2];
+	Bit32u irqcheck;
+	Bit64u ticks;
+	float lag;
+	Bit32u count;
+	if (!reader.ReadStruct(newpics,sizeof(newpics)) || !reader.Read(irqcheck) ||
+	    !reader.Read(ticks) || !reader.Read(lag) || !reader.Read(count)) return false;
+	if (count>reader.Remaining()) return false;
+	memcpy(pics,newpics,sizeof(pics));
+	PIC_IRQCheck=irqcheck;
+	PIC_Ticks=(Bitu)ticks;
+	srv_lag=lag;
+	/* Rebuild the queue in the stored order, so events with the same index
+	 * keep running in the same order. The entries go straight into the heap,
+	 * the slice and the profiler counters are left as they are.
+	 * A load can happen while an event handler is suspended, its entry is
+	 * put back on the free list by PIC_RunQueue and must not be handed out. */
+	PIC_ResetQueue();
+	for (Bitu i=0;i<count;i++) {
+		if (!pic_queue.free_entry && !GrowQueue()) return false;
+		PICEntry * entry=pic_queue.free_entry;
+		Bit64u value;
+		if (!reader.Read(entry->index) || !reader.Read(value) || !reader.ReadFunc(entry->pic_event)) return false;
+		entry->value=(Bitu)value;
+		pic_queue.free_entry=entry->next;
+		LinkEntry(entry);
+		HeapUp(entry);
+	}
+	return true;
+}
+
 /* Use full name to avoid name clash with compile option for position-independent code */
 class PIC_8259A: public Module_base {
 private:
@@ -601,15 +811,13 @@ public:
 		WriteHandler[2].Install(0xa0,write_command,IO_MB);
 		WriteHandler[3].Install(0xa1,write_data,IO_MB);
 		/* Initialize the pic queue */
-		for (i=0;i<PIC_QUEUESIZE-1;i++) {
-			pic_queue.entries[i].next=&pic_queue.entries[i+1];
-		}
-		pic_queue.entries[PIC_QUEUESIZE-1].next=0;
-		pic_queue.free_entry=&pic_queue.entries[0];
-		pic_queue.next_entry=0;
+		PIC_ResetQueue();
+		SNAPSHOT_Register("PIC",2,PIC_SaveState,PIC_LoadState);
 	}
 
 	~PIC_8259A(){
+		SNAPSHOT_Unregister("PIC");
+		PIC_FreeQueue();
 	}
 };
 
@@ -30,6 +30,7 @@
 #include "setup.h"
 #include "support.h"
 #include "shell.h"
+#include "snapshot.h"
 using namespace std;
 
 void MIDI_RawOutByte(Bit8u data);
@@ -1600,6 +1601,24 @@ static void SBLASTER_CallBack(Bitu len) {
 	}
 }
 
+static void SBLASTER_SaveState(SnapshotWriter& writer) {
+	writer.WriteStruct(&sb,sizeof(sb));
+	writer.Write((Bit8u)(sb.dma.chan ? sb.dma.chan->channum : 0xff));
+	writer.WriteStruct(ASP_regs,sizeof(ASP_regs));
+	writer.Write(ASP_init_in_progress);
+	writer.Write(last_dma_callback);
+}
+
+static bool SBLASTER_LoadState(SnapshotReader& reader,Bit16u /*version*/) {
+	MixerChannel * chan=sb.chan;
+	Bit8u dmanum;
+	if (!reader.ReadStruct(&sb,sizeof(sb)) || !reader.Read(dmanum)) return false;
+	sb.chan=chan;
+	sb.dma.chan=(dmanum==0xff) ? NULL : GetDMAChannel(dmanum);
+	return reader.ReadStruct(ASP_regs,sizeof(ASP_regs)) && reader.Read(ASP_init_in_progress) &&
+		reader.Read(last_dma_callback);
+}
+
 class SBLASTER: public Module_base {
 private:
 	/* Data */
@@ -1732,9 +1751,11 @@ public:
 		/* Soundblaster midi interface */
 		if (!MIDI_Available()) sb.midi = false;
 		else sb.midi = true;
+		SNAPSHOT_Register("SBLASTER",1,SBLASTER_SaveState,SBLASTER_LoadState);
 	}
 
 	~SBLASTER() {
+		SNAPSHOT_Unregister("SBLASTER");
 		switch (oplmode) {
 		case OPL_none:
 			break;
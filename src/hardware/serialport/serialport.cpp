@@ -27,6 +27,7 @@
 #include "setup.h"
 #include "bios.h"					// SetComPorts(..)
 #include "callback.h"				// CALLBACK_Idle
+#include "snapshot.h"
 
 #include "serialport.h"
 #include "directserial.h"
@@ -1219,6 +1220,91 @@ bool CSerial::Putchar(Bit8u data, bool wait_dsr, bool wait_cts, Bitu timeout) {
 	return true;
 }
 
+void MyFifo::SaveState(SnapshotWriter& writer) {
+	writer.Write(size);
+	writer.Write(pos);
+	writer.Write(used);
+	writer.WriteBlock(data,maxsize);
+}
+
+bool MyFifo::LoadState(SnapshotReader& reader) {
+	Bitu newsize,newpos,newused;
+	if (!reader.Read(newsize) || !reader.Read(newpos) || !reader.Read(newused)) return false;
+	if (newsize>maxsize || newpos>=maxsize || newused>newsize) return false;
+	if (!reader.ReadBlock(data,maxsize)) return false;
+	size=newsize;
+	pos=newpos;
+	used=newused;
+	return true;
+}
+
+void CSerial::SaveState(SnapshotWriter& writer) {
+	writer.Write(bytetime);
+	writer.Write(waiting_interrupts);
+	writer.Write(baud_divider);
+	writer.Write(IER);
+	writer.Write(irq_active);
+	writer.Write(ISR);
+	writer.Write(LCR);
+	writer.Write(dtr);
+	writer.Write(rts);
+	writer.Write(op1);
+	writer.Write(op2);
+	writer.Write(loopback);
+	writer.Write(LSR);
+	writer.Write(d_cts);
+	writer.Write(d_dsr);
+	writer.Write(d_ri);
+	writer.Write(d_cd);
+	writer.Write(cts);
+	writer.Write(dsr);
+	writer.Write(ri);
+	writer.Write(cd);
+	writer.Write(SPR);
+	writer.Write(loopback_data);
+	writer.Write(errors_in_fifo);
+	writer.Write(rx_interrupt_threshold);
+	writer.Write(fifosize);
+	writer.Write(FCR);
+	writer.Write(sync_guardtime);
+	rxfifo->SaveState(writer);
+	txfifo->SaveState(writer);
+	errorfifo->SaveState(writer);
+}
+
+bool CSerial::LoadState(SnapshotReader& reader) {
+	return reader.Read(bytetime) && reader.Read(waiting_interrupts) &&
+		reader.Read(baud_divider) && reader.Read(IER) && reader.Read(irq_active) &&
+		reader.Read(ISR) && reader.Read(LCR) && reader.Read(dtr) && reader.Read(rts) &&
+		reader.Read(op1) && reader.Read(op2) && reader.Read(loopback) && reader.Read(LSR) &&
+		reader.Read(d_cts) && reader.Read(d_dsr) && reader.Read(d_ri) && reader.Read(d_cd) &&
+		reader.Read(cts) && reader.Read(dsr) && reader.Read(ri) && reader.Read(cd) &&
+		reader.Read(SPR) && reader.Read(loopback_data) && reader.Read(errors_in_fifo) &&
+		reader.Read(rx_interrupt_threshold) && reader.Read(fifosize) && reader.Read(FCR) &&
+		reader.Read(sync_guardtime) && rxfifo->LoadState(reader) &&
+		txfifo->LoadState(reader) && errorfifo->LoadState(reader);
+}
+
+static void SERIAL_SaveState(SnapshotWriter& writer) {
+	for (Bitu i = 0; i < 4; i++) {
+		writer.Write((Bit8u)(serialports[i] ? 1 : 0));
+		if (serialports[i]) serialports[i]->SaveState(writer);
+	}
+}
+
+static bool SERIAL_LoadState(SnapshotReader& reader,Bit16u /*version*/) {
+	for (Bitu i = 0; i < 4; i++) {
+		Bit8u present;
+		if (!reader.Read(present)) return false;
+		if ((present!=0) != (serialports[i]!=NULL)) {
+			LOG_MSG("SNAPSHOT: COM%d is configured differently",(int)(i+1));
+			return false;
+		}
+		if (serialports[i] && !serialports[i]->LoadState(reader)) return false;
+	}
+	return true;
+}
+
 class SERIALPORTS:public Module_base {
 public:
 	SERIALPORTS (Section * configuration):Module_base (configuration) {
@@ -1272,9 +1358,11 @@ public:
 			if(serialports[i]) biosParameter[i] = serial_baseaddr[i];
 		} // for 1-4
 		BIOS_SetComPorts (biosParameter);
+		SNAPSHOT_Register("SERIAL",1,SERIAL_SaveState,SERIAL_LoadState);
 	}
 
 	~SERIALPORTS () {
+		SNAPSHOT_Unregister("SERIAL");
 		for (Bitu i = 0; i < 4; i++)
 			if (serialports[i]) {
 				delete serialports[i];
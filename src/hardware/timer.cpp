@@ -25,6 +25,7 @@
 #include "mixer.h"
 #include "timer.h"
 #include "setup.h"
+#include "snapshot.h"
 
 static INLINE void BIN2BCD(Bit16u& val) {
 	Bit16u temp=val%10 + (((val/10)%10)<<4)+ (((val/100)%10)<<8) + (((val/1000)%10)<<12);
@@ -406,6 +407,18 @@ bool TIMER_GetOutput2(void) {
 	return counter_output(2);
 }
 
+static void TIMER_SaveState(SnapshotWriter& writer) {
+	writer.WriteStruct(pit,sizeof(pit));
+	writer.Write(gate2);
+	writer.Write(latched_timerstatus);
+	writer.Write(latched_timerstatus_locked);
+}
+
+static bool TIMER_LoadState(SnapshotReader& reader,Bit16u /*version*/) {
+	return reader.ReadStruct(pit,sizeof(pit)) && reader.Read(gate2) &&
+		reader.Read(latched_timerstatus) && reader.Read(latched_timerstatus_locked);
+}
+
 class TIMER:public Module_base{
 private:
 	IO_ReadHandleObject ReadHandler[4];
@@ -457,8 +470,10 @@ public:
 		latched_timerstatus_locked=false;
 		gate2 = false;
 		PIC_AddEvent(PIT0_Event,pit[0].delay);
+		SNAPSHOT_Register("PIT",1,TIMER_SaveState,TIMER_LoadState);
 	}
 	~TIMER(){
+		SNAPSHOT_Unregister("PIT");
 		PIC_RemoveEvents(PIT0_Event);
 	}
 };
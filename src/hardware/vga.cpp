@@ -22,6 +22,8 @@
 #include "video.h"
 #include "pic.h"
 #include "vga.h"
+#include "mem.h"
+#include "snapshot.h"
 
 #include <string.h>
 
@@ -172,6 +174,155 @@ void VGA_SetCGA4Table(Bit8u val0,Bit8u val1,Bit8u val2,Bit8u val3) {
 	}	
 }
 
+/* Pointers into video memory are stored as a region and an offset */
+enum {
+	VGA_PTR_NULL,VGA_PTR_LINEAR,VGA_PTR_FASTMEM,VGA_PTR_MEMBASE,VGA_PTR_FONT
+};
+
+static void VGA_SavePointer(SnapshotWriter& writer,const Bit8u* ptr) {
+	const Bit8u* membase = GetMemBase();
+	Bit8u region = VGA_PTR_NULL;
+	Bitu offset = 0;
+	if (!ptr) {
+	} else if (ptr >= vga.mem.linear && ptr < vga.mem.linear + vga.vmemsize + 2048) {
+		region = VGA_PTR_LINEAR; offset = ptr - vga.mem.linear;
+	} else if (ptr >= vga.fastmem && ptr < vga.fastmem + (vga.vmemsize << 1) + 4096) {
+		region = VGA_PTR_FASTMEM; offset = ptr - vga.fastmem;
+	} else if (ptr >= vga.draw.font && ptr < vga.draw.font + sizeof(vga.draw.font)) {
+		region = VGA_PTR_FONT; offset = ptr - vga.draw.font;
+	} else if (ptr >= membase && ptr < membase + MEM_TotalPages() * 4096) {
+		region = VGA_PTR_MEMBASE; offset = ptr - membase;
+	} else {
+		LOG(LOG_VGA,LOG_ERROR)("Snapshot: pointer outside of any memory region");
+	}
+	writer.Write(region);
+	writer.Write((Bit32u)offset);
+}
+
+static bool VGA_LoadPointer(SnapshotReader& reader,Bit8u*& ptr) {
+	Bit8u region;
+	Bit32u offset;
+	if (!reader.Read(region) || !reader.Read(offset)) return false;
+	switch (region) {
+	case VGA_PTR_NULL: ptr = 0; break;
+	case VGA_PTR_LINEAR: ptr = vga.mem.linear + offset; break;
+	case VGA_PTR_FASTMEM: ptr = vga.fastmem + offset; break;
+	case VGA_PTR_MEMBASE: ptr = GetMemBase() + offset; break;
+	case VGA_PTR_FONT: ptr = vga.draw.font + offset; break;
+	default: return false;
+	}
+	return true;
+}
+
+/* Copy of video memory that snapshot deltas are taken against. Writes to video
+ * memory take too many paths to track, so a delta stores the pages that differ. */
+static struct {
+	std::vector<Bit8u> mem;
+	Bit32u id;
+} vga_base;
+
+static void VGA_SaveVideoMemory(SnapshotWriter& writer,const Bit8u* mem,Bitu size,const Bit8u* base) {
+	if (writer.Type()!=SNAPSHOT_DELTA) {
+		writer.WriteBlock(mem,size);
+		return;
+	}
+	std::vector<Bit32u> changed;
+	for (Bitu start=0;start<size;start+=MEM_PAGESIZE) {
+		Bitu len=MEM_PAGESIZE < size-start ? MEM_PAGESIZE : size-start;
+		if (memcmp(mem+start,base+start,len)) changed.push_back((Bit32u)start);
+	}
+	writer.Write((Bit32u)changed.size());
+	for (size_t i=0;i<changed.size();i++) {
+		Bitu start=changed[i];
+		Bitu len=MEM_PAGESIZE < size-start ? MEM_PAGESIZE : size-start;
+		writer.Write(changed[i]);
+		writer.WriteBlock(mem+start,len);
+	}
+}
+
+/* The pages in a delta are read, the other ones are put back to the base */
+static bool VGA_LoadVideoMemory(SnapshotReader& reader,Bit8u* mem,Bitu size,const Bit8u* base) {
+	if (reader.Type()!=SNAPSHOT_DELTA) return reader.ReadBlock(mem,size);
+	Bit32u count;
+	if (!reader.Read(count)) return false;
+	Bitu next=0;
+	for (Bit32u i=0;i<=count;i++) {
+		Bit32u start=(Bit32u)size;
+		if (i<count && (!reader.Read(start) || start<next || start>=size || (start & (MEM_PAGESIZE-1)))) return false;
+		for (;next<start;next+=MEM_PAGESIZE) {
+			Bitu len=MEM_PAGESIZE < size-next ? MEM_PAGESIZE : size-next;
+			if (memcmp(mem+next,base+next,len)) memcpy(mem+next,base+next,len);
+		}
+		if (i==count) break;
+		Bitu len=MEM_PAGESIZE < size-start ? MEM_PAGESIZE : size-start;
+		if (!reader.ReadBlock(mem+start,len)) return false;
+		next=start+len;
+	}
+	return true;
+}
+
+static void VGA_SaveState(SnapshotWriter& writer) {
+	if (writer.Type()==SNAPSHOT_DELTA && vga_base.id!=writer.Base()) {
+		vga_base.mem.assign(vga.mem.linear,vga.mem.linear+vga.vmemsize);
+		vga_base.mem.insert(vga_base.mem.end(),vga.fastmem,vga.fastmem+(vga.vmemsize << 1));
+		vga_base.id=writer.Base();
+	}
+	writer.Write(vga.vmemsize);
+	writer.WriteStruct(&vga,sizeof(vga));
+	VGA_SavePointer(writer,vga.draw.linear_base);
+	VGA_SavePointer(writer,vga.draw.font_tables[0]);
+	VGA_SavePointer(writer,vga.draw.font_tables[1]);
+	VGA_SavePointer(writer,vga.tandy.draw_base);
+	VGA_SavePointer(writer,vga.tandy.mem_base);
+	VGA_SaveVideoMemory(writer,vga.mem.linear,vga.vmemsize,vga_base.mem.data());
+	VGA_SaveVideoMemory(writer,vga.fastmem,vga.vmemsize << 1,vga_base.mem.data()+vga.vmemsize);
+	writer.WriteStruct(CGA_2_Table,sizeof(CGA_2_Table));
+	writer.WriteStruct(CGA_4_Table,sizeof(CGA_4_Table));
+	writer.WriteStruct(CGA_4_HiRes_Table,sizeof(CGA_4_HiRes_Table));
+	writer.WriteStruct(CGA_16_Table,sizeof(CGA_16_Table));
+}
+
+static bool VGA_LoadState(SnapshotReader& reader,Bit16u /*version*/) {
+	Bit32u vmemsize;
+	if (!reader.Read(vmemsize) || vmemsize != vga.vmemsize) return false;
+	if (reader.Type()==SNAPSHOT_DELTA && reader.Base()!=vga_base.id) return false;
+	/* Keep the allocations of the running machine */
+	Bit8u* linear = vga.mem.linear;
+	Bit8u* linear_orgptr = vga.mem.linear_orgptr;
+	Bit8u* fastmem = vga.fastmem;
+	Bit8u* fastmem_orgptr = vga.fastmem_orgptr;
+#ifdef VGA_KEEP_CHANGES
+	Bit8u* changes_map = vga.changes.map;
+#endif
+	PageHandler* lfb_handler = vga.lfb.handler;
+	if (!reader.ReadStruct(&vga,sizeof(vga))) return false;
+	vga.mem.linear = linear;
+	vga.mem.linear_orgptr = linear_orgptr;
+	vga.fastmem = fastmem;
+	vga.fastmem_orgptr = fastmem_orgptr;
+#ifdef VGA_KEEP_CHANGES
+	vga.changes.map = changes_map;
+#endif
+	vga.lfb.handler = lfb_handler;
+	if (!VGA_LoadPointer(reader,vga.draw.linear_base) ||
+	    !VGA_LoadPointer(reader,vga.draw.font_tables[0]) ||
+	    !VGA_LoadPointer(reader,vga.draw.font_tables[1]) ||
+	    !VGA_LoadPointer(reader,vga.tandy.draw_base) ||
+	    !VGA_LoadPointer(reader,vga.tandy.mem_base)) return false;
+	if (!VGA_LoadVideoMemory(reader,vga.mem.linear,vga.vmemsize,vga_base.mem.data()) ||
+	    !VGA_LoadVideoMemory(reader,vga.fastmem,vga.vmemsize << 1,vga_base.mem.data()+vga.vmemsize) ||
+	    !reader.ReadStruct(CGA_2_Table,sizeof(CGA_2_Table)) ||
+	    !reader.ReadStruct(CGA_4_Table,sizeof(CGA_4_Table)) ||
+	    !reader.ReadStruct(CGA_4_HiRes_Table,sizeof(CGA_4_HiRes_Table)) ||
+	    !reader.ReadStruct(CGA_16_Table,sizeof(CGA_16_Table))) return false;
+
+	VGA_SetupHandlers();
+	if (svgaCard==SVGA_S3Trio) VGA_StartUpdateLFB();
+	VGA_DACSetEntirePalette();
+	VGA_RestartDrawing();
+	return true;
+}
+
 void VGA_Init(Section* sec) {
 //	Section_prop * section=static_cast<Section_prop *>(sec);
 	vga.draw.resizing=false;
@@ -190,6 +341,7 @@ void VGA_Init(Section* sec) {
 /* Generate tables */
 	VGA_SetCGA2Table(0,1);
 	VGA_SetCGA4Table(0,1,2,3);
+	SNAPSHOT_Register("VGA",1,VGA_SaveState,VGA_LoadState);
 	Bitu i,j;
 	for (i=0;i<256;i++) {
 		ExpandTable[i]=i | (i << 8)| (i <<16) | (i << 24);
@@ -173,6 +173,10 @@ static Bitu read_p3c9(Bitu /*port*/,Bitu /*iolen*/) {
 	return ret;
 }
 
+void VGA_DACSetEntirePalette(void) {
+	for (Bitu i=0;i<256;i++) VGA_DAC_UpdateColor(i);
+}
+
 void VGA_DAC_CombineColor(Bit8u attr,Bit8u pal) {
 	/* Check if this is a new color */
 	vga.dac.combine[attr]=pal;
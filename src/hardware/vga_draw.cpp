@@ -29,6 +29,7 @@
 #ifdef __LIBRETRO__
 #include "CoreOptions.h"
 #include "libretro_core_options.h"
+#include "libretro_profiler.h"
 #include "pinhack.h"
 #endif
 
@@ -717,9 +718,19 @@ static void VGA_DrawEGASingleLine(Bitu /*blah*/) {
 }
 
 static void VGA_DrawPart(Bitu lines) {
+#ifdef __LIBRETRO__
+	profiler::Scope profile_scope(profiler::Section::Video);
+#endif
 	while (lines--) {
 		Bit8u * data=VGA_DrawLine( vga.draw.address, vga.draw.address_line );
+#ifdef __LIBRETRO__
+		{
+			profiler::Scope line_scope(profiler::Section::RenderLine);
+			RENDER_DrawLine(data);
+		}
+#else
 		RENDER_DrawLine(data);
+#endif
 		vga.draw.address_line++;
 		if (vga.draw.address_line>=vga.draw.address_line_total) {
 			vga.draw.address_line=0;
@@ -1655,6 +1666,26 @@ void VGA_KillDrawing(void) {
 	if (!vga.draw.vga_override) RENDER_EndUpdate(true);
 }
 
+/* Drop the frame in progress without touching the output and rebuild all
+   timing from the current registers, used after the whole state was replaced */
+void VGA_RestartDrawing(void) {
+	PIC_RemoveEvents(VGA_DrawPart);
+	PIC_RemoveEvents(VGA_DrawSingleLine);
+	PIC_RemoveEvents(VGA_DrawEGASingleLine);
+	PIC_RemoveEvents(VGA_Other_VertInterrupt);
+	PIC_RemoveEvents(VGA_VerticalTimer);
+	PIC_RemoveEvents(VGA_PanningLatch);
+	PIC_RemoveEvents(VGA_DisplayStartLatch);
+	PIC_RemoveEvents(VGA_SetupDrawing);
+	vga.draw.parts_left = 0;
+	vga.draw.lines_done = ~0;
+	/* Force both a new vertical timer and a new output size */
+	vga.draw.delay.vtotal = 0;
+	vga.draw.width = 0;
+	vga.draw.resizing = false;
+	PIC_AddEvent(VGA_SetupDrawing,0.0f);
+}
+
 void VGA_SetOverride(bool vga_override) {
 	if (vga.draw.vga_override!=vga_override) {
 		
@@ -26,9 +26,24 @@
 #include "dos_inc.h" /* for Drives[] */
 #include "../dos/drives.h"
 #include "mapper.h"
+#include "cross.h"
+#include <string>
+#include <sys/types.h>
+#include <sys/stat.h>
 
+#if defined (WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
 
 
+
+/* Changes are tracked in 512 byte blocks regardless of the disk geometry */
+#define DELTA_BLOCK_SIZE 512
+#define DELTA_HEADER_SIZE 512
+#define DELTA_VERSION 1
+
 diskGeo DiskGeometryList[] = {
 	{ 160,  8, 1, 40, 0},	// SS/DD 5.25"
 	{ 180,  9, 1, 40, 0},	// SS/DD 5.25"
@@ -159,18 +174,82 @@ Bit8u imageDisk::Read_Sector(Bit32u head,Bit32u cylinder,Bit32u sector,void * da
 }
 
 Bit8u imageDisk::Read_AbsoluteSector(Bit32u sectnum, void * data) {
-	Bit32u bytenum;
-
-	bytenum = sectnum * sector_size;
+	return Read_AbsoluteSectors(sectnum, 1, data);
+}
 
+Bit8u imageDisk::ReadImage(Bit32u bytenum, size_t len, Bit8u *data) {
+#if defined (WIN32)
 	if (last_action==WRITE || bytenum!=current_fpos) fseek(diskimg,bytenum,SEEK_SET);
-	size_t ret=fread(data, 1, sector_size, diskimg);
-	current_fpos=bytenum+ret;
+	size_t ret=fread(data, 1, len, diskimg);
+	current_fpos=bytenum+(Bit32u)ret;
 	last_action=READ;
+#else
+	/* A single call straight from the page cache, no seek and no stdio buffer */
+	if (pread(fileno(diskimg), data, len, (off_t)bytenum) < 0) return 0x04;
+#endif
 
 	return 0x00;
 }
 
+Bit8u imageDisk::ReadBlocks(Bit32u block, Bit32u blocks, Bit8u *dst) {
+	/* Split the transfer into runs of changed and unchanged blocks */
+	while (blocks) {
+		bool changed = InDelta(block);
+		Bit32u run = 1;
+		while (run < blocks && InDelta(block + run) == changed) run++;
+		size_t runlen = (size_t)run * DELTA_BLOCK_SIZE;
+		if (changed && delta) {
+			fseek(delta, delta_data + block * DELTA_BLOCK_SIZE, SEEK_SET);
+			if (fread(dst, 1, runlen, delta) != runlen) return 0x04;
+		} else if (changed) {
+			for (Bit32u i = 0; i < run; i++)
+				memcpy(dst + i * DELTA_BLOCK_SIZE, &overlay[block + i][0], DELTA_BLOCK_SIZE);
+		} else {
+			ReadImage(block * DELTA_BLOCK_SIZE, runlen, dst);
+		}
+		dst += runlen;
+		block += run;
+		blocks -= run;
+	}
+	return 0x00;
+}
+
+Bit8u imageDisk::Read_AbsoluteSectors(Bit32u sectnum, Bit32u count, void * data) {
+	Bit32u bytenum;
+
+	bytenum = sectnum * sector_size;
+
+	size_t len = (size_t)count * sector_size;
+	Bit8u *dst = (Bit8u *)data;
+	if (!delta_blocks) return ReadImage(bytenum, len, dst);
+
+	/* Whole blocks are read in place, partial ones through a bounce buffer */
+	Bit32u block = bytenum / DELTA_BLOCK_SIZE;
+	Bit32u offset = bytenum % DELTA_BLOCK_SIZE;
+	while (len) {
+		Bit8u ret;
+		size_t part;
+		if (offset || len < DELTA_BLOCK_SIZE) {
+			Bit8u buf[DELTA_BLOCK_SIZE];
+			memset(buf, 0, DELTA_BLOCK_SIZE);
+			part = DELTA_BLOCK_SIZE - offset;
+			if (part > len) part = len;
+			if ((ret = ReadBlocks(block, 1, buf)) != 0x00) return ret;
+			memcpy(dst, buf + offset, part);
+			block++;
+			offset = 0;
+		} else {
+			Bit32u blocks = (Bit32u)(len / DELTA_BLOCK_SIZE);
+			part = (size_t)blocks * DELTA_BLOCK_SIZE;
+			if ((ret = ReadBlocks(block, blocks, dst)) != 0x00) return ret;
+			block += blocks;
+		}
+		dst += part;
+		len -= part;
+	}
+	return 0x00;
+}
+
 Bit8u imageDisk::Write_Sector(Bit32u head,Bit32u cylinder,Bit32u sector,void * data) {
 	Bit32u sectnum;
 
@@ -181,19 +260,205 @@ Bit8u imageDisk::Write_Sector(Bit32u head,Bit32u cylinder,Bit32u sector,void * d
 
 
 Bit8u imageDisk::Write_AbsoluteSector(Bit32u sectnum, void *data) {
+	return Write_AbsoluteSectors(sectnum, 1, data);
+}
+
+Bit8u imageDisk::WriteImage(Bit32u bytenum, size_t len, const Bit8u *data) {
+#if defined (WIN32)
+	if (last_action==READ || bytenum!=current_fpos) fseek(diskimg,bytenum,SEEK_SET);
+	size_t ret=fwrite(data, 1, len, diskimg);
+	current_fpos=bytenum+(Bit32u)ret;
+	last_action=WRITE;
+
+	return ((ret>0)?0x00:0x05);
+#else
+	return ((pwrite(fileno(diskimg), data, len, (off_t)bytenum)>0)?0x00:0x05);
+#endif
+}
+
+Bit8u imageDisk::WriteBlocks(Bit32u block, Bit32u blocks, const Bit8u *data) {
+	if (block >= delta_blocks || blocks > delta_blocks - block) return 0x05;
+	if (!delta && !delta_path.empty() && !CreateDelta()) {
+		LOG_MSG("ImageLoader: Keeping the changes to %s in memory", diskname);
+		delta_path.clear();
+	}
+	if (!delta) {
+		for (Bit32u i = block; i < block + blocks; i++) {
+			overlay[i].assign(data, data + DELTA_BLOCK_SIZE);
+			delta_map[i >> 3] |= 1 << (i & 7);
+			data += DELTA_BLOCK_SIZE;
+		}
+		return 0x00;
+	}
+
+	size_t len = (size_t)blocks * DELTA_BLOCK_SIZE;
+	fseek(delta, delta_data + block * DELTA_BLOCK_SIZE, SEEK_SET);
+	if (fwrite(data, 1, len, delta) != len) return 0x05;
+	Bit32u first = block >> 3, last = (block + blocks - 1) >> 3;
+	bool marked = true;
+	for (Bit32u i = block; i < block + blocks; i++) {
+		if (!InDelta(i)) {
+			delta_map[i >> 3] |= 1 << (i & 7);
+			marked = false;
+		}
+	}
+	if (!marked) {
+		/* The data has to be on disk before a block is marked changed */
+		if (fflush(delta)) return 0x05;
+#if defined (WIN32)
+		_commit(_fileno(delta));
+#else
+		fsync(fileno(delta));
+#endif
+		fseek(delta, DELTA_HEADER_SIZE + first, SEEK_SET);
+		if (fwrite(&delta_map[first], 1, last - first + 1, delta) != last - first + 1) return 0x05;
+	}
+	return 0x00;
+}
+
+Bit8u imageDisk::Write_AbsoluteSectors(Bit32u sectnum, Bit32u count, void *data) {
 	Bit32u bytenum;
 
 	bytenum = sectnum * sector_size;
 
 	//LOG_MSG("Writing sectors to %ld at bytenum %d", sectnum, bytenum);
 
-	if (last_action==READ || bytenum!=current_fpos) fseek(diskimg,bytenum,SEEK_SET);
-	size_t ret=fwrite(data, 1, sector_size, diskimg);
-	current_fpos=bytenum+ret;
-	last_action=WRITE;
+	size_t len = (size_t)count * sector_size;
+	if (cacheOwner) cacheOwner->SectorsWritten(sectnum, count);
+	if (!delta_blocks) return WriteImage(bytenum, len, (const Bit8u *)data);
+
+	/* Partial blocks are read, merged and written back whole */
+	const Bit8u *src = (const Bit8u *)data;
+	Bit32u block = bytenum / DELTA_BLOCK_SIZE;
+	Bit32u offset = bytenum % DELTA_BLOCK_SIZE;
+	while (len) {
+		Bit8u ret;
+		size_t part;
+		if (offset || len < DELTA_BLOCK_SIZE) {
+			Bit8u buf[DELTA_BLOCK_SIZE];
+			memset(buf, 0, DELTA_BLOCK_SIZE);
+			part = DELTA_BLOCK_SIZE - offset;
+			if (part > len) part = len;
+			if (block >= delta_blocks) return 0x05;
+			if (ReadBlocks(block, 1, buf) != 0x00) return 0x05;
+			memcpy(buf + offset, src, part);
+			if ((ret = WriteBlocks(block, 1, buf)) != 0x00) return ret;
+			block++;
+			offset = 0;
+		} else {
+			Bit32u blocks = (Bit32u)(len / DELTA_BLOCK_SIZE);
+			part = (size_t)blocks * DELTA_BLOCK_SIZE;
+			if ((ret = WriteBlocks(block, blocks, src)) != 0x00) return ret;
+			block += blocks;
+		}
+		src += part;
+		len -= part;
+	}
+	return 0x00;
+}
 
-	return ((ret>0)?0x00:0x05);
+static std::string delta_directory;
+
+void DISK_SetDeltaDirectory(const char *dir) {
+	delta_directory = dir;
+}
+
+bool DISK_DeltaEnabled(void) {
+	return !delta_directory.empty();
+}
+
+/* Image name plus a hash of its full path, so that images of the same
+ * name in different directories don't share a delta */
+static std::string DeltaName(const char *diskname) {
+	char full[CROSS_LEN * 2];
+#if defined (WIN32)
+	if (!_fullpath(full, diskname, sizeof(full)))
+#else
+	if (!realpath(diskname, full))
+#endif
+		safe_strncpy(full, diskname, sizeof(full));
+	Bit32u hash = 2166136261u;
+	for (const char *c = full; *c; c++) hash = (hash ^ (Bit8u)*c) * 16777619u;
+
+	std::string name(full);
+	std::string::size_type split = name.find_last_of("/\\:");
+	if (split != std::string::npos) name.erase(0, split + 1);
+	char suffix[16];
+	sprintf(suffix, "-%08x.delta", hash);
+	return name + suffix;
+}
+
+bool imageDisk::AttachDelta(void) {
+	if (delta_blocks || delta_directory.empty()) return false;
+
+	/* Size and modification time identify the image the delta belongs to */
+	struct stat info;
+	if (fstat(fileno(diskimg), &info) || info.st_size <= 0) return false;
+	last_action = NONE;
+	current_fpos = 0xffffffff;
+	Bit64u imgsize = (Bit64u)info.st_size;
+	delta_stamp = (Bit64u)info.st_mtime;
+	Bit32u blocks = (Bit32u)((imgsize + DELTA_BLOCK_SIZE - 1) / DELTA_BLOCK_SIZE);
+	delta_map.assign((blocks + 7) / 8, 0);
+	Bit32u maplen = (Bit32u)delta_map.size();
+	delta_data = DELTA_HEADER_SIZE + (maplen + DELTA_BLOCK_SIZE - 1) / DELTA_BLOCK_SIZE * DELTA_BLOCK_SIZE;
+	delta_path = delta_directory + CROSS_FILESPLIT + DeltaName(diskname);
+
+	/* The file is only created once something gets written */
+	FILE *file = fopen_wrap(delta_path.c_str(), "rb+");
+	if (file) {
+		Bit8u header[DELTA_HEADER_SIZE];
+		if (fread(header, 1, DELTA_HEADER_SIZE, file) != DELTA_HEADER_SIZE ||
+		    memcmp(header, "DBXDELTA", 8) || host_readd(&header[8]) != DELTA_VERSION ||
+		    host_readd(&header[12]) != DELTA_BLOCK_SIZE || host_readd(&header[16]) != blocks * DELTA_BLOCK_SIZE ||
+		    host_readd(&header[20]) != (Bit32u)delta_stamp || host_readd(&header[24]) != (Bit32u)(delta_stamp >> 32) ||
+		    fread(&delta_map[0], 1, maplen, file) != maplen) {
+			LOG_MSG("ImageLoader: %s does not belong to this image, keeping changes in memory only", delta_path.c_str());
+			fclose(file);
+			delta_path.clear();
+			delta_blocks = blocks;
+			delta_map.assign(maplen, 0);
+			return false;
+		}
+		delta = file;
+	}
+	delta_blocks = blocks;
+	LOG_MSG("ImageLoader: Changes to %s are kept in %s", diskname, delta_path.c_str());
+	return true;
+}
+
+void imageDisk::AttachOverlay(void) {
+	if (delta_blocks) return;
+	struct stat info;
+	if (fstat(fileno(diskimg), &info) || info.st_size <= 0) return;
+	delta_blocks = (Bit32u)(((Bit64u)info.st_size + DELTA_BLOCK_SIZE - 1) / DELTA_BLOCK_SIZE);
+	delta_map.assign((delta_blocks + 7) / 8, 0);
+}
 
+bool imageDisk::CreateDelta(void) {
+	/* Create the directory one level at a time */
+	std::string::size_type split;
+	for (split = 1; (split = delta_directory.find_first_of("/\\", split)) != std::string::npos; split++)
+		Cross::CreateDir(delta_directory.substr(0, split));
+	Cross::CreateDir(delta_directory);
+
+	Bit8u header[DELTA_HEADER_SIZE];
+	memset(header, 0, DELTA_HEADER_SIZE);
+	memcpy(header, "DBXDELTA", 8);
+	host_writed(&header[8], DELTA_VERSION);
+	host_writed(&header[12], DELTA_BLOCK_SIZE);
+	host_writed(&header[16], delta_blocks * DELTA_BLOCK_SIZE);
+	host_writed(&header[20], (Bit32u)delta_stamp);
+	host_writed(&header[24], (Bit32u)(delta_stamp >> 32));
+	FILE *file = fopen_wrap(delta_path.c_str(), "wb+");
+	if (!file || fwrite(header, 1, DELTA_HEADER_SIZE, file) != DELTA_HEADER_SIZE ||
+	    fwrite(&delta_map[0], 1, delta_map.size(), file) != delta_map.size()) {
+		LOG_MSG("ImageLoader: Can't create %s", delta_path.c_str());
+		if (file) fclose(file);
+		return false;
+	}
+	delta = file;
+	return true;
 }
 
 imageDisk::imageDisk(FILE *imgFile, const char *imgName, Bit32u imgSizeK, bool isHardDisk) {
@@ -205,6 +470,11 @@ imageDisk::imageDisk(FILE *imgFile, const char *imgName, Bit32u imgSizeK, bool i
 	last_action = NONE;
 	diskimg = imgFile;
 	fseek(diskimg,0,SEEK_SET);
+	delta = NULL;
+	delta_blocks = 0;
+	delta_data = 0;
+	delta_stamp = 0;
+	cacheOwner = NULL;
 	memset(diskname,0,512);
 	safe_strncpy(diskname, imgName, sizeof(diskname));
 	active = false;
@@ -235,6 +505,11 @@ imageDisk::imageDisk(FILE *imgFile, const char *imgName, Bit32u imgSizeK, bool i
 	}
 }
 
+imageDisk::~imageDisk() {
+	if (delta != NULL) fclose(delta);
+	if(diskimg != NULL) { fclose(diskimg); }
+}
+
 void imageDisk::Set_Geometry(Bit32u setHeads, Bit32u setCyl, Bit32u setSect, Bit32u setSectSize) {
 	heads = setHeads;
 	cylinders = setCyl;
@@ -32,6 +32,7 @@
 #include "support.h"
 #include "cpu.h"
 #include "dma.h"
+#include "snapshot.h"
 
 #define EMM_PAGEFRAME	0xE000
 #define EMM_PAGEFRAME4K	((EMM_PAGEFRAME*16)/4096)
@@ -1356,6 +1357,22 @@ Bitu GetEMSType(Section_prop * section) {
 }
 
 
+/* The pages themselves are part of the memory section, the page frame
+ * mapping is restored by the paging section */
+static void EMS_SaveState(SnapshotWriter& writer) {
+	writer.WriteStruct(emm_handles,sizeof(emm_handles));
+	writer.WriteStruct(emm_mappings,sizeof(emm_mappings));
+	writer.WriteStruct(emm_segmentmappings,sizeof(emm_segmentmappings));
+	writer.Write(GEMMIS_seg);
+	writer.WriteStruct(&vcpi,sizeof(vcpi));
+}
+static bool EMS_LoadState(SnapshotReader& reader,Bit16u /*version*/) {
+	return reader.ReadStruct(emm_handles,sizeof(emm_handles)) &&
+		reader.ReadStruct(emm_mappings,sizeof(emm_mappings)) &&
+		reader.ReadStruct(emm_segmentmappings,sizeof(emm_segmentmappings)) &&
+		reader.Read(GEMMIS_seg) && reader.ReadStruct(&vcpi,sizeof(vcpi));
+}
+
 class EMS: public Module_base {
 private:
 	DOS_Device * emm_device;
@@ -1381,6 +1398,7 @@ public:
 		Section_prop * section=static_cast<Section_prop *>(configuration);
 		ems_type=GetEMSType(section);
 		if (ems_type<=0) return;
+		SNAPSHOT_Register("EMS",1,EMS_SaveState,EMS_LoadState);
 
 		if (machine==MCH_PCJR) {
 			ems_type=0;
@@ -1474,6 +1492,7 @@ public:
 
 	~EMS() {
 		if (ems_type<=0) return;
+		SNAPSHOT_Unregister("EMS");
 
 		/* Undo Biosclearing */
 		BIOS_ZeroExtendedSize(false);
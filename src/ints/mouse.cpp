@@ -32,6 +32,7 @@
 #include "int10.h"
 #include "bios.h"
 #include "dos_inc.h"
+#include "snapshot.h"
 
 static Bitu call_int33,call_int74,int74_ret_callback,call_mouse_bd;
 static Bit16u ps2cbseg,ps2cbofs;
@@ -1115,6 +1116,33 @@ Bitu UIR_Handler(void) {
 	return CBRET_NONE;
 }
 
+static void MOUSE_SaveState(SnapshotWriter& writer) {
+	writer.WriteStruct(&mouse,sizeof(mouse));
+	/* The mask pointers refer to host arrays; store which set is in use */
+	writer.Write((Bit8u)(mouse.screenMask==userdefScreenMask));
+	writer.WriteStruct(userdefScreenMask,sizeof(userdefScreenMask));
+	writer.WriteStruct(userdefCursorMask,sizeof(userdefCursorMask));
+	writer.Write(ps2cbseg);
+	writer.Write(ps2cbofs);
+	writer.Write(useps2callback);
+	writer.Write(ps2callbackinit);
+	writer.Write(oldmouseX);
+	writer.Write(oldmouseY);
+}
+
+static bool MOUSE_LoadState(SnapshotReader& reader,Bit16u /*version*/) {
+	Bit8u userdef;
+	if (!reader.ReadStruct(&mouse,sizeof(mouse)) || !reader.Read(userdef) ||
+		!reader.ReadStruct(userdefScreenMask,sizeof(userdefScreenMask)) ||
+		!reader.ReadStruct(userdefCursorMask,sizeof(userdefCursorMask)) ||
+		!reader.Read(ps2cbseg) || !reader.Read(ps2cbofs) ||
+		!reader.Read(useps2callback) || !reader.Read(ps2callbackinit) ||
+		!reader.Read(oldmouseX) || !reader.Read(oldmouseY)) return false;
+	mouse.screenMask = userdef ? userdefScreenMask : defaultScreenMask;
+	mouse.cursorMask = userdef ? userdefCursorMask : defaultCursorMask;
+	return true;
+}
+
 void MOUSE_Init(Section* /*sec*/) {
 	// Callback for mouse interrupt 0x33
 	call_int33=CALLBACK_Allocate();
@@ -1194,4 +1222,5 @@ void MOUSE_Init(Section* /*sec*/) {
 	Mouse_ResetHardware();
 	Mouse_Reset();
 	Mouse_SetSensitivity(50,50,50);
+	SNAPSHOT_Register("MOUSE",1,MOUSE_SaveState,MOUSE_LoadState);
 }
@@ -29,6 +29,7 @@
 #include "inout.h"
 #include "xms.h"
 #include "bios.h"
+#include "snapshot.h"
 
 #define XMS_HANDLES							50		/* 50 XMS Memory Blocks */ 
 #define XMS_VERSION    						0x0300	/* version 3.00 */
@@ -414,6 +415,14 @@ Bitu XMS_Handler(void) {
 
 Bitu GetEMSType(Section_prop * section);
 
+/* The blocks themselves are part of the memory section */
+static void XMS_SaveState(SnapshotWriter& writer) {
+	writer.WriteStruct(xms_handles,sizeof(xms_handles));
+}
+static bool XMS_LoadState(SnapshotReader& reader,Bit16u /*version*/) {
+	return reader.ReadStruct(xms_handles,sizeof(xms_handles));
+}
+
 class XMS: public Module_base {
 private:
 	CALLBACK_HandlerObject callbackhandler;
@@ -449,6 +458,7 @@ public:
 		umb_available=section->Get_bool("umb");
 		bool ems_available = GetEMSType(section)>0;
 		DOS_BuildUMBChain(section->Get_bool("umb"),ems_available);
+		SNAPSHOT_Register("XMS",1,XMS_SaveState,XMS_LoadState);
 	}
 
 	~XMS(){
@@ -461,6 +471,7 @@ public:
 		}
 
 		if (!section->Get_bool("xms")) return;
+		SNAPSHOT_Unregister("XMS");
 		/* Undo biosclearing */
 		BIOS_ZeroExtendedSize(false);
 
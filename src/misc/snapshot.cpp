@@ -0,0 +1,355 @@
+/*
+ *  Copyright (C) 2002-2021  The DOSBox Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+#include "dosbox.h"
+#include "pic.h"
+#include "snapshot.h"
+
+/* Layout of a snapshot:
+ *   header:  magic "DBXS", Bit16u format, Bit16u sections, Bit32u payload, Bit32u build,
+ *            Bit32u depth, Bit32u base
+ *   section: char tag[8], Bit16u version, Bit32u layout, Bit32u length, data[length]
+ * The payload size covers the sections only, anything behind it is padding.
+ * Depth is the callback nesting depth at the time of the snapshot. Base is 0
+ * for a full snapshot and names the base of a delta. The layout of a section
+ * identifies the code that wrote it, see SectionLayout. */
+#define SNAPSHOT_FORMAT 2
+#define SNAPSHOT_TAGLEN 8
+#define SNAPSHOT_HEADERLEN (4+2+2+4+4+4+4)
+#define SNAPSHOT_SECTIONLEN (SNAPSHOT_TAGLEN+2+4+4)
+
+static const char snapshot_magic[4] = { 'D','B','X','S' };
+
+struct SnapshotSection {
+	char tag[SNAPSHOT_TAGLEN];
+	Bit16u version;
+	SNAPSHOT_SaveHandler save;
+	SNAPSHOT_LoadHandler load;
+};
+
+static std::vector<SnapshotSection> sections;
+
+/* The base deltas are taken against, 0 while there is none */
+static Bit32u delta_base = 0;
+
+static intptr_t FuncBase(void) {
+	return reinterpret_cast<intptr_t>(&SNAPSHOT_Save);
+}
+
+/* Identifies the binary, function pointer offsets are only valid in the same build */
+static Bit32u BuildId(void) {
+	Bit32u hash = 2166136261u;
+#ifdef GIT_VERSION
+	for (const char* s = GIT_VERSION; *s; s++) hash = (hash ^ (Bit8u)*s) * 16777619u;
+#endif
+	Bit64s layout[3];
+	layout[0] = reinterpret_cast<intptr_t>(&PIC_RunQueue) - FuncBase();
+	layout[1] = reinterpret_cast<intptr_t>(&PIC_AddEvent) - FuncBase();
+	layout[2] = sizeof(void*);
+	const Bit8u* bytes = reinterpret_cast<const Bit8u*>(layout);
+	for (Bitu i = 0; i < sizeof(layout); i++) hash = (hash ^ bytes[i]) * 16777619u;
+	return hash;
+}
+
+static Bit32u HashBytes(Bit32u hash,const void* data,Bitu len) {
+	const Bit8u* bytes = static_cast<const Bit8u*>(data);
+	for (Bitu i = 0; i < len; i++) hash = (hash ^ bytes[i]) * 16777619u;
+	return hash;
+}
+
+/* Where the handlers of a section are in the binary moves with any change
+ * to the code before them, so a section written by other code is rejected
+ * even if the build id happens to match */
+static Bit32u SectionLayout(const SnapshotSection& section) {
+	Bit64s layout[3];
+	layout[0] = reinterpret_cast<intptr_t>(section.save) - FuncBase();
+	layout[1] = reinterpret_cast<intptr_t>(section.load) - FuncBase();
+	layout[2] = section.version;
+	Bit32u hash = HashBytes(2166136261u,section.tag,SNAPSHOT_TAGLEN);
+	return HashBytes(hash,layout,sizeof(layout));
+}
+
+/* Also differs between two instances of the core, a delta must never be
+ * taken for one of the other instance */
+static Bit32u NewBase(void) {
+	static Bit32u serial = 0;
+	const void* instance = &serial;
+	time_t now = time(0);
+	serial++;
+	Bit32u hash = HashBytes(2166136261u,&instance,sizeof(instance));
+	hash = HashBytes(hash,&now,sizeof(now));
+	hash = HashBytes(hash,&serial,sizeof(serial));
+	return hash ? hash : 1;
+}
+
+static void MakeTag(const char* name,char* tag) {
+	memset(tag,0,SNAPSHOT_TAGLEN);
+	size_t len = strlen(name);
+	if (len > SNAPSHOT_TAGLEN) E_Exit("Snapshot section name too long: %s",name);
+	memcpy(tag,name,len);
+}
+
+static SnapshotSection* FindSection(const char* tag) {
+	for (size_t i = 0; i < sections.size(); i++) {
+		if (memcmp(sections[i].tag,tag,SNAPSHOT_TAGLEN) == 0) return &sections[i];
+	}
+	return 0;
+}
+
+void SnapshotWriter::WriteBlock(const void* data,Bitu len) {
+	const Bit8u* src = static_cast<const Bit8u*>(data);
+	if (buf) buf->insert(buf->end(),src,src+len);
+	size += len;
+}
+
+void SnapshotWriter::WriteFuncPtr(SnapshotFunc func) {
+	if (!func) {
+		Write((Bit8u)0);
+		return;
+	}
+	Write((Bit8u)1);
+	Write((Bit64s)(reinterpret_cast<intptr_t>(func) - FuncBase()));
+}
+
+void SnapshotWriter::WriteString(const char* str) {
+	Bit16u len = str ? (Bit16u)strlen(str) : 0;
+	Write(len);
+	WriteBlock(str,len);
+}
+
+bool SnapshotReader::ReadBlock(void* dest,Bitu len) {
+	if (failed || len > size - pos) {
+		failed = true;
+		return false;
+	}
+	memcpy(dest,data+pos,len);
+	pos += len;
+	return true;
+}
+
+bool SnapshotReader::ReadStruct(void* dest,Bitu len) {
+	Bit32u stored;
+	if (!Read(stored)) return false;
+	if (stored != len) {
+		failed = true;
+		return false;
+	}
+	return ReadBlock(dest,len);
+}
+
+bool SnapshotReader::ReadFuncPtr(SnapshotFunc& func) {
+	Bit8u present;
+	if (!Read(present)) return false;
+	if (!present) {
+		func = 0;
+		return true;
+	}
+	Bit64s offset;
+	if (!Read(offset)) return false;
+	func = reinterpret_cast<SnapshotFunc>(FuncBase() + (intptr_t)offset);
+	return true;
+}
+
+bool SnapshotReader::ReadString(char* dest,Bitu len) {
+	Bit16u stored;
+	if (!Read(stored)) return false;
+	if (stored >= len) {
+		failed = true;
+		return false;
+	}
+	if (!ReadBlock(dest,stored)) return false;
+	dest[stored] = 0;
+	return true;
+}
+
+bool SnapshotReader::Skip(Bitu len) {
+	if (failed || len > size - pos) {
+		failed = true;
+		return false;
+	}
+	pos += len;
+	return true;
+}
+
+void SNAPSHOT_Register(const char* tag,Bit16u version,SNAPSHOT_SaveHandler save,SNAPSHOT_LoadHandler load) {
+	SnapshotSection section;
+	MakeTag(tag,section.tag);
+	section.version = version;
+	section.save = save;
+	section.load = load;
+	SnapshotSection* old = FindSection(section.tag);
+	if (old) *old = section;
+	else sections.push_back(section);
+	/* The new module has no base yet */
+	delta_base = 0;
+}
+
+void SNAPSHOT_Unregister(const char* tag) {
+	char key[SNAPSHOT_TAGLEN];
+	MakeTag(tag,key);
+	for (size_t i = 0; i < sections.size(); i++) {
+		if (memcmp(sections[i].tag,key,SNAPSHOT_TAGLEN) == 0) {
+			sections.erase(sections.begin()+i);
+			delta_base = 0;
+			return;
+		}
+	}
+}
+
+bool SNAPSHOT_Save(std::vector<Bit8u>& out,SnapshotType type) {
+	if (type == SNAPSHOT_DELTA && !delta_base) delta_base = NewBase();
+	Bit32u base = (type == SNAPSHOT_DELTA) ? delta_base : 0;
+	out.clear();
+	SnapshotWriter writer(out,type,base);
+	writer.WriteBlock(snapshot_magic,4);
+	writer.Write((Bit16u)SNAPSHOT_FORMAT);
+	writer.Write((Bit16u)sections.size());
+	writer.Write((Bit32u)0);		// payload size, patched below
+	writer.Write(BuildId());
+	writer.Write((Bit32u)DOSBOX_RunDepth());
+	writer.Write(base);
+	for (size_t i = 0; i < sections.size(); i++) {
+		writer.WriteBlock(sections[i].tag,SNAPSHOT_TAGLEN);
+		writer.Write(sections[i].version);
+		writer.Write(SectionLayout(sections[i]));
+		Bitu lenpos = writer.Size();
+		writer.Write((Bit32u)0);
+		sections[i].save(writer);
+		Bit32u len = (Bit32u)(writer.Size() - lenpos - 4);
+		memcpy(&out[lenpos],&len,4);
+	}
+	Bit32u payload = (Bit32u)(out.size() - SNAPSHOT_HEADERLEN);
+	memcpy(&out[8],&payload,4);
+	return true;
+}
+
+Bitu SNAPSHOT_Size(void) {
+	SnapshotWriter writer;
+	for (size_t i = 0; i < sections.size(); i++) sections[i].save(writer);
+	return SNAPSHOT_HEADERLEN + sections.size()*SNAPSHOT_SECTIONLEN + writer.Size();
+}
+
+/* Only called on a section list that has already been checked */
+static bool ApplySections(const Bit8u* data,Bitu payload,Bitu count,SnapshotType type,Bit32u base) {
+	SnapshotReader apply(data,payload);
+	for (Bitu i = 0; i < count; i++) {
+		char tag[SNAPSHOT_TAGLEN];
+		Bit16u version;
+		Bit32u layout,len;
+		if (!apply.ReadBlock(tag,SNAPSHOT_TAGLEN) || !apply.Read(version) ||
+		    !apply.Read(layout) || !apply.Read(len)) return false;
+		const Bit8u* start = data + (payload - apply.Remaining());
+		if (!apply.Skip(len)) return false;
+		SnapshotSection* section = FindSection(tag);
+		if (!section) continue;
+		SnapshotReader reader(start,len,type,base);
+		if (!section->load(reader,version) || reader.Failed()) {
+			LOG_MSG("SNAPSHOT: Failed to restore section %.8s",tag);
+			return false;
+		}
+	}
+	return true;
+}
+
+bool SNAPSHOT_Load(const Bit8u* data,Bitu size) {
+	SnapshotReader header(data,size);
+	char magic[4];
+	Bit16u format,count;
+	Bit32u payload,build,depth,base;
+	if (!header.ReadBlock(magic,4) || !header.Read(format) || !header.Read(count) ||
+	    !header.Read(payload) || !header.Read(build) || !header.Read(depth) || !header.Read(base)) {
+		LOG_MSG("SNAPSHOT: Data too short");
+		return false;
+	}
+	if (memcmp(magic,snapshot_magic,4) != 0 || format != SNAPSHOT_FORMAT) {
+		LOG_MSG("SNAPSHOT: Unknown data format");
+		return false;
+	}
+	if (build != BuildId()) {
+		LOG_MSG("SNAPSHOT: Created by a different build, not loading");
+		return false;
+	}
+	if (depth != DOSBOX_RunDepth()) {
+		LOG_MSG("SNAPSHOT: Taken at callback depth %d, the machine is at %d, not loading",
+			(int)depth,(int)DOSBOX_RunDepth());
+		return false;
+	}
+	if (payload > header.Remaining()) {
+		LOG_MSG("SNAPSHOT: Data truncated");
+		return false;
+	}
+	if (base && base != delta_base) {
+		LOG_MSG("SNAPSHOT: Delta of an older base or another instance, not loading");
+		return false;
+	}
+	SnapshotType type = base ? SNAPSHOT_DELTA : SNAPSHOT_FULL;
+
+	/* Check the whole section list before touching the machine */
+	std::vector<bool> found(sections.size(),false);
+	SnapshotReader walk(data+SNAPSHOT_HEADERLEN,payload);
+	for (Bitu i = 0; i < count; i++) {
+		char tag[SNAPSHOT_TAGLEN];
+		Bit16u version;
+		Bit32u layout,len;
+		if (!walk.ReadBlock(tag,SNAPSHOT_TAGLEN) || !walk.Read(version) || !walk.Read(layout) ||
+		    !walk.Read(len) || !walk.Skip(len)) {
+			LOG_MSG("SNAPSHOT: Corrupt section list");
+			return false;
+		}
+		SnapshotSection* section = FindSection(tag);
+		if (!section) {
+			LOG_MSG("SNAPSHOT: Skipping unknown section %.8s",tag);
+			continue;
+		}
+		if (version == 0 || version > section->version) {
+			LOG_MSG("SNAPSHOT: Section %.8s has unsupported version %d",tag,version);
+			return false;
+		}
+		if (version == section->version && layout != SectionLayout(*section)) {
+			LOG_MSG("SNAPSHOT: Section %.8s was written by different code",tag);
+			return false;
+		}
+		found[section - &sections[0]] = true;
+	}
+	for (size_t i = 0; i < sections.size(); i++) {
+		if (!found[i]) {
+			LOG_MSG("SNAPSHOT: Section %.8s missing",sections[i].tag);
+			return false;
+		}
+	}
+
+	/* A section can still turn out not to fit the machine after the ones
+	 * before it have been applied, so keep the current state to go back to */
+	std::vector<Bit8u> backup;
+	SNAPSHOT_Save(backup,type);
+	bool loaded = ApplySections(data+SNAPSHOT_HEADERLEN,payload,count,type,base);
+	if (!loaded && !ApplySections(&backup[SNAPSHOT_HEADERLEN],backup.size()-SNAPSHOT_HEADERLEN,
+	                              sections.size(),type,base))
+		E_Exit("SNAPSHOT: Could not restore the machine after a failed load");
+	/* Guest memory was replaced without the tracking seeing it, the next
+	 * delta has to start a new base */
+	if (type == SNAPSHOT_FULL) delta_base = 0;
+	if (!loaded) LOG_MSG("SNAPSHOT: Load failed, machine state unchanged");
+	return loaded;
+}